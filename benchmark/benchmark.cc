@@ -56,14 +56,23 @@
 #include "benchmarks/avg_teen_cnt.h"
 #include "benchmarks/bc_adj.h"
 #include "benchmarks/bc_random.h"
+#include "benchmarks/benchmark_results.h"
 #include "benchmarks/bfs.h"
+#include "benchmarks/mixed_workload.h"
 #include "benchmarks/pagerank.h"
+#include "benchmarks/perf_counters.h"
 #include "benchmarks/sssp.h"
 #include "benchmarks/tarjan_scc.h"
 #include "benchmarks/triangle_counting.h"
 
+#include "tests/checkpoint_readers.h"
 #include "tests/delete_edges.h"
 #include "tests/delete_nodes.h"
+#include "tests/growable_array.h"
+#include "tests/root_record.h"
+#include "tests/snapshot.h"
+#include "tests/wal.h"
+#include "tests/wal_replay.h"
 
 #include "tools/cross_validate.h"
 #include "tools/level_spread.h"
@@ -112,6 +121,68 @@ typedef ll_mlcsr_ro_graph benchmarkable_graph_t;
 #endif
 
 
+/**
+ * The configuration macros in effect (for the machine-readable results)
+ */
+static const char* g_configuration_macros[] = {
+#ifdef LL_MEMORY_ONLY
+	"LL_MEMORY_ONLY",
+#endif
+#ifdef LL_PERSISTENCE
+	"LL_PERSISTENCE",
+#endif
+#ifdef LL_STREAMING
+	"LL_STREAMING",
+#endif
+#ifdef LL_SLCSR
+	"LL_SLCSR",
+#endif
+#ifdef LL_DELETIONS
+	"LL_DELETIONS",
+#endif
+#ifdef LL_TX
+	"LL_TX",
+#endif
+#ifdef LL_TIMESTAMPS
+	"LL_TIMESTAMPS",
+#endif
+#ifdef LL_ONE_VT
+	"LL_ONE_VT",
+#endif
+#ifdef LL_FLAT_VT
+	"LL_FLAT_VT",
+#endif
+#ifdef LL_MLCSR_CONTINUATIONS
+	"LL_MLCSR_CONTINUATIONS",
+#endif
+#ifdef LL_IO_URING
+	"LL_IO_URING",
+#endif
+#ifdef LL_WAL
+	"LL_WAL",
+#endif
+#ifdef LL_BUFFER_POOL
+	"LL_BUFFER_POOL",
+#endif
+#ifdef LL_COUNTERS
+	"LL_COUNTERS",
+#endif
+#ifdef BENCHMARK_WRITABLE
+	"BENCHMARK_WRITABLE",
+#endif
+#ifdef BENCHMARK_CONCURRENT_LOAD
+	"BENCHMARK_CONCURRENT_LOAD",
+#endif
+#ifdef DO_CP
+	"DO_CP",
+#endif
+#if defined(BENCHMARK_TASK_ID) && BENCHMARK_TASK_ID >= 0
+	"BENCHMARK_TASK_ID",
+#endif
+	NULL
+};
+
+
 
 //==========================================================================//
 // Testing                                                                  //
@@ -309,9 +380,27 @@ public:
 	std::vector<size_t> io_write_bytes;
 	std::vector<size_t> io_cancelled_write_bytes;
 
+#if defined(__linux__)
+	std::vector<perf_values> perf_load;
+	std::vector<perf_values> perf_load_cp;
+	std::vector<perf_values> perf_delete_snapshot;
+	std::vector<perf_values> perf_runs;
+#endif
+
 
 private:
 
+	// Hardware performance counters (NULL if disabled)
+
+#if defined(__linux__)
+	perf_counters* _perf;
+	std::vector<uint64_t> _b_perf_start;
+	std::vector<uint64_t> _l_perf_start;
+	std::vector<uint64_t> _l_perf_cp_start;
+	std::vector<uint64_t> _d_perf_start;
+#endif
+
+
 	// Benchmark stats
 	
 #if defined(__linux__)
@@ -348,6 +437,42 @@ public:
 
 		start_time = time(NULL);
 		localtime_r(&start_time, &tm_start_time);
+
+#if defined(__linux__)
+		_perf = NULL;
+#endif
+	}
+
+
+	/**
+	 * Destroy the instance
+	 */
+	~ll_benchmark_stats(void) {
+#if defined(__linux__)
+		if (_perf != NULL) delete _perf;
+#endif
+	}
+
+
+	/**
+	 * Enable the hardware performance counters, if they are available
+	 *
+	 * @param num_threads the number of OpenMP threads
+	 * @return true if enabled
+	 */
+	bool enable_perf(int num_threads) {
+#if defined(__linux__)
+		if (_perf != NULL) return true;
+		_perf = new perf_counters(num_threads);
+		if (_perf->available()) return true;
+		delete _perf;
+		_perf = NULL;
+#else
+		(void) num_threads;
+		fprintf(stderr, "Warning: Hardware performance counters are "
+				"supported only on Linux\n");
+#endif
+		return false;
 	}
 
 
@@ -358,6 +483,7 @@ public:
 
 #if defined(__linux__)
 		getiostat(&_b_io_start);
+		perf_start(_b_perf_start);
 #endif
 
 		getrusage(RUSAGE_SELF, &_b_ru_start);
@@ -375,6 +501,7 @@ public:
 		getrusage(RUSAGE_SELF, &ru_end);
 
 #if defined(__linux__)
+		perf_stop(_b_perf_start, perf_runs);
 		struct io_stat io_end;
 		getiostat(&io_end);
 #endif
@@ -415,6 +542,9 @@ public:
 	 */
 	void before_load(void) {
 
+#if defined(__linux__)
+		perf_start(_l_perf_start);
+#endif
 		_l_t_start = ll_get_time_ms();
 	}
 
@@ -426,6 +556,9 @@ public:
 
 		double t = ll_get_time_ms() - _l_t_start;
 		load_times.push_back(t);
+#if defined(__linux__)
+		perf_stop(_l_perf_start, perf_load);
+#endif
 
 		struct rusage r_loaded;
 		getrusage(RUSAGE_SELF, &r_loaded);
@@ -457,6 +590,9 @@ public:
 	 */
 	void before_load_cp(void) {
 
+#if defined(__linux__)
+		perf_start(_l_perf_cp_start);
+#endif
 		_l_t_cp_start = ll_get_time_ms();
 	}
 
@@ -468,6 +604,9 @@ public:
 
 		double t = ll_get_time_ms() - _l_t_cp_start;
 		load_cp_times.push_back(t);
+#if defined(__linux__)
+		perf_stop(_l_perf_cp_start, perf_load_cp);
+#endif
 	}
 
 
@@ -476,6 +615,9 @@ public:
 	 */
 	void before_delete_snapshot(void) {
 
+#if defined(__linux__)
+		perf_start(_d_perf_start);
+#endif
 		_d_t_start = ll_get_time_ms();
 	}
 
@@ -487,6 +629,9 @@ public:
 
 		double t = ll_get_time_ms() - _d_t_start;
 		delete_snapshot_times.push_back(t);
+#if defined(__linux__)
+		perf_stop(_d_perf_start, perf_delete_snapshot);
+#endif
 	}
 
 
@@ -577,12 +722,121 @@ public:
 #endif
 			}
 		}
+
+#if defined(__linux__)
+		print_perf(f, "\nLOAD COUNTERS\n", perf_load, load_times);
+		print_perf(f, "\nCHECKPOINT COUNTERS\n", perf_load_cp, load_cp_times);
+		print_perf(f, "\nDELETE SNAPSHOT COUNTERS\n", perf_delete_snapshot,
+				delete_snapshot_times);
+		print_perf(f, "\nRUN COUNTERS\n", perf_runs, runtimes);
+#endif
+
 		printf("\n");
 
 		fflush(f);
 	}
 
 
+	/**
+	 * Print the hardware performance counters of the last run on one line
+	 *
+	 * @param f the output file
+	 */
+	void print_last_perf_run(FILE* f) const {
+
+#if defined(__linux__)
+		if (perf_runs.empty()) return;
+		const perf_values& p = perf_runs[perf_runs.size()-1];
+
+		fprintf(f, "         ");
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+			if (std::isnan(p.pv_values[e])) continue;
+			fprintf(f, " %s=%0.0lf", PERF_EVENT_IDS[e], p.pv_values[e]);
+		}
+
+		double ipc = p.pv_values[PERF_INSTRUCTIONS] / p.pv_values[PERF_CYCLES];
+		if (!std::isnan(ipc)) fprintf(f, " ipc=%0.2lf", ipc);
+		fprintf(f, "\n");
+#else
+		(void) f;
+#endif
+	}
+
+
+#if defined(__linux__)
+
+	/**
+	 * Print the hardware performance counters of a phase
+	 *
+	 * @param f the output file
+	 * @param title the section title
+	 * @param values the counter values of the individual runs of the phase
+	 * @param times the corresponding times in ms
+	 */
+	void print_perf(FILE* f, const char* title,
+			std::vector<perf_values>& values, std::vector<double>& times) {
+
+		if (values.empty()) return;
+		fprintf(f, "%s", title);
+
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+			std::vector<double> x;
+			for (size_t i = 0; i < values.size(); i++)
+				x.push_back(values[i].pv_values[e]);
+			print_perf_value(f, PERF_EVENT_LABELS[e], x, 0, "");
+		}
+
+
+		// Derived metrics; the LLC traffic assumes 64-byte lines and is thus
+		// only an estimate of the memory bandwidth
+
+		std::vector<double> ipc;
+		std::vector<double> llc_traffic;
+		for (size_t i = 0; i < values.size(); i++) {
+			const double* v = values[i].pv_values;
+			ipc.push_back(v[PERF_INSTRUCTIONS] / v[PERF_CYCLES]);
+			llc_traffic.push_back(i >= times.size() || times[i] <= 0 ? NAN
+					: v[PERF_LLC_MISSES] * 64 / (times[i] / 1000.0)
+					/ (1024.0*1024.0*1024.0));
+		}
+
+		print_perf_value(f, "IPC        : ", ipc, 2, "");
+		print_perf_value(f, "LLC Traffic: ", llc_traffic, 2, " GB/s");
+	}
+
+
+	/**
+	 * Print a hardware performance counter value, with the confidence
+	 * interval if there are multiple runs
+	 *
+	 * @param f the output file
+	 * @param prefix the prefix
+	 * @param x the values of the individual runs
+	 * @param precision the number of decimal places
+	 * @param suffix the suffix
+	 */
+	void print_perf_value(FILE* f, const char* prefix, std::vector<double>& x,
+			int precision, const char* suffix) {
+
+		for (size_t i = 0; i < x.size(); i++) {
+			if (std::isnan(x[i]) || std::isinf(x[i])) {
+				fprintf(f, "%sn/a\n", prefix);
+				return;
+			}
+		}
+
+		if (x.size() == 1) {
+			fprintf(f, "%s%0.*lf%s\n", prefix, precision, x[0], suffix);
+		}
+		else {
+			fprintf(f, "%s%0.*lf +- %0.*lf%s\n", prefix, precision, ll_mean(x),
+					precision, ll_c95(x), suffix);
+		}
+	}
+
+#endif
+
+
 	/**
 	 * Save the statistics to a file
 	 *
@@ -675,6 +929,18 @@ public:
 		data << "," << ll_mean(in_blocks);
 		data << "," << ll_mean(out_blocks);
 
+#if defined(__linux__)
+		if (!perf_runs.empty()) {
+			for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+				double sum = 0;
+				for (size_t i = 0; i < perf_runs.size(); i++)
+					sum += perf_runs[i].pv_values[e];
+				header << "," << PERF_EVENT_IDS[e];
+				data << "," << sum / perf_runs.size();
+			}
+		}
+#endif
+
 		fprintf(f, "%s\n%s\n\n", header.str().c_str(), data.str().c_str());
 
 
@@ -683,6 +949,12 @@ public:
 		header.str("");
 		header << "id,runtime_ms,cpu_ms,cpu_util";
 		header << ",major_faults,in_blocks,out_blocks";
+#if defined(__linux__)
+		if (perf_runs.size() == runtimes.size() && !perf_runs.empty()) {
+			for (int e = 0; e < PERF_NUM_EVENTS; e++)
+				header << "," << PERF_EVENT_IDS[e];
+		}
+#endif
 
 		fprintf(f, "%s\n", header.str().c_str());
 
@@ -694,6 +966,12 @@ public:
 			data << "," << major_faults[i];
 			data << "," << in_blocks[i];
 			data << "," << out_blocks[i];
+#if defined(__linux__)
+			if (perf_runs.size() == runtimes.size()) {
+				for (int e = 0; e < PERF_NUM_EVENTS; e++)
+					data << "," << perf_runs[i].pv_values[e];
+			}
+#endif
 			fprintf(f, "%s\n", data.str().c_str());
 		}
 
@@ -702,6 +980,85 @@ public:
 
 		fclose(f);
 	}
+
+
+	/**
+	 * Export the statistics into the machine-readable results
+	 *
+	 * @param r the results
+	 */
+	void export_results(ll_benchmark_results& r) {
+
+		r.add_runs("runtime_ms", runtimes);
+		r.add_runs("cpu_ms", cpu_times);
+		r.add_runs("cpu_user_ms", cpu_user_times);
+		r.add_runs("cpu_sys_ms", cpu_sys_times);
+		r.add_runs("major_faults", major_faults);
+		r.add_runs("in_blocks", in_blocks);
+		r.add_runs("out_blocks", out_blocks);
+
+		r.add_load("load_ms", load_times);
+		r.add_load("load_pull_ms", load_pull_times);
+		r.add_load("load_cp_ms", load_cp_times);
+		r.add_load("delete_snapshot_ms", delete_snapshot_times);
+
+		if (!load_times.empty()) {
+			r.set_graph("load_memory_mb",
+					(maxrss_loaded - maxrss_start) / 1024.0);
+		}
+
+#if defined(__linux__)
+		r.add_runs("io_read_bytes", io_read_bytes);
+		r.add_runs("io_write_bytes", io_write_bytes);
+
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+			std::vector<double> v_runs;
+			std::vector<double> v_load;
+			for (size_t i = 0; i < perf_runs.size(); i++)
+				v_runs.push_back(perf_runs[i].pv_values[e]);
+			for (size_t i = 0; i < perf_load.size(); i++)
+				v_load.push_back(perf_load[i].pv_values[e]);
+			if (!v_runs.empty()) r.add_runs(PERF_EVENT_IDS[e], v_runs);
+			if (!v_load.empty()) r.add_load(PERF_EVENT_IDS[e], v_load);
+		}
+#endif
+	}
+
+
+private:
+
+#if defined(__linux__)
+
+	/**
+	 * Read the hardware performance counters at the start of a phase
+	 *
+	 * @param start the output for the raw counters
+	 */
+	void perf_start(std::vector<uint64_t>& start) {
+		if (_perf != NULL) _perf->read_all(start);
+	}
+
+
+	/**
+	 * Read the hardware performance counters at the end of a phase
+	 *
+	 * @param start the raw counters at the start of the phase
+	 * @param out the vector to which to append the values of the phase
+	 */
+	void perf_stop(const std::vector<uint64_t>& start,
+			std::vector<perf_values>& out) {
+
+		if (_perf == NULL) return;
+
+		std::vector<uint64_t> end;
+		_perf->read_all(end);
+
+		perf_values v;
+		_perf->diff(end, start, v);
+		out.push_back(v);
+	}
+
+#endif
 };
 
 
@@ -721,6 +1078,12 @@ public:
 	bool print_progress;
 	bool verbose;
 
+#ifdef LL_COUNTERS
+	ll_counters_snapshot_t counters_before;	// at the start of the run
+	ll_counters_snapshot_t counters_run;	// during the last run
+	std::vector<ll_counters_snapshot_t> counters_runs;
+#endif
+
 
 public:
 
@@ -737,6 +1100,11 @@ public:
 
 		print_progress = true;
 		verbose = false;
+
+#ifdef LL_COUNTERS
+		memset(&counters_before, 0, sizeof(counters_before));
+		memset(&counters_run, 0, sizeof(counters_run));
+#endif
 	}
 
 
@@ -809,6 +1177,10 @@ public:
 				}
 			}
 		}
+
+#ifdef LL_COUNTERS
+		counters_before = ll_counters_snapshot();
+#endif
 	}
 
 
@@ -819,6 +1191,12 @@ public:
 	 */
 	void print_after_benchmark(const ll_benchmark_stats& stats) {
 
+#ifdef LL_COUNTERS
+		counters_run = ll_counters_diff(ll_counters_snapshot(),
+				counters_before);
+		counters_runs.push_back(counters_run);
+#endif
+
 		if (print_progress && verbose) {
 			double t = stats.runtimes[stats.runtimes.size()-1];
 #ifdef LL_STREAMING
@@ -848,6 +1226,10 @@ public:
 #	endif
 #else
 			print_time(stderr, "", t);
+#endif
+			stats.print_last_perf_run(stderr);
+#ifdef LL_COUNTERS
+			ll_print_counters(counters_run, stderr, "=");
 #endif
 		}
 	}
@@ -942,6 +1324,33 @@ static ll_runnable_thing g_runnable_things[] = {
 	{ "ll_b_sssp_unweighted_iter" , "sssp_unweighted_iter"
 	                              , "Unweighted SSSP - iterative"
 	                              , false },
+	{ "ll_b_mixed_workload"       , "mixed_workload"
+	                              , "Mixed read/write workload (configure using -w)"
+	                              , false },
+	{ "ll_b_sssp_unweighted_em"   , "sssp_unweighted_em"
+	                              , "Unweighted SSSP - edge map"
+	                              , false },
+	{ "ll_b_pagerank_scan_float"  , "pagerank_scan"
+	                              , "PageRank - edge-centric scan"
+	                              , false },
+	{ "ll_t_snapshot"             , "t:snapshot"
+	                              , "Regression test: snapshot isolation"
+	                              , true  },
+	{ "ll_t_wal"                  , "t:wal"
+	                              , "Regression test: write-ahead log recovery"
+	                              , false },
+	{ "ll_t_root_record"          , "t:root_record"
+	                              , "Regression test: root record recovery"
+	                              , false },
+	{ "ll_t_checkpoint_readers"   , "t:checkpoint_readers"
+	                              , "Regression test: readers during checkpoints"
+	                              , false },
+	{ "ll_t_growable_array"       , "t:growable_array"
+	                              , "Regression test: growable array appends"
+	                              , false },
+	{ "ll_t_wal_replay"           , "t:wal_replay"
+	                              , "Regression test: write-ahead log replay"
+	                              , false },
 	{ NULL, NULL, NULL, false }
 };
 
@@ -973,8 +1382,8 @@ static ll_runnable_thing g_runnable_things[] = {
 // The Command-Line Arguments                                               //
 //==========================================================================//
 
-static const char* SHORT_OPTIONS = "c:C:d:DIhl:Ln:No:OP:r:R:t:ST:UvX:"
-	IF_LL_STREAMING("B:M:W:");
+static const char* SHORT_OPTIONS = "A:c:C:d:DH:Ihj:JLl:n:No:OpP:r:R:t:ST:Uvw:X:"
+	IF_LL_STREAMING("B:E:i:M:W:") IF_LL_BUFFER_POOL("m:");
 
 static struct option LONG_OPTIONS[] =
 {
@@ -983,13 +1392,18 @@ static struct option LONG_OPTIONS[] =
 	{"database"     , required_argument, 0, 'd'},
 	{"deduplicate"  , no_argument      , 0, 'D'},
 	{"help"         , no_argument,       0, 'h'},
+	{"huge-pages"   , required_argument, 0, 'H'},
 	{"in-edges"     , no_argument,       0, 'I'},
+	{"results"      , required_argument, 0, 'j'},
+	{"compare-results", no_argument,     0, 'J'},
 	{"level"        , required_argument, 0, 'l'},
 	{"levels"       , required_argument, 0, 'l'},
 	{"load"         , no_argument,       0, 'L'},
 	{"num-iters"    , required_argument, 0, 'n'},
 	{"no-properties", no_argument,       0, 'N'},
+	{"numa"         , required_argument, 0, 'A'},
 	{"output"       , required_argument, 0, 'o'},
+	{"perf"         , no_argument,       0, 'p'},
 	{"print"        , required_argument, 0, 'P'},
 	{"run"          , required_argument, 0, 'r'},
 	{"root"         , required_argument, 0, 'R'},
@@ -999,11 +1413,17 @@ static struct option LONG_OPTIONS[] =
 	{"undir-double" , no_argument,       0, 'U'},
 	{"undir-order"  , no_argument,       0, 'O'},
 	{"verbose"      , no_argument,       0, 'v'},
+	{"workload"     , required_argument, 0, 'w'},
 	{"xs-buffer"    , required_argument, 0, 'X'},
 #ifdef LL_STREAMING
 	{"batch"        , required_argument, 0, 'B'},
+	{"ttl"          , required_argument, 0, 'E'},
+	{"ingest"       , required_argument, 0, 'i'},
 	{"max-batches"  , required_argument, 0, 'M'},
 	{"window"       , required_argument, 0, 'W'},
+#endif
+#ifdef LL_BUFFER_POOL
+	{"buffer-pool"  , required_argument, 0, 'm'},
 #endif
 	{0, 0, 0, 0}
 };
@@ -1022,6 +1442,8 @@ static void usage(const char* arg0) {
 	free(s);
 	
 	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -A, --numa POLICY     Set the NUMA policy (default, interleave,\n"
+	                "                        first-touch)\n");
 #ifdef LL_STREAMING
 	fprintf(stderr, "  -B, --batch N         Set the batch size for advancing the stream\n");
 #endif
@@ -1029,12 +1451,25 @@ static void usage(const char* arg0) {
 	fprintf(stderr, "  -C, --compare FILE    Compare graph to the one in the given file\n");
 	fprintf(stderr, "  -d, --database DIR    Set the database directory\n");
 	fprintf(stderr, "  -D, --deduplicate     Deduplicate edges within level while loading\n");
+#ifdef LL_STREAMING
+	fprintf(stderr, "  -E, --ttl MS          Expire the batches older than MS milliseconds\n");
+#endif
 	fprintf(stderr, "  -h, --help            Show this usage information and exit\n");
+	fprintf(stderr, "  -H, --huge-pages MODE Set the huge page policy (none, thp, hugetlb)\n");
+#ifdef LL_STREAMING
+	fprintf(stderr, "  -i, --ingest N        Load through the ingest service with N appliers\n");
+#endif
 	fprintf(stderr, "  -I, --in-edges        Load or generate in-edges\n");
+	fprintf(stderr, "  -j, --results FILE    Save the results as JSON (or CSV if FILE is .csv)\n");
+	fprintf(stderr, "  -J, --compare-results Compare two result files given as the inputs\n"
+	                "                        (baseline first); exit with 2 on regression\n");
 	fprintf(stderr, "  -l, --level N[-M]     Set the level or the min and max levels\n");
 #ifdef LL_PERSISTENCE
 	fprintf(stderr, "  -L, --load            Load the input files into the database\n");
 #endif
+#ifdef LL_BUFFER_POOL
+	fprintf(stderr, "  -m, --buffer-pool MB  Limit the resident edges and properties to MB\n");
+#endif
 #ifdef LL_STREAMING
 	fprintf(stderr, "  -M, --max-batches M   Set the maximum number of batches\n");
 #endif
@@ -1042,6 +1477,7 @@ static void usage(const char* arg0) {
 	fprintf(stderr, "  -N, --no-properties   Do not load (ingest) properties\n");
 	fprintf(stderr, "  -o, --output FILE     Write the query output to a file\n");
 	fprintf(stderr, "  -O, --undir-order     Load undirected by ordering all edges\n");
+	fprintf(stderr, "  -p, --perf            Collect hardware performance counters\n");
 	fprintf(stderr, "  -P, --print N[-M]     Print edges adjacent to one or more nodes\n");
 #if BENCHMARK_TASK_ID < 0
 	fprintf(stderr, "  -r, --run TASK        Run a task\n");
@@ -1052,6 +1488,9 @@ static void usage(const char* arg0) {
 	fprintf(stderr, "  -T, --temp DIR        Add a temporary directory\n");
 	fprintf(stderr, "  -U, --undir-double    Load undirected by doubling all edges\n");
 	fprintf(stderr, "  -v, --verbose         Enable verbose output\n");
+	fprintf(stderr, "  -w, --workload SPEC   Configure the mixed_workload task, e.g.\n"
+	                "                        find=40,scan=20,insert=30,delete=10,zipf=0.99,\n"
+	                "                        hot=0.01:0.5,ops=1000000,clients=4,checkpoint=100\n");
 #ifdef LL_STREAMING
 	fprintf(stderr, "  -W, --window N        Set the sliding window size to be N batches\n");
 #endif
@@ -1093,13 +1532,14 @@ static void usage(const char* arg0) {
  * @param data_source the data source
  * @param loader_config the loader configuration
  * @param batch_size the batch size (the max number of edges to load)
- * @param window_size the streaming window size (if streaming)
+ * @param window the streaming window (if streaming)
  * @param stats the stats
  * @return true if the graph was loaded
  */
 bool load_batch_via_writable_graph(ll_writable_graph& graph,
 		ll_data_source& data_source, const ll_loader_config& loader_config,
-		size_t batch_size, ssize_t window_size, ll_benchmark_stats& stats) {
+		size_t batch_size, IF_LL_STREAMING(ll_sliding_window& window,)
+		ll_benchmark_stats& stats) {
 
 	stats.before_load();
 
@@ -1113,14 +1553,9 @@ bool load_batch_via_writable_graph(ll_writable_graph& graph,
 	stats.after_load_cp();
 
 #ifdef LL_STREAMING
-	if (window_size > 0 && graph.num_levels() >= (size_t) window_size) {
-		graph.set_min_level(graph.num_levels() - window_size);
-		if (graph.num_levels() >= (size_t) window_size + 2) {
-			stats.before_delete_snapshot();
-			graph.delete_level(graph.num_levels() - window_size - 2);
-			stats.after_delete_snapshot();
-		}
-	}
+	stats.before_delete_snapshot();
+	window.expire();
+	stats.after_delete_snapshot();
 #endif
 
 	stats.after_load();
@@ -1154,6 +1589,152 @@ double run_benchmark(Graph& graph, ll_benchmark<Graph>* benchmark,
 }
 
 
+#ifdef LL_STREAMING
+
+/**
+ * The checkpoint of the streaming benchmark through the ingest service,
+ * which also expires the levels that fell out of the window while the
+ * appliers are parked
+ */
+struct ll_b_ingest_checkpoint {
+
+	ll_writable_graph& _graph;
+	const ll_loader_config& _loader_config;
+	ll_sliding_window& _window;
+	ll_benchmark_stats& _stats;
+
+	ll_b_ingest_checkpoint(ll_writable_graph& graph,
+			const ll_loader_config& loader_config, ll_sliding_window& window,
+			ll_benchmark_stats& stats)
+		: _graph(graph), _loader_config(loader_config), _window(window),
+		  _stats(stats) {}
+
+	void operator() (void) {
+
+		_stats.before_load_cp();
+		_graph.checkpoint(&_loader_config);
+		_stats.after_load_cp();
+
+		_stats.before_delete_snapshot();
+		_window.expire();
+		_stats.after_delete_snapshot();
+	}
+};
+
+
+/**
+ * Stream the batches through the pipelined ingest service and run the
+ * benchmark after each batch. A controller thread checkpoints each batch
+ * once it was fully submitted and then runs the benchmark, a producer thread
+ * submits the next batch while that happens, and the remaining threads apply
+ * the requests. Since the producer does not wait for the checkpoint to
+ * finish, a level can include the first few edges of the next batch.
+ *
+ * @param graph the writable graph
+ * @param G the graph to benchmark
+ * @param benchmark the benchmark
+ * @param data_source the data source
+ * @param loader_config the loader configuration
+ * @param batch_size the batch size
+ * @param num_appliers the number of applier threads
+ * @param window the streaming window
+ * @param counter the benchmark counter
+ * @param stats the stats
+ * @param ingest_stats the output ingest statistics
+ * @return the return value of the last benchmark run
+ */
+template <class Graph>
+double stream_via_ingest(ll_writable_graph& graph, Graph& G,
+		ll_benchmark<Graph>* benchmark, ll_data_source& data_source,
+		const ll_loader_config& loader_config, size_t batch_size,
+		size_t num_appliers, ll_sliding_window& window,
+		ll_benchmark_counter& counter, ll_benchmark_stats& stats,
+		ll_la_ingest_stats_t* ingest_stats) {
+
+	double return_d = 0;
+	int task_threads = omp_get_max_threads();
+
+	ll_la_ingest ingest(&graph, num_appliers, 2 * batch_size);
+	ll_b_ingest_checkpoint checkpoint(graph, loader_config, window, stats);
+
+	volatile size_t submitted_batches = 0;
+	volatile size_t checkpointed_batches = 0;
+	volatile bool submitted_all = false;
+
+	omp_set_nested(1);
+
+#	pragma omp parallel num_threads(num_appliers + 2)
+	{
+		int t = omp_get_thread_num();
+
+		if (t == 0) {
+
+			// The producer
+
+			while (counter.max_batches <= 0
+					|| submitted_batches < counter.max_batches) {
+
+				// Start the next batch only after the checkpoint of the
+				// previous batch started, so that the two overlap
+
+				while (submitted_batches > checkpointed_batches) usleep(10);
+				if (!data_source.pull(&ingest, batch_size)) break;
+				__sync_fetch_and_add(&submitted_batches, 1);
+			}
+
+			submitted_all = true;
+		}
+		else if (t == 1) {
+
+			// The controller
+
+			omp_set_num_threads(task_threads);
+
+			while (true) {
+
+				counter.print_before_batch();
+				stats.before_load();
+
+				stats.before_load_pull();
+				while (submitted_batches <= counter.current_batch
+						&& !submitted_all) usleep(10);
+				stats.after_load_pull();
+				if (submitted_batches <= counter.current_batch) break;
+
+				checkpointed_batches = counter.current_batch + 1;
+				ingest.checkpoint_with(checkpoint);
+
+				stats.after_load();
+				counter.current_batch++;
+				counter.print_after_batch_load(stats);
+
+				for (counter.current_iteration = 0;
+						counter.current_iteration < counter.benchmark_count;
+						counter.current_iteration++) {
+
+					counter.print_before_benchmark();
+					return_d = run_benchmark(G, benchmark, stats);
+					counter.print_after_benchmark(stats);
+				}
+			}
+
+			ingest.shutdown();
+		}
+		else {
+
+			// The appliers
+
+			ingest.applier(t - 2);
+		}
+	}
+
+	ingest.stats(ingest_stats);
+	return return_d;
+}
+
+#endif
+
+
 
 
 //==========================================================================//
@@ -1169,9 +1750,12 @@ int main(int argc, char** argv)
 	char* database_directory = NULL;
 	char* run_task = NULL;
 	char* output_file = NULL;
+	char* results_file = NULL;
 
 	bool verbose = false;
 	bool save_execution_statistics = false;
+	bool perf = false;
+	bool compare_results = false;
 
 	ll_benchmark_counter counter;
 
@@ -1192,6 +1776,15 @@ int main(int argc, char** argv)
 
 	int streaming_batch = 1000 * 1000; (void) streaming_batch;
 	int streaming_window = 10; (void) streaming_window;
+	double streaming_ttl = 0; (void) streaming_ttl;
+	int ingest_appliers = 0; (void) ingest_appliers;
+
+	double buffer_pool_mb = -1; (void) buffer_pool_mb;
+
+	ll_memory_policy_t memory_policy = ll_memory_policy();
+
+	ll_workload_config_t workload_config;
+	ll_workload_config_init(&workload_config);
 
 
 	// Pase the command-line arguments
@@ -1204,6 +1797,14 @@ int main(int argc, char** argv)
 
 		switch (c) {
 
+			case 'A':
+				memory_policy.mp_numa = ll_parse_numa_policy(optarg);
+				if (memory_policy.mp_numa < 0) {
+					fprintf(stderr, "Error: Invalid NUMA policy\n");
+					return 1;
+				}
+				break;
+
 			case 'B':
 				streaming_batch = atoi(optarg);
 				if (streaming_batch <= 0) {
@@ -1228,6 +1829,30 @@ int main(int argc, char** argv)
 				loader_config.lc_deduplicate = true;
 				break;
 
+			case 'E':
+				streaming_ttl = atof(optarg);
+				if (streaming_ttl <= 0) {
+					fprintf(stderr, "Error: The time to live must be positive\n");
+					return 1;
+				}
+				break;
+
+			case 'i':
+				ingest_appliers = atoi(optarg);
+				if (ingest_appliers <= 0) {
+					fprintf(stderr, "Error: The number of appliers must be positive\n");
+					return 1;
+				}
+				break;
+
+			case 'H':
+				memory_policy.mp_huge_pages = ll_parse_huge_page_policy(optarg);
+				if (memory_policy.mp_huge_pages < 0) {
+					fprintf(stderr, "Error: Invalid huge page policy\n");
+					return 1;
+				}
+				break;
+
 			case 'h':
 				usage(argv[0]);
 				return 0;
@@ -1250,6 +1875,14 @@ int main(int argc, char** argv)
 				}
 				break;
 
+			case 'j':
+				results_file = optarg;
+				break;
+
+			case 'J':
+				compare_results = true;
+				break;
+
 			case 'L':
 				do_load = true;
 				break;
@@ -1312,10 +1945,20 @@ int main(int argc, char** argv)
 				loader_config.lc_direction = LL_L_UNDIRECTED_DOUBLE;
 				break;
 
+			case 'p':
+				perf = true;
+				break;
+
 			case 'v':
 				verbose = true;
 				break;
 
+			case 'w':
+				if (!ll_workload_config_parse(&workload_config, optarg)) {
+					return 1;
+				}
+				break;
+
 			case 'W':
 				streaming_window = atoi(optarg);
 				if (streaming_window <= 0) {
@@ -1324,6 +1967,14 @@ int main(int argc, char** argv)
 				}
 				break;
 
+			case 'm':
+				buffer_pool_mb = atof(optarg);
+				if (buffer_pool_mb < 0) {
+					fprintf(stderr, "Error: The buffer pool size cannot be negative\n");
+					return 1;
+				}
+				break;
+
 			case 'X':
 				loader_config.lc_xs_buffer_size = (size_t) (atof(optarg)
 						* 1024ul*1048576ul);
@@ -1345,6 +1996,24 @@ int main(int argc, char** argv)
 		input_files.push_back(std::string(argv[i]));
 	}
 
+
+	// Compare two result files
+
+	if (compare_results) {
+		if (input_files.size() != 2) {
+			fprintf(stderr, "Error: The comparison requires two result files "
+					"(the baseline and the candidate).\n");
+			return 1;
+		}
+
+		ll_benchmark_results baseline;
+		ll_benchmark_results candidate;
+		if (!baseline.load_file(input_files[0].c_str())) return 1;
+		if (!candidate.load_file(input_files[1].c_str())) return 1;
+
+		return ll_compare_results(baseline, candidate) > 0 ? 2 : 0;
+	}
+
 #ifdef LL_PERSISTENCE
 	if (do_load && input_files.empty()) {
 		fprintf(stderr, "Error: No input files specified (use -h for help).\n");
@@ -1536,6 +2205,47 @@ int main(int argc, char** argv)
 #if B < 0 || B == 21
 	LL_RT_COND_CREATE(run_task_class, 21, ll_b_sssp_unweighted_iter, root_node);
 #endif
+#if B < 0 || B == 22
+# ifdef BENCHMARK_WRITABLE
+	LL_RT_COND_CREATE(run_task_class, 22, ll_b_mixed_workload, workload_config);
+# endif
+#endif
+#if B < 0 || B == 23
+	LL_RT_COND_CREATE(run_task_class, 23, ll_b_sssp_unweighted_em, root_node);
+#endif
+#if B < 0 || B == 24
+# ifndef BENCHMARK_WRITABLE
+	LL_RT_COND_CREATE(run_task_class, 24, ll_b_pagerank_scan_float, pagerank_iters);
+# endif
+#endif
+#if B < 0 || B == 25
+# ifdef BENCHMARK_WRITABLE
+	LL_RT_COND_CREATE(run_task_class, 25, ll_t_snapshot);
+# endif
+#endif
+#if B < 0 || B == 26
+# ifdef LL_WAL
+	LL_RT_COND_CREATE(run_task_class, 26, ll_t_wal);
+# endif
+#endif
+#if B < 0 || B == 27
+# ifdef LL_PERSISTENCE
+	LL_RT_COND_CREATE(run_task_class, 27, ll_t_root_record);
+# endif
+#endif
+#if B < 0 || B == 28
+# ifdef BENCHMARK_WRITABLE
+	LL_RT_COND_CREATE(run_task_class, 28, ll_t_checkpoint_readers);
+# endif
+#endif
+#if B < 0 || B == 29
+	LL_RT_COND_CREATE(run_task_class, 29, ll_t_growable_array);
+#endif
+#if B < 0 || B == 30
+# if defined(LL_WAL) && defined(LL_PERSISTENCE)
+	LL_RT_COND_CREATE(run_task_class, 30, ll_t_wal_replay);
+# endif
+#endif
 #undef B
 
 	if (benchmark == NULL) counter.benchmark_count = 0;
@@ -1589,11 +2299,15 @@ int main(int argc, char** argv)
 
 	// Prepare the benchmark
 
+	if (perf) {
+		stats.enable_perf(std::max(num_threads, omp_get_max_threads()));
+	}
+
 	stats.before_load();
 
 	bool ll = true; (void) ll;
 	loader_config.lc_reverse_edges = needs_reverse_edges;
-#ifdef BENCHMARK_WRITABLE
+#if defined(BENCHMARK_WRITABLE) || defined(LL_STREAMING)
 	ll = false;
 	loader_config.lc_reverse_maps = needs_reverse_edges;
 #else
@@ -1604,7 +2318,15 @@ int main(int argc, char** argv)
 
 	ll_database database(database_directory);
 	if (num_threads > 0) database.set_num_threads(num_threads);
+	database.set_memory_policy(memory_policy);
+#ifdef LL_BUFFER_POOL
+	if (buffer_pool_mb >= 0) {
+		database.storage()->buffer_pool().set_budget(
+				(size_t) (buffer_pool_mb * 1048576ul));
+	}
+#endif
 	ll_writable_graph& graph = *database.graph();//(max_nodes);
+	database.recover();
 
 
 #ifndef LL_STREAMING
@@ -1641,11 +2363,13 @@ int main(int argc, char** argv)
 
 #ifdef DO_CP
 			ts = ll_get_time_ms();
+			stats.before_load_cp();
 #	ifdef BENCHMARK_WRITABLE
 			if (i < max_level) graph.checkpoint(&loader_config);
 #	else
 			graph.checkpoint(&loader_config);
 #	endif
+			stats.after_load_cp();
 			double t_c = ll_get_time_ms() - ts;
 			tt += t_c;
 			if (verbose) {
@@ -1739,6 +2463,8 @@ int main(int argc, char** argv)
 	//
 	//
 
+	IF_LL_BUFFER_POOL(database.storage()->buffer_pool().reset_stats());
+
 	if (counter.print_progress && counter.benchmark_count > 0) {
 		benchmark->set_print_progress(verbose);
 
@@ -1781,9 +2507,25 @@ int main(int argc, char** argv)
 		combined_data_source.add(d);
 	}
 
+	ll_sliding_window window(&graph, streaming_window, streaming_ttl);
 	counter.current_batch = 0;
 
-	while (true) {
+	ll_la_ingest_stats_t ingest_stats;
+	memset(&ingest_stats, 0, sizeof(ingest_stats));
+
+	if (ingest_appliers > 0) {
+#	if defined(BENCHMARK_CONCURRENT_LOAD)
+		fprintf(stderr, "Error: The ingest service does not support "
+				"BENCHMARK_CONCURRENT_LOAD\n");
+		return 1;
+#	else
+		return_d = stream_via_ingest(graph, G, benchmark,
+				combined_data_source, loader_config, streaming_batch,
+				ingest_appliers, window, counter, stats, &ingest_stats);
+#	endif
+	}
+
+	while (ingest_appliers <= 0) {
 
 #	if defined(BENCHMARK_CONCURRENT_LOAD)
 		
@@ -1798,7 +2540,7 @@ int main(int argc, char** argv)
 			
 			counter.print_before_batch();
 			if (!load_batch_via_writable_graph(graph, combined_data_source,
-						loader_config, streaming_batch, streaming_window,
+						loader_config, streaming_batch, window,
 						stats)) break;
 			counter.current_batch++;
 			counter.print_after_batch_load(stats);
@@ -1830,7 +2572,7 @@ int main(int argc, char** argv)
 						|| counter.max_batches <= 0) {
 					loaded = load_batch_via_writable_graph(graph,
 							combined_data_source, loader_config,
-							streaming_batch, streaming_window, stats);
+							streaming_batch, window, stats);
 				}
 			}
 
@@ -1845,10 +2587,6 @@ int main(int argc, char** argv)
 						counter.current_iteration < counter.benchmark_count;
 						counter.current_iteration++) {
 
-#ifdef LL_COUNTERS
-					ll_clear_counters();
-#endif
-
 					counter.print_before_benchmark();
 					return_d = run_benchmark(G_ro, benchmark, stats);
 					counter.print_after_benchmark(stats);
@@ -1870,7 +2608,7 @@ int main(int argc, char** argv)
 
 		counter.print_before_batch();
 		if (!load_batch_via_writable_graph(graph, combined_data_source,
-				loader_config, streaming_batch, streaming_window,
+				loader_config, streaming_batch, window,
 				stats)) break;
 		counter.current_batch++;
 		counter.print_after_batch_load(stats);
@@ -1879,10 +2617,6 @@ int main(int argc, char** argv)
 				counter.current_iteration < counter.benchmark_count;
 				counter.current_iteration++) {
 
-#ifdef LL_COUNTERS
-			ll_clear_counters();
-#endif
-
 			counter.print_before_benchmark();
 			return_d = run_benchmark(G, benchmark, stats);
 			counter.print_after_benchmark(stats);
@@ -1902,10 +2636,6 @@ int main(int argc, char** argv)
 			counter.current_iteration < counter.benchmark_count;
 			counter.current_iteration++) {
 
-#ifdef LL_COUNTERS
-		ll_clear_counters();
-#endif
-
 		counter.print_before_benchmark();
 		return_d = run_benchmark(G, benchmark, stats);
 		counter.print_after_benchmark(stats);
@@ -1973,6 +2703,40 @@ int main(int argc, char** argv)
 	if (graph.ro_graph().num_levels() == 1)
 		printf("# Edges    : %lu\n", (size_t) graph.ro_graph().max_edges(0));
 	printf("# Levels   : %lu\n", (size_t) G.num_levels());
+#ifdef LL_STREAMING
+	ll_window_stats_t window_stats;
+	window.stats(&window_stats);
+	printf("Window     : %lu levels (%d--%d), %lu edges\n",
+			window_stats.ws_live_levels, window_stats.ws_min_level,
+			window_stats.ws_max_level, window_stats.ws_live_edges);
+	printf("Expired    : %lu levels, %lu edges, %lu deleted, %lu pending\n",
+			window_stats.ws_retired_levels, window_stats.ws_retired_edges,
+			window_stats.ws_deleted_levels,
+			window_stats.ws_pending_reclamation);
+	if (ingest_appliers > 0) {
+		printf("Ingest     : %lu requests, %lu stalls, %lu checkpoints "
+				"(%0.3lf s), max %lu during one\n",
+				ingest_stats.is_submitted, ingest_stats.is_stalls,
+				ingest_stats.is_checkpoints,
+				ingest_stats.is_checkpoint_ms / 1000.0,
+				ingest_stats.is_max_checkpoint_backlog);
+	}
+#endif
+	printf("Mem Policy : %s\n", ll_memory_policy_summary().c_str());
+	printf("THP Memory : %0.2lf MB\n", ll_memory_anon_huge_pages() / 1048576.0);
+#ifdef LL_BUFFER_POOL
+	ll_buffer_pool_stats_t pool_stats
+		= database.storage()->buffer_pool().stats();
+	size_t pool_accesses = pool_stats.bps_hits + pool_stats.bps_misses;
+	printf("Buffer Pool: %lu hits, %lu misses (%0.2lf%% hits), %lu evictions\n",
+			pool_stats.bps_hits, pool_stats.bps_misses,
+			pool_accesses == 0 ? 0.0
+				: 100.0 * pool_stats.bps_hits / pool_accesses,
+			pool_stats.bps_evictions);
+	printf("Resident   : %0.2lf MB (budget %0.2lf MB)\n",
+			pool_stats.bps_resident_bytes / 1048576.0,
+			pool_stats.bps_budget / 1048576.0);
+#endif
 
 	stats.print_stats(stdout);
 
@@ -1994,6 +2758,66 @@ int main(int argc, char** argv)
 	}
 
 
+	// Save the machine-readable results
+
+	if (benchmark != NULL && results_file != NULL) {
+
+		ll_benchmark_results results;
+
+		std::string macros;
+		for (const char** m = g_configuration_macros; *m != NULL; m++) {
+			if (!macros.empty()) macros += " ";
+			macros += *m;
+		}
+
+		results.set_config("type", type);
+		results.set_config("representation", configuration_summary);
+		results.set_config("macros", macros);
+		results.set_config("task", run->rt_identifier);
+		results.set_config("threads", omp_get_max_threads());
+		results.set_config("node_bits", (int) sizeof(node_t) * 8);
+		results.set_config("edge_bits", (int) sizeof(edge_t) * 8);
+
+		results.set_graph("max_nodes", graph.max_nodes());
+		results.set_graph("levels", G.num_levels());
+		results.set_graph("min_level", min_level);
+		results.set_graph("max_level", max_level);
+		if (graph.ro_graph().num_levels() == 1)
+			results.set_graph("max_edges", graph.ro_graph().max_edges(0));
+
+		stats.export_results(results);
+
+#ifdef LL_COUNTERS
+		for (size_t c = 0; c < LL_C_NUM_COUNTERS; c++) {
+			std::vector<size_t> v;
+			for (size_t i = 0; i < counter.counters_runs.size(); i++)
+				v.push_back(counter.counters_runs[i].cs_counters[c]);
+			results.add_runs(g_ll_counter_names[c], v);
+		}
+		for (size_t l = 0; l < LL_L_NUM_SITES; l++) {
+			for (size_t c = 0; c < LL_LS_NUM_STATS; c++) {
+				std::vector<size_t> v;
+				size_t total = 0;
+				for (size_t i = 0; i < counter.counters_runs.size(); i++) {
+					v.push_back(counter.counters_runs[i].cs_locks[l][c]);
+					total += counter.counters_runs[i].cs_locks[l][LL_LS_ACQUISITIONS];
+				}
+				if (total == 0) continue;
+				std::string name = std::string("lock_") + g_ll_lock_site_names[l]
+					+ "_" + g_ll_lock_stat_names[c];
+				results.add_runs(name.c_str(), v);
+			}
+		}
+#endif
+
+		if (!results.save(results_file)) {
+			fprintf(stderr, "Error: Cannot save the results to %s\n",
+					results_file);
+			return 1;
+		}
+	}
+
+
 	// Print the results
 
 	if (benchmark != NULL && output_file != NULL) {
@@ -2021,8 +2845,8 @@ int main(int argc, char** argv)
 	}
 
 #ifdef LL_COUNTERS
-	fprintf(stderr, "\nCounters:\n");
-	ll_print_counters();
+	fprintf(stderr, "\nCounters (last run):\n");
+	ll_print_counters(counter.counters_run);
 #endif
 
 	if (benchmark != NULL) delete benchmark;
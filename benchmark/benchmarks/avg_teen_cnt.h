@@ -99,6 +99,9 @@ public:
 
 		__S2 = 0 ;
 		_cnt3 = 0 ;
+
+		ll_edge_balanced_partition P(G.in_degree_prefix_sums(), G.max_nodes());
+
 #pragma omp parallel
 		{
 			int32_t __S2_prv = 0 ;
@@ -107,8 +110,9 @@ public:
 			_cnt3_prv = 0 ;
 			__S2_prv = 0 ;
 
-#pragma omp for nowait schedule(dynamic,4096)
-			for (node_t n = 0; n < G.max_nodes(); n ++) 
+#pragma omp for nowait schedule(dynamic,1)
+			for (size_t c = 0; c < P.size(); c ++) 
+			for (node_t n = P[c].ec_begin; n < P[c].ec_end; n ++) 
 			{
 				int32_t __S1 = 0 ;
 
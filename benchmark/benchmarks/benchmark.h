@@ -177,7 +177,7 @@ public:
 
 		for (size_t i = 0; i < _auto_arrays.size(); i++) {
 			if (_auto_arrays[i].ba_data != NULL) {
-				free(_auto_arrays[i].ba_data);
+				ll_large_free(_auto_arrays[i].ba_data);
 				*_auto_arrays[i].ba_variable = NULL;
 			}
 		}
@@ -228,11 +228,11 @@ public:
 							> (ssize_t) _auto_arrays[i].ba_length) {
 
 						if (_auto_arrays[i].ba_data != NULL) {
-							free(_auto_arrays[i].ba_data);
+							ll_large_free(_auto_arrays[i].ba_data);
 						}
 
 						_auto_arrays[i].ba_length = _graph->max_nodes();
-						_auto_arrays[i].ba_data = malloc
+						_auto_arrays[i].ba_data = ll_large_alloc
 							(_auto_arrays[i].ba_element_size
 								* (_auto_arrays[i].ba_length + 16));
 						*_auto_arrays[i].ba_variable = _auto_arrays[i].ba_data;
@@ -346,7 +346,7 @@ protected:
 
 		if (_graph != NULL) {
 			b.ba_length = _graph->max_nodes();
-			b.ba_data = malloc(b.ba_element_size
+			b.ba_data = ll_large_alloc(b.ba_element_size
 					* (b.ba_length + 16));
 		}
 		else {
@@ -0,0 +1,807 @@
+/*
+ * benchmark_results.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef BENCHMARK_RESULTS_H_
+#define BENCHMARK_RESULTS_H_
+
+#include <cctype>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+#include <llama/ll_utils.h>
+
+
+/*
+ * Machine-Readable Benchmark Results
+ * ==================================
+ *
+ * The results consist of four sections:
+ *   - config: the configuration (compile-time macros, task, threads, ...)
+ *   - graph: the graph statistics
+ *   - runs: the per-iteration series of the benchmark runs (times, resource
+ *     usage, and the counters, if they were enabled)
+ *   - load: the per-batch series of the load phase
+ *
+ * They can be written either as JSON or as CSV, in which case each line is
+ * a "section,name,index,value" tuple (the index is empty for config and graph
+ * values). Both formats can be read back for comparison.
+ */
+
+/// The format identifier
+#define LL_BR_FORMAT				"llama-benchmark-results"
+
+/// The format version
+#define LL_BR_VERSION				1
+
+
+/**
+ * The benchmark results
+ */
+class ll_benchmark_results {
+
+public:
+
+	typedef std::map<std::string, std::string> string_map_t;
+	typedef std::map<std::string, std::vector<double> > series_map_t;
+
+	/// The configuration
+	string_map_t config;
+
+	/// The graph statistics
+	string_map_t graph;
+
+	/// The per-iteration series of the benchmark runs
+	series_map_t runs;
+
+	/// The per-batch series of the load phase
+	series_map_t load;
+
+
+public:
+
+	/**
+	 * Set a configuration value
+	 *
+	 * @param key the key
+	 * @param value the value
+	 */
+	void set_config(const char* key, const std::string& value) {
+		config[key] = value;
+	}
+
+
+	/**
+	 * Set a configuration value
+	 *
+	 * @param key the key
+	 * @param value the value
+	 */
+	void set_config(const char* key, double value) {
+		config[key] = format_number(value);
+	}
+
+
+	/**
+	 * Set a graph statistic
+	 *
+	 * @param key the key
+	 * @param value the value
+	 */
+	void set_graph(const char* key, double value) {
+		graph[key] = format_number(value);
+	}
+
+
+	/**
+	 * Add a series of the benchmark runs
+	 *
+	 * @param name the name
+	 * @param values the values
+	 */
+	template <typename T>
+	void add_runs(const char* name, const std::vector<T>& values) {
+		add_series(runs, name, values);
+	}
+
+
+	/**
+	 * Add a series of the load phase
+	 *
+	 * @param name the name
+	 * @param values the values
+	 */
+	template <typename T>
+	void add_load(const char* name, const std::vector<T>& values) {
+		add_series(load, name, values);
+	}
+
+
+	/**
+	 * Write the results as JSON
+	 *
+	 * @param f the output file
+	 */
+	void write_json(FILE* f) const {
+
+		fprintf(f, "{\n");
+		fprintf(f, "  \"format\": \"%s\",\n", LL_BR_FORMAT);
+		fprintf(f, "  \"version\": %d,\n", LL_BR_VERSION);
+
+		fprintf(f, "  \"config\": {");
+		write_json_strings(f, config);
+		fprintf(f, "},\n");
+
+		fprintf(f, "  \"graph\": {");
+		write_json_strings(f, graph, false);
+		fprintf(f, "},\n");
+
+		fprintf(f, "  \"runs\": {");
+		write_json_series(f, runs);
+		fprintf(f, "},\n");
+
+		fprintf(f, "  \"load\": {");
+		write_json_series(f, load);
+		fprintf(f, "}\n");
+
+		fprintf(f, "}\n");
+	}
+
+
+	/**
+	 * Write the results as CSV
+	 *
+	 * @param f the output file
+	 */
+	void write_csv(FILE* f) const {
+
+		fprintf(f, "section,name,index,value\n");
+
+		for (string_map_t::const_iterator it = config.begin();
+				it != config.end(); it++) {
+			fprintf(f, "config,%s,,%s\n", it->first.c_str(),
+					csv_escape(it->second).c_str());
+		}
+
+		for (string_map_t::const_iterator it = graph.begin();
+				it != graph.end(); it++) {
+			fprintf(f, "graph,%s,,%s\n", it->first.c_str(),
+					it->second.c_str());
+		}
+
+		write_csv_series(f, "runs", runs);
+		write_csv_series(f, "load", load);
+	}
+
+
+	/**
+	 * Write the results to a file, choosing the format by the file extension
+	 * (.csv for CSV, JSON otherwise)
+	 *
+	 * @param file_name the file name
+	 * @return true on success
+	 */
+	bool save(const char* file_name) const {
+
+		FILE* f = fopen(file_name, "w");
+		if (f == NULL) {
+			perror("fopen");
+			return false;
+		}
+
+		if (strcmp(ll_file_extension(file_name), "csv") == 0) {
+			write_csv(f);
+		}
+		else {
+			write_json(f);
+		}
+
+		return fclose(f) == 0;
+	}
+
+
+	/**
+	 * Read the results from a file in either format
+	 *
+	 * @param file_name the file name
+	 * @return true on success
+	 */
+	bool load_file(const char* file_name) {
+
+		config.clear();
+		graph.clear();
+		runs.clear();
+		load.clear();
+
+		FILE* f = fopen(file_name, "r");
+		if (f == NULL) {
+			perror("fopen");
+			return false;
+		}
+
+		std::string s;
+		char buffer[4096];
+		size_t n;
+		while ((n = fread(buffer, 1, sizeof(buffer), f)) > 0) {
+			s.append(buffer, n);
+		}
+		fclose(f);
+
+		size_t i = 0;
+		while (i < s.length() && isspace(s[i])) i++;
+
+		bool r = i < s.length() && s[i] == '{'
+			? parse_json(s) : parse_csv(s);
+		if (!r) {
+			fprintf(stderr, "Error: Cannot parse the results file %s\n",
+					file_name);
+		}
+
+		return r;
+	}
+
+
+private:
+
+	/**
+	 * Format a number
+	 *
+	 * @param value the value
+	 * @return the string
+	 */
+	static std::string format_number(double value) {
+
+		char buffer[64];
+		if (std::isnan(value) || std::isinf(value)) return "null";
+		if (value == (double) (long long) value
+				&& std::abs(value) < 1e15) {
+			snprintf(buffer, sizeof(buffer), "%lld", (long long) value);
+		}
+		else {
+			snprintf(buffer, sizeof(buffer), "%0.6lf", value);
+		}
+
+		return buffer;
+	}
+
+
+	/**
+	 * Add a series
+	 *
+	 * @param map the map
+	 * @param name the name
+	 * @param values the values
+	 */
+	template <typename T>
+	static void add_series(series_map_t& map, const char* name,
+			const std::vector<T>& values) {
+
+		std::vector<double>& v = map[name];
+		v.clear();
+		for (size_t i = 0; i < values.size(); i++) {
+			v.push_back((double) values[i]);
+		}
+	}
+
+
+	/**
+	 * Escape a string for JSON
+	 *
+	 * @param s the string
+	 * @return the escaped string
+	 */
+	static std::string json_escape(const std::string& s) {
+
+		std::string r;
+		for (size_t i = 0; i < s.length(); i++) {
+			char c = s[i];
+			if (c == '"' || c == '\\') { r += '\\'; r += c; }
+			else if (c == '\n') r += "\\n";
+			else if ((unsigned char) c < 0x20) r += ' ';
+			else r += c;
+		}
+
+		return r;
+	}
+
+
+	/**
+	 * Escape a string for CSV
+	 *
+	 * @param s the string
+	 * @return the escaped string
+	 */
+	static std::string csv_escape(const std::string& s) {
+
+		if (s.find_first_of(",\"\n") == std::string::npos) return s;
+
+		std::string r = "\"";
+		for (size_t i = 0; i < s.length(); i++) {
+			if (s[i] == '"') r += '"';
+			r += s[i] == '\n' ? ' ' : s[i];
+		}
+
+		return r + "\"";
+	}
+
+
+	/**
+	 * Write a map of strings as the body of a JSON object
+	 *
+	 * @param f the output file
+	 * @param map the map
+	 * @param quote true to quote the values
+	 */
+	static void write_json_strings(FILE* f, const string_map_t& map,
+			bool quote = true) {
+
+		const char* q = quote ? "\"" : "";
+		for (string_map_t::const_iterator it = map.begin();
+				it != map.end(); it++) {
+			fprintf(f, "%s\n    \"%s\": %s%s%s", it == map.begin() ? "" : ",",
+					json_escape(it->first).c_str(), q,
+					json_escape(it->second).c_str(), q);
+		}
+		if (!map.empty()) fprintf(f, "\n  ");
+	}
+
+
+	/**
+	 * Write a map of series as the body of a JSON object
+	 *
+	 * @param f the output file
+	 * @param map the map
+	 */
+	static void write_json_series(FILE* f, const series_map_t& map) {
+
+		for (series_map_t::const_iterator it = map.begin();
+				it != map.end(); it++) {
+			fprintf(f, "%s\n    \"%s\": [", it == map.begin() ? "" : ",",
+					json_escape(it->first).c_str());
+			for (size_t i = 0; i < it->second.size(); i++) {
+				fprintf(f, "%s%s", i == 0 ? "" : ", ",
+						format_number(it->second[i]).c_str());
+			}
+			fprintf(f, "]");
+		}
+		if (!map.empty()) fprintf(f, "\n  ");
+	}
+
+
+	/**
+	 * Write a map of series as CSV
+	 *
+	 * @param f the output file
+	 * @param section the section name
+	 * @param map the map
+	 */
+	static void write_csv_series(FILE* f, const char* section,
+			const series_map_t& map) {
+
+		for (series_map_t::const_iterator it = map.begin();
+				it != map.end(); it++) {
+			for (size_t i = 0; i < it->second.size(); i++) {
+				fprintf(f, "%s,%s,%lu,%s\n", section, it->first.c_str(), i,
+						format_number(it->second[i]).c_str());
+			}
+		}
+	}
+
+
+	/**
+	 * Parse the CSV format
+	 *
+	 * @param s the contents of the file
+	 * @return true on success
+	 */
+	bool parse_csv(const std::string& s) {
+
+		size_t pos = 0;
+		bool header = true;
+
+		while (pos < s.length()) {
+
+			size_t eol = s.find('\n', pos);
+			if (eol == std::string::npos) eol = s.length();
+			std::string line = s.substr(pos, eol - pos);
+			pos = eol + 1;
+
+			if (!line.empty() && line[line.length()-1] == '\r')
+				line.erase(line.length()-1);
+			if (line.empty()) continue;
+
+			if (header) {
+				if (line != "section,name,index,value") return false;
+				header = false;
+				continue;
+			}
+
+			size_t c1 = line.find(',');
+			size_t c2 = c1 == std::string::npos ? c1 : line.find(',', c1+1);
+			size_t c3 = c2 == std::string::npos ? c2 : line.find(',', c2+1);
+			if (c3 == std::string::npos) return false;
+
+			std::string section = line.substr(0, c1);
+			std::string name = line.substr(c1 + 1, c2 - c1 - 1);
+			std::string value = line.substr(c3 + 1);
+
+			if (value.length() >= 2 && value[0] == '"') {
+				std::string v;
+				for (size_t i = 1; i + 1 < value.length(); i++) {
+					if (value[i] == '"' && value[i+1] == '"') i++;
+					v += value[i];
+				}
+				value = v;
+			}
+
+			if (section == "config") config[name] = value;
+			else if (section == "graph") graph[name] = value;
+			else if (section == "runs") runs[name].push_back(parse_number(value));
+			else if (section == "load") load[name].push_back(parse_number(value));
+			else return false;
+		}
+
+		return !header;
+	}
+
+
+	/**
+	 * Parse a number, with "null" being NaN
+	 *
+	 * @param s the string
+	 * @return the number
+	 */
+	static double parse_number(const std::string& s) {
+		if (s == "null" || s.empty()) return NAN;
+		return atof(s.c_str());
+	}
+
+
+	/**
+	 * Parse the JSON format. This handles only the subset of JSON written by
+	 * write_json(), but it skips unknown members.
+	 *
+	 * @param s the contents of the file
+	 * @return true on success
+	 */
+	bool parse_json(const std::string& s) {
+
+		size_t p = 0;
+		if (!json_expect(s, p, '{')) return false;
+		if (json_peek(s, p) == '}') return true;
+
+		while (true) {
+
+			std::string key;
+			if (!json_string(s, p, key)) return false;
+			if (!json_expect(s, p, ':')) return false;
+
+			bool r;
+			if (key == "config") r = json_scalars(s, p, config);
+			else if (key == "graph") r = json_scalars(s, p, graph);
+			else if (key == "runs") r = json_series(s, p, runs);
+			else if (key == "load") r = json_series(s, p, load);
+			else r = json_skip(s, p);
+			if (!r) return false;
+
+			char c = json_peek(s, p);
+			p++;
+			if (c == '}') return true;
+			if (c != ',') return false;
+		}
+	}
+
+
+	/**
+	 * Skip whitespace and peek at the next character
+	 *
+	 * @param s the string
+	 * @param p the position (will be advanced past the whitespace)
+	 * @return the next character, or '\0' at the end
+	 */
+	static char json_peek(const std::string& s, size_t& p) {
+		while (p < s.length() && isspace(s[p])) p++;
+		return p < s.length() ? s[p] : '\0';
+	}
+
+
+	/**
+	 * Consume the expected character
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @param c the expected character
+	 * @return true if it was found
+	 */
+	static bool json_expect(const std::string& s, size_t& p, char c) {
+		if (json_peek(s, p) != c) return false;
+		p++;
+		return true;
+	}
+
+
+	/**
+	 * Parse a string
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @param out the output
+	 * @return true on success
+	 */
+	static bool json_string(const std::string& s, size_t& p,
+			std::string& out) {
+
+		if (!json_expect(s, p, '"')) return false;
+
+		out.clear();
+		while (p < s.length() && s[p] != '"') {
+			if (s[p] == '\\' && p + 1 < s.length()) {
+				p++;
+				out += s[p] == 'n' ? '\n' : s[p] == 't' ? '\t' : s[p];
+			}
+			else {
+				out += s[p];
+			}
+			p++;
+		}
+
+		if (p >= s.length()) return false;
+		p++;
+		return true;
+	}
+
+
+	/**
+	 * Parse a scalar (a string, a number, a literal) as a string
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @param out the output
+	 * @return true on success
+	 */
+	static bool json_scalar(const std::string& s, size_t& p,
+			std::string& out) {
+
+		char c = json_peek(s, p);
+		if (c == '"') return json_string(s, p, out);
+		if (c == '{' || c == '[' || c == '\0') return false;
+
+		size_t start = p;
+		while (p < s.length() && s[p] != ',' && s[p] != '}' && s[p] != ']'
+				&& !isspace(s[p])) p++;
+		out = s.substr(start, p - start);
+		return !out.empty();
+	}
+
+
+	/**
+	 * Parse an object of scalars
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @param out the output map
+	 * @return true on success
+	 */
+	static bool json_scalars(const std::string& s, size_t& p,
+			string_map_t& out) {
+
+		if (!json_expect(s, p, '{')) return false;
+		if (json_expect(s, p, '}')) return true;
+
+		while (true) {
+			std::string key, value;
+			if (!json_string(s, p, key)) return false;
+			if (!json_expect(s, p, ':')) return false;
+			if (!json_scalar(s, p, value)) return false;
+			out[key] = value;
+
+			if (json_expect(s, p, '}')) return true;
+			if (!json_expect(s, p, ',')) return false;
+		}
+	}
+
+
+	/**
+	 * Parse an object of arrays of numbers
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @param out the output map
+	 * @return true on success
+	 */
+	static bool json_series(const std::string& s, size_t& p,
+			series_map_t& out) {
+
+		if (!json_expect(s, p, '{')) return false;
+		if (json_expect(s, p, '}')) return true;
+
+		while (true) {
+			std::string key, value;
+			if (!json_string(s, p, key)) return false;
+			if (!json_expect(s, p, ':')) return false;
+			if (!json_expect(s, p, '[')) return false;
+
+			std::vector<double>& v = out[key];
+			if (!json_expect(s, p, ']')) {
+				while (true) {
+					if (!json_scalar(s, p, value)) return false;
+					v.push_back(parse_number(value));
+					if (json_expect(s, p, ']')) break;
+					if (!json_expect(s, p, ',')) return false;
+				}
+			}
+
+			if (json_expect(s, p, '}')) return true;
+			if (!json_expect(s, p, ',')) return false;
+		}
+	}
+
+
+	/**
+	 * Skip a value
+	 *
+	 * @param s the string
+	 * @param p the position
+	 * @return true on success
+	 */
+	static bool json_skip(const std::string& s, size_t& p) {
+
+		char c = json_peek(s, p);
+		std::string value;
+
+		if (c == '{' || c == '[') {
+			char close = c == '{' ? '}' : ']';
+			p++;
+			if (json_expect(s, p, close)) return true;
+			while (true) {
+				if (c == '{') {
+					if (!json_string(s, p, value)) return false;
+					if (!json_expect(s, p, ':')) return false;
+				}
+				if (!json_skip(s, p)) return false;
+				if (json_expect(s, p, close)) return true;
+				if (!json_expect(s, p, ',')) return false;
+			}
+		}
+
+		return json_scalar(s, p, value);
+	}
+};
+
+
+
+//==========================================================================//
+// Regression Comparison                                                    //
+//==========================================================================//
+
+/**
+ * Compare two benchmark results and flag the statistically significant
+ * differences. A metric regressed if the 95% confidence interval of the
+ * candidate lies entirely above that of the baseline (all series are "lower
+ * is better"), and it improved if it lies entirely below. Series with fewer
+ * than two values in either result are reported but not judged.
+ *
+ * @param baseline the baseline results
+ * @param candidate the candidate results
+ * @param f the output file
+ * @return the number of regressions
+ */
+inline size_t ll_compare_results(ll_benchmark_results& baseline,
+		ll_benchmark_results& candidate, FILE* f = stdout) {
+
+	size_t regressions = 0;
+
+
+	// Check that the results are comparable
+
+	for (ll_benchmark_results::string_map_t::iterator it
+			= baseline.config.begin(); it != baseline.config.end(); it++) {
+		ll_benchmark_results::string_map_t::iterator c
+			= candidate.config.find(it->first);
+		const char* cv = c == candidate.config.end()
+			? "(missing)" : c->second.c_str();
+		if (c == candidate.config.end() || c->second != it->second) {
+			fprintf(f, "Warning: Different %s: %s vs. %s\n",
+					it->first.c_str(), it->second.c_str(), cv);
+		}
+	}
+
+
+	// Compare the series of the benchmark runs
+
+	fprintf(f, "%-20s %24s %24s %9s  %s\n", "Metric", "Baseline",
+			"Candidate", "Change", "Verdict");
+
+	for (ll_benchmark_results::series_map_t::iterator it
+			= baseline.runs.begin(); it != baseline.runs.end(); it++) {
+
+		ll_benchmark_results::series_map_t::iterator c
+			= candidate.runs.find(it->first);
+		if (c == candidate.runs.end()) continue;
+
+		std::vector<double>& b = it->second;
+		std::vector<double>& a = c->second;
+
+		bool valid = !b.empty() && !a.empty();
+		for (size_t i = 0; valid && i < b.size(); i++)
+			if (std::isnan(b[i])) valid = false;
+		for (size_t i = 0; valid && i < a.size(); i++)
+			if (std::isnan(a[i])) valid = false;
+		if (!valid) continue;
+
+		double b_mean = ll_mean(b);
+		double b_c95 = ll_c95(b);
+		double a_mean = ll_mean(a);
+		double a_c95 = ll_c95(a);
+
+		const char* verdict = "same";
+		if (b.size() < 2 || a.size() < 2) {
+			verdict = "? (too few runs)";
+		}
+		else if (a_mean - a_c95 > b_mean + b_c95) {
+			verdict = "REGRESSION";
+			regressions++;
+		}
+		else if (a_mean + a_c95 < b_mean - b_c95) {
+			verdict = "improvement";
+		}
+
+		char bs[64], as[64], ch[32];
+		snprintf(bs, sizeof(bs), "%0.3lf +- %0.3lf", b_mean, b_c95);
+		snprintf(as, sizeof(as), "%0.3lf +- %0.3lf", a_mean, a_c95);
+		if (b_mean != 0) {
+			snprintf(ch, sizeof(ch), "%+0.2lf%%",
+					100.0 * (a_mean - b_mean) / b_mean);
+		}
+		else {
+			snprintf(ch, sizeof(ch), "n/a");
+		}
+
+		fprintf(f, "%-20s %24s %24s %9s  %s\n", it->first.c_str(),
+				bs, as, ch, verdict);
+	}
+
+	fprintf(f, "\nRegressions: %lu\n", regressions);
+
+	return regressions;
+}
+
+#endif
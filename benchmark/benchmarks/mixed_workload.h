@@ -0,0 +1,893 @@
+/*
+ * mixed_workload.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_MIXED_WORKLOAD_H
+#define LL_MIXED_WORKLOAD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <float.h>
+#include <limits.h>
+#include <time.h>
+#include <cmath>
+#include <string>
+#include <vector>
+#include <omp.h>
+
+#include "llama/ll_writable_graph.h"
+#include "llama/loaders/ll_load_async_writable.h"
+#include "benchmarks/benchmark.h"
+
+
+/*
+ * Mixed Read/Write Workload
+ * =========================
+ *
+ * N client threads replay a mix of point operations against the writable
+ * graph, while an optional maintenance thread checkpoints it periodically.
+ * The reads run in their own transactions between read_begin() and
+ * read_end(), so they proceed while a checkpoint is in progress. The writes
+ * go through an ll_la_ingest service, which keeps them out of the writable
+ * representation while it is being frozen; a client waits until its write
+ * is applied, so the write latencies include the time spent waiting for a
+ * checkpoint to finish.
+ *
+ * The workload is configured by a comma-separated list of key=value pairs:
+ *   find=W, degree=W, scan=W, insert=W, delete=W - the relative weights of
+ *       the operation types (default: 40, 20, 20, 15, 5)
+ *   zipf=S - the Zipf exponent of the vertex popularity (0 = uniform)
+ *   hot=F:P - with the probability P, pick the vertex uniformly from the hot
+ *       set consisting of the fraction F of the vertices
+ *   ops=N - the total number of operations (default: 1000000)
+ *   clients=N - the number of client threads (default: all threads)
+ *   appliers=N - the number of threads that apply the writes (default: 1)
+ *   checkpoint=MS - checkpoint every MS milliseconds (0 = never)
+ *   seed=N - the random seed
+ */
+
+#define LL_WL_FIND				0
+#define LL_WL_DEGREE			1
+#define LL_WL_SCAN				2
+#define LL_WL_INSERT			3
+#define LL_WL_DELETE			4
+#define LL_WL_NUM_OPS			5
+
+
+/**
+ * The operation names
+ */
+static const char* LL_WL_OP_NAMES[LL_WL_NUM_OPS] = {
+	"find", "degree", "scan", "insert", "delete"
+};
+
+
+/**
+ * The workload configuration
+ */
+typedef struct {
+
+	/// The relative weights of the operation types
+	double wc_weights[LL_WL_NUM_OPS];
+
+	/// The Zipf exponent (0 for uniform)
+	double wc_zipf;
+
+	/// The fraction of the vertices in the hot set
+	double wc_hot_fraction;
+
+	/// The probability of picking a vertex from the hot set
+	double wc_hot_probability;
+
+	/// The total number of operations
+	size_t wc_ops;
+
+	/// The number of client threads (0 for all)
+	int wc_clients;
+
+	/// The number of ingest applier threads
+	int wc_appliers;
+
+	/// The checkpoint interval in ms (0 for none)
+	double wc_checkpoint_ms;
+
+	/// The random seed
+	unsigned wc_seed;
+
+} ll_workload_config_t;
+
+
+/**
+ * Initialize the workload configuration to the defaults
+ *
+ * @param c the configuration
+ */
+inline void ll_workload_config_init(ll_workload_config_t* c) {
+
+	c->wc_weights[LL_WL_FIND  ] = 40;
+	c->wc_weights[LL_WL_DEGREE] = 20;
+	c->wc_weights[LL_WL_SCAN  ] = 20;
+	c->wc_weights[LL_WL_INSERT] = 15;
+	c->wc_weights[LL_WL_DELETE] = 5;
+
+	c->wc_zipf = 0;
+	c->wc_hot_fraction = 0;
+	c->wc_hot_probability = 0;
+	c->wc_ops = 1000000;
+	c->wc_clients = 0;
+	c->wc_appliers = 1;
+	c->wc_checkpoint_ms = 0;
+	c->wc_seed = 42;
+}
+
+
+/**
+ * Parse the workload configuration
+ *
+ * @param c the configuration (will be modified)
+ * @param spec the specification string
+ * @return true on success, false on error (an error message is printed)
+ */
+inline bool ll_workload_config_parse(ll_workload_config_t* c,
+		const char* spec) {
+
+	std::string s = spec;
+	size_t pos = 0;
+
+	while (pos < s.length()) {
+
+		size_t end = s.find(',', pos);
+		if (end == std::string::npos) end = s.length();
+		std::string item = s.substr(pos, end - pos);
+		pos = end + 1;
+		if (item.empty()) continue;
+
+		size_t eq = item.find('=');
+		if (eq == std::string::npos) {
+			fprintf(stderr, "Error: Invalid workload item \"%s\"\n",
+					item.c_str());
+			return false;
+		}
+
+		std::string key = item.substr(0, eq);
+		const char* value = item.c_str() + eq + 1;
+
+		bool found = false;
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) {
+			if (key == LL_WL_OP_NAMES[i]) {
+				c->wc_weights[i] = atof(value);
+				found = c->wc_weights[i] >= 0;
+			}
+		}
+
+		if (key == "zipf") {
+			c->wc_zipf = atof(value);
+			found = c->wc_zipf >= 0;
+		}
+		else if (key == "hot") {
+			const char* colon = strchr(value, ':');
+			c->wc_hot_fraction = atof(value);
+			c->wc_hot_probability = colon == NULL ? 0 : atof(colon + 1);
+			found = colon != NULL
+				&& c->wc_hot_fraction > 0 && c->wc_hot_fraction <= 1
+				&& c->wc_hot_probability >= 0 && c->wc_hot_probability <= 1;
+		}
+		else if (key == "ops") {
+			c->wc_ops = (size_t) atof(value);
+			found = c->wc_ops > 0;
+		}
+		else if (key == "clients") {
+			c->wc_clients = atoi(value);
+			found = c->wc_clients > 0;
+		}
+		else if (key == "appliers") {
+			c->wc_appliers = atoi(value);
+			found = c->wc_appliers > 0;
+		}
+		else if (key == "checkpoint") {
+			c->wc_checkpoint_ms = atof(value);
+			found = c->wc_checkpoint_ms >= 0;
+		}
+		else if (key == "seed") {
+			c->wc_seed = (unsigned) atol(value);
+			found = true;
+		}
+
+		if (!found) {
+			fprintf(stderr, "Error: Invalid workload item \"%s\"\n",
+					item.c_str());
+			return false;
+		}
+	}
+
+	double total = 0;
+	for (int i = 0; i < LL_WL_NUM_OPS; i++) total += c->wc_weights[i];
+	if (total <= 0) {
+		fprintf(stderr, "Error: The workload has no operations\n");
+		return false;
+	}
+
+#ifndef LL_DELETIONS
+	if (c->wc_weights[LL_WL_DELETE] > 0) {
+		fprintf(stderr, "Warning: Ignoring the delete operations, which "
+				"require LL_DELETIONS\n");
+		c->wc_weights[LL_WL_DELETE] = 0;
+	}
+#endif
+
+	return true;
+}
+
+
+
+//==========================================================================//
+// Class: ll_latency_histogram                                              //
+//==========================================================================//
+
+/// The number of bits of the linear sub-buckets within each power of two
+#define LL_LH_SUB_BITS			5
+
+/// The number of sub-buckets
+#define LL_LH_SUB				(1 << LL_LH_SUB_BITS)
+
+/// The number of buckets (enough for 2^48 ns)
+#define LL_LH_BUCKETS			((48 - LL_LH_SUB_BITS + 1) * LL_LH_SUB)
+
+
+/**
+ * A log-linear (HDR-style) latency histogram: the values are bucketed by
+ * their power of two, and each power of two is split into LL_LH_SUB linear
+ * sub-buckets, so that the relative error is at most 1/LL_LH_SUB regardless
+ * of the magnitude, with a fixed and small footprint. The histogram is not
+ * thread-safe; use one per thread and merge them.
+ */
+class ll_latency_histogram {
+
+	uint64_t _counts[LL_LH_BUCKETS];
+	uint64_t _count;
+	uint64_t _max;
+	double _sum;
+
+
+public:
+
+	/**
+	 * Create an empty histogram
+	 */
+	ll_latency_histogram() {
+		clear();
+	}
+
+
+	/**
+	 * Clear the histogram
+	 */
+	void clear() {
+		memset(_counts, 0, sizeof(_counts));
+		_count = 0;
+		_max = 0;
+		_sum = 0;
+	}
+
+
+	/**
+	 * Record a value
+	 *
+	 * @param v the value (e.g. in ns)
+	 */
+	inline void record(uint64_t v) {
+		size_t b = bucket(v);
+		if (b >= LL_LH_BUCKETS) b = LL_LH_BUCKETS - 1;
+		_counts[b]++;
+		_count++;
+		_sum += v;
+		if (v > _max) _max = v;
+	}
+
+
+	/**
+	 * Merge another histogram into this one
+	 *
+	 * @param h the other histogram
+	 */
+	void merge(const ll_latency_histogram& h) {
+		for (size_t i = 0; i < LL_LH_BUCKETS; i++) _counts[i] += h._counts[i];
+		_count += h._count;
+		_sum += h._sum;
+		if (h._max > _max) _max = h._max;
+	}
+
+
+	/**
+	 * Get the number of values
+	 *
+	 * @return the count
+	 */
+	inline uint64_t count() const { return _count; }
+
+
+	/**
+	 * Get the maximum value
+	 *
+	 * @return the maximum
+	 */
+	inline uint64_t max() const { return _max; }
+
+
+	/**
+	 * Get the mean value
+	 *
+	 * @return the mean
+	 */
+	inline double mean() const { return _count == 0 ? 0 : _sum / _count; }
+
+
+	/**
+	 * Get a percentile
+	 *
+	 * @param p the percentile, between 0 and 100
+	 * @return the value (the midpoint of its bucket)
+	 */
+	double percentile(double p) const {
+
+		if (_count == 0) return 0;
+
+		uint64_t rank = (uint64_t) std::ceil(p / 100.0 * _count);
+		if (rank < 1) rank = 1;
+
+		uint64_t c = 0;
+		for (size_t i = 0; i < LL_LH_BUCKETS; i++) {
+			c += _counts[i];
+			if (c >= rank) {
+				double lo = lower_bound(i);
+				double hi = lower_bound(i + 1);
+				double v = (lo + hi - 1) / 2.0;
+				return v > _max ? _max : v;
+			}
+		}
+
+		return _max;
+	}
+
+
+private:
+
+	/**
+	 * Get the bucket for a value
+	 *
+	 * @param v the value
+	 * @return the bucket index
+	 */
+	static inline size_t bucket(uint64_t v) {
+		if (v < 2 * LL_LH_SUB) return (size_t) v;
+		int e = 63 - __builtin_clzll(v);
+		int shift = e - LL_LH_SUB_BITS;
+		return (shift + 1) * LL_LH_SUB + (size_t) ((v >> shift) - LL_LH_SUB);
+	}
+
+
+	/**
+	 * Get the lowest value of a bucket
+	 *
+	 * @param b the bucket index
+	 * @return the lowest value
+	 */
+	static inline double lower_bound(size_t b) {
+		if (b < 2 * LL_LH_SUB) return (double) b;
+		size_t shift = b / LL_LH_SUB - 1;
+		return (double) ((uint64_t) (b % LL_LH_SUB + LL_LH_SUB) << shift);
+	}
+};
+
+
+
+//==========================================================================//
+// Class: ll_zipf_generator                                                 //
+//==========================================================================//
+
+/**
+ * A Zipf-distributed random number generator using rejection-inversion
+ * sampling (Hormann and Derflinger), which needs O(1) time per sample and no
+ * table, so that it works for any number of vertices
+ */
+class ll_zipf_generator {
+
+	uint64_t _n;
+	double _s;
+
+	double _h_integral_x1;
+	double _h_integral_n;
+	double _threshold;
+
+
+public:
+
+	/**
+	 * Create the generator
+	 *
+	 * @param n the number of elements
+	 * @param s the exponent (must be positive)
+	 */
+	ll_zipf_generator(uint64_t n, double s) {
+		_n = n < 1 ? 1 : n;
+		_s = s;
+		_h_integral_x1 = h_integral(1.5) - 1;
+		_h_integral_n = h_integral(_n + 0.5);
+		_threshold = 2 - h_integral_inverse(h_integral(2.5) - h(2));
+	}
+
+
+	/**
+	 * Generate the next number
+	 *
+	 * @param seedp the pointer to the random seed
+	 * @return the rank, between 0 (the most popular) and n-1
+	 */
+	uint64_t next(unsigned* seedp) const {
+
+		while (true) {
+			double r = ll_rand64_positive_r(seedp) / (double) INT64_MAX;
+			double u = _h_integral_n + r * (_h_integral_x1 - _h_integral_n);
+			double x = h_integral_inverse(u);
+
+			double k = std::floor(x + 0.5);
+			if (k < 1) k = 1;
+			else if (k > _n) k = _n;
+
+			if (k - x <= _threshold || u >= h_integral(k + 0.5) - h(k)) {
+				return (uint64_t) k - 1;
+			}
+		}
+	}
+
+
+private:
+
+	inline double h(double x) const {
+		return std::exp(-_s * std::log(x));
+	}
+
+	inline double h_integral(double x) const {
+		double log_x = std::log(x);
+		return helper2((1 - _s) * log_x) * log_x;
+	}
+
+	inline double h_integral_inverse(double x) const {
+		double t = x * (1 - _s);
+		if (t < -1) t = -1;
+		return std::exp(helper1(t) * x);
+	}
+
+	static inline double helper1(double x) {
+		if (std::abs(x) > 1e-8) return std::log1p(x) / x;
+		return 1 - x * (0.5 - x * (1 / 3.0 - 0.25 * x));
+	}
+
+	static inline double helper2(double x) {
+		if (std::abs(x) > 1e-8) return std::expm1(x) / x;
+		return 1 + x * 0.5 * (1 + x * (1 / 3.0) * (1 + 0.25 * x));
+	}
+};
+
+
+
+//==========================================================================//
+// Class: ll_b_mixed_workload                                               //
+//==========================================================================//
+
+/**
+ * The mixed read/write workload
+ */
+template <class Graph>
+class ll_b_mixed_workload : public ll_benchmark<Graph> {
+
+	ll_workload_config_t _config;
+
+	ll_latency_histogram _latencies[LL_WL_NUM_OPS];
+	ll_latency_histogram _checkpoints;
+
+	double _elapsed_ms;
+	int _clients;
+
+
+public:
+
+	/**
+	 * Create the benchmark
+	 *
+	 * @param config the workload configuration
+	 */
+	ll_b_mixed_workload(const ll_workload_config_t& config)
+		: ll_benchmark<Graph>("Mixed Read/Write Workload") {
+
+		_config = config;
+		_elapsed_ms = 0;
+		_clients = 0;
+	}
+
+
+	/**
+	 * Destroy the benchmark
+	 */
+	virtual ~ll_b_mixed_workload(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the throughput in operations per second
+	 */
+	virtual double run(void) {
+
+		Graph& G = *this->_graph;
+
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) _latencies[i].clear();
+		_checkpoints.clear();
+
+		node_t max_nodes = G.max_nodes();
+		if (max_nodes <= 0) return NAN;
+
+
+		// The operation mix and the vertex popularity
+
+		double cdf[LL_WL_NUM_OPS];
+		double total = 0;
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) {
+			total += _config.wc_weights[i];
+			cdf[i] = total;
+		}
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) cdf[i] /= total;
+
+		ll_zipf_generator zipf(max_nodes, _config.wc_zipf > 0
+				? _config.wc_zipf : 1);
+		node_t hot_nodes = (node_t) (_config.wc_hot_fraction * max_nodes);
+		if (hot_nodes < 1) hot_nodes = 1;
+
+		_clients = _config.wc_clients > 0 ? _config.wc_clients
+			: omp_get_max_threads();
+		int appliers = _config.wc_appliers;
+		bool maintenance = _config.wc_checkpoint_ms > 0;
+		int threads = _clients + appliers + (maintenance ? 1 : 0);
+
+		ll_la_ingest ingest(&G, appliers);
+
+		volatile size_t next_op = 0;
+		volatile size_t clients_done = 0;
+		size_t ops = _config.wc_ops;
+
+		std::vector<ll_latency_histogram*> local;
+		for (int t = 0; t < threads; t++) {
+			local.push_back(new ll_latency_histogram[LL_WL_NUM_OPS]);
+		}
+
+		if (this->_print_progress) this->progress_init(ops);
+		double t_start = ll_get_time_ms();
+
+#		pragma omp parallel num_threads(threads)
+		{
+			int t = omp_get_thread_num();
+			unsigned seed = _config.wc_seed + 7919 * t;
+			ll_latency_histogram* h = local[t];
+
+			if (t >= _clients + appliers) {
+
+				// The maintenance thread, which also shuts down the ingest
+				// service, so that it never checkpoints after the appliers
+				// returned
+
+				while (clients_done < (size_t) _clients) {
+					double until = ll_get_time_ms() + _config.wc_checkpoint_ms;
+					while (clients_done < (size_t) _clients
+							&& ll_get_time_ms() < until) usleep(1000);
+					if (clients_done >= (size_t) _clients) break;
+
+					uint64_t c_start = now_ns();
+					ingest.checkpoint();
+					h[0].record(now_ns() - c_start);
+				}
+
+				ingest.shutdown();
+			}
+			else if (t >= _clients) {
+
+				// The appliers
+
+				ingest.applier(t - _clients);
+			}
+			else {
+
+				// The client threads
+
+				while (true) {
+					size_t i = __sync_fetch_and_add(&next_op, 1);
+					if (i >= ops) break;
+
+					if (t == 0 && this->_print_progress && (i & 0xfff) == 0) {
+						this->progress_update(i);
+					}
+
+					double r = ll_rand64_positive_r(&seed) / (double) INT64_MAX;
+					int op = 0;
+					while (op < LL_WL_NUM_OPS - 1 && r >= cdf[op]) op++;
+
+					node_t n = pick(zipf, hot_nodes, max_nodes, &seed);
+					node_t m = pick(zipf, hot_nodes, max_nodes, &seed);
+
+					uint64_t o_start = now_ns();
+					if (op == LL_WL_INSERT || op == LL_WL_DELETE) {
+						write(ingest, op, n, m);
+					}
+					else {
+						read(G, op, n, m);
+					}
+					h[op].record(now_ns() - o_start);
+				}
+
+				size_t d = __sync_add_and_fetch(&clients_done, 1);
+				if (d == (size_t) _clients && !maintenance) ingest.shutdown();
+			}
+		}
+
+		_elapsed_ms = ll_get_time_ms() - t_start;
+		if (this->_print_progress) this->progress_clear();
+
+		for (int t = 0; t < threads; t++) {
+			if (t < _clients) {
+				for (int i = 0; i < LL_WL_NUM_OPS; i++) {
+					_latencies[i].merge(local[t][i]);
+				}
+			}
+			else if (t >= _clients + appliers) {
+				_checkpoints.merge(local[t][0]);
+			}
+			delete[] local[t];
+		}
+
+		return ops / (_elapsed_ms / 1000.0);
+	}
+
+
+	/**
+	 * Finalize the benchmark
+	 *
+	 * @return the updated numerical result, if applicable
+	 */
+	virtual double finalize(void) {
+		print_results(stdout);
+		return NAN;
+	}
+
+
+	/**
+	 * Print the results
+	 *
+	 * @param f the output file
+	 */
+	virtual void print_results(FILE* f) {
+
+		uint64_t total = 0;
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) total += _latencies[i].count();
+		double seconds = _elapsed_ms / 1000.0;
+
+		fprintf(f, "\nWORKLOAD (%d clients, %0.3lf seconds, %0.0lf ops/s)\n",
+				_clients, seconds, seconds <= 0 ? 0 : total / seconds);
+		fprintf(f, "%-10s %10s %12s %10s %10s %10s %10s %10s\n",
+				"Operation", "Count", "Ops/s", "Mean us", "p50 us",
+				"p99 us", "p99.9 us", "Max us");
+
+		for (int i = 0; i < LL_WL_NUM_OPS; i++) {
+			const ll_latency_histogram& h = _latencies[i];
+			if (h.count() == 0) continue;
+			fprintf(f, "%-10s %10lu %12.0lf %10.2lf %10.2lf %10.2lf %10.2lf "
+					"%10.2lf\n", LL_WL_OP_NAMES[i], (unsigned long) h.count(),
+					seconds <= 0 ? 0 : h.count() / seconds,
+					h.mean() / 1000.0, h.percentile(50) / 1000.0,
+					h.percentile(99) / 1000.0, h.percentile(99.9) / 1000.0,
+					h.max() / 1000.0);
+		}
+
+		if (_checkpoints.count() > 0) {
+			fprintf(f, "Checkpoints: %lu, mean %0.3lf ms, max %0.3lf ms\n",
+					(unsigned long) _checkpoints.count(),
+					_checkpoints.mean() / 1e6, _checkpoints.max() / 1e6);
+		}
+	}
+
+
+private:
+
+	/**
+	 * Get the current time in ns
+	 *
+	 * @return the time
+	 */
+	static inline uint64_t now_ns() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return ts.tv_sec * 1000000000ull + ts.tv_nsec;
+	}
+
+
+	/**
+	 * Pick a vertex
+	 *
+	 * @param zipf the Zipf generator
+	 * @param hot_nodes the number of vertices in the hot set
+	 * @param max_nodes the number of vertices
+	 * @param seedp the pointer to the random seed
+	 * @return the vertex
+	 */
+	inline node_t pick(const ll_zipf_generator& zipf, node_t hot_nodes,
+			node_t max_nodes, unsigned* seedp) {
+
+		if (_config.wc_hot_probability > 0) {
+			double r = ll_rand64_positive_r(seedp) / (double) INT64_MAX;
+			if (r < _config.wc_hot_probability) {
+				return ll_rand64_positive_r(seedp) % hot_nodes;
+			}
+		}
+
+		if (_config.wc_zipf > 0) return (node_t) zipf.next(seedp);
+		return ll_rand64_positive_r(seedp) % max_nodes;
+	}
+
+
+	/**
+	 * Execute a read operation
+	 *
+	 * @param G the graph
+	 * @param op the operation type
+	 * @param n the vertex
+	 * @param m the other vertex (for find)
+	 */
+	void read(Graph& G, int op, node_t n, node_t m) {
+
+		int slot = G.read_begin();
+		G.tx_begin();
+
+		switch (op) {
+
+			case LL_WL_FIND:
+				G.find(n, m);
+				break;
+
+			case LL_WL_DEGREE:
+				G.out_degree(n);
+				break;
+
+			case LL_WL_SCAN:
+				{
+					node_t sum = 0;
+					ll_edge_iterator iter;
+					G.out_iter_begin(iter, n);
+					for (edge_t v_idx = G.out_iter_next(iter);
+							v_idx != LL_NIL_EDGE;
+							v_idx = G.out_iter_next(iter)) {
+						sum ^= LL_ITER_OUT_NEXT_NODE(G, iter, v_idx);
+					}
+					__COMPILER_FENCE;
+					(void) sum;
+				}
+				break;
+		}
+
+		G.tx_commit();
+		G.read_end(slot);
+	}
+
+
+	/**
+	 * Execute a write operation through the ingest service and wait until
+	 * it is applied
+	 *
+	 * @param ingest the ingest service
+	 * @param op the operation type
+	 * @param n the vertex
+	 * @param m the other vertex (for insert)
+	 */
+	void write(ll_la_ingest& ingest, int op, node_t n, node_t m) {
+
+		volatile bool done = false;
+		ingest.submit(new ll_wl_write(op, n, m, &done), n);
+		while (!done) asm volatile ("pause" ::: "memory");
+	}
+
+
+	/**
+	 * A write request
+	 */
+	class ll_wl_write : public ll_la_request {
+
+		int _op;
+		node_t _n;
+		node_t _m;
+		volatile bool* _done;
+
+
+	public:
+
+		/**
+		 * Create the request
+		 *
+		 * @param op the operation type
+		 * @param n the vertex
+		 * @param m the other vertex (for insert)
+		 * @param done the flag to set once the request is applied
+		 */
+		ll_wl_write(int op, node_t n, node_t m, volatile bool* done) {
+			_op = op;
+			_n = n;
+			_m = m;
+			_done = done;
+		}
+
+
+		/**
+		 * Perform the request
+		 *
+		 * @param graph the graph
+		 */
+		virtual void run(ll_writable_graph& graph) {
+
+			switch (_op) {
+
+				case LL_WL_INSERT:
+					graph.add_edge(_n, _m);
+					break;
+
+				case LL_WL_DELETE:
+#ifdef LL_DELETIONS
+					{
+						ll_edge_iterator iter;
+						graph.out_iter_begin(iter, _n);
+						edge_t e = graph.out_iter_next(iter);
+						graph.out_iter_end(iter);
+						if (e != LL_NIL_EDGE) graph.delete_edge(_n, e);
+					}
+#endif
+					break;
+			}
+
+			__COMPILER_FENCE;
+			*_done = true;
+		}
+	};
+};
+
+#endif
@@ -50,6 +50,15 @@
 #include "benchmarks/benchmark.h"
 
 
+/*
+ * Gather the contributions of the in-neighbors using the contiguous adjacency
+ * spans of the read-only graph instead of the edge iterators
+ */
+#if !defined(TEST_CXX_ITER) && !defined(BENCHMARK_WRITABLE)
+#define PAGERANK_SPANS
+#endif
+
+
 /**
  * The PageRank benchmark
  */
@@ -104,6 +113,9 @@ public:
 		int32_t cnt = 0 ;
 		value_t N = 0.0 ;
 		value_t* G_pg_rank_nxt = m.allocate<value_t>(G.max_nodes());
+#ifdef PAGERANK_SPANS
+		value_t* G_contrib = m.allocate<value_t>(G.max_nodes());
+#endif
 
 		cnt = 0 ;
 		N = (value_t)(G.max_nodes()) ;
@@ -112,19 +124,32 @@ public:
 		for (node_t t0 = 0; t0 < G.max_nodes(); t0 ++) 
 			G.set_node_prop(G_pg_rank, t0, 1 / N);
 
+		ll_edge_balanced_partition P(G.in_degree_prefix_sums(), G.max_nodes());
+
 		this->progress_init(max);
 
 		do
 		{
 			diff = 0.000000 ;
+
+#ifdef PAGERANK_SPANS
+#pragma omp parallel for
+			for (node_t w = 0; w < G.max_nodes(); w ++) {
+				size_t w_degree = G.out_degree(w);
+				G_contrib[w] = w_degree == 0 ? 0
+					: G_pg_rank[w] / ((value_t) w_degree);
+			}
+#endif
+
 #pragma omp parallel
 			{
 				value_t diff_prv = 0.0 ;
 
 				diff_prv = 0.000000 ;
 
-#pragma omp for nowait schedule(dynamic,4096)
-				for (node_t t = 0; t < G.max_nodes(); t ++) 
+#pragma omp for nowait schedule(dynamic,1)
+				for (size_t c = 0; c < P.size(); c ++) 
+				for (node_t t = P[c].ec_begin; t < P[c].ec_end; t ++) 
 				{
 					value_t val = 0.0 ;
 					value_t __S1 = 0.0 ;
@@ -146,6 +171,23 @@ public:
 					for (iter = G.in_begin(t); iter != end; ++iter) {
 						__S1 = __S1 + G_pg_rank[*iter] / ((value_t)((G.out_degree(*iter)))) ;
 					}
+#elif defined(PAGERANK_SPANS)
+					ll_foreach_in_span(span, G, t) {
+#ifdef LL_DELETIONS
+						uint64_t mask[LL_SPAN_MASK_WORDS];
+						G.in_span_live_mask(span, mask);
+						for (size_t i = 0; i < span.as_length; i++) {
+							if (ll_adjacency_span_is_live(mask, i)) {
+								__S1 = __S1 + G_contrib
+									[LL_VALUE_PAYLOAD(span.as_values[i])];
+							}
+						}
+#else
+						for (size_t i = 0; i < span.as_length; i++) {
+							__S1 = __S1 + G_contrib[span.as_values[i]];
+						}
+#endif
+					}
 #else
 					/*ll_edge_iterator iter;
 					G.inm_iter_begin(iter, t);
@@ -274,6 +316,16 @@ public:
 			G.set_node_prop(G_pg_rank_nxt, t0, (value_t) 0.0);
 		}
 
+		// Split the high-degree nodes, except with the C++ iterators, which
+		// cannot start in the middle of an adjacency list
+
+#ifdef TEST_CXX_ITER
+		ll_edge_balanced_partition P(G.out_degree_prefix_sums(), G.max_nodes());
+#else
+		ll_edge_balanced_partition P(G.out_degree_prefix_sums(), G.max_nodes(),
+				true);
+#endif
+
 		this->progress_init(max);
 
 		do
@@ -281,8 +333,9 @@ public:
 #pragma omp parallel
 			{
 
-#pragma omp for schedule(dynamic,4096)
-				for (node_t t = 0; t < G.max_nodes(); t ++) 
+#pragma omp for schedule(dynamic,1)
+				for (size_t c = 0; c < P.size(); c ++) 
+				for (node_t t = P[c].ec_begin; t < P[c].ec_end; t ++) 
 				{
 					int t_degree = G.out_degree(t);
 					if (t_degree == 0) continue;
@@ -306,7 +359,8 @@ public:
 						ATOMIC_ADD<value_t>(&G_pg_rank_nxt[w], t_delta);
 					}*/
 
-					ll_foreach_out(w, G, t) {
+					ll_foreach_out_range(w, G, t,
+							P[c].ec_edge_begin, P[c].ec_edge_end) {
 						ATOMIC_ADD<value_t>(&G_pg_rank_nxt[w], t_delta);
 					}
 #endif
@@ -360,6 +414,146 @@ public:
 };
 
 
+/**
+ * The scatter step of the edge-centric PageRank: push the contribution of
+ * the source of each edge in a block to its target
+ */
+template <typename value_t>
+struct u_pagerank_scatter {
+
+	const value_t* contrib;
+	value_t* nxt;
+
+	void operator() (const ll_edge_block& block) {
+		for (size_t i = 0; i < block.eb_length; i++) {
+			ATOMIC_ADD<value_t>(&nxt[block.eb_neighbors[i]],
+					contrib[block.eb_nodes[i]]);
+		}
+	}
+};
+
+
+/**
+ * The PageRank benchmark - edge-centric variant (X-Stream style), which
+ * streams the edge tables level by level instead of visiting the vertices
+ */
+template <class Graph, typename value_t>
+class ll_b_pagerank_scan_ext : public ll_benchmark<Graph> {
+
+	value_t d;
+	int32_t max;
+
+	value_t* G_pg_rank;
+
+
+public:
+
+	/**
+	 * Create the benchmark
+	 */
+	ll_b_pagerank_scan_ext(int32_t max, value_t d=0.85)
+		: ll_benchmark<Graph>(
+				/* assuming that value_t is either a float or a double */
+				sizeof(value_t) == sizeof(float)
+					? "PageRank<float> - Edge Scan"
+					: "PageRank<double> - Edge Scan") {
+
+		assert(d > 0 && d < 1);
+
+		this->d = d;
+		this->max = max;
+
+		this->create_auto_array_for_nodes(G_pg_rank);
+	}
+
+
+	/**
+	 * Destroy the benchmark
+	 */
+	virtual ~ll_b_pagerank_scan_ext(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		Graph& G = *this->_graph;
+		ll_memory_helper m;
+
+		int32_t cnt = 0 ;
+		value_t N = (value_t)(G.max_nodes()) ;
+		value_t* G_pg_rank_nxt = m.allocate<value_t>(G.max_nodes());
+		value_t* G_contrib = m.allocate<value_t>(G.max_nodes());
+
+#pragma omp parallel for
+		for (node_t t0 = 0; t0 < G.max_nodes(); t0 ++)  {
+			G.set_node_prop(G_pg_rank, t0, 1 / N);
+			G.set_node_prop(G_pg_rank_nxt, t0, (value_t) 0.0);
+		}
+
+		u_pagerank_scatter<value_t> scatter;
+		scatter.contrib = G_contrib;
+		scatter.nxt = G_pg_rank_nxt;
+
+		this->progress_init(max);
+
+		do
+		{
+#pragma omp parallel for schedule(dynamic,4096)
+			for (node_t t = 0; t < G.max_nodes(); t ++) {
+				size_t t_degree = G.out_degree(t);
+				G_contrib[t] = t_degree == 0 ? 0
+					: G_pg_rank[t] / ((value_t) t_degree);
+			}
+
+			G.out_scan(scatter);
+
+#pragma omp parallel for schedule(dynamic,4096)
+			for (node_t t = 0; t < G.max_nodes(); t ++) 
+			{
+				G.set_node_prop(G_pg_rank, t, (1 - d) / N + d * G_pg_rank_nxt[t]);
+				G.set_node_prop(G_pg_rank_nxt, t, (value_t) 0.0);
+			}
+
+			cnt = cnt + 1 ;
+			this->progress_update(cnt);
+		}
+		while (cnt < max);
+		this->progress_clear();
+
+		return 0;
+	}
+
+
+	/**
+	 * Finalize the benchmark
+	 *
+	 * @return the updated numerical result, if applicable
+	 */
+	virtual double finalize(void) {
+		value_t s = 0;
+		for (node_t n = 0; n < this->_graph->max_nodes(); n++) {
+			s += G_pg_rank[n];
+		}
+		return s;
+	}
+
+
+	/**
+	 * Print the results
+	 * 
+	 * @param f the output file
+	 */
+	virtual void print_results(FILE* f) {
+		print_results_part(f, this->_graph, G_pg_rank);
+	}
+};
+
+
 /**
  * Adapters
  */
@@ -432,5 +626,22 @@ public:
 		: ll_b_pagerank_push_ext<Graph, double>(max, d) {}
 };
 
+
+/**
+ * The PageRank benchmark - Edge scan variant, float
+ */
+template <class Graph>
+class ll_b_pagerank_scan_float
+	: public ll_b_pagerank_scan_ext<Graph, float> {
+
+public:
+
+	/**
+	 * Create the benchmark
+	 */
+	ll_b_pagerank_scan_float(int32_t max, float d=0.85)
+		: ll_b_pagerank_scan_ext<Graph, float>(max, d) {}
+};
+
 #endif
 
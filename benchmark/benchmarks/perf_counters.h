@@ -0,0 +1,309 @@
+/*
+ * perf_counters.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef PERF_COUNTERS_H_
+#define PERF_COUNTERS_H_
+
+#if defined(__linux__)
+
+#include <sys/syscall.h>
+#include <sys/types.h>
+#include <linux/perf_event.h>
+#include <omp.h>
+#include <stdint.h>
+#include <unistd.h>
+
+#include <cerrno>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+
+
+/**
+ * The number of hardware performance counters
+ */
+#define PERF_NUM_EVENTS			6
+
+#define PERF_CYCLES				0
+#define PERF_INSTRUCTIONS		1
+#define PERF_LLC_MISSES			2
+#define PERF_L1D_MISSES			3
+#define PERF_DTLB_MISSES		4
+#define PERF_BRANCH_MISSES		5
+
+
+/**
+ * The labels of the hardware performance counters
+ */
+static const char* PERF_EVENT_LABELS[PERF_NUM_EVENTS] = {
+	"Cycles     : ",
+	"Instr.     : ",
+	"LLC Misses : ",
+	"L1D Misses : ",
+	"dTLB Misses: ",
+	"Br. Misses : ",
+};
+
+
+/**
+ * The identifiers of the hardware performance counters (for the saved stats)
+ */
+static const char* PERF_EVENT_IDS[PERF_NUM_EVENTS] = {
+	"cycles",
+	"instructions",
+	"llc_misses",
+	"l1d_misses",
+	"dtlb_misses",
+	"branch_misses",
+};
+
+
+/**
+ * The hardware performance counter values of a phase (NAN if not available)
+ */
+struct perf_values {
+	double pv_values[PERF_NUM_EVENTS];
+};
+
+
+/**
+ * The hardware performance counters of the calling thread and the OpenMP
+ * worker threads. Each thread gets its own perf_event_open() counter group,
+ * which is always enabled; the phases are measured by reading all groups
+ * before and after, and the counts are scaled if the kernel had to multiplex
+ * the counters.
+ */
+class perf_counters {
+
+	std::vector<int> _leaders;
+	std::vector<int> _fds;
+
+	int _positions[PERF_NUM_EVENTS];
+	int _num_open;
+
+
+public:
+
+	/**
+	 * Open the counters
+	 *
+	 * @param num_threads the number of OpenMP threads
+	 */
+	perf_counters(int num_threads) {
+
+		_num_open = 0;
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) _positions[e] = -1;
+
+		std::vector<pid_t> tids(num_threads, 0);
+#		pragma omp parallel num_threads(num_threads)
+		tids[omp_get_thread_num()] = (pid_t) syscall(SYS_gettid);
+
+		for (size_t t = 0; t < tids.size(); t++) {
+			if (tids[t] == 0) continue;
+			if (!open_group(tids[t], t == 0)) break;
+		}
+	}
+
+
+	/**
+	 * Close the counters
+	 */
+	~perf_counters() {
+		for (size_t i = 0; i < _fds.size(); i++) close(_fds[i]);
+	}
+
+
+	/**
+	 * Determine whether any counters are available
+	 *
+	 * @return true if at least one counter is available
+	 */
+	bool available() const {
+		return !_leaders.empty() && _num_open > 0;
+	}
+
+
+	/**
+	 * Read the raw counters of all groups
+	 *
+	 * @param out the output vector
+	 */
+	void read_all(std::vector<uint64_t>& out) const {
+
+		size_t n = 3 + _num_open;
+		out.assign(_leaders.size() * n, 0);
+
+		for (size_t i = 0; i < _leaders.size(); i++) {
+			ssize_t r = read(_leaders[i], &out[i * n], n * sizeof(uint64_t));
+			if (r != (ssize_t) (n * sizeof(uint64_t))) {
+				memset(&out[i * n], 0, n * sizeof(uint64_t));
+			}
+		}
+	}
+
+
+	/**
+	 * Compute the counts between two reads
+	 *
+	 * @param after the later read
+	 * @param before the earlier read
+	 * @param out the output values
+	 */
+	void diff(const std::vector<uint64_t>& after,
+			const std::vector<uint64_t>& before, perf_values& out) const {
+
+		double v[PERF_NUM_EVENTS];
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) v[e] = 0;
+
+		size_t n = 3 + _num_open;
+		bool ok = after.size() == before.size()
+			&& after.size() == _leaders.size() * n;
+
+		for (size_t i = 0; ok && i < _leaders.size(); i++) {
+			const uint64_t* a = &after[i * n];
+			const uint64_t* b = &before[i * n];
+
+			// Layout: nr, time_enabled, time_running, values[nr]
+
+			uint64_t enabled = a[1] - b[1];
+			uint64_t running = a[2] - b[2];
+			if (enabled == 0) continue;
+			if (running == 0) { ok = false; break; }
+
+			double scale = enabled / (double) running;
+			for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+				if (_positions[e] < 0) continue;
+				v[e] += (a[3 + _positions[e]] - b[3 + _positions[e]]) * scale;
+			}
+		}
+
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+			out.pv_values[e] = ok && _positions[e] >= 0 ? v[e] : NAN;
+		}
+	}
+
+
+private:
+
+	/**
+	 * Open a counter group for the given thread
+	 *
+	 * @param tid the thread ID
+	 * @param first true if this is the first group
+	 * @return true on success
+	 */
+	bool open_group(pid_t tid, bool first) {
+
+		static const uint32_t types[PERF_NUM_EVENTS] = {
+			PERF_TYPE_HARDWARE,
+			PERF_TYPE_HARDWARE,
+			PERF_TYPE_HARDWARE,
+			PERF_TYPE_HW_CACHE,
+			PERF_TYPE_HW_CACHE,
+			PERF_TYPE_HARDWARE,
+		};
+
+		static const uint64_t configs[PERF_NUM_EVENTS] = {
+			PERF_COUNT_HW_CPU_CYCLES,
+			PERF_COUNT_HW_INSTRUCTIONS,
+			PERF_COUNT_HW_CACHE_MISSES,
+			PERF_COUNT_HW_CACHE_L1D
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+				| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_CACHE_DTLB
+				| (PERF_COUNT_HW_CACHE_OP_READ << 8)
+				| (PERF_COUNT_HW_CACHE_RESULT_MISS << 16),
+			PERF_COUNT_HW_BRANCH_MISSES,
+		};
+
+		std::vector<int> fds;
+		int leader = -1;
+		int err = 0;
+
+		for (int e = 0; e < PERF_NUM_EVENTS; e++) {
+
+			// Open only the events that are available in the first group
+
+			if (!first && _positions[e] < 0) continue;
+
+			struct perf_event_attr attr;
+			memset(&attr, 0, sizeof(attr));
+			attr.size = sizeof(attr);
+			attr.type = types[e];
+			attr.config = configs[e];
+			attr.exclude_kernel = 1;
+			attr.exclude_hv = 1;
+			attr.read_format = PERF_FORMAT_GROUP
+				| PERF_FORMAT_TOTAL_TIME_ENABLED
+				| PERF_FORMAT_TOTAL_TIME_RUNNING;
+
+			int fd = (int) syscall(SYS_perf_event_open, &attr, tid, -1,
+					leader, 0);
+			if (fd < 0) {
+				if (first) {
+					if (err == 0) err = errno;
+					continue;
+				}
+
+				fprintf(stderr, "Warning: Cannot open the hardware "
+						"performance counters of thread %d (%s)\n",
+						(int) tid, strerror(errno));
+				for (size_t i = 0; i < fds.size(); i++) close(fds[i]);
+				return false;
+			}
+
+			if (leader < 0) leader = fd;
+			fds.push_back(fd);
+			if (first) _positions[e] = _num_open++;
+		}
+
+		if (leader < 0) {
+			fprintf(stderr, "Warning: Hardware performance counters are "
+					"not available (%s)\n", strerror(err));
+			return false;
+		}
+
+		_leaders.push_back(leader);
+		_fds.insert(_fds.end(), fds.begin(), fds.end());
+
+		return true;
+	}
+};
+
+#endif
+#endif
@@ -47,12 +47,54 @@
 #include <omp.h>
 
 #include "llama/ll_bfs_template.h"
+#include "llama/ll_edge_map.h"
 #include "llama/ll_writable_graph.h"
 #include "benchmarks/benchmark.h"
 
 #define LL_SSSP_RETURNS_MAX
 
 
+#ifdef LL_FRONTIER_PREFETCH
+
+/**
+ * Advise the OS about the upcoming accesses to the out-edges of the nodes
+ * in the frontier
+ *
+ * @param G the graph
+ * @param in_frontier the per-node frontier flags
+ * @param frontier the buffer for the frontier nodes
+ */
+template <class Graph>
+static void sssp_advise_frontier(Graph& G, const bool* in_frontier,
+		std::vector<node_t>& frontier) {
+
+	// Gather the frontier in parallel into per-thread lists; the static
+	// schedule keeps them in the node order when concatenated
+
+	size_t num_threads = omp_get_max_threads();
+	std::vector<node_t>* parts = new std::vector<node_t>[num_threads];
+
+#pragma omp parallel
+	{
+		std::vector<node_t>& part = parts[omp_get_thread_num()];
+
+#pragma omp for schedule(static)
+		for (node_t n = 0; n < G.max_nodes(); n++) {
+			if (in_frontier[n]) part.push_back(n);
+		}
+	}
+
+	frontier.clear();
+	for (size_t t = 0; t < num_threads; t++) {
+		frontier.insert(frontier.end(), parts[t].begin(), parts[t].end());
+	}
+	delete[] parts;
+
+	G.out_advise(frontier.data(), frontier.size());
+}
+#endif
+
+
 /**
  * Weighted SSSP
  */
@@ -108,6 +150,9 @@ public:
 		bool* G_updated_nxt = m.allocate<bool>(G.max_nodes());
 		WeightType* G_dist_nxt
 			= (WeightType*) malloc(sizeof(WeightType) * G.max_nodes());
+#ifdef LL_FRONTIER_PREFETCH
+		std::vector<node_t> frontier;
+#endif
 
 		fin = false ;
 
@@ -121,6 +166,9 @@ public:
 			G.set_node_prop(G_dist_nxt, t0, G_dist[t0]);
 			G.set_node_prop(G_updated_nxt, t0, G_updated[t0]);
 		}
+		ll_edge_balanced_partition P(G.out_degree_prefix_sums(),
+				G.max_nodes(), true);
+
 		while ( !fin)
 		{
 			bool __E8 = false ;
@@ -128,17 +176,19 @@ public:
 			fin = true ;
 			__E8 = false ;
 
-#pragma omp parallel for schedule(dynamic,4096)
-			for (node_t n = 0; n < G.max_nodes(); n ++) 
+#ifdef LL_FRONTIER_PREFETCH
+			sssp_advise_frontier(G, G_updated, frontier);
+#endif
+
+#pragma omp parallel for schedule(dynamic,1)
+			for (size_t c = 0; c < P.size(); c ++) 
 			{
-				if (G_updated[n])
+				const ll_edge_balanced_chunk& chunk = P[c];
+				for (node_t n = chunk.ec_begin; n < chunk.ec_end; n ++) 
 				{
-					ll_edge_iterator iter;
-					G.out_iter_begin(iter, n);
-					for (edge_t s_idx = G.out_iter_next(iter);
-							s_idx != LL_NIL_EDGE;
-							s_idx = G.out_iter_next(iter)) {
-						node_t s = LL_ITER_OUT_NEXT_NODE(G, iter, s_idx);
+					if (!G_updated[n]) continue;
+					ll_foreach_out_range_ext(s_idx, s, G, n,
+							chunk.ec_edge_begin, chunk.ec_edge_end) {
 						edge_t e;
 
 						e = s_idx ;
@@ -382,6 +432,9 @@ public:
 		bool* G_updated_nxt = m.allocate<bool>(G.max_nodes());
 		int32_t* G_dist_nxt
 			= (int32_t*) malloc(sizeof(int32_t) * G.max_nodes());
+#ifdef LL_FRONTIER_PREFETCH
+		std::vector<node_t> frontier;
+#endif
 
 		fin = false ;
 
@@ -393,6 +446,9 @@ public:
 			G.set_node_prop(G_dist_nxt, t0, G_dist[t0]);
 			G.set_node_prop(G_updated_nxt, t0, G_updated[t0]);
 		}
+		ll_edge_balanced_partition P(G.out_degree_prefix_sums(),
+				G.max_nodes(), true);
+
 		while ( !fin)
 		{
 			bool __E8 = false ;
@@ -400,17 +456,19 @@ public:
 			fin = true ;
 			__E8 = false ;
 
-#pragma omp parallel for schedule(dynamic,4096)
-			for (node_t n = 0; n < G.max_nodes(); n ++) 
+#ifdef LL_FRONTIER_PREFETCH
+			sssp_advise_frontier(G, G_updated, frontier);
+#endif
+
+#pragma omp parallel for schedule(dynamic,1)
+			for (size_t c = 0; c < P.size(); c ++) 
 			{
-				if (G_updated[n])
+				const ll_edge_balanced_chunk& chunk = P[c];
+				for (node_t n = chunk.ec_begin; n < chunk.ec_end; n ++) 
 				{
-					ll_edge_iterator iter;
-					G.out_iter_begin(iter, n);
-					for (edge_t s_idx = G.out_iter_next(iter);
-							s_idx != LL_NIL_EDGE;
-							s_idx = G.out_iter_next(iter)) {
-						node_t s = LL_ITER_OUT_NEXT_NODE(G, iter, s_idx);
+					if (!G_updated[n]) continue;
+					ll_foreach_out_range_ext(s_idx, s, G, n,
+							chunk.ec_edge_begin, chunk.ec_edge_end) {
 
 						{ // argmin(argmax) - test and test-and-set
 							int32_t G_dist_nxt_new = G_dist[n] + 1;
@@ -481,5 +539,124 @@ public:
 	}
 };
 
+
+/**
+ * The edge map functor for the unweighted SSSP
+ */
+struct u_sssp_edge_map {
+
+	int32_t* dist;
+	int32_t level;
+
+	u_sssp_edge_map(int32_t* _dist) : dist(_dist), level(0) {}
+
+	inline bool update(node_t s, node_t d) {
+		dist[d] = level;
+		return true;
+	}
+
+	inline bool update_atomic(node_t s, node_t d) {
+		return __sync_bool_compare_and_swap(&dist[d], INT_MAX-1, level);
+	}
+
+	inline bool cond(node_t d) {
+		return dist[d] == INT_MAX-1;
+	}
+};
+
+
+
+/**
+ * Unweighted SSSP using the edge map runtime
+ */
+template <class Graph>
+class ll_b_sssp_unweighted_em : public ll_benchmark<Graph> {
+
+	node_t root;
+	int32_t* G_dist;
+
+
+public:
+
+	/**
+	 * Create the benchmark
+	 *
+	 * @param root the root
+	 */
+	ll_b_sssp_unweighted_em(node_t root)
+		: ll_benchmark<Graph>("SSSP - Unweighted, edge map") {
+
+		this->root = root;
+		this->create_auto_array_for_nodes(G_dist);
+	}
+
+
+	/**
+	 * Destroy the benchmark
+	 */
+	virtual ~ll_b_sssp_unweighted_em(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		Graph& G = *this->_graph;
+
+#pragma omp parallel for
+		for (node_t t0 = 0; t0 < G.max_nodes(); t0 ++) 
+			G.set_node_prop(G_dist, t0, (t0 == root)?0:INT_MAX-1);
+
+		u_sssp_edge_map f(G_dist);
+		ll_vertex_subset* frontier = new ll_vertex_subset(G.max_nodes(), root);
+
+		while (!frontier->empty()) {
+			f.level++;
+			ll_vertex_subset* next = ll_edge_map(G, *frontier, f);
+			delete frontier;
+			frontier = next;
+		}
+
+		delete frontier;
+		return 0;
+	}
+
+
+	/**
+	 * Finalize the benchmark
+	 *
+	 * @return the updated numerical result, if applicable
+	 */
+	virtual double finalize(void) {
+		size_t count = 0;
+		int32_t max = 0;
+		for (node_t n = 0; n < this->_graph->max_nodes(); n++) {
+			if (G_dist[n] < INT_MAX-1) {
+				count++;
+				if (G_dist[n] > max) max = G_dist[n];
+			}
+		}
+#ifdef LL_SSSP_RETURNS_MAX
+		return max;
+#else
+		return count;
+#endif
+	}
+
+
+	/**
+	 * Print the results
+	 * 
+	 * @param f the output file
+	 */
+	virtual void print_results(FILE* f) {
+		print_results_part(f, this->_graph, G_dist);
+	}
+};
+
 #endif
 
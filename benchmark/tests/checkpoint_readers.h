@@ -0,0 +1,213 @@
+/*
+ * checkpoint_readers.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_TEST_CHECKPOINT_READERS_H
+#define LL_TEST_CHECKPOINT_READERS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+#include <limits.h>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "llama/ll_writable_graph.h"
+#include "benchmarks/benchmark.h"
+
+
+/**
+ * Test: Scan the graph inside read_begin() and read_end() while another
+ * thread keeps adding edges and checkpointing them into new levels
+ */
+template <class Graph>
+class ll_t_checkpoint_readers : public ll_benchmark<Graph> {
+
+	/// The number of checkpoints
+	int _rounds;
+
+	/// The number of edges added before each checkpoint
+	int _edges_per_round;
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_checkpoint_readers()
+		: ll_benchmark<Graph>("[Test] Readers during checkpoints") {
+
+		_rounds = 40;
+		_edges_per_round = 64;
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_checkpoint_readers(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		Graph& G = *this->_graph;
+
+		printf("\nCHECKPOINT READERS TEST START\n");
+
+		node_t max_nodes = G.max_nodes();
+		if (max_nodes <= 0) {
+			printf("     --> the graph is empty\n");
+			return NAN;
+		}
+
+		size_t levels = G.num_levels();
+		long base = count(G, max_nodes);
+
+		printf(" * Initial: %ld out-edges in %lu levels\n", base,
+				(unsigned long) levels);
+		printf(" * Checkpoint %d times while scanning: ", _rounds);
+		fflush(stdout);
+
+		volatile bool done = false;
+		volatile long added = 0;
+		volatile long scans = 0;
+		volatile long failures = 0;
+
+		int threads = std::max(2, omp_get_max_threads());
+
+#pragma omp parallel num_threads(threads)
+		{
+			if (omp_get_thread_num() == 0) {
+
+				// The writer, which adds enough levels to outgrow the
+				// per-level arrays a few times over
+
+				unsigned seed = 1;
+
+				for (int r = 0; r < _rounds; r++) {
+
+					G.tx_begin();
+					for (int i = 0; i < _edges_per_round; i++) {
+						node_t n = ll_rand64_positive_r(&seed) % max_nodes;
+						node_t m = ll_rand64_positive_r(&seed) % max_nodes;
+						if (!G.node_exists(n) || !G.node_exists(m)) continue;
+						G.add_edge(n, m);
+						added++;
+					}
+					G.tx_commit();
+
+					G.checkpoint();
+				}
+
+				done = true;
+			}
+			else {
+
+				// The readers, which must always see at least the edges that
+				// existed before
+
+				while (!done) {
+					long c = count(G, max_nodes);
+					if (c < base) __sync_fetch_and_add(&failures, 1);
+					__sync_fetch_and_add(&scans, 1);
+				}
+			}
+		}
+
+		printf("%ld edges added, %lu levels, %ld scans\n", (long) added,
+				(unsigned long) G.num_levels(), (long) scans);
+
+		if (failures > 0) {
+			printf("     --> %ld scans missed edges\n", (long) failures);
+			return NAN;
+		}
+
+		long final_count = count(G, max_nodes);
+		printf(" * Validate: %ld out-edges\n", final_count); fflush(stdout);
+
+		if (final_count != base + added) {
+			printf("     --> failed, expected %ld\n", base + added);
+			return NAN;
+		}
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/**
+	 * Count the out-edges of the given nodes within a reader epoch
+	 *
+	 * @param G the graph
+	 * @param max_nodes the number of nodes to scan
+	 * @return the number of out-edges
+	 */
+	long count(Graph& G, node_t max_nodes) {
+
+		long c = 0;
+
+		int slot = G.read_begin();
+		G.tx_begin();
+
+		for (node_t n = 0; n < max_nodes; n++) {
+
+			ll_edge_iterator iter;
+			G.out_iter_begin(iter, n);
+			for (edge_t v_idx = G.out_iter_next(iter); v_idx != LL_NIL_EDGE;
+					v_idx = G.out_iter_next(iter)) {
+				c++;
+			}
+		}
+
+		G.tx_commit();
+		G.read_end(slot);
+
+		return c;
+	}
+};
+
+#endif
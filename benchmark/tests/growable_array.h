@@ -0,0 +1,196 @@
+/*
+ * growable_array.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_TEST_GROWABLE_ARRAY_H
+#define LL_TEST_GROWABLE_ARRAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+#include <limits.h>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "llama/ll_growable_array.h"
+#include "benchmarks/benchmark.h"
+
+
+/**
+ * Test: Append to ll_growable_array across its block boundaries and beyond
+ * its preallocated block table, while other threads read it without locks
+ */
+template <class Graph>
+class ll_t_growable_array : public ll_benchmark<Graph> {
+
+	typedef ll_growable_array<size_t, 10, ll_nop_deallocator<size_t>, false>
+		array_t;
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_growable_array() : ll_benchmark<Graph>("[Test] Growable array") {
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_growable_array(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		printf("\nGROWABLE ARRAY TEST START\n");
+
+		for (size_t n = 1000; n <= 1024000; n *= 32) {
+			if (!run(n)) return NAN;
+		}
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/**
+	 * The value stored at the given index
+	 *
+	 * @param index the index
+	 * @return the value
+	 */
+	static inline size_t value(size_t index) {
+		return index * 7 + 1;
+	}
+
+
+	/**
+	 * Append the given number of values while reading them concurrently,
+	 * and then check them
+	 *
+	 * @param count the number of values
+	 * @return true on success
+	 */
+	bool run(size_t count) {
+
+		printf(" * Append %lu values: ", count); fflush(stdout);
+
+		array_t* array = new array_t();
+		array_t& a = *array;
+
+		volatile bool done = false;
+		volatile long reads = 0;
+		volatile long failures = 0;
+
+		int threads = std::max(2, omp_get_max_threads());
+
+#pragma omp parallel num_threads(threads)
+		{
+			if (omp_get_thread_num() == 0) {
+				for (size_t i = 0; i < count; i++) a.append(value(i));
+				done = true;
+			}
+			else {
+
+				// The readers check the most recently appended values,
+				// which are the ones that can race with the writer
+
+				long r = 0;
+				long f = 0;
+
+				while (!done) {
+					size_t s = a.size();
+					__COMPILER_FENCE;
+					size_t from = s > 64 ? s - 64 : 0;
+					for (size_t i = from; i < s; i++, r++) {
+						if (a[i] != value(i)) f++;
+					}
+				}
+
+				__sync_fetch_and_add(&reads, r);
+				__sync_fetch_and_add(&failures, f);
+			}
+		}
+
+		printf("%ld concurrent reads\n", (long) reads);
+
+		if (failures > 0) {
+			printf("     --> %ld reads saw a wrong value\n", (long) failures);
+			delete array;
+			return false;
+		}
+
+
+		// Check the final contents through both block() and operator[]
+
+		size_t n = 0;
+		for (size_t b = 0; b < a.block_count(); b++) {
+			const size_t* block = a.block(b);
+			for (size_t i = 0; i < a.block_size(b); i++, n++) {
+				if (block[i] != value(n) || a[n] != block[i]) {
+					printf("     --> wrong value at index %lu of block %lu\n",
+							i, b);
+					delete array;
+					return false;
+				}
+			}
+		}
+
+		if (n != count || a.size() != count) {
+			printf("     --> the array has %lu (%lu in blocks) out of %lu "
+					"values\n", a.size(), n, count);
+			delete array;
+			return false;
+		}
+
+		delete array;
+		return true;
+	}
+};
+
+#endif
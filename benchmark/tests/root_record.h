@@ -0,0 +1,263 @@
+/*
+ * root_record.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+
+
+#ifndef LL_TEST_ROOT_RECORD_H
+#define LL_TEST_ROOT_RECORD_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <cmath>
+#include <string>
+
+#include "llama/ll_persistent_storage.h"
+#include "benchmarks/benchmark.h"
+#include "tests/test_utils.h"
+
+#ifdef LL_PERSISTENCE
+
+
+/**
+ * Test: Leave a level unfinished, tear the newer copy of the root record,
+ * and check which levels survive each reopen of the storage
+ */
+template <class Graph>
+class ll_t_root_record : public ll_benchmark<Graph> {
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_root_record() : ll_benchmark<Graph>("[Test] Root Record") {
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_root_record(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		printf("\nROOT RECORD TEST START\n");
+
+		char dir[] = "/tmp/llama-root-XXXXXX";
+		if (mkdtemp(dir) == NULL) {
+			perror("mkdtemp");
+			return NAN;
+		}
+
+		bool ok = run_steps(dir);
+		ll_t_remove_directory(dir);
+
+		if (!ok) return NAN;
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/**
+	 * Run the test steps
+	 *
+	 * @param dir the database directory
+	 * @return true if all passed
+	 */
+	bool run_steps(const char* dir) {
+
+		// Finish two levels and crash while writing the third, after its
+		// level metadata reached the ML file and the manifest
+
+		printf(" * Write: "); fflush(stdout);
+
+		ll_persistent_storage* storage = new ll_persistent_storage(dir);
+		ll_persistence_context* context
+			= new ll_persistence_context(storage, "test", "t");
+
+		for (size_t level = 0; level < 3; level++) {
+			context->ensure_file_for_level(level);
+			free(context->allocate_level(level, 0, 16, 1));
+			if (level < 2) context->finish_level(level);
+		}
+
+		storage->write_manifest();
+
+		delete context;
+		delete storage;
+
+		printf("3 levels, 2 finished\n");
+
+
+		// The unfinished level must be discarded, and it must stay
+		// discarded once the manifest is rewritten
+
+		if (!reopen(dir, 2, true)) return false;
+		if (!reopen(dir, 2, false)) return false;
+
+
+		// Corrupt the newer copy of the root record, which publishes both
+		// levels: the older copy, which publishes only the first, must win
+
+		printf(" * Corrupt the root record: "); fflush(stdout);
+
+		int newer = -1;
+		uint64_t newer_version = 0;
+
+		for (int copy = 0; copy < 2; copy++) {
+			ll_persistence_root_header_t h;
+			if (!ll_t_read_at(root_path(dir, copy), &h, sizeof(h), 0)) {
+				return false;
+			}
+			if (newer < 0 || h.rh_version > newer_version) {
+				newer = copy;
+				newer_version = h.rh_version;
+			}
+		}
+
+		const size_t H = sizeof(ll_persistence_root_header_t);
+
+		uint64_t published = 7;
+		if (!ll_t_write_at(root_path(dir, newer), &published,
+					sizeof(published), H)) {
+			return false;
+		}
+
+		printf("copy %d, version %lu\n", newer, (size_t) newer_version);
+
+		if (!reopen(dir, 1, true)) return false;
+
+
+		// Tear the older copy as well: with no valid copy left, the
+		// storage republishes what is left in the ML files
+
+		printf(" * Tear the root record: "); fflush(stdout);
+
+		if (truncate(root_path(dir, 1 - newer).c_str(), H / 2) != 0) {
+			perror("truncate");
+			return false;
+		}
+
+		printf("copy %d\n", 1 - newer);
+
+		if (!reopen(dir, 1, true)) return false;
+		if (!reopen(dir, 1, false)) return false;
+
+		return true;
+	}
+
+
+	/**
+	 * Reopen the storage and check the levels of the test context
+	 *
+	 * @param dir the database directory
+	 * @param levels the expected number of published levels
+	 * @param write_manifest true to rewrite the manifest before closing
+	 * @return true if it matches
+	 */
+	bool reopen(const char* dir, size_t levels, bool write_manifest) {
+
+		printf(" * Reopen: "); fflush(stdout);
+
+		ll_persistent_storage* storage = new ll_persistent_storage(dir);
+		ll_persistence_context* context
+			= new ll_persistence_context(storage, "test", "t");
+
+		size_t published = storage->published_levels(context->prefix());
+		ll_persistence_level_meta* metas = context->read_level_meta(0);
+
+		size_t present = 0;
+		bool contiguous = true;
+		for (size_t level = 0; level < LL_LEVELS_PER_ML_FILE; level++) {
+			if (metas[level].lm_vt_offset == 0) continue;
+			if (level != present) contiguous = false;
+			present++;
+		}
+
+		free(metas);
+
+		if (write_manifest) storage->write_manifest();
+
+		delete context;
+		delete storage;
+
+		printf("%lu levels published, %lu present\n", published, present);
+
+		if (published != levels || present != levels || !contiguous) {
+			printf("     --> failed (expected %lu levels)\n", levels);
+			return false;
+		}
+
+		return true;
+	}
+
+
+	/**
+	 * Get the path of a copy of the root record
+	 *
+	 * @param dir the database directory
+	 * @param copy the copy number
+	 * @return the path
+	 */
+	std::string root_path(const char* dir, int copy) {
+
+		char b[64];
+		snprintf(b, sizeof(b), LL_PERSISTENCE_ROOT, copy);
+
+		std::string s = dir;
+		s += "/";
+		s += b;
+		return s;
+	}
+};
+
+#endif
+#endif
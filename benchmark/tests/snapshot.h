@@ -0,0 +1,330 @@
+/*
+ * snapshot.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_TEST_SNAPSHOT_H
+#define LL_TEST_SNAPSHOT_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <float.h>
+#include <limits.h>
+#include <cmath>
+#include <algorithm>
+#include <omp.h>
+
+#include "llama/ll_writable_graph.h"
+#include "llama/ll_writable_snapshot.h"
+#include "benchmarks/benchmark.h"
+
+
+/**
+ * Test: Delete edges while holding a snapshot, which must not observe them
+ */
+template <class Graph>
+class ll_t_snapshot : public ll_benchmark<Graph> {
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_snapshot() : ll_benchmark<Graph>("[Test] Snapshot") {
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_snapshot(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		Graph& G = *this->_graph;
+
+		printf("\nSNAPSHOT TEST START\n");
+
+
+		// Freeze the loaded edges, since without LL_TIMESTAMPS the snapshot
+		// covers only the read-only levels
+
+		printf(" * Checkpoint: "); fflush(stdout);
+
+		G.checkpoint();
+
+		printf("done\n"); fflush(stdout);
+
+
+		// Add a node and delete it, and add another one past a hole in the
+		// node IDs, which is filled only after the snapshot
+
+		printf(" * Nodes: "); fflush(stdout);
+
+		G.tx_begin();
+		node_t deleted_node = G.add_node();
+		node_t hole_node = deleted_node + 1;
+		node_t kept_node = deleted_node + 2;
+		bool has_hole = G.add_node(kept_node);
+		G.tx_commit();
+
+#ifdef LL_DELETIONS
+		G.tx_begin();
+		G.delete_node(deleted_node);
+		G.tx_commit();
+#endif
+
+		printf("added %ld and %ld, deleted %ld\n", (long) deleted_node,
+				(long) kept_node, (long) deleted_node); fflush(stdout);
+
+		printf(" * Snapshot: "); fflush(stdout);
+
+		ll_writable_snapshot S(&G);
+
+		long num_out_edges = 0;
+		long num_in_edges = 0;
+		long checksum = 0;
+		count(S, num_out_edges, num_in_edges, checksum);
+
+		printf("%ld out-edges, %ld in-edges\n", num_out_edges, num_in_edges);
+		printf(" * Delete: "); fflush(stdout);
+
+		int num_edges = 0;
+		int numDeletedEdges = 0;
+
+		G.tx_begin();
+
+#pragma omp parallel
+		{
+			int ne = 0;
+			int nd = 0;
+
+#pragma omp for schedule(dynamic,4096)
+			for (node_t n = 0; n < G.max_nodes(); n++) {
+
+				ll_edge_iterator iter;
+				G.out_iter_begin(iter, n);
+				for (edge_t v_idx = G.out_iter_next(iter); v_idx != LL_NIL_EDGE;
+						v_idx = G.out_iter_next(iter)) {
+					ne++;
+
+					if (v_idx % 10 == 0) {
+						G.delete_edge(n, v_idx);
+						nd++;
+					}
+				}
+			}
+
+			ATOMIC_ADD(&num_edges, ne);
+			ATOMIC_ADD(&numDeletedEdges, nd);
+		}
+
+		printf("%d edges originaly, %d deleted, %d left\n",
+				num_edges, numDeletedEdges, num_edges - numDeletedEdges); fflush(stdout);
+
+		G.tx_commit();
+
+		if (!validate(S, num_out_edges, num_in_edges, checksum)) return NAN;
+
+
+		// The nodes out of the range of the snapshot, including a node added
+		// after it to the writable vertex table that the snapshot pins, must
+		// not be visible
+
+		printf(" * Out of range: "); fflush(stdout);
+
+		G.tx_begin();
+		node_t new_node = G.add_node();
+		G.add_edge(new_node, new_node);
+		G.tx_commit();
+
+		node_t out_of_range[] = { -1, S.max_nodes(), new_node,
+			S.max_nodes() + ((node_t) 1 << 30) };
+
+		for (size_t i = 0; i < sizeof(out_of_range) / sizeof(node_t); i++) {
+			node_t n = out_of_range[i];
+			if (n < S.max_nodes() && n >= 0) continue;
+			if (S.node_exists(n) || S.out_degree(n) != 0
+					|| S.in_degree(n) != 0) {
+				printf("\n     --> failed, the snapshot sees node %ld\n",
+						(long) n);
+				return NAN;
+			}
+		}
+
+		printf("done\n"); fflush(stdout);
+
+
+		// The snapshot must agree with its own iterators about the nodes
+		// deleted before it and added after it
+
+		printf(" * Node visibility: "); fflush(stdout);
+
+		if (has_hole) {
+			G.tx_begin();
+			has_hole = G.add_node(hole_node);
+			G.tx_commit();
+		}
+
+#ifdef LL_DELETIONS
+		if (S.node_exists(deleted_node)) {
+			printf("\n     --> failed, the snapshot sees deleted node %ld\n",
+					(long) deleted_node);
+			return NAN;
+		}
+#endif
+
+		if (has_hole && S.node_exists(hole_node)) {
+			printf("\n     --> failed, the snapshot sees node %ld added after"
+					" it\n", (long) hole_node);
+			return NAN;
+		}
+
+#ifdef LL_TIMESTAMPS
+		if (!S.node_exists(kept_node)) {
+			printf("\n     --> failed, the snapshot does not see node %ld\n",
+					(long) kept_node);
+			return NAN;
+		}
+#endif
+
+		printf("done\n"); fflush(stdout);
+
+		printf(" * Checkpoint: "); fflush(stdout);
+
+		G.checkpoint();
+
+		printf("done\n"); fflush(stdout);
+
+		if (!validate(S, num_out_edges, num_in_edges, checksum)) return NAN;
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/**
+	 * Count the edges visible in the snapshot
+	 *
+	 * @param S the snapshot
+	 * @param o_out the number of out-edges
+	 * @param o_in the number of in-edges
+	 * @param o_checksum the sum of the out-edge targets
+	 */
+	void count(ll_writable_snapshot& S, long& o_out, long& o_in,
+			long& o_checksum) {
+
+		long num_out = 0;
+		long num_in = 0;
+		long checksum = 0;
+
+#pragma omp parallel
+		{
+			long no = 0;
+			long ni = 0;
+			long c = 0;
+
+#pragma omp for schedule(dynamic,4096)
+			for (node_t n = 0; n < S.max_nodes(); n++) {
+
+				ll_edge_iterator iter;
+				S.out_iter_begin(iter, n);
+				for (edge_t v_idx = S.out_iter_next(iter); v_idx != LL_NIL_EDGE;
+						v_idx = S.out_iter_next(iter)) {
+					no++;
+					c += iter.last_node;
+				}
+
+				S.in_iter_begin(iter, n);
+				for (edge_t v_idx = S.in_iter_next(iter); v_idx != LL_NIL_EDGE;
+						v_idx = S.in_iter_next(iter)) {
+					ni++;
+				}
+			}
+
+			ATOMIC_ADD(&num_out, no);
+			ATOMIC_ADD(&num_in, ni);
+			ATOMIC_ADD(&checksum, c);
+		}
+
+		o_out = num_out;
+		o_in = num_in;
+		o_checksum = checksum;
+	}
+
+
+	/**
+	 * Check that the snapshot still sees the same edges
+	 *
+	 * @param S the snapshot
+	 * @param num_out the expected number of out-edges
+	 * @param num_in the expected number of in-edges
+	 * @param checksum the expected sum of the out-edge targets
+	 * @return true if it does
+	 */
+	bool validate(ll_writable_snapshot& S, long num_out, long num_in,
+			long checksum) {
+
+		printf(" * Validate: "); fflush(stdout);
+
+		long num_out2 = 0;
+		long num_in2 = 0;
+		long checksum2 = 0;
+		count(S, num_out2, num_in2, checksum2);
+
+		printf("%ld out-edges, %ld in-edges in the snapshot\n",
+				num_out2, num_in2); fflush(stdout);
+
+		if (num_out2 != num_out || num_in2 != num_in || checksum2 != checksum) {
+			printf("     --> failed\n");
+			return false;
+		}
+
+		return true;
+	}
+};
+
+#endif
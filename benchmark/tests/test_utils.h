@@ -0,0 +1,126 @@
+/*
+ * test_utils.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_TEST_UTILS_H
+#define LL_TEST_UTILS_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <sys/types.h>
+#include <string>
+
+
+/**
+ * Read from a file
+ *
+ * @param file the file name
+ * @param data the buffer
+ * @param length the length
+ * @param offset the file offset
+ * @return true on success
+ */
+inline bool ll_t_read_at(const std::string& file, void* data, size_t length,
+		off_t offset) {
+
+	FILE* f = fopen(file.c_str(), "rb");
+	if (f == NULL) {
+		perror("fopen");
+		return false;
+	}
+
+	bool ok = fseeko(f, offset, SEEK_SET) == 0
+		&& fread(data, 1, length, f) == length;
+	if (!ok) perror("fread");
+
+	fclose(f);
+	return ok;
+}
+
+
+/**
+ * Overwrite a part of a file
+ *
+ * @param file the file name
+ * @param data the data
+ * @param length the length
+ * @param offset the file offset
+ * @return true on success
+ */
+inline bool ll_t_write_at(const std::string& file, const void* data,
+		size_t length, off_t offset) {
+
+	FILE* f = fopen(file.c_str(), "r+b");
+	if (f == NULL) {
+		perror("fopen");
+		return false;
+	}
+
+	bool ok = fseeko(f, offset, SEEK_SET) == 0
+		&& fwrite(data, 1, length, f) == length;
+	if (!ok) perror("fwrite");
+
+	fclose(f);
+	return ok;
+}
+
+
+/**
+ * Remove a test database directory and its files
+ *
+ * @param dir the directory
+ */
+inline void ll_t_remove_directory(const char* dir) {
+
+	DIR* d = opendir(dir);
+	if (d == NULL) return;
+
+	struct dirent* ent;
+	while ((ent = readdir(d)) != NULL) {
+		if (ent->d_name[0] == '.') continue;
+		std::string s = dir;
+		s += "/";
+		s += ent->d_name;
+		unlink(s.c_str());
+	}
+
+	closedir(d);
+	rmdir(dir);
+}
+
+#endif
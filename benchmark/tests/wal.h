@@ -0,0 +1,375 @@
+/*
+ * wal.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+
+
+#ifndef LL_TEST_WAL_H
+#define LL_TEST_WAL_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llama/ll_wal.h"
+#include "benchmarks/benchmark.h"
+#include "tests/test_utils.h"
+
+#ifdef LL_WAL
+
+
+/**
+ * The edges replayed from a write-ahead log
+ */
+struct ll_t_wal_edges {
+
+	/// The source and target of each replayed edge, in order
+	std::vector<std::pair<int64_t, int64_t> > edges;
+
+	/// The number of replayed records other than edge additions
+	size_t others;
+
+	/**
+	 * Create the collector
+	 */
+	ll_t_wal_edges() : others(0) {
+	}
+
+	/**
+	 * Collect a replayed record
+	 *
+	 * @param r the record
+	 * @param name the property name, or NULL
+	 */
+	void operator() (const ll_wal_record_t* r, const char* name) {
+		if (r->wr_type == LL_WAL_ADD_EDGE) {
+			edges.push_back(std::make_pair(r->wr_args[0], r->wr_args[1]));
+		}
+		else {
+			others++;
+		}
+	}
+};
+
+
+/**
+ * Test: Write a write-ahead log, tear and corrupt its tail, restart it as
+ * if after a checkpoint, and check which edges each reopen recovers
+ */
+template <class Graph>
+class ll_t_wal : public ll_benchmark<Graph> {
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_wal() : ll_benchmark<Graph>("[Test] Write-Ahead Log") {
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_wal(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		printf("\nWRITE-AHEAD LOG TEST START\n");
+
+		char dir[] = "/tmp/llama-wal-XXXXXX";
+		if (mkdtemp(dir) == NULL) {
+			perror("mkdtemp");
+			return NAN;
+		}
+
+		_file_name = dir;
+		_file_name += "/";
+		_file_name += LL_WAL_FILE;
+
+		bool ok = run_steps(dir);
+
+		unlink(_file_name.c_str());
+		rmdir(dir);
+
+		if (!ok) return NAN;
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/// The log file
+	std::string _file_name;
+
+	/// The edges that the next reopen should replay, in order
+	std::vector<std::pair<int64_t, int64_t> > _expected;
+
+
+	/**
+	 * Run the test steps
+	 *
+	 * @param dir the database directory
+	 * @return true if all passed
+	 */
+	bool run_steps(const char* dir) {
+
+		const size_t H = sizeof(ll_wal_header_t);
+		const size_t R = sizeof(ll_wal_record_t);
+
+
+		// A committed transaction, an aborted transaction, a transaction
+		// interrupted before its commit, and a group commit whose tail gets
+		// torn
+
+		printf(" * Write: "); fflush(stdout);
+
+		ll_wal* wal = new ll_wal(dir);
+
+		add_edges(wal, 1, 0, 10, true);
+		add_edges(wal, 2, 100, 5, false);
+		wal->append(LL_WAL_ABORT, 2, 0);
+		wal->commit();
+		_expected.resize(10);
+		add_edges(wal, 3, 200, 8, true);
+		add_edges(wal, 4, 300, 4, false);
+		wal->commit();
+		_expected.resize(18);
+		add_edges(wal, 5, 400, 2, true);
+
+		printf("%lu records, %lu syncs\n", (size_t) wal->last_lsn(),
+				wal->num_syncs());
+		delete wal;
+
+		if (!check_size(H + 33 * R)) return false;
+
+
+		// The durable records of the interrupted transaction must not replay
+
+		if (!reopen(dir, 0, 33, 33)) return false;
+
+
+		// Tear the last edge record and drop the commit record after it, as
+		// if the crash hit in the middle of writing out the group: none of
+		// the records of that transaction may replay
+
+		printf(" * Tear the tail: "); fflush(stdout);
+
+		if (truncate(_file_name.c_str(), H + 31 * R + R / 2) != 0) {
+			perror("truncate");
+			return false;
+		}
+		_expected.resize(_expected.size() - 2);
+
+		printf("done\n");
+
+		if (!reopen(dir, 0, 31, 31)) return false;
+		if (!check_size(H + 31 * R)) return false;
+
+
+		// Corrupt a record in the middle: the valid records after it must
+		// not be recovered either, and the transaction loses its commit
+
+		printf(" * Corrupt a record: "); fflush(stdout);
+
+		wal = new ll_wal(dir);
+		add_edges(wal, 6, 600, 5, true);
+		delete wal;
+
+		int64_t bad = 0x7fff;
+		if (!ll_t_write_at(_file_name, &bad, sizeof(bad),
+					H + 33 * R + offsetof(ll_wal_record_t, wr_args))) {
+			return false;
+		}
+		_expected.resize(_expected.size() - 5);
+
+		printf("done\n");
+
+		if (!reopen(dir, 0, 33, 33)) return false;
+
+
+		// Restart the log as if after a checkpoint, and crash before the
+		// truncate: the old records are below the new first LSN
+
+		printf(" * Checkpoint: "); fflush(stdout);
+
+		wal = new ll_wal(dir);
+		add_edges(wal, 7, 700, 5, true);
+		delete wal;
+
+		std::vector<char> old(6 * R);
+		if (!ll_t_read_at(_file_name, &old[0], old.size(), H + 33 * R)) {
+			return false;
+		}
+
+		wal = new ll_wal(dir);
+		wal->restart(3);
+		delete wal;
+
+		if (!ll_t_write_at(_file_name, &old[0], old.size(), H)) return false;
+		_expected.clear();
+
+		printf("done\n");
+
+		if (!reopen(dir, 3, 0, 39)) return false;
+		if (!check_size(H)) return false;
+
+
+		// Append after the checkpoint: only the new records replay
+
+		printf(" * Append: "); fflush(stdout);
+
+		wal = new ll_wal(dir);
+		add_edges(wal, 8, 800, 3, true);
+		delete wal;
+
+		printf("done\n");
+
+		if (!reopen(dir, 3, 4, 43)) return false;
+
+		return true;
+	}
+
+
+	/**
+	 * Append a run of edges (n, n + 1) and add them to the expected edges
+	 *
+	 * @param wal the log
+	 * @param tx the transaction
+	 * @param first the first source node
+	 * @param count the number of edges
+	 * @param commit true to append the commit record and sync the log
+	 */
+	void add_edges(ll_wal* wal, uint64_t tx, int64_t first, int count,
+			bool commit) {
+
+		for (int i = 0; i < count; i++) {
+			int64_t n = first + i;
+			wal->append(LL_WAL_ADD_EDGE, tx, n, n + 1, i);
+			_expected.push_back(std::make_pair(n, n + 1));
+		}
+
+		if (commit) {
+			wal->append(LL_WAL_COMMIT, tx, 0);
+			wal->commit();
+		}
+	}
+
+
+	/**
+	 * Reopen the log, replay it, and check the result
+	 *
+	 * @param dir the database directory
+	 * @param base_levels the expected number of base levels
+	 * @param num_recovered the expected number of recovered records
+	 * @param last_lsn the expected last LSN
+	 * @return true if it matches
+	 */
+	bool reopen(const char* dir, size_t base_levels, size_t num_recovered,
+			uint64_t last_lsn) {
+
+		printf(" * Reopen: "); fflush(stdout);
+
+		ll_wal* wal = new ll_wal(dir);
+
+		size_t b = wal->base_levels();
+		size_t n = wal->num_recovered();
+		uint64_t l = wal->last_lsn();
+
+		ll_t_wal_edges collector;
+		size_t replayed = wal->replay(collector);
+		delete wal;
+
+		printf("base level %lu, %lu records recovered, %lu replayed, "
+				"last LSN %lu\n", b, n, replayed, (size_t) l);
+
+		if (b != base_levels || n != num_recovered || l != last_lsn
+				|| collector.others != 0 || collector.edges != _expected
+				|| replayed != _expected.size()) {
+			printf("     --> failed (expected base level %lu, %lu records, "
+					"%lu edges, last LSN %lu)\n", base_levels, num_recovered,
+					_expected.size(), (size_t) last_lsn);
+			return false;
+		}
+
+		return true;
+	}
+
+
+	/**
+	 * Check the size of the log file
+	 *
+	 * @param size the expected size
+	 * @return true if it matches
+	 */
+	bool check_size(size_t size) {
+
+		struct stat st;
+		if (stat(_file_name.c_str(), &st) != 0) {
+			perror("stat");
+			return false;
+		}
+
+		if ((size_t) st.st_size != size) {
+			printf("     --> failed (the log has %lu bytes instead of %lu)\n",
+					(size_t) st.st_size, size);
+			return false;
+		}
+
+		return true;
+	}
+};
+
+#endif
+#endif
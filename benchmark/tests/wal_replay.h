@@ -0,0 +1,515 @@
+/*
+ * wal_replay.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_TEST_WAL_REPLAY_H
+#define LL_TEST_WAL_REPLAY_H
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/types.h>
+#include <algorithm>
+#include <cmath>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "llama/ll_database.h"
+#include "llama/ll_wal.h"
+#include "benchmarks/benchmark.h"
+#include "tests/test_utils.h"
+
+#if defined(LL_WAL) && defined(LL_PERSISTENCE)
+
+
+/**
+ * The name of the node property used by the test
+ */
+#define LL_T_WAL_REPLAY_NP			"t-wal-np"
+
+/**
+ * The name of the edge property used by the test
+ */
+#define LL_T_WAL_REPLAY_EP			"t-wal-ep"
+
+
+/**
+ * The contents of the graph as seen by the test
+ */
+struct ll_t_wal_replay_state {
+
+	/// Whether each node exists
+	std::vector<bool> nodes;
+
+	/// The node property values
+	std::vector<uint64_t> node_values;
+
+	/// The (target, edge property value) pairs of each node, sorted
+	std::vector<std::vector<std::pair<node_t, uint64_t> > > edges;
+
+	/**
+	 * Compare
+	 *
+	 * @param other the other state
+	 * @return true if equal
+	 */
+	bool operator== (const ll_t_wal_replay_state& other) const {
+		return nodes == other.nodes && node_values == other.node_values
+			&& edges == other.edges;
+	}
+};
+
+
+/**
+ * Test: Log updates of the writable graph, drop it, reopen the database,
+ * replay the log, and compare the nodes, edges, and properties; then
+ * check that a checkpoint restarts the log, and that a log which no longer
+ * matches the read-only levels is discarded
+ */
+template <class Graph>
+class ll_t_wal_replay : public ll_benchmark<Graph> {
+
+	/// The number of nodes in the first level
+	int _base_nodes;
+
+
+public:
+
+	/**
+	 * Create the test
+	 */
+	ll_t_wal_replay() : ll_benchmark<Graph>("[Test] Write-Ahead Log Replay") {
+		_base_nodes = 64;
+	}
+
+
+	/**
+	 * Destroy the test
+	 */
+	virtual ~ll_t_wal_replay(void) {
+	}
+
+
+	/**
+	 * Run the benchmark
+	 *
+	 * @return the numerical result, if applicable
+	 */
+	virtual double run(void) {
+
+		printf("\nWRITE-AHEAD LOG REPLAY TEST START\n");
+
+		char dir[] = "/tmp/llama-wal-replay-XXXXXX";
+		if (mkdtemp(dir) == NULL) {
+			perror("mkdtemp");
+			return NAN;
+		}
+
+		bool ok = run_steps(dir);
+
+		ll_t_remove_directory(dir);
+
+		if (!ok) return NAN;
+
+		printf("DID NOT CRASH :)\n");
+		return NAN;
+	}
+
+
+private:
+
+	/**
+	 * Run the test steps
+	 *
+	 * @param dir the database directory
+	 * @return true if all passed
+	 */
+	bool run_steps(const char* dir) {
+
+		std::string log_file = dir;
+		log_file += "/";
+		log_file += LL_WAL_FILE;
+
+
+		// Create the first level, which the log then starts at
+
+		printf(" * Create: "); fflush(stdout);
+
+		ll_database* D = open(dir, true);
+		ll_writable_graph* G = D->graph();
+
+		G->tx_begin();
+		for (int i = 0; i < _base_nodes; i++) G->add_node();
+		for (int i = 0; i < _base_nodes; i++) {
+			G->add_edge(i, (i + 1) % _base_nodes);
+			G->add_edge(i, (i * 5 + 3) % _base_nodes);
+		}
+		G->tx_commit();
+		G->checkpoint();
+
+		printf("%lu levels, the log starts at %lu\n",
+				G->ro_graph().num_levels(), D->wal()->base_levels());
+
+		if (D->wal()->base_levels() != G->ro_graph().num_levels()) {
+			printf("     --> failed, the checkpoint did not restart the log\n");
+			return false;
+		}
+
+
+		// Log the updates that the replay must reproduce
+
+		printf(" * Log: "); fflush(stdout);
+
+		ll_t_wal_replay_state expected;
+		if (!write_updates(D)) return false;
+		capture(D, expected);
+
+		uint64_t last_lsn = D->wal()->last_lsn();
+		printf("%lu records\n", (size_t) last_lsn);
+
+		delete D;
+
+
+		// Reopen and replay, which must not log the replayed updates again;
+		// close without a checkpoint, so that the log stays as it is
+
+		if (!reopen(dir, expected, true, true, &D)) return false;
+
+		if (D->wal()->last_lsn() != last_lsn) {
+			printf("     --> failed, the replay appended %lu records\n",
+					(size_t) (D->wal()->last_lsn() - last_lsn));
+			delete D;
+			return false;
+		}
+
+		delete D;
+
+
+		// The edge properties cannot be reopened from the persistent storage
+		// yet, and a checkpoint cannot write a re-created edge property that
+		// lacks the older levels, so replay once more without it; the replay
+		// then skips the logged edge property updates
+
+		for (size_t n = 0; n < expected.edges.size(); n++) {
+			for (size_t i = 0; i < expected.edges[n].size(); i++) {
+				expected.edges[n][i].second = 0;
+			}
+		}
+
+		if (!reopen(dir, expected, false, true, &D)) return false;
+
+
+		// Checkpoint the replayed updates, which restarts the log, so that
+		// the next reopen has nothing to replay
+
+		printf(" * Checkpoint: "); fflush(stdout);
+
+		G = D->graph();
+		G->checkpoint();
+
+		printf("%lu levels, the log starts at %lu\n",
+				G->ro_graph().num_levels(), D->wal()->base_levels());
+
+		if (D->wal()->base_levels() != G->ro_graph().num_levels()
+				|| !check_size(log_file, sizeof(ll_wal_header_t))) {
+			printf("     --> failed, the checkpoint did not restart the log\n");
+			delete D;
+			return false;
+		}
+
+		capture(D, expected);
+		delete D;
+
+		if (!reopen(dir, expected, false, false, &D)) return false;
+
+
+		// Log a few more edges and checkpoint them, but put the log back as
+		// if the crash hit before the checkpoint truncated it: the log now
+		// starts below the read-only levels, so it must be discarded
+
+		printf(" * Stale log: "); fflush(stdout);
+
+		G = D->graph();
+		G->tx_begin();
+		for (int i = 0; i < 8; i++) G->add_edge(i, _base_nodes - 1 - i);
+		G->tx_commit();
+
+		std::vector<char> stale;
+		if (!read_file(log_file, stale)) {
+			delete D;
+			return false;
+		}
+
+		G->checkpoint();
+		capture(D, expected);
+		delete D;
+
+		if (!ll_t_write_at(log_file, &stale[0], stale.size(), 0)) return false;
+
+		printf("%lu bytes\n", stale.size());
+
+		if (!reopen(dir, expected, false, false, &D)) return false;
+		delete D;
+
+		return true;
+	}
+
+
+	/**
+	 * Open the database and create the test properties
+	 *
+	 * @param dir the database directory
+	 * @param edge_property true to also create the edge property
+	 * @return the database
+	 */
+	ll_database* open(const char* dir, bool edge_property) {
+
+		ll_database* D = new ll_database(dir);
+		ll_mlcsr_ro_graph& R = D->graph()->ro_graph();
+
+		if (R.get_node_property_64(LL_T_WAL_REPLAY_NP) == NULL) {
+			R.create_uninitialized_node_property_64(LL_T_WAL_REPLAY_NP,
+					LL_T_INT64);
+		}
+
+		if (edge_property
+				&& R.get_edge_property_64(LL_T_WAL_REPLAY_EP) == NULL) {
+			R.create_uninitialized_edge_property_64(LL_T_WAL_REPLAY_EP,
+					LL_T_INT64);
+		}
+
+		return D;
+	}
+
+
+	/**
+	 * Write the logged updates: new nodes, new edges, properties of both,
+	 * deletions of a new and a frozen edge, and an aborted transaction
+	 *
+	 * @param D the database
+	 * @return true on success
+	 */
+	bool write_updates(ll_database* D) {
+
+		ll_writable_graph* G = D->graph();
+		auto np = G->get_node_property_64(LL_T_WAL_REPLAY_NP);
+		auto ep = G->get_edge_property_64(LL_T_WAL_REPLAY_EP);
+
+		G->tx_begin();
+
+		std::vector<node_t> new_nodes;
+		for (int i = 0; i < 8; i++) new_nodes.push_back(G->add_node());
+
+		std::vector<edge_t> new_edges;
+		for (size_t i = 0; i < new_nodes.size(); i++) {
+			node_t n = new_nodes[i];
+			new_edges.push_back(G->add_edge(n, (node_t) i));
+			new_edges.push_back(G->add_edge((node_t) (i * 3), n));
+			G->set_node_property(np, n, (uint64_t) (1000 + n));
+		}
+
+		for (node_t n = 0; n < 8; n++) {
+			G->set_node_property(np, n, (uint64_t) (2000 + n));
+		}
+
+		// The edge IDs of the writable edges are logged, and the replay
+		// must map them to the IDs of the replayed edges
+
+		for (size_t i = 0; i < new_edges.size(); i++) {
+			G->set_edge_property(ep, new_edges[i], (uint64_t) (3000 + i));
+		}
+
+#ifdef LL_DELETIONS
+		G->delete_edge(new_nodes[0], new_edges[0]);
+
+		edge_t frozen = G->find(1, 2);
+		if (frozen == LL_NIL_EDGE) {
+			printf("     --> failed, no edge 1 -> 2\n");
+			G->tx_commit();
+			return false;
+		}
+		G->delete_edge(1, frozen);
+#endif
+
+		G->tx_commit();
+
+
+		// An aborted transaction, whose records the replay must skip
+
+		ll_wal* wal = D->wal();
+		uint64_t tx = wal->max_tx() + 1000;
+		wal->append(LL_WAL_ADD_NODE, tx, _base_nodes + 100);
+		wal->append(LL_WAL_ADD_EDGE, tx, 2, 3, 0);
+		wal->append(LL_WAL_ABORT, tx, 0);
+		wal->commit();
+
+		return true;
+	}
+
+
+	/**
+	 * Reopen the database, replay the log, and compare the graph
+	 *
+	 * @param dir the database directory
+	 * @param expected the expected contents
+	 * @param edge_property true to re-create the edge property
+	 * @param expect_replay true if the log should replay some records
+	 * @param out the output database
+	 * @return true if it matches
+	 */
+	bool reopen(const char* dir, const ll_t_wal_replay_state& expected,
+			bool edge_property, bool expect_replay, ll_database** out) {
+
+		printf(" * Reopen: "); fflush(stdout);
+
+		ll_database* D = open(dir, edge_property);
+		size_t replayed = D->recover();
+
+		ll_t_wal_replay_state actual;
+		capture(D, actual);
+
+		printf("%lu levels, %lu records replayed\n",
+				D->graph()->ro_graph().num_levels(), replayed);
+
+		if ((replayed > 0) != expect_replay) {
+			printf("     --> failed, expected %s replay\n",
+					expect_replay ? "a" : "no");
+			delete D;
+			return false;
+		}
+
+		if (!(actual == expected)) {
+			printf("     --> failed, the graph differs\n");
+			delete D;
+			return false;
+		}
+
+		*out = D;
+		return true;
+	}
+
+
+	/**
+	 * Capture the contents of the graph
+	 *
+	 * @param D the database
+	 * @param s the output state
+	 */
+	void capture(ll_database* D, ll_t_wal_replay_state& s) {
+
+		ll_writable_graph* G = D->graph();
+		auto np = G->get_node_property_64(LL_T_WAL_REPLAY_NP);
+		auto ep = G->get_edge_property_64(LL_T_WAL_REPLAY_EP);
+
+		node_t max_nodes = G->max_nodes();
+
+		s.nodes.assign(max_nodes, false);
+		s.node_values.assign(max_nodes, 0);
+		s.edges.assign(max_nodes,
+				std::vector<std::pair<node_t, uint64_t> >());
+
+		G->tx_begin();
+
+		for (node_t n = 0; n < max_nodes; n++) {
+			if (!G->node_exists(n)) continue;
+
+			s.nodes[n] = true;
+			s.node_values[n] = np->get(n);
+
+			// A re-created edge property has no read-only levels, so
+			// compare the values only for the writable edges
+
+			ll_edge_iterator iter;
+			G->out_iter_begin(iter, n);
+			for (edge_t e = G->out_iter_next(iter); e != LL_NIL_EDGE;
+					e = G->out_iter_next(iter)) {
+				uint64_t v = ep != NULL && LL_EDGE_IS_WRITABLE(e)
+					? ep->get(e) : 0;
+				s.edges[n].push_back(std::make_pair(iter.last_node, v));
+			}
+
+			std::sort(s.edges[n].begin(), s.edges[n].end());
+		}
+
+		G->tx_commit();
+	}
+
+
+	/**
+	 * Read a whole file
+	 *
+	 * @param file the file name
+	 * @param data the output buffer
+	 * @return true on success
+	 */
+	bool read_file(const std::string& file, std::vector<char>& data) {
+
+		struct stat st;
+		if (stat(file.c_str(), &st) != 0) {
+			perror("stat");
+			return false;
+		}
+
+		data.resize(st.st_size);
+		return ll_t_read_at(file, &data[0], data.size(), 0);
+	}
+
+
+	/**
+	 * Check the size of a file
+	 *
+	 * @param file the file name
+	 * @param size the expected size
+	 * @return true if it matches
+	 */
+	bool check_size(const std::string& file, size_t size) {
+
+		struct stat st;
+		if (stat(file.c_str(), &st) != 0) {
+			perror("stat");
+			return false;
+		}
+
+		return (size_t) st.st_size == size;
+	}
+};
+
+#endif
+#endif
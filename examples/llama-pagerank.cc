@@ -231,6 +231,7 @@ int main(int argc, char** argv)
 	ll_database database(database_directory);
 	if (num_threads > 0) database.set_num_threads(num_threads);
 	ll_writable_graph& graph = *database.graph();
+	database.recover();
 
 	if (!graph.ro_graph().has_reverse_edges()) {
 		fprintf(stderr, "Error: The graph does not have reverse edges\n");
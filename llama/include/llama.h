@@ -45,7 +45,9 @@
 #include "llama/ll_slcsr.h"
 #include "llama/ll_mlcsr_graph.h"
 #include "llama/ll_writable_graph.h"
+#include "llama/ll_writable_snapshot.h"
 #include "llama/ll_database.h"
+#include "llama/ll_edge_map.h"
 
 #ifdef LL_PERSISTENCE
 #include "llama/ll_persistent_storage.h"
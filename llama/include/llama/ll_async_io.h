@@ -0,0 +1,610 @@
+/*
+ * ll_async_io.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+#ifndef LL_ASYNC_IO_H_
+#define LL_ASYNC_IO_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+#include "llama/ll_common.h"
+#include "llama/ll_lock.h"
+
+#if defined(LL_IO_URING) && !defined(__linux__)
+#	error "LL_IO_URING requires Linux"
+#endif
+
+#ifdef LL_IO_URING
+#include <linux/io_uring.h>
+#include <sys/syscall.h>
+#endif
+
+
+/// The number of submission queue entries of the io_uring
+#ifndef LL_IO_URING_ENTRIES
+#define LL_IO_URING_ENTRIES			256
+#endif
+
+
+
+//==========================================================================//
+// Class: ll_async_io                                                       //
+//==========================================================================//
+
+/**
+ * Write-behind I/O for the persistent storage. With LL_IO_URING, the writes
+ * and fsyncs are queued on an io_uring shared by all persistence contexts of
+ * the database and submitted in batches; flush() waits for all of them to
+ * complete. Without it, or if the kernel does not support io_uring, all
+ * operations are performed synchronously as they are issued; if the kernel
+ * supports io_uring but not its write operation, only the writes are.
+ *
+ * The data are copied, so the caller can reuse its buffers immediately. An
+ * fsync is ordered after all previously queued operations. Since this is
+ * write-behind, the owner must flush() before reading the written ranges
+ * back or closing the file descriptors.
+ */
+class ll_async_io {
+
+#ifdef LL_IO_URING
+
+	/**
+	 * An in-flight request
+	 */
+	typedef struct {
+		int r_opcode;
+		int r_fd;
+		off_t r_offset;
+		size_t r_length;
+		size_t r_written;
+		unsigned r_fsync_flags;
+		const char* r_what;
+		char r_data[0];
+	} request_t;
+
+#endif
+
+
+public:
+
+	/**
+	 * Create an instance of ll_async_io
+	 *
+	 * @param entries the number of submission queue entries
+	 */
+	ll_async_io(unsigned entries = LL_IO_URING_ENTRIES) {
+
+		_lock = 0;
+		_async = false;
+		_async_writes = false;
+
+#ifdef LL_IO_URING
+		_ring_fd = -1;
+		_in_flight = 0;
+		_to_submit = 0;
+
+		struct io_uring_params p;
+		memset(&p, 0, sizeof(p));
+
+		_ring_fd = (int) syscall(__NR_io_uring_setup, entries, &p);
+		if (_ring_fd < 0) {
+			LL_W_PRINT("io_uring is not available (%s), using synchronous "
+					"I/O\n", strerror(errno));
+			return;
+		}
+
+		if ((p.features & IORING_FEAT_SINGLE_MMAP) == 0) {
+			LL_W_PRINT("io_uring is too old, using synchronous I/O\n");
+			close(_ring_fd);
+			_ring_fd = -1;
+			return;
+		}
+
+
+		// Check which operations the kernel supports; the features do not
+		// say that, and the probe itself is newer than IORING_OP_FSYNC
+
+		bool can_fsync = false;
+		bool can_write = false;
+
+		size_t probe_size = sizeof(struct io_uring_probe)
+			+ 256 * sizeof(struct io_uring_probe_op);
+		struct io_uring_probe* probe
+			= (struct io_uring_probe*) malloc(probe_size);
+		memset(probe, 0, probe_size);
+
+		if (syscall(__NR_io_uring_register, _ring_fd, IORING_REGISTER_PROBE,
+					probe, 256) >= 0) {
+			can_fsync = probe_supports(probe, IORING_OP_FSYNC);
+			can_write = probe_supports(probe, IORING_OP_WRITE);
+		}
+		else {
+			can_fsync = true;
+		}
+
+		free(probe);
+
+		if (!can_fsync) {
+			LL_W_PRINT("io_uring does not support fsync, using synchronous "
+					"I/O\n");
+			close(_ring_fd);
+			_ring_fd = -1;
+			return;
+		}
+
+		if (!can_write) {
+			LL_W_PRINT("io_uring does not support writes, using synchronous "
+					"writes\n");
+		}
+
+
+		// Map the rings (the SQ and CQ rings share a mapping)
+
+		size_t sq_size = p.sq_off.array + p.sq_entries * sizeof(unsigned);
+		size_t cq_size = p.cq_off.cqes
+			+ p.cq_entries * sizeof(struct io_uring_cqe);
+		_ring_size = std::max(sq_size, cq_size);
+
+		_ring = mmap(NULL, _ring_size, PROT_READ | PROT_WRITE,
+				MAP_SHARED | MAP_POPULATE, _ring_fd, IORING_OFF_SQ_RING);
+		if (_ring == MAP_FAILED) {
+			perror("mmap");
+			LL_E_PRINT("Cannot map the io_uring\n");
+			abort();
+		}
+
+		_sqes_size = p.sq_entries * sizeof(struct io_uring_sqe);
+		_sqes = (struct io_uring_sqe*) mmap(NULL, _sqes_size,
+				PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, _ring_fd,
+				IORING_OFF_SQES);
+		if (_sqes == MAP_FAILED) {
+			perror("mmap");
+			LL_E_PRINT("Cannot map the io_uring submission queue entries\n");
+			abort();
+		}
+
+		char* r = (char*) _ring;
+		_sq_tail = (unsigned*) (r + p.sq_off.tail);
+		_sq_mask = *(unsigned*) (r + p.sq_off.ring_mask);
+		_sq_array = (unsigned*) (r + p.sq_off.array);
+		_sq_entries = p.sq_entries;
+		_cq_head = (unsigned*) (r + p.cq_off.head);
+		_cq_tail = (unsigned*) (r + p.cq_off.tail);
+		_cq_mask = *(unsigned*) (r + p.cq_off.ring_mask);
+		_cqes = (struct io_uring_cqe*) (r + p.cq_off.cqes);
+
+		_async = true;
+		_async_writes = can_write;
+#endif
+	}
+
+
+	/**
+	 * Destroy the instance, waiting for all outstanding I/O
+	 */
+	~ll_async_io() {
+
+		flush();
+
+#ifdef LL_IO_URING
+		if (_ring_fd >= 0) {
+			munmap(_sqes, _sqes_size);
+			munmap(_ring, _ring_size);
+			close(_ring_fd);
+		}
+#endif
+	}
+
+
+	/**
+	 * Determine whether the I/O is asynchronous
+	 *
+	 * @return true if it uses io_uring
+	 */
+	inline bool is_async() const {
+		return _async;
+	}
+
+
+	/**
+	 * Write the data to the file
+	 *
+	 * @param fd the file descriptor
+	 * @param data the data (copied if the write is asynchronous)
+	 * @param length the length
+	 * @param offset the file offset
+	 * @param what the description of the data for error messages
+	 */
+	void pwrite(int fd, const void* data, size_t length, off_t offset,
+			const char* what) {
+
+#ifdef LL_IO_URING
+		if (_async_writes && length <= 0xfffffffful) {
+
+			request_t* q = (request_t*) malloc(sizeof(request_t) + length);
+			q->r_opcode = IORING_OP_WRITE;
+			q->r_fd = fd;
+			q->r_offset = offset;
+			q->r_length = length;
+			q->r_written = 0;
+			q->r_fsync_flags = 0;
+			q->r_what = what;
+			memcpy(q->r_data, data, length);
+
+			ll_spinlock_acquire(&_lock);
+			push_write(q);
+			ll_spinlock_release(&_lock);
+			return;
+		}
+#endif
+
+		// Write the rest if the write was short, such as due to a signal
+
+		const char* d = (const char*) data;
+		size_t written = 0;
+
+		while (written < length) {
+			ssize_t r = ::pwrite(fd, d + written, length - written,
+					offset + written);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) {
+				if (r == 0) errno = EIO;
+				perror("pwrite");
+				LL_E_PRINT("Cannot write %s\n", what);
+				abort();
+			}
+			written += r;
+		}
+	}
+
+
+	/**
+	 * Sync the file. If the I/O is asynchronous, this is ordered after all
+	 * previously queued operations, but it does not wait for its completion.
+	 *
+	 * @param fd the file descriptor
+	 * @param datasync true to sync only the data and the metadata needed to
+	 *                 read them back (fdatasync)
+	 */
+	void fsync(int fd, bool datasync=false) {
+
+#ifdef LL_IO_URING
+		if (_async) {
+
+			ll_spinlock_acquire(&_lock);
+			push_fsync(new_fsync(fd, datasync));
+			ll_spinlock_release(&_lock);
+			return;
+		}
+#endif
+
+#if defined(__linux__)
+		int r = datasync ? ::fdatasync(fd) : ::fsync(fd);
+#else
+		int r = ::fsync(fd);
+#endif
+		if (r != 0) {
+			LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
+			abort();
+		}
+	}
+
+
+	/**
+	 * Submit all queued operations and wait until they complete
+	 */
+	void flush() {
+
+#ifdef LL_IO_URING
+		if (!_async) return;
+		if (*((volatile size_t*) &_in_flight) == 0) return;
+
+		ll_spinlock_acquire(&_lock);
+		while (_in_flight > 0) reap(_in_flight);
+		ll_spinlock_release(&_lock);
+#endif
+	}
+
+
+private:
+
+#ifdef LL_IO_URING
+
+	/**
+	 * Get the next free submission queue entry, making space if necessary.
+	 * Must be called with _lock.
+	 *
+	 * @return the cleared entry
+	 */
+	struct io_uring_sqe* next_sqe() {
+
+		// Do not have more requests in flight than there are SQ entries,
+		// which also keeps the CQ (twice the size) from overflowing
+
+		while (_in_flight >= _sq_entries) reap(1);
+
+		unsigned tail = *_sq_tail;
+		unsigned i = tail & _sq_mask;
+		struct io_uring_sqe* e = &_sqes[i];
+		memset(e, 0, sizeof(*e));
+		_sq_array[i] = i;
+		return e;
+	}
+
+
+	/**
+	 * Check whether the probed kernel supports the given operation
+	 *
+	 * @param probe the result of IORING_REGISTER_PROBE
+	 * @param opcode the operation
+	 * @return true if it is supported
+	 */
+	static bool probe_supports(const struct io_uring_probe* probe,
+			int opcode) {
+
+		if (opcode > probe->last_op || opcode >= probe->ops_len) return false;
+		return (probe->ops[opcode].flags & IO_URING_OP_SUPPORTED) != 0;
+	}
+
+
+	/**
+	 * Queue the part of the write that has not been written yet. Must be
+	 * called with _lock.
+	 *
+	 * @param q the write request
+	 */
+	void push_write(request_t* q) {
+
+		struct io_uring_sqe* e = next_sqe();
+		e->opcode = IORING_OP_WRITE;
+		e->fd = q->r_fd;
+		e->addr = (uint64_t) (q->r_data + q->r_written);
+		e->len = q->r_length - q->r_written;
+		e->off = q->r_offset + q->r_written;
+		e->user_data = (uint64_t) q;
+		push_sqe();
+	}
+
+
+	/**
+	 * Create an fsync request
+	 *
+	 * @param fd the file descriptor
+	 * @param datasync true for fdatasync
+	 * @return the new request
+	 */
+	static request_t* new_fsync(int fd, bool datasync) {
+
+		request_t* q = (request_t*) malloc(sizeof(request_t));
+		q->r_opcode = IORING_OP_FSYNC;
+		q->r_fd = fd;
+		q->r_offset = 0;
+		q->r_length = 0;
+		q->r_written = 0;
+		q->r_fsync_flags = datasync ? IORING_FSYNC_DATASYNC : 0;
+		q->r_what = datasync ? "fdatasync" : "fsync";
+		return q;
+	}
+
+
+	/**
+	 * Queue the fsync. Must be called with _lock.
+	 *
+	 * @param q the fsync request
+	 */
+	void push_fsync(request_t* q) {
+
+		struct io_uring_sqe* e = next_sqe();
+		e->opcode = IORING_OP_FSYNC;
+		e->flags = IOSQE_IO_DRAIN;
+		e->fd = q->r_fd;
+		e->fsync_flags = q->r_fsync_flags;
+		e->user_data = (uint64_t) q;
+		push_sqe();
+	}
+
+
+	/**
+	 * Publish the entry obtained by next_sqe(). Must be called with _lock.
+	 */
+	void push_sqe() {
+
+		__sync_synchronize();
+		*((volatile unsigned*) _sq_tail) = *_sq_tail + 1;
+		_in_flight++;
+		_to_submit++;
+
+
+		// Submit in batches, without waiting
+
+		if (_to_submit >= _sq_entries / 4) enter(0);
+	}
+
+
+	/**
+	 * Submit the pending entries and wait for the given number of completions
+	 *
+	 * @param min_complete the minimum number of completions to wait for
+	 */
+	void enter(unsigned min_complete) {
+
+		int r = (int) syscall(__NR_io_uring_enter, _ring_fd, _to_submit,
+				min_complete, min_complete > 0 ? IORING_ENTER_GETEVENTS : 0,
+				NULL, 0);
+		if (r < 0) {
+			if (errno == EINTR || errno == EAGAIN || errno == EBUSY) return;
+			perror("io_uring_enter");
+			abort();
+		}
+
+		_to_submit -= r;
+	}
+
+
+	/**
+	 * Submit everything and reap at least the given number of completions.
+	 * Must be called with _lock.
+	 *
+	 * @param min_complete the minimum number of completions to wait for
+	 */
+	void reap(size_t min_complete) {
+
+		enter(min_complete);
+
+		unsigned head = *_cq_head;
+		unsigned tail = *((volatile unsigned*) _cq_tail);
+		__sync_synchronize();
+
+		while (head != tail) {
+
+			struct io_uring_cqe* c = &_cqes[head & _cq_mask];
+			request_t* q = (request_t*) c->user_data;
+			int res = c->res;
+			bool retry = res == -EINTR || res == -EAGAIN;
+			head++;
+			_in_flight--;
+
+			if (!retry && (res < 0
+					|| (q->r_opcode == IORING_OP_WRITE && res == 0))) {
+				errno = res < 0 ? -res : EIO;
+				perror(q->r_opcode == IORING_OP_WRITE ? "pwrite" : "fsync");
+				LL_E_PRINT("Cannot complete asynchronous I/O: %s\n", q->r_what);
+				abort();
+			}
+
+			if (q->r_opcode == IORING_OP_WRITE && !retry) q->r_written += res;
+			if (!retry && q->r_written >= q->r_length) {
+				free(q);
+				continue;
+			}
+
+
+			// Resubmit an interrupted request or the rest of a short write.
+			// An fsync queued after the write might have already run, so
+			// follow the rest of the write by another one. Publish the CQ
+			// head first, since queueing can reap recursively.
+
+			__sync_synchronize();
+			*((volatile unsigned*) _cq_head) = head;
+
+			if (q->r_opcode == IORING_OP_WRITE) {
+				push_write(q);
+				push_fsync(new_fsync(q->r_fd, false));
+			}
+			else {
+				push_fsync(q);
+			}
+
+			head = *_cq_head;
+			tail = *((volatile unsigned*) _cq_tail);
+			__sync_synchronize();
+		}
+
+		__sync_synchronize();
+		*((volatile unsigned*) _cq_head) = head;
+	}
+
+#endif
+
+
+private:
+
+	/// The lock
+	ll_spinlock_t _lock;
+
+	/// Whether the I/O is asynchronous
+	bool _async;
+
+	/// Whether the writes are asynchronous
+	bool _async_writes;
+
+#ifdef LL_IO_URING
+
+	/// The ring file descriptor
+	int _ring_fd;
+
+	/// The mapped SQ and CQ rings
+	void* _ring;
+
+	/// The size of the ring mapping
+	size_t _ring_size;
+
+	/// The submission queue entries
+	struct io_uring_sqe* _sqes;
+
+	/// The size of the submission queue entries mapping
+	size_t _sqes_size;
+
+	/// The SQ tail
+	unsigned* _sq_tail;
+
+	/// The SQ mask
+	unsigned _sq_mask;
+
+	/// The SQ index array
+	unsigned* _sq_array;
+
+	/// The number of SQ entries
+	unsigned _sq_entries;
+
+	/// The CQ head
+	unsigned* _cq_head;
+
+	/// The CQ tail
+	unsigned* _cq_tail;
+
+	/// The CQ mask
+	unsigned _cq_mask;
+
+	/// The completion queue entries
+	struct io_uring_cqe* _cqes;
+
+	/// The number of requests that have been queued but not reaped
+	size_t _in_flight;
+
+	/// The number of entries that have not been submitted yet
+	unsigned _to_submit;
+
+#endif
+};
+
+#endif
@@ -168,6 +168,12 @@ class ll_bfs_template
 
         bool is_done = false;
         while (!is_done) {
+#ifdef LL_FRONTIER_PREFETCH
+            // read ahead the edges of the frontier if it is in the queue
+            if (state == ST_SMALL || state == ST_QUE) {
+                advise_edges(&global_vector[global_curr_level_begin], curr_count);
+            }
+#endif
             switch (state) {
                 case ST_SMALL: {
                     for (node_t i = 0; i < curr_count; i++) {
@@ -465,6 +471,14 @@ class ll_bfs_template
 		return iter.last_node;
     }
 
+    void advise_edges(const node_t* nodes, node_t count) {
+        if (use_reverse_edge) {
+            G.in_advise(nodes, count);
+        } else {
+            G.out_advise(nodes, count);
+        }
+    }
+
     void iterate_neighbor_small(node_t t) {
 		ll_edge_iterator iter; iter_begin(iter, t);
 		for (edge_t nx = iter_next(iter); nx != LL_NIL_EDGE; nx = iter_next(iter)) {
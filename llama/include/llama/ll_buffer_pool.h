@@ -0,0 +1,740 @@
+/*
+ * ll_buffer_pool.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_BUFFER_POOL_H_
+#define LL_BUFFER_POOL_H_
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <map>
+#include <vector>
+
+#include "llama/ll_common.h"
+#include "llama/ll_lock.h"
+#include "llama/ll_utils.h"
+
+#ifdef LL_BUFFER_POOL
+
+
+/// The log2 of the frame size (the unit of residency management)
+#ifndef LL_BUFFER_POOL_FRAME_BITS
+#define LL_BUFFER_POOL_FRAME_BITS		18
+#endif
+
+/// The default budget in bytes (0 = unlimited)
+#ifndef LL_BUFFER_POOL_BUDGET
+#define LL_BUFFER_POOL_BUDGET			0
+#endif
+
+/// The number of frames that each thread keeps pinned
+#ifndef LL_BUFFER_POOL_PINS
+#define LL_BUFFER_POOL_PINS				4
+#endif
+
+/// The percentage of the budget for the frames seen only once (2Q A1in)
+#ifndef LL_BUFFER_POOL_A1IN_PERCENT
+#define LL_BUFFER_POOL_A1IN_PERCENT		25
+#endif
+
+/// The number of remembered evicted frames as a percentage of the budget
+#ifndef LL_BUFFER_POOL_A1OUT_PERCENT
+#define LL_BUFFER_POOL_A1OUT_PERCENT	50
+#endif
+
+#define LL_BP_NOT_RESIDENT				0
+#define LL_BP_A1IN						1
+#define LL_BP_AM						2
+
+#define LL_BP_PAGE_SIZE					4096ul
+#define LL_BP_ADDRESS_BITS				47
+#define LL_BP_LEAF_BITS					14
+#define LL_BP_DIRECTORY_BITS			(LL_BP_ADDRESS_BITS \
+		- LL_BUFFER_POOL_FRAME_BITS - LL_BP_LEAF_BITS)
+
+
+class ll_buffer_pool;
+
+
+/**
+ * A frame: the part of a registered mapping within one aligned frame-sized
+ * range of the address space
+ */
+typedef struct ll_buffer_pool_frame {
+
+	/// The owner, or NULL if the mapping was unregistered
+	ll_buffer_pool* volatile f_pool;
+
+	/// The mapped range
+	char* f_address;
+	size_t f_length;
+
+	/// The backing file range
+	int f_fd;
+	off_t f_file_offset;
+
+	/// The state (LL_BP_*)
+	volatile int f_state;
+
+	/// The reference bit (for CLOCK within Am)
+	volatile int f_referenced;
+
+	/// The number of threads that have it pinned
+	volatile int f_pins;
+
+	/// The sequence number if it is remembered in A1out, or 0
+	size_t f_ghost;
+
+	/// The next frame of another mapping within the same address range
+	struct ll_buffer_pool_frame* volatile f_next;
+
+} ll_buffer_pool_frame_t;
+
+
+/**
+ * The buffer pool statistics
+ */
+typedef struct {
+	size_t bps_hits;
+	size_t bps_misses;
+	size_t bps_evictions;
+	size_t bps_resident_bytes;
+	size_t bps_budget;
+} ll_buffer_pool_stats_t;
+
+
+/// The global address-to-frame directory shared by all buffer pools
+ll_buffer_pool_frame_t** volatile
+	g_buffer_pool_directory[1ul << LL_BP_DIRECTORY_BITS];
+
+/// The lock for modifying the directory
+ll_spinlock_t g_buffer_pool_directory_lock = 0;
+
+
+
+//==========================================================================//
+// Class: ll_buffer_pool                                                    //
+//==========================================================================//
+
+/**
+ * A buffer manager for the mmap-ed edge tables and property levels, which
+ * bounds the number of their resident bytes by a budget instead of leaving
+ * it to the kernel. The mappings are split into frames, which are admitted
+ * on first access and evicted with madvise() and posix_fadvise() when the
+ * budget is exceeded; the mappings are MAP_SHARED, so evicted pages fault
+ * back in from the page cache or the file.
+ *
+ * The replacement is 2Q: a frame seen once enters the A1in FIFO, so that
+ * a scan can displace only A1in; a frame accessed again after it was
+ * evicted from A1in (and is remembered in A1out) enters Am, which is
+ * managed by CLOCK. Each thread keeps the last few accessed frames pinned,
+ * which protects the adjacency lists and property pages being iterated.
+ *
+ * The accesses are reported by touch(), which finds the frame by address,
+ * so it can be called for any memory; unregistered memory is ignored.
+ */
+class ll_buffer_pool {
+
+	/**
+	 * The per-thread pins and counters
+	 */
+	typedef struct {
+		size_t ps_hits;
+		size_t ps_misses;
+		size_t ps_next;
+		ll_buffer_pool_frame_t* volatile ps_pins[LL_BUFFER_POOL_PINS];
+		char ps_padding[64 - ((3 + LL_BUFFER_POOL_PINS) * sizeof(void*)) % 64];
+	} pin_slot_t;
+
+
+	/**
+	 * An entry in the A1out queue
+	 */
+	typedef struct {
+		ll_buffer_pool_frame_t* g_frame;
+		size_t g_sequence;
+	} ghost_t;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_buffer_pool
+	 *
+	 * @param budget the budget in bytes (0 = unlimited)
+	 */
+	ll_buffer_pool(size_t budget = LL_BUFFER_POOL_BUDGET) {
+
+		_lock = 0;
+		_budget = budget;
+
+		_resident_bytes = 0;
+		_a1in_bytes = 0;
+		_clock_hand = 0;
+		_ghost_sequence = 0;
+		_evictions = 0;
+
+		_num_slots = omp_get_max_threads() + 1;
+		_slots = (pin_slot_t*) calloc(_num_slots, sizeof(pin_slot_t));
+	}
+
+
+	/**
+	 * Destroy the instance. All mappings must be unregistered by now.
+	 */
+	virtual ~ll_buffer_pool() {
+
+		for (auto it = _regions.begin(); it != _regions.end(); it++) {
+			unregister_frames(it->second);
+		}
+
+		for (size_t i = 0; i < _retired.size(); i++) free(_retired[i]);
+		free(_slots);
+	}
+
+
+	/**
+	 * Get the budget
+	 *
+	 * @return the budget in bytes (0 = unlimited)
+	 */
+	inline size_t budget() const {
+		return _budget;
+	}
+
+
+	/**
+	 * Set the budget, evicting frames if necessary
+	 *
+	 * @param budget the budget in bytes (0 = unlimited)
+	 */
+	void set_budget(size_t budget) {
+
+		ll_spinlock_acquire(&_lock);
+		_budget = budget;
+		evict_over_budget();
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Register a mapping
+	 *
+	 * @param address the address
+	 * @param length the length
+	 * @param fd the file descriptor
+	 * @param file_offset the file offset of the address
+	 */
+	void register_region(void* address, size_t length, int fd,
+			off_t file_offset) {
+
+		char* a = (char*) address;
+		char* end = a + length;
+		if (length == 0) return;
+
+		if ((((uintptr_t) end - 1) >> LL_BP_ADDRESS_BITS) != 0) {
+			LL_W_PRINT("The mapping at %p is out of range; not managing it\n",
+					address);
+			return;
+		}
+
+		std::vector<ll_buffer_pool_frame_t*> frames;
+		size_t frame_size = 1ul << LL_BUFFER_POOL_FRAME_BITS;
+
+		while (a < end) {
+
+			char* frame_end = (char*) ((((uintptr_t) a) | (frame_size - 1)) + 1);
+			if (frame_end > end) frame_end = end;
+
+			ll_buffer_pool_frame_t* f = (ll_buffer_pool_frame_t*)
+				calloc(1, sizeof(ll_buffer_pool_frame_t));
+			f->f_pool = this;
+			f->f_address = a;
+			f->f_length = frame_end - a;
+			f->f_fd = fd;
+			f->f_file_offset = file_offset + (a - (char*) address);
+			f->f_state = LL_BP_NOT_RESIDENT;
+
+			frames.push_back(f);
+			a = frame_end;
+		}
+
+
+		// Publish the frames
+
+		ll_spinlock_acquire(&g_buffer_pool_directory_lock);
+
+		for (size_t i = 0; i < frames.size(); i++) {
+
+			size_t key = ((uintptr_t) frames[i]->f_address)
+				>> LL_BUFFER_POOL_FRAME_BITS;
+			size_t d = key >> LL_BP_LEAF_BITS;
+
+			if (g_buffer_pool_directory[d] == NULL) {
+				ll_buffer_pool_frame_t** leaf = (ll_buffer_pool_frame_t**)
+					calloc(1ul << LL_BP_LEAF_BITS, sizeof(void*));
+				__COMPILER_FENCE;
+				g_buffer_pool_directory[d] = leaf;
+			}
+
+			ll_buffer_pool_frame_t** leaf = g_buffer_pool_directory[d];
+			size_t l = key & ((1ul << LL_BP_LEAF_BITS) - 1);
+
+			frames[i]->f_next = leaf[l];
+			__COMPILER_FENCE;
+			leaf[l] = frames[i];
+		}
+
+		ll_spinlock_release(&g_buffer_pool_directory_lock);
+
+		ll_spinlock_acquire(&_lock);
+		_regions[(char*) address].swap(frames);
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Unregister a mapping before it is unmapped
+	 *
+	 * @param address the address passed to register_region()
+	 */
+	void unregister_region(void* address) {
+
+		ll_spinlock_acquire(&_lock);
+
+		auto it = _regions.find((char*) address);
+		if (it != _regions.end()) {
+			unregister_frames(it->second);
+			_regions.erase(it);
+		}
+
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Report an access to a range of memory. The frames that belong to a
+	 * buffer pool are admitted if they are not resident, and pinned by
+	 * the calling thread.
+	 *
+	 * @param address the address
+	 * @param length the length in bytes
+	 */
+	static inline void touch(const void* address, size_t length) {
+
+		uintptr_t a = (uintptr_t) address;
+		uintptr_t end = a + (length == 0 ? 1 : length);
+
+		do {
+			ll_buffer_pool_frame_t* f = lookup(a);
+			if (f != NULL) {
+				ll_buffer_pool* p = f->f_pool;
+				if (p != NULL) p->access(f);
+			}
+			a = (a | ((1ul << LL_BUFFER_POOL_FRAME_BITS) - 1)) + 1;
+		}
+		while (a < end);
+	}
+
+
+	/**
+	 * Unpin all frames pinned by the calling thread
+	 */
+	void unpin_all() {
+
+		pin_slot_t& s = slot();
+
+		for (size_t i = 0; i < LL_BUFFER_POOL_PINS; i++) {
+			ll_buffer_pool_frame_t* old
+				= __sync_lock_test_and_set(&s.ps_pins[i],
+						(ll_buffer_pool_frame_t*) NULL);
+			if (old != NULL) __sync_fetch_and_add(&old->f_pins, -1);
+		}
+	}
+
+
+	/**
+	 * Get the statistics
+	 *
+	 * @return the statistics
+	 */
+	ll_buffer_pool_stats_t stats() {
+
+		ll_buffer_pool_stats_t s;
+		memset(&s, 0, sizeof(s));
+
+		for (size_t i = 0; i < _num_slots; i++) {
+			s.bps_hits += _slots[i].ps_hits;
+			s.bps_misses += _slots[i].ps_misses;
+		}
+
+		s.bps_evictions = _evictions;
+		s.bps_resident_bytes = _resident_bytes;
+		s.bps_budget = _budget;
+
+		return s;
+	}
+
+
+	/**
+	 * Reset the hit, miss, and eviction counters
+	 */
+	void reset_stats() {
+
+		for (size_t i = 0; i < _num_slots; i++) {
+			_slots[i].ps_hits = 0;
+			_slots[i].ps_misses = 0;
+		}
+
+		_evictions = 0;
+	}
+
+
+private:
+
+	/**
+	 * Find the frame that contains the given address
+	 *
+	 * @param a the address
+	 * @return the frame, or NULL if not registered
+	 */
+	static inline ll_buffer_pool_frame_t* lookup(uintptr_t a) {
+
+		size_t key = a >> LL_BUFFER_POOL_FRAME_BITS;
+		if ((key >> (LL_BP_LEAF_BITS + LL_BP_DIRECTORY_BITS)) != 0) return NULL;
+
+		ll_buffer_pool_frame_t** leaf
+			= g_buffer_pool_directory[key >> LL_BP_LEAF_BITS];
+		if (leaf == NULL) return NULL;
+
+		ll_buffer_pool_frame_t* f = leaf[key & ((1ul << LL_BP_LEAF_BITS) - 1)];
+		while (f != NULL && (a < (uintptr_t) f->f_address
+					|| a >= (uintptr_t) f->f_address + f->f_length)) {
+			f = f->f_next;
+		}
+
+		return f;
+	}
+
+
+	/**
+	 * Get the slot of the calling thread
+	 *
+	 * @return the slot
+	 */
+	inline pin_slot_t& slot() {
+		size_t t = omp_get_thread_num();
+		return _slots[t < _num_slots ? t : _num_slots - 1];
+	}
+
+
+	/**
+	 * Record an access to a frame
+	 *
+	 * @param f the frame
+	 */
+	inline void access(ll_buffer_pool_frame_t* f) {
+
+		pin_slot_t& s = slot();
+
+		if (f->f_state != LL_BP_NOT_RESIDENT) {
+			s.ps_hits++;
+			if (!f->f_referenced) f->f_referenced = 1;
+		}
+		else {
+			s.ps_misses++;
+			admit(f);
+		}
+
+
+		// Pin it, replacing the least recently pinned frame of this thread
+
+		if (s.ps_pins[s.ps_next % LL_BUFFER_POOL_PINS] == f) return;
+
+		__sync_fetch_and_add(&f->f_pins, 1);
+		size_t i = __sync_add_and_fetch(&s.ps_next, 1) % LL_BUFFER_POOL_PINS;
+		ll_buffer_pool_frame_t* old = __sync_lock_test_and_set(&s.ps_pins[i], f);
+		if (old != NULL) __sync_fetch_and_add(&old->f_pins, -1);
+	}
+
+
+	/**
+	 * Admit a frame that is not resident
+	 *
+	 * @param f the frame
+	 */
+	void admit(ll_buffer_pool_frame_t* f) {
+
+		ll_spinlock_acquire(&_lock);
+
+		if (f->f_state != LL_BP_NOT_RESIDENT || f->f_pool != this) {
+			ll_spinlock_release(&_lock);
+			return;
+		}
+
+		if (f->f_ghost != 0) {
+			f->f_ghost = 0;
+			f->f_state = LL_BP_AM;
+			_am.push_back(f);
+		}
+		else {
+			f->f_state = LL_BP_A1IN;
+			_a1in.push_back(f);
+			_a1in_bytes += f->f_length;
+		}
+
+		f->f_referenced = 0;
+		_resident_bytes += f->f_length;
+
+		evict_over_budget();
+		ll_spinlock_release(&_lock);
+
+		madvise(f->f_address - ((uintptr_t) f->f_address) % LL_BP_PAGE_SIZE,
+				f->f_length + ((uintptr_t) f->f_address) % LL_BP_PAGE_SIZE,
+				MADV_WILLNEED);
+	}
+
+
+	/**
+	 * Evict frames until the resident bytes fit within the budget. Must be
+	 * called with _lock held.
+	 */
+	void evict_over_budget() {
+
+		if (_budget == 0) return;
+
+		while (_resident_bytes > _budget) {
+
+			ll_buffer_pool_frame_t* v = NULL;
+
+			if (_a1in_bytes > _budget / 100 * LL_BUFFER_POOL_A1IN_PERCENT
+					|| _am.empty()) {
+				v = evict_from_a1in();
+			}
+			if (v == NULL) v = evict_from_am();
+			if (v == NULL) v = evict_from_a1in();
+			if (v == NULL) break;		// everything is pinned
+		}
+	}
+
+
+	/**
+	 * Evict the oldest unpinned frame from A1in and remember it in A1out.
+	 * Must be called with _lock held.
+	 *
+	 * @return the evicted frame, or NULL if none
+	 */
+	ll_buffer_pool_frame_t* evict_from_a1in() {
+
+		for (size_t n = _a1in.size(); n > 0; n--) {
+
+			ll_buffer_pool_frame_t* f = _a1in.front();
+			_a1in.pop_front();
+
+			if (f->f_state != LL_BP_A1IN) continue;
+			if (f->f_pins > 0) {
+				_a1in.push_back(f);
+				continue;
+			}
+
+			_a1in_bytes -= f->f_length;
+			release(f);
+
+
+			// Remember it, so that the next access promotes it to Am
+
+			ghost_t g;
+			g.g_frame = f;
+			g.g_sequence = f->f_ghost = ++_ghost_sequence;
+			_a1out.push_back(g);
+
+			size_t max_ghosts = (_budget >> LL_BUFFER_POOL_FRAME_BITS)
+				* LL_BUFFER_POOL_A1OUT_PERCENT / 100 + 1;
+			while (_a1out.size() > max_ghosts) {
+				ghost_t& o = _a1out.front();
+				if (o.g_frame->f_ghost == o.g_sequence) o.g_frame->f_ghost = 0;
+				_a1out.pop_front();
+			}
+
+			return f;
+		}
+
+		return NULL;
+	}
+
+
+	/**
+	 * Evict an unpinned and unreferenced frame from Am using CLOCK. Must be
+	 * called with _lock held.
+	 *
+	 * @return the evicted frame, or NULL if none
+	 */
+	ll_buffer_pool_frame_t* evict_from_am() {
+
+		for (size_t n = 2 * _am.size(); n > 0 && !_am.empty(); n--) {
+
+			if (_clock_hand >= _am.size()) _clock_hand = 0;
+			ll_buffer_pool_frame_t* f = _am[_clock_hand];
+
+			if (f->f_state == LL_BP_AM) {
+				if (f->f_referenced) {
+					f->f_referenced = 0;
+					_clock_hand++;
+					continue;
+				}
+				if (f->f_pins > 0) {
+					_clock_hand++;
+					continue;
+				}
+				release(f);
+			}
+
+			_am[_clock_hand] = _am.back();
+			_am.pop_back();
+
+			if (f->f_state == LL_BP_NOT_RESIDENT && f->f_pool == this) return f;
+		}
+
+		return NULL;
+	}
+
+
+	/**
+	 * Drop a frame from memory. Must be called with _lock held.
+	 *
+	 * @param f the frame
+	 */
+	void release(ll_buffer_pool_frame_t* f) {
+
+		f->f_state = LL_BP_NOT_RESIDENT;
+		_resident_bytes -= f->f_length;
+		_evictions++;
+
+		size_t skew = ((uintptr_t) f->f_address) % LL_BP_PAGE_SIZE;
+		madvise(f->f_address - skew, f->f_length + skew, MADV_DONTNEED);
+		posix_fadvise(f->f_fd, f->f_file_offset - skew, f->f_length + skew,
+				POSIX_FADV_DONTNEED);
+	}
+
+
+	/**
+	 * Unlink the frames of a mapping from the directory and retire them.
+	 * Must be called with _lock held.
+	 *
+	 * @param frames the frames
+	 */
+	void unregister_frames(std::vector<ll_buffer_pool_frame_t*>& frames) {
+
+		ll_spinlock_acquire(&g_buffer_pool_directory_lock);
+
+		for (size_t i = 0; i < frames.size(); i++) {
+
+			ll_buffer_pool_frame_t* f = frames[i];
+			size_t key = ((uintptr_t) f->f_address) >> LL_BUFFER_POOL_FRAME_BITS;
+
+			ll_buffer_pool_frame_t* volatile* p
+				= &g_buffer_pool_directory[key >> LL_BP_LEAF_BITS]
+					[key & ((1ul << LL_BP_LEAF_BITS) - 1)];
+			while (*p != NULL && *p != f) p = &(*p)->f_next;
+			if (*p == f) *p = f->f_next;
+
+			if (f->f_state == LL_BP_A1IN) _a1in_bytes -= f->f_length;
+			if (f->f_state != LL_BP_NOT_RESIDENT) {
+				_resident_bytes -= f->f_length;
+			}
+
+			f->f_state = LL_BP_NOT_RESIDENT;
+			f->f_ghost = 0;
+			f->f_pool = NULL;
+
+
+			// A concurrent reader or a pin might still point to the frame,
+			// so keep it until the pool is destroyed
+
+			_retired.push_back(f);
+		}
+
+		ll_spinlock_release(&g_buffer_pool_directory_lock);
+	}
+
+
+private:
+
+	/// The lock for the replacement state
+	ll_spinlock_t _lock;
+
+	/// The budget in bytes
+	volatile size_t _budget;
+
+	/// The resident bytes
+	volatile size_t _resident_bytes;
+
+	/// The registered mappings
+	std::map<char*, std::vector<ll_buffer_pool_frame_t*>> _regions;
+
+	/// The frames seen once (FIFO)
+	std::deque<ll_buffer_pool_frame_t*> _a1in;
+	size_t _a1in_bytes;
+
+	/// The recently evicted frames from A1in (FIFO)
+	std::deque<ghost_t> _a1out;
+	size_t _ghost_sequence;
+
+	/// The frequently used frames (CLOCK)
+	std::vector<ll_buffer_pool_frame_t*> _am;
+	size_t _clock_hand;
+
+	/// The number of evictions
+	volatile size_t _evictions;
+
+	/// The per-thread pins and counters
+	pin_slot_t* _slots;
+	size_t _num_slots;
+
+	/// The frames of the unregistered mappings
+	std::vector<ll_buffer_pool_frame_t*> _retired;
+};
+
+#endif
+
+#endif
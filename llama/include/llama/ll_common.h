@@ -48,6 +48,9 @@
  *
  * Additional configuration:
  *   LL_DELETIONS
+ *   LL_IO_URING (asynchronous I/O for LL_PERSISTENCE on Linux)
+ *   LL_WAL (write-ahead log of the writable graph for LL_PERSISTENCE)
+ *   LL_BUFFER_POOL (bounded residency of the mapped levels for LL_PERSISTENCE)
  */
 
 
@@ -100,6 +103,14 @@
 #	error "You must specify one of the four LLAMA configurations"
 #endif
 
+#if defined(LL_WAL) && !defined(LL_PERSISTENCE)
+#	undef LL_WAL		/* there is nothing to recover into */
+#endif
+
+#if defined(LL_BUFFER_POOL) && !defined(LL_PERSISTENCE)
+#	undef LL_BUFFER_POOL	/* there is nothing mapped from files */
+#endif
+
 
 
 //==========================================================================//
@@ -148,6 +159,11 @@ struct ll_edge_comparator {
 #define LL_ADV_DONTNEED		MADV_DONTNEED
 #define LL_ADV_WILLNEED		MADV_WILLNEED
 
+/// The max. hole in bytes between two advised ranges that get coalesced
+#ifndef LL_ADVISE_COALESCE_GAP
+#define LL_ADVISE_COALESCE_GAP		(16 * 4096)
+#endif
+
 
 
 //==========================================================================//
@@ -335,6 +351,12 @@ inline bool ll_is_type_floating_point(short t) {
 #	define LL_MLCSR_CONTINUATIONS
 #endif
 
+//#define LL_FRONTIER_PREFETCH		/* advise the next frontier's edges */
+
+#if defined(LL_FRONTIER_PREFETCH) && !defined(LL_PERSISTENCE)
+#	undef LL_FRONTIER_PREFETCH
+#endif
+
 //#define LL_MIN_LEVEL
 //#define LL_MLCSR_LEVEL_ID_WRAP
 
@@ -390,6 +412,30 @@ typedef unsigned length_t;
 
 
 
+//==========================================================================//
+// Level Helpers                                                            //
+//==========================================================================//
+
+/**
+ * Determine whether the level ID is within the range of the live levels,
+ * which can wrap around with LL_MLCSR_LEVEL_ID_WRAP
+ *
+ * @param level the level ID
+ * @param min_level the minimum (oldest) live level ID
+ * @param max_level the maximum (newest) live level ID
+ * @return true if the level is within the bounds
+ */
+inline bool ll_level_within_bounds(int level, int min_level, int max_level) {
+#ifdef LL_MLCSR_LEVEL_ID_WRAP
+	if (min_level <= max_level) return level >= min_level && level <= max_level;
+	return level >= min_level || level <= max_level;
+#else
+	return level >= min_level && level <= max_level;
+#endif
+}
+
+
+
 //==========================================================================//
 // Configuration Helpers                                                    //
 //==========================================================================//
@@ -418,6 +464,18 @@ typedef unsigned length_t;
 #define IFE_LL_PERSISTENCE(t, e) e
 #endif
 
+#ifdef LL_WAL
+#define IF_LL_WAL(...) __VA_ARGS__
+#else
+#define IF_LL_WAL(...)
+#endif
+
+#ifdef LL_BUFFER_POOL
+#define IF_LL_BUFFER_POOL(...) __VA_ARGS__
+#else
+#define IF_LL_BUFFER_POOL(...)
+#endif
+
 #ifdef LL_DELETIONS
 #define IF_LL_DELETIONS(...) __VA_ARGS__
 #define IFE_LL_DELETIONS(t, e) t
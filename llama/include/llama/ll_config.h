@@ -95,7 +95,8 @@ public:
 	/// Whether to print progress while loading
 	bool lc_print_progress;
 
-	/// The buffer size in bytes for external sort (0 = auto-configure)
+	/// The buffer size in bytes for external sort and for building the
+	/// in-edges (0 = auto-configure the sort, do not limit the in-edges)
 	size_t lc_xs_buffer_size;
 
 	/// The max number of edges to load
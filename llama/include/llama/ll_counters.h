@@ -0,0 +1,359 @@
+/*
+ * ll_counters.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_COUNTERS_H_
+#define LL_COUNTERS_H_
+
+#include <cstdio>
+#include <cstring>
+
+#include "llama/ll_common.h"
+
+
+/*
+ * Lock Sites
+ * ==========
+ *
+ * The contention statistics of the adaptive locks are kept per lock site
+ * (they are collected only with LL_COUNTERS).
+ */
+
+/// Any other lock
+#define LL_L_OTHER						0
+
+/// The per-node locks of the writable graph (w_node::wn_lock)
+#define LL_L_NODE						1
+
+/// The lock for creating new nodes in the writable graph
+#define LL_L_NEW_NODE					2
+
+/// The locks of the deletion maps of the writable graph
+#define LL_L_DELETIONS					3
+
+/// The number of lock sites
+#define LL_L_NUM_SITES					4
+
+/// Lock acquisitions
+#define LL_LS_ACQUISITIONS				0
+
+/// Backoff rounds spent spinning on a held lock
+#define LL_LS_SPINS						1
+
+/// Times a thread parked on the futex of a held lock
+#define LL_LS_PARKS						2
+
+/// The number of lock statistics
+#define LL_LS_NUM_STATS					3
+
+
+#ifdef LL_COUNTERS
+
+
+/*
+ * Instrumentation Counters
+ * ========================
+ *
+ * Each thread counts into its own cache-line-aligned slot, which it claims on
+ * its first increment, so that the hot paths never share a cache line with
+ * other threads and need no atomic instructions. The slots are aggregated
+ * only when a snapshot is taken. Threads beyond LL_COUNTERS_MAX_SLOTS share
+ * the slots round-robin, in which case a few increments may be lost.
+ */
+
+/// The maximum number of per-thread slots
+#ifndef LL_COUNTERS_MAX_SLOTS
+#define LL_COUNTERS_MAX_SLOTS			256
+#endif
+
+/// Iterators started
+#define LL_C_ITER_BEGIN					0
+
+/// Iterator steps to the adjacency list fragment of an older level
+#define LL_C_ITER_DESCEND				1
+
+/// Iterator steps, including the edges returned in adjacency spans
+#define LL_C_ITER_NEXT					2
+
+/// Non-empty adjacency list fragments (levels) visited by the iterators
+#define LL_C_LEVELS_VISITED				3
+
+/// Descends that followed an explicit continuation record
+#define LL_C_CONTINUATIONS				4
+
+/// Edge deletion checks
+#define LL_C_DELETION_CHECKS			5
+
+/// Vertex table pages copied on write
+#define LL_C_COW_PAGE_COPIES			6
+
+/// Iterators that started in the writable layer
+#define LL_C_WRITABLE_HITS				7
+
+/// The number of counters
+#define LL_C_NUM_COUNTERS				8
+
+
+/**
+ * The counter names
+ */
+static const char* g_ll_counter_names[LL_C_NUM_COUNTERS] = {
+	"iter_begin",
+	"iter_descend",
+	"iter_next",
+	"levels_visited",
+	"continuations",
+	"deletion_checks",
+	"cow_page_copies",
+	"writable_hits",
+};
+
+
+/**
+ * The lock site names
+ */
+static const char* g_ll_lock_site_names[LL_L_NUM_SITES] = {
+	"other",
+	"node",
+	"new_node",
+	"deletions",
+};
+
+
+/**
+ * The lock statistic names
+ */
+static const char* g_ll_lock_stat_names[LL_LS_NUM_STATS] = {
+	"acquisitions",
+	"spins",
+	"parks",
+};
+
+
+/**
+ * A per-thread counter slot
+ */
+typedef struct {
+	size_t cs_counters[LL_C_NUM_COUNTERS];
+	size_t cs_locks[LL_L_NUM_SITES][LL_LS_NUM_STATS];
+} __attribute__((aligned(64))) ll_counters_slot_t;
+
+
+/**
+ * A snapshot of the aggregated counters
+ */
+typedef struct {
+	size_t cs_counters[LL_C_NUM_COUNTERS];
+	size_t cs_locks[LL_L_NUM_SITES][LL_LS_NUM_STATS];
+} ll_counters_snapshot_t;
+
+
+/// The per-thread slots
+ll_counters_slot_t g_ll_counters_slots[LL_COUNTERS_MAX_SLOTS];
+
+/// The next slot to claim
+volatile size_t g_ll_counters_next_slot = 0;
+
+/// The slot of the current thread
+__thread ll_counters_slot_t* g_ll_counters_slot = NULL;
+
+
+/**
+ * Get the slot of the current thread, claiming one on the first call
+ *
+ * @return the slot
+ */
+inline ll_counters_slot_t* ll_counters_slot() {
+
+	ll_counters_slot_t* s = g_ll_counters_slot;
+	if (__builtin_expect(s == NULL, 0)) {
+		size_t i = __sync_fetch_and_add(&g_ll_counters_next_slot, 1);
+		s = &g_ll_counters_slots[i % LL_COUNTERS_MAX_SLOTS];
+		g_ll_counters_slot = s;
+	}
+
+	return s;
+}
+
+
+/**
+ * Increment a counter of the current thread
+ *
+ * @param c the counter (LL_C_*)
+ */
+#define LL_COUNT(c)		(ll_counters_slot()->cs_counters[c]++)
+
+
+/**
+ * Add to a counter of the current thread
+ *
+ * @param c the counter (LL_C_*)
+ * @param n the amount to add
+ */
+#define LL_COUNT_N(c, n)	(ll_counters_slot()->cs_counters[c] += (n))
+
+
+/**
+ * Add to a lock statistic of the current thread
+ *
+ * @param site the lock site (LL_L_*)
+ * @param stat the statistic (LL_LS_*)
+ * @param n the amount to add
+ */
+#define LL_COUNT_LOCK(site, stat, n) \
+	(ll_counters_slot()->cs_locks[site][stat] += (n))
+
+
+/**
+ * Aggregate the counters of all threads
+ *
+ * @return the snapshot
+ */
+inline ll_counters_snapshot_t ll_counters_snapshot() {
+
+	ll_counters_snapshot_t s;
+	memset(&s, 0, sizeof(s));
+
+	size_t n = *((volatile size_t*) &g_ll_counters_next_slot);
+	if (n > LL_COUNTERS_MAX_SLOTS) n = LL_COUNTERS_MAX_SLOTS;
+
+	for (size_t i = 0; i < n; i++) {
+		for (size_t c = 0; c < LL_C_NUM_COUNTERS; c++) {
+			s.cs_counters[c] += *((volatile size_t*)
+					&g_ll_counters_slots[i].cs_counters[c]);
+		}
+		for (size_t l = 0; l < LL_L_NUM_SITES; l++) {
+			for (size_t c = 0; c < LL_LS_NUM_STATS; c++) {
+				s.cs_locks[l][c] += *((volatile size_t*)
+						&g_ll_counters_slots[i].cs_locks[l][c]);
+			}
+		}
+	}
+
+	return s;
+}
+
+
+/**
+ * Compute the difference between two snapshots
+ *
+ * @param after the later snapshot
+ * @param before the earlier snapshot
+ * @return the counts between the two snapshots
+ */
+inline ll_counters_snapshot_t ll_counters_diff(
+		const ll_counters_snapshot_t& after,
+		const ll_counters_snapshot_t& before) {
+
+	ll_counters_snapshot_t s;
+	for (size_t c = 0; c < LL_C_NUM_COUNTERS; c++) {
+		s.cs_counters[c] = after.cs_counters[c] - before.cs_counters[c];
+	}
+	for (size_t l = 0; l < LL_L_NUM_SITES; l++) {
+		for (size_t c = 0; c < LL_LS_NUM_STATS; c++) {
+			s.cs_locks[l][c] = after.cs_locks[l][c] - before.cs_locks[l][c];
+		}
+	}
+
+	return s;
+}
+
+
+/**
+ * Print a snapshot, one counter per line, followed by the number of levels
+ * visited per started iterator and the statistics of the lock sites in use
+ *
+ * @param s the snapshot
+ * @param f the output file
+ * @param sep the separator
+ */
+inline void ll_print_counters(const ll_counters_snapshot_t& s,
+		FILE* f = stderr, const char* sep = ":\t") {
+
+	for (size_t c = 0; c < LL_C_NUM_COUNTERS; c++) {
+		fprintf(f, "%s%s%lu\n", g_ll_counter_names[c], sep, s.cs_counters[c]);
+	}
+
+	size_t b = s.cs_counters[LL_C_ITER_BEGIN];
+	fprintf(f, "levels_per_vertex%s%0.3lf\n", sep, b == 0 ? 0.0
+			: s.cs_counters[LL_C_LEVELS_VISITED] / (double) b);
+
+	for (size_t l = 0; l < LL_L_NUM_SITES; l++) {
+		if (s.cs_locks[l][LL_LS_ACQUISITIONS] == 0) continue;
+		for (size_t c = 0; c < LL_LS_NUM_STATS; c++) {
+			fprintf(f, "lock_%s_%s%s%lu\n", g_ll_lock_site_names[l],
+					g_ll_lock_stat_names[c], sep, s.cs_locks[l][c]);
+		}
+	}
+}
+
+
+/**
+ * Clear the counters. This is not synchronized with the concurrent
+ * increments, so it should be called only when no other threads are counting;
+ * otherwise take snapshots and use ll_counters_diff()
+ */
+inline void ll_clear_counters() {
+
+	for (size_t i = 0; i < LL_COUNTERS_MAX_SLOTS; i++) {
+		memset(g_ll_counters_slots[i].cs_counters, 0,
+				sizeof(g_ll_counters_slots[i].cs_counters));
+		memset(g_ll_counters_slots[i].cs_locks, 0,
+				sizeof(g_ll_counters_slots[i].cs_locks));
+	}
+}
+
+
+/**
+ * Print the current counters
+ *
+ * @param f the output file
+ * @param sep the separator
+ */
+inline void ll_print_counters(FILE* f = stderr, const char* sep = ":\t") {
+	ll_print_counters(ll_counters_snapshot(), f, sep);
+}
+
+
+#else
+
+#define LL_COUNT(c)
+#define LL_COUNT_N(c, n)
+#define LL_COUNT_LOCK(site, stat, n)
+
+#endif
+
+#endif
@@ -42,7 +42,9 @@
 
 #include "llama/ll_common.h"
 #include "llama/ll_config.h"
+#include "llama/ll_mem_policy.h"
 #include "llama/ll_persistent_storage.h"
+#include "llama/ll_wal.h"
 
 
 /**
@@ -54,7 +56,8 @@ class ll_database {
 public:
 
 	/**
-	 * Create a new database instance, or load it if it exists
+	 * Create a new database instance, or load it if it exists. The updates
+	 * in the write-ahead log are replayed only by recover().
 	 *
 	 * @param dir the database directory (if it is a persistent database)
 	 */
@@ -67,6 +70,11 @@ public:
 
 		_graph = new ll_writable_graph(this, IF_LL_PERSISTENCE(_storage,)
 				80 * 1000000 /* XXX */);
+
+#ifdef LL_WAL
+		_wal = new ll_wal(_dir.c_str());
+		_graph->attach_wal(_wal);
+#endif
 	}
 
 
@@ -76,7 +84,12 @@ public:
 	virtual ~ll_database() {
 		
 		delete _graph;
-		IF_LL_PERSISTENCE(delete _storage);
+
+#ifdef LL_PERSISTENCE
+		_storage->write_manifest();
+		IF_LL_WAL(delete _wal);
+		delete _storage;
+#endif
 	}
 
 
@@ -91,6 +104,30 @@ public:
 	}
 
 
+	/**
+	 * Set the memory policy for the large arrays, such as the edge tables,
+	 * the vertex table pages, and the per-node arrays of the benchmarks. The
+	 * policy applies to the arrays allocated after this call, so it should be
+	 * set before loading the graph.
+	 *
+	 * @param policy the policy
+	 */
+	void set_memory_policy(const ll_memory_policy_t& policy) {
+		// XXX This also belongs to some global runtime
+		ll_set_memory_policy(policy);
+	}
+
+
+	/**
+	 * Get the memory policy
+	 *
+	 * @return the memory policy
+	 */
+	inline const ll_memory_policy_t& memory_policy() {
+		return ll_memory_policy();
+	}
+
+
 	/**
 	 * Get the database directory, if this is a persistent database
 	 *
@@ -114,6 +151,36 @@ public:
 #endif
 
 
+#ifdef LL_WAL
+
+	/**
+	 * Get the write-ahead log
+	 *
+	 * @return the write-ahead log
+	 */
+	inline ll_wal* wal() {
+		return _wal;
+	}
+#endif
+
+
+	/**
+	 * Recover the updates that were not checkpointed from the write-ahead
+	 * log, if enabled. Call this after creating the writable properties, so
+	 * that their logged updates are not skipped, but before any other
+	 * updates.
+	 *
+	 * @return the number of replayed log records
+	 */
+	size_t recover() {
+#ifdef LL_WAL
+		return _graph->replay_wal();
+#else
+		return 0;
+#endif
+	}
+
+
 	/**
 	 * Get the graph
 	 *
@@ -142,6 +209,9 @@ private:
 	/// The persistent storage
 	IF_LL_PERSISTENCE(ll_persistent_storage* _storage);
 
+	/// The write-ahead log
+	IF_LL_WAL(ll_wal* _wal);
+
 	/// The database directory
 	std::string _dir;
 
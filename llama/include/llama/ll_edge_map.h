@@ -0,0 +1,708 @@
+/*
+ * ll_edge_map.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_EDGE_MAP_H_
+#define LL_EDGE_MAP_H_
+
+#include "llama/ll_common.h"
+#include "llama/ll_utils.h"
+#include "llama/ll_mlcsr_iterator.h"
+#include "llama/ll_parallel.h"
+
+#include <cstdlib>
+#include <cstring>
+#include <vector>
+
+
+/*
+ * A vertex-centric runtime in the style of Ligra
+ *
+ * An algorithm is expressed as a sequence of edge maps over a frontier
+ * (ll_vertex_subset), each of which applies a functor to the out-edges of
+ * the frontier nodes and returns the subset of the targets for which the
+ * functor returned true. The functor has the following methods:
+ *
+ *   bool update(node_t s, node_t d)         -- apply to the edge s -> d
+ *   bool update_atomic(node_t s, node_t d)  -- the same, but thread-safe
+ *   bool cond(node_t d)                     -- false if d needs no updates
+ *
+ * The edge map picks the direction automatically: a small frontier pushes
+ * from the sparse list of its nodes, while a frontier that (together with
+ * its out-edges) covers a large part of the graph switches to a dense
+ * bitmap and pulls from the in-neighbors of each node, stopping as soon as
+ * cond() becomes false -- or pushes from all frontier nodes if the graph
+ * does not have the in-edges. The loops are balanced by the edge counts
+ * using ll_edge_balanced_partition.
+ *
+ * Usage (BFS):
+ *
+ *   ll_vertex_subset* frontier = new ll_vertex_subset(G.max_nodes(), root);
+ *   while (!frontier->empty()) {
+ *       ll_vertex_subset* next = ll_edge_map(G, *frontier, f);
+ *       delete frontier;
+ *       frontier = next;
+ *   }
+ *   delete frontier;
+ *
+ * The graph can be ll_mlcsr_ro_graph or ll_writable_graph; the direction is
+ * chosen using the degrees of the latest read-only level.
+ */
+
+
+
+//==========================================================================//
+// Configuration                                                            //
+//==========================================================================//
+
+/// Choose the direction automatically
+#define LL_EM_AUTO				0
+
+/// Push from the sparse list of the frontier nodes
+#define LL_EM_SPARSE_PUSH		1
+
+/// Push from all nodes in the dense frontier
+#define LL_EM_DENSE_PUSH		2
+
+/// Pull into all nodes from their in-neighbors in the dense frontier
+#define LL_EM_DENSE_PULL		3
+
+/// Go dense when the frontier and its out-edges exceed 1/N of the edges
+#ifndef LL_EM_DENSE_THRESHOLD
+#define LL_EM_DENSE_THRESHOLD	20
+#endif
+
+
+
+//==========================================================================//
+// Class: ll_vertex_subset                                                  //
+//==========================================================================//
+
+/**
+ * A subset of nodes, such as a frontier, stored either as a list of nodes
+ * or as a bitmap (or both); each representation is computed from the other
+ * on demand
+ */
+class ll_vertex_subset {
+
+	/// The maximum number of nodes
+	node_t _max_nodes;
+
+	/// The number of nodes in the subset
+	size_t _size;
+
+	/// The sparse representation: the list of nodes (NULL if not available)
+	node_t* _sparse;
+
+	/// The dense representation: the bitmap (NULL if not available)
+	uint64_t* _dense;
+
+
+public:
+
+	/**
+	 * Create an empty subset
+	 *
+	 * @param max_nodes the maximum number of nodes
+	 */
+	ll_vertex_subset(node_t max_nodes) {
+
+		_max_nodes = max_nodes;
+		_size = 0;
+		_sparse = NULL;
+		_dense = NULL;
+	}
+
+
+	/**
+	 * Create a subset with a single node
+	 *
+	 * @param max_nodes the maximum number of nodes
+	 * @param node the node
+	 */
+	ll_vertex_subset(node_t max_nodes, node_t node) {
+
+		_max_nodes = max_nodes;
+		_size = 1;
+		_sparse = (node_t*) malloc(sizeof(node_t));
+		_sparse[0] = node;
+		_dense = NULL;
+	}
+
+
+	/**
+	 * Destroy the subset
+	 */
+	~ll_vertex_subset() {
+		if (_sparse != NULL) free(_sparse);
+		if (_dense != NULL) free(_dense);
+	}
+
+
+	/**
+	 * Get the maximum number of nodes
+	 *
+	 * @return the maximum number of nodes
+	 */
+	inline node_t max_nodes() const {
+		return _max_nodes;
+	}
+
+
+	/**
+	 * Get the number of nodes in the subset
+	 *
+	 * @return the number of nodes
+	 */
+	inline size_t size() const {
+		return _size;
+	}
+
+
+	/**
+	 * Determine whether the subset is empty
+	 *
+	 * @return true if it is empty
+	 */
+	inline bool empty() const {
+		return _size == 0;
+	}
+
+
+	/**
+	 * Determine whether the sparse representation is available
+	 *
+	 * @return true if it is available
+	 */
+	inline bool is_sparse() const {
+		return _sparse != NULL;
+	}
+
+
+	/**
+	 * Determine whether the dense representation is available
+	 *
+	 * @return true if it is available
+	 */
+	inline bool is_dense() const {
+		return _dense != NULL;
+	}
+
+
+	/**
+	 * Get the list of nodes; requires the sparse representation
+	 *
+	 * @return the nodes
+	 */
+	inline const node_t* nodes() const {
+		return _sparse;
+	}
+
+
+	/**
+	 * Get the given node from the list; requires the sparse representation
+	 *
+	 * @param index the index
+	 * @return the node
+	 */
+	inline node_t operator[] (size_t index) const {
+		return _sparse[index];
+	}
+
+
+	/**
+	 * Determine whether the given node is in the subset; requires the dense
+	 * representation
+	 *
+	 * @param node the node
+	 * @return true if it is in the subset
+	 */
+	inline bool contains(node_t node) const {
+		return node < _max_nodes && bitmap_get(_dense, node);
+	}
+
+
+	/**
+	 * Replace the contents of the subset by a list of nodes
+	 *
+	 * @param nodes the malloc-ed list of nodes (will be owned by the subset)
+	 * @param size the number of nodes
+	 */
+	void set_sparse(node_t* nodes, size_t size) {
+
+		if (_sparse != NULL) free(_sparse);
+		if (_dense != NULL) free(_dense);
+
+		_sparse = nodes;
+		_dense = NULL;
+		_size = size;
+	}
+
+
+	/**
+	 * Replace the contents of the subset by a bitmap
+	 *
+	 * @param bitmap the bitmap from allocate_bitmap() (will be owned by the subset)
+	 * @param size the number of bits set in the bitmap
+	 */
+	void set_dense(uint64_t* bitmap, size_t size) {
+
+		if (_sparse != NULL) free(_sparse);
+		if (_dense != NULL) free(_dense);
+
+		_sparse = NULL;
+		_dense = bitmap;
+		_size = size;
+	}
+
+
+	/**
+	 * Make sure that the sparse representation is available
+	 */
+	void to_sparse() {
+
+		if (_sparse != NULL) return;
+
+		_sparse = (node_t*) malloc(sizeof(node_t) * (_size + 1));
+		if (_size == 0) return;
+
+
+		// Count the nodes in each block of the bitmap, and then list them
+
+		size_t words = bitmap_words(_max_nodes);
+		size_t num_blocks = omp_get_max_threads();
+		std::vector<size_t> offsets(num_blocks + 1, 0);
+
+#pragma omp parallel for schedule(static,1)
+		for (size_t b = 0; b < num_blocks; b++) {
+			size_t c = 0;
+			for (size_t w = b * words / num_blocks;
+					w < (b + 1) * words / num_blocks; w++) {
+				c += __builtin_popcountll(_dense[w]);
+			}
+			offsets[b + 1] = c;
+		}
+
+		for (size_t b = 0; b < num_blocks; b++) {
+			offsets[b + 1] += offsets[b];
+		}
+
+#pragma omp parallel for schedule(static,1)
+		for (size_t b = 0; b < num_blocks; b++) {
+			size_t k = offsets[b];
+			for (size_t w = b * words / num_blocks;
+					w < (b + 1) * words / num_blocks; w++) {
+				uint64_t x = _dense[w];
+				while (x != 0) {
+					_sparse[k++] = (node_t) ((w << 6) + __builtin_ctzll(x));
+					x &= x - 1;
+				}
+			}
+		}
+	}
+
+
+	/**
+	 * Make sure that the dense representation is available
+	 */
+	void to_dense() {
+
+		if (_dense != NULL) return;
+
+		_dense = allocate_bitmap(_max_nodes);
+
+#pragma omp parallel for schedule(static)
+		for (size_t i = 0; i < _size; i++) {
+			bitmap_set_atomic(_dense, _sparse[i]);
+		}
+	}
+
+
+	/**
+	 * Get the number of words in a bitmap
+	 *
+	 * @param max_nodes the maximum number of nodes
+	 * @return the number of 64-bit words
+	 */
+	static inline size_t bitmap_words(node_t max_nodes) {
+		return (((size_t) max_nodes) + 63) >> 6;
+	}
+
+
+	/**
+	 * Allocate a cleared bitmap
+	 *
+	 * @param max_nodes the maximum number of nodes
+	 * @return the bitmap, to be released using free()
+	 */
+	static uint64_t* allocate_bitmap(node_t max_nodes) {
+
+		uint64_t* b = (uint64_t*) calloc(bitmap_words(max_nodes) + 1,
+				sizeof(uint64_t));
+		if (b == NULL) {
+			LL_E_PRINT("Out of memory\n");
+			abort();
+		}
+
+		return b;
+	}
+
+
+	/**
+	 * Get a bit
+	 *
+	 * @param bitmap the bitmap
+	 * @param node the node
+	 * @return true if the bit is set
+	 */
+	static inline bool bitmap_get(const uint64_t* bitmap, node_t node) {
+		return (bitmap[((size_t) node) >> 6] >> (node & 63)) & 1;
+	}
+
+
+	/**
+	 * Set a bit atomically
+	 *
+	 * @param bitmap the bitmap
+	 * @param node the node
+	 * @return true if this call set the bit, false if it was already set
+	 */
+	static inline bool bitmap_set_atomic(uint64_t* bitmap, node_t node) {
+
+		uint64_t m = ((uint64_t) 1) << (node & 63);
+		uint64_t* w = &bitmap[((size_t) node) >> 6];
+
+		if ((*w & m) != 0) return false;
+		return (__sync_fetch_and_or(w, m) & m) == 0;
+	}
+
+
+private:
+
+	/**
+	 * Disable the copy constructor
+	 */
+	ll_vertex_subset(const ll_vertex_subset& other);
+
+
+	/**
+	 * Disable the assignment operator
+	 */
+	ll_vertex_subset& operator= (const ll_vertex_subset& other);
+};
+
+
+
+//==========================================================================//
+// Vertex map                                                               //
+//==========================================================================//
+
+/**
+ * Apply a function to all nodes in a subset in parallel
+ *
+ * @param U the subset
+ * @param f the functor with void operator() (node_t n)
+ */
+template <class F>
+void ll_vertex_map(ll_vertex_subset& U, F& f) {
+
+	if (U.empty()) return;
+
+	if (U.is_sparse()) {
+
+#pragma omp parallel for schedule(dynamic,1024)
+		for (size_t i = 0; i < U.size(); i++) {
+			f(U[i]);
+		}
+	}
+	else {
+
+		size_t words = ll_vertex_subset::bitmap_words(U.max_nodes());
+
+#pragma omp parallel for schedule(dynamic,64)
+		for (size_t w = 0; w < words; w++) {
+			for (node_t n = (node_t) (w << 6);
+					n < (node_t) ((w + 1) << 6) && n < U.max_nodes(); n++) {
+				if (U.contains(n)) f(n);
+			}
+		}
+	}
+}
+
+
+
+//==========================================================================//
+// Edge map                                                                 //
+//==========================================================================//
+
+/**
+ * Apply a functor to the out-edges of a sparse frontier
+ *
+ * A frontier node with a very high out-degree is split across several
+ * chunks, each of which seeks directly to its range of the adjacency list,
+ * so that a single hub does not serialize the step.
+ *
+ * @param G the graph
+ * @param U the frontier (will be converted to the sparse representation)
+ * @param f the functor
+ * @param frontier_sums the out-degree prefix sums of U's list (NULL to compute)
+ * @return the new frontier (sparse), to be deleted by the caller
+ */
+template <class Graph, class F>
+ll_vertex_subset* ll_edge_map_sparse_push(Graph& G, ll_vertex_subset& U,
+		F& f, const ll_degree_prefix_sums* frontier_sums = NULL) {
+
+	U.to_sparse();
+
+	ll_degree_prefix_sums* own_sums = NULL;
+	if (frontier_sums == NULL) {
+		own_sums = new ll_degree_prefix_sums(G, U.nodes(), U.size());
+		frontier_sums = own_sums;
+	}
+
+	ll_edge_balanced_partition P(frontier_sums, (node_t) U.size(), true,
+			4, 256);
+
+
+	// Push into per-thread lists
+
+	size_t num_threads = omp_get_max_threads();
+	std::vector<node_t>* next = new std::vector<node_t>[num_threads];
+
+#pragma omp parallel
+	{
+		std::vector<node_t>& out = next[omp_get_thread_num()];
+
+#pragma omp for schedule(dynamic,1)
+		for (size_t c = 0; c < P.size(); c++) {
+			const ll_edge_balanced_chunk& chunk = P[c];
+			for (node_t i = chunk.ec_begin; i < chunk.ec_end; i++) {
+				node_t s = U[i];
+				ll_foreach_out_range(d, G, s, chunk.ec_edge_begin,
+						chunk.ec_edge_end) {
+					if (f.cond(d) && f.update_atomic(s, d)) out.push_back(d);
+				}
+			}
+		}
+	}
+
+
+	// Concatenate the lists
+
+	std::vector<size_t> offsets(num_threads + 1, 0);
+	for (size_t t = 0; t < num_threads; t++) {
+		offsets[t + 1] = offsets[t] + next[t].size();
+	}
+
+	node_t* nodes = (node_t*) malloc(sizeof(node_t)
+			* (offsets[num_threads] + 1));
+
+#pragma omp parallel for schedule(static,1)
+	for (size_t t = 0; t < num_threads; t++) {
+		if (!next[t].empty()) {
+			memcpy(&nodes[offsets[t]], &next[t][0],
+					sizeof(node_t) * next[t].size());
+		}
+	}
+
+	delete[] next;
+	if (own_sums != NULL) delete own_sums;
+
+	ll_vertex_subset* r = new ll_vertex_subset(G.max_nodes());
+	r->set_sparse(nodes, offsets[num_threads]);
+	return r;
+}
+
+
+/**
+ * Apply a functor to the out-edges of a dense frontier; the nodes with a very
+ * high out-degree are split across several chunks as in the sparse push
+ *
+ * @param G the graph
+ * @param U the frontier (will be converted to the dense representation)
+ * @param f the functor
+ * @return the new frontier (dense), to be deleted by the caller
+ */
+template <class Graph, class F>
+ll_vertex_subset* ll_edge_map_dense_push(Graph& G, ll_vertex_subset& U,
+		F& f) {
+
+	U.to_dense();
+
+	node_t max_nodes = std::min(U.max_nodes(), G.max_nodes());
+	ll_edge_balanced_partition P(G.out_degree_prefix_sums(), max_nodes, true);
+
+	uint64_t* next = ll_vertex_subset::allocate_bitmap(G.max_nodes());
+	size_t count = 0;
+
+#pragma omp parallel
+	{
+		size_t count_prv = 0;
+
+#pragma omp for nowait schedule(dynamic,1)
+		for (size_t c = 0; c < P.size(); c++) {
+			const ll_edge_balanced_chunk& chunk = P[c];
+			for (node_t s = chunk.ec_begin; s < chunk.ec_end; s++) {
+				if (!U.contains(s)) continue;
+				ll_foreach_out_range(d, G, s, chunk.ec_edge_begin,
+						chunk.ec_edge_end) {
+					if (f.cond(d) && f.update_atomic(s, d)) {
+						if (ll_vertex_subset::bitmap_set_atomic(next, d))
+							count_prv++;
+					}
+				}
+			}
+		}
+
+		ATOMIC_ADD<size_t>(&count, count_prv);
+	}
+
+	ll_vertex_subset* r = new ll_vertex_subset(G.max_nodes());
+	r->set_dense(next, count);
+	return r;
+}
+
+
+/**
+ * Apply a functor to the in-edges of all nodes that come from a dense
+ * frontier; the functor is called by a single thread per target node
+ *
+ * @param G the graph (must have the in-edges)
+ * @param U the frontier (will be converted to the dense representation)
+ * @param f the functor
+ * @return the new frontier (dense), to be deleted by the caller
+ */
+template <class Graph, class F>
+ll_vertex_subset* ll_edge_map_dense_pull(Graph& G, ll_vertex_subset& U,
+		F& f) {
+
+	U.to_dense();
+
+	ll_edge_balanced_partition P(G.in_degree_prefix_sums(), G.max_nodes());
+
+	uint64_t* next = ll_vertex_subset::allocate_bitmap(G.max_nodes());
+	size_t count = 0;
+
+#pragma omp parallel
+	{
+		size_t count_prv = 0;
+
+#pragma omp for nowait schedule(dynamic,1)
+		for (size_t c = 0; c < P.size(); c++) {
+			for (node_t d = P[c].ec_begin; d < P[c].ec_end; d++) {
+				if (!f.cond(d)) continue;
+				ll_foreach_in(s, G, d) {
+					if (U.contains(s) && f.update(s, d)) {
+						if (ll_vertex_subset::bitmap_set_atomic(next, d))
+							count_prv++;
+					}
+					if (!f.cond(d)) break;
+				}
+			}
+		}
+
+		ATOMIC_ADD<size_t>(&count, count_prv);
+	}
+
+	ll_vertex_subset* r = new ll_vertex_subset(G.max_nodes());
+	r->set_dense(next, count);
+	return r;
+}
+
+
+/**
+ * Apply a functor to the out-edges of a frontier, choosing the direction
+ * and the representation based on the size of the frontier
+ *
+ * @param G the graph
+ * @param U the frontier (its representation can change)
+ * @param f the functor
+ * @param mode the mode (LL_EM_*)
+ * @return the new frontier, to be deleted by the caller
+ */
+template <class Graph, class F>
+ll_vertex_subset* ll_edge_map(Graph& G, ll_vertex_subset& U, F& f,
+		int mode = LL_EM_AUTO) {
+
+	if (U.empty()) return new ll_vertex_subset(G.max_nodes());
+
+	ll_degree_prefix_sums* frontier_sums = NULL;
+
+	if (mode == LL_EM_AUTO) {
+
+		const ll_degree_prefix_sums* S = G.out_degree_prefix_sums();
+		size_t threshold = S == NULL ? 0 : S->edges() / LL_EM_DENSE_THRESHOLD;
+
+		if (threshold > 0 && U.size() > threshold) {
+			mode = LL_EM_DENSE_PULL;
+		}
+		else if (threshold > 0) {
+			U.to_sparse();
+			frontier_sums = new ll_degree_prefix_sums(G, U.nodes(), U.size());
+			mode = U.size() + frontier_sums->edges() > threshold
+				? LL_EM_DENSE_PULL : LL_EM_SPARSE_PUSH;
+		}
+		else {
+			mode = LL_EM_SPARSE_PUSH;
+		}
+
+		if (mode == LL_EM_DENSE_PULL && !G.has_reverse_edges()) {
+			mode = LL_EM_DENSE_PUSH;
+		}
+	}
+
+	ll_vertex_subset* r = NULL;
+
+	switch (mode) {
+		case LL_EM_SPARSE_PUSH:
+			r = ll_edge_map_sparse_push(G, U, f, frontier_sums);
+			break;
+		case LL_EM_DENSE_PUSH:
+			r = ll_edge_map_dense_push(G, U, f);
+			break;
+		case LL_EM_DENSE_PULL:
+			r = ll_edge_map_dense_pull(G, U, f);
+			break;
+		default:
+			LL_E_PRINT("Invalid edge map mode %d\n", mode);
+			abort();
+	}
+
+	if (frontier_sums != NULL) delete frontier_sums;
+	return r;
+}
+
+#endif
@@ -38,6 +38,7 @@
 #define LL_EDGE_TABLE_H_
 
 #include "llama/ll_common.h"
+#include "llama/ll_mem_policy.h"
 #include "llama/ll_mlcsr_helpers.h"
 
 
@@ -191,8 +192,8 @@ template <typename T> struct ll_et_array {
  */
 template <typename T>
 ll_et_array<T>* new_ll_et_array(size_t capacity, size_t max_nodes) {
-	ll_et_array<T>* et = (ll_et_array<T>*) malloc(sizeof(ll_et_array<T>)
-			+ capacity * sizeof(T));
+	ll_et_array<T>* et = (ll_et_array<T>*) ll_large_alloc(
+			sizeof(ll_et_array<T>) + capacity * sizeof(T));
 	return et;
 }
 
@@ -204,7 +205,7 @@ ll_et_array<T>* new_ll_et_array(size_t capacity, size_t max_nodes) {
  */
 template <typename T>
 void delete_ll_et_array(ll_et_array<T>* et) {
-	free(et);
+	ll_large_free(et);
 }
 
 
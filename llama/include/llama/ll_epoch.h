@@ -0,0 +1,446 @@
+/*
+ * ll_epoch.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_EPOCH_H_
+#define LL_EPOCH_H_
+
+#include <sched.h>
+#include <stdint.h>
+
+#include <atomic>
+#include <vector>
+
+#include "llama/ll_common.h"
+#include "llama/ll_lock.h"
+
+
+/// The maximum number of concurrently registered threads or readers
+#define LL_EPOCH_MAX_SLOTS			256
+
+/// The value of an inactive slot
+#define LL_EPOCH_INACTIVE			0l
+
+
+
+//==========================================================================//
+// Class: ll_slot_registry                                                  //
+//==========================================================================//
+
+/**
+ * A fixed-size registry of cache-line padded slots, each of which publishes
+ * a single positive value (an epoch or a timestamp) of an active reader or
+ * transaction, so that others can cheaply compute the minimum over all
+ * active participants
+ */
+class ll_slot_registry {
+
+	typedef struct {
+		volatile long s_value;
+		char s_padding[64 - sizeof(long)];
+	} slot_t;
+
+	/// The slots
+	slot_t _slots[LL_EPOCH_MAX_SLOTS];
+
+	/// One past the highest slot ever used, which bounds the scans
+	volatile int _high_water;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_slot_registry
+	 */
+	ll_slot_registry() {
+		for (int i = 0; i < LL_EPOCH_MAX_SLOTS; i++) {
+			_slots[i].s_value = LL_EPOCH_INACTIVE;
+		}
+		_high_water = 0;
+	}
+
+
+	/**
+	 * Acquire a free slot and publish the given value in it
+	 *
+	 * @param value the value (must be positive)
+	 * @return the slot index
+	 */
+	int acquire(long value) {
+
+		assert(value != LL_EPOCH_INACTIVE);
+
+		while (true) {
+			for (int i = 0; i < LL_EPOCH_MAX_SLOTS; i++) {
+				if (_slots[i].s_value != LL_EPOCH_INACTIVE) continue;
+				if (!__sync_bool_compare_and_swap(&_slots[i].s_value,
+							LL_EPOCH_INACTIVE, value)) continue;
+
+				int h;
+				while ((h = _high_water) <= i) {
+					__sync_bool_compare_and_swap(&_high_water, h, i + 1);
+				}
+
+				return i;
+			}
+
+			// All slots are taken, so wait for someone to leave
+
+			sched_yield();
+		}
+	}
+
+
+	/**
+	 * Update the value published in a slot
+	 *
+	 * @param slot the slot index
+	 * @param value the new value (must be positive)
+	 */
+	inline void update(int slot, long value) {
+		assert(value != LL_EPOCH_INACTIVE);
+		_slots[slot].s_value = value;
+		__sync_synchronize();
+	}
+
+
+	/**
+	 * Release a slot
+	 *
+	 * @param slot the slot index
+	 */
+	inline void release(int slot) {
+		__sync_synchronize();
+		_slots[slot].s_value = LL_EPOCH_INACTIVE;
+	}
+
+
+	/**
+	 * Get the value published in the slot
+	 *
+	 * @param slot the slot index
+	 * @return the value, or LL_EPOCH_INACTIVE if the slot is free
+	 */
+	inline long get(int slot) const {
+		return _slots[slot].s_value;
+	}
+
+
+	/**
+	 * Compute the minimum over all published values
+	 *
+	 * @param otherwise the value to return if no slot is active
+	 * @return the minimum value, or otherwise if there are no active slots
+	 */
+	long min(long otherwise) const {
+
+		long m = otherwise;
+		int h = _high_water;
+
+		for (int i = 0; i < h; i++) {
+			long v = _slots[i].s_value;
+			if (v != LL_EPOCH_INACTIVE && v < m) m = v;
+		}
+
+		return m;
+	}
+
+
+	/**
+	 * Count the active slots
+	 *
+	 * @return the number of active slots
+	 */
+	size_t active(void) const {
+
+		size_t n = 0;
+		int h = _high_water;
+
+		for (int i = 0; i < h; i++) {
+			if (_slots[i].s_value != LL_EPOCH_INACTIVE) n++;
+		}
+
+		return n;
+	}
+};
+
+
+
+//==========================================================================//
+// Class: ll_epoch_manager                                                  //
+//==========================================================================//
+
+/**
+ * Epoch-based reclamation. Readers enter an epoch before touching shared
+ * memory and exit when done; writers retire objects instead of freeing them,
+ * and the retired objects are freed only after every reader that could have
+ * observed them has exited.
+ */
+class ll_epoch_manager {
+
+	typedef struct {
+		long r_epoch;
+		void (*r_function)(void*);
+		void* r_data;
+	} retired_t;
+
+	/// The global epoch
+	std::atomic<long> _epoch;
+
+	/// The active readers
+	ll_slot_registry _readers;
+
+	/// The retired objects waiting to be reclaimed
+	std::vector<retired_t> _retired;
+
+	/// The lock for the retired list
+	ll_spinlock_t _retired_lock;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_epoch_manager
+	 */
+	ll_epoch_manager() {
+		_epoch.store(1);
+		_retired_lock = 0;
+	}
+
+
+	/**
+	 * Destroy the instance, reclaiming everything that is still retired
+	 */
+	~ll_epoch_manager() {
+		for (size_t i = 0; i < _retired.size(); i++) {
+			_retired[i].r_function(_retired[i].r_data);
+		}
+	}
+
+
+	/**
+	 * Get the current global epoch
+	 *
+	 * @return the global epoch
+	 */
+	inline long epoch(void) const {
+		return _epoch.load();
+	}
+
+
+	/**
+	 * Advance the global epoch
+	 *
+	 * @return the new epoch
+	 */
+	inline long advance(void) {
+		return _epoch.fetch_add(1) + 1;
+	}
+
+
+	/**
+	 * Enter the current epoch
+	 *
+	 * @return the reader slot, to be passed to exit()
+	 */
+	int enter(void) {
+
+		long e = _epoch.load();
+		int slot = _readers.acquire(e);
+
+		// Make sure that a concurrent advance() did not miss us
+
+		long e2;
+		while ((e2 = _epoch.load()) != e) {
+			_readers.update(slot, e2);
+			e = e2;
+		}
+
+		return slot;
+	}
+
+
+	/**
+	 * Exit the epoch
+	 *
+	 * @param slot the reader slot returned by enter()
+	 */
+	inline void exit(int slot) {
+		_readers.release(slot);
+	}
+
+
+	/**
+	 * Get the epoch entered by the given reader
+	 *
+	 * @param slot the reader slot returned by enter()
+	 * @return the epoch
+	 */
+	inline long reader_epoch(int slot) const {
+		return _readers.get(slot);
+	}
+
+
+	/**
+	 * Get the oldest epoch that is still in use by a reader
+	 *
+	 * @return the oldest active epoch, or the current epoch if none
+	 */
+	inline long min_active(void) const {
+		return _readers.min(_epoch.load());
+	}
+
+
+	/**
+	 * Get the number of active readers
+	 *
+	 * @return the number of active readers
+	 */
+	inline size_t num_active(void) const {
+		return _readers.active();
+	}
+
+
+	/**
+	 * Determine whether all readers that entered at or before the given
+	 * epoch have already exited
+	 *
+	 * @param e the epoch
+	 * @return true if nobody can still observe state from epoch e
+	 */
+	inline bool quiescent(long e) const {
+		return min_active() > e;
+	}
+
+
+	/**
+	 * Advance the epoch and wait until all readers that entered before have
+	 * exited. This blocks only the caller, never the readers.
+	 */
+	void synchronize(void) {
+
+		long e = advance();
+		while (!quiescent(e - 1)) sched_yield();
+	}
+
+
+	/**
+	 * Retire an object, so that it would be reclaimed once no reader can
+	 * observe it anymore
+	 *
+	 * @param function the reclamation function
+	 * @param data the argument for the function
+	 */
+	void retire(void (*function)(void*), void* data) {
+
+		retired_t r;
+		r.r_epoch = advance() - 1;
+		r.r_function = function;
+		r.r_data = data;
+
+		ll_spinlock_acquire(&_retired_lock);
+		_retired.push_back(r);
+		ll_spinlock_release(&_retired_lock);
+	}
+
+
+	/**
+	 * Reclaim all retired objects that are no longer observable
+	 *
+	 * @return the number of reclaimed objects
+	 */
+	size_t collect(void) {
+
+		std::vector<retired_t> ready;
+		long m = min_active();
+
+		ll_spinlock_acquire(&_retired_lock);
+		size_t j = 0;
+		for (size_t i = 0; i < _retired.size(); i++) {
+			if (_retired[i].r_epoch < m) {
+				ready.push_back(_retired[i]);
+			}
+			else {
+				_retired[j++] = _retired[i];
+			}
+		}
+		_retired.resize(j);
+		ll_spinlock_release(&_retired_lock);
+
+		for (size_t i = 0; i < ready.size(); i++) {
+			ready[i].r_function(ready[i].r_data);
+		}
+
+		return ready.size();
+	}
+
+
+	/**
+	 * Reclaim all retired objects regardless of the active readers, such as
+	 * when destroying the protected structure
+	 *
+	 * @return the number of reclaimed objects
+	 */
+	size_t flush(void) {
+
+		std::vector<retired_t> ready;
+
+		ll_spinlock_acquire(&_retired_lock);
+		ready.swap(_retired);
+		ll_spinlock_release(&_retired_lock);
+
+		for (size_t i = 0; i < ready.size(); i++) {
+			ready[i].r_function(ready[i].r_data);
+		}
+
+		return ready.size();
+	}
+
+
+	/**
+	 * Get the number of retired objects that are waiting to be reclaimed
+	 *
+	 * @return the number of pending objects
+	 */
+	size_t num_retired(void) {
+		ll_spinlock_acquire(&_retired_lock);
+		size_t n = _retired.size();
+		ll_spinlock_release(&_retired_lock);
+		return n;
+	}
+};
+
+#endif
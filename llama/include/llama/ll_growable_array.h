@@ -95,12 +95,19 @@ public:
 	 * @param blocks the number of blocks to preallocate
 	 */
 	ll_growable_array(int blocks = 16) {
-		_blocks = blocks;
-		_size = 0;
-		_lock = 0;
-		_arrays = (T**) _block_allocator(sizeof(T*) * _blocks);
-		memset(_arrays, 0, sizeof(T*) * _blocks);
-		_arrays[0] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
+		init(blocks);
+	}
+
+
+	/**
+	 * Create an empty growable array that uses the given block allocator
+	 *
+	 * @param allocator the block allocator
+	 * @param blocks the number of blocks to preallocate
+	 */
+	ll_growable_array(const block_allocator& allocator, int blocks = 16)
+		: _block_allocator(allocator) {
+		init(blocks);
 	}
 
 
@@ -124,7 +131,7 @@ public:
 			}
 
 			if (use_block_deallocator)
-				_block_deallocator(_arrays);
+				free_directories();
 		}
 	}
 
@@ -168,23 +175,7 @@ public:
 
 		T* p = &_arrays[_size >> _block_size2][_size & ((1 << _block_size2) - 1)];
 		_size++;
-
-		if ((_size & ((1 << _block_size2) - 1)) == 0) {
-			int newBlock = _size >> _block_size2;
-			if (newBlock == _blocks) {
-				int n = _blocks * 2;
-				T** a = (T**) _block_allocator(sizeof(T*) * n);
-				memcpy(a, _arrays, sizeof(T*) * _blocks);
-				memset(&a[_blocks], 0, sizeof(T*) * (n - _blocks));
-				if (use_block_deallocator)
-					_block_deallocator(_arrays);
-				_arrays = a;
-				_blocks = n;
-			}
-			if (_arrays[newBlock] == NULL) {
-				_arrays[newBlock] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
-			}
-		}
+		grow();
 
 		ll_spinlock_release(&_lock);
 		return p;
@@ -192,13 +183,22 @@ public:
 
 
 	/**
-	 * Append a value
+	 * Append a value. The value is stored before the size is increased, so
+	 * that a concurrent reader that does not take the lock never sees an
+	 * uninitialized cell.
 	 *
 	 * @param value the value to append
 	 * @return the appended value
 	 */
 	T append(T value) {
-		*(append()) = value;
+		ll_spinlock_acquire(&_lock);
+
+		_arrays[_size >> _block_size2][_size & ((1 << _block_size2) - 1)] = value;
+		__COMPILER_FENCE;
+		_size++;
+		grow();
+
+		ll_spinlock_release(&_lock);
 		return value;
 	}
 
@@ -251,6 +251,258 @@ public:
 			? 1 << _block_size2
 			: (_size & ((1 << _block_size2) - 1));
 	}
+
+
+private:
+
+	/**
+	 * Initialize the array
+	 *
+	 * @param blocks the number of blocks to preallocate
+	 */
+	void init(int blocks) {
+		_blocks = blocks;
+		_size = 0;
+		_lock = 0;
+		_arrays = (T**) _block_allocator(sizeof(T*) * (_blocks + 1));
+		memset(_arrays, 0, sizeof(T*) * (_blocks + 1));
+		_arrays[0] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
+	}
+
+
+	/**
+	 * Allocate the next block if the last one just filled up; must be called
+	 * with the lock held.
+	 *
+	 * A concurrent reader that does not take the lock might still use the
+	 * old block directory, so it is not freed until the array is destroyed;
+	 * the last slot of each directory links to the previous one, which has
+	 * half as many blocks.
+	 */
+	void grow(void) {
+
+		if ((_size & ((1 << _block_size2) - 1)) == 0) {
+			int newBlock = _size >> _block_size2;
+			if (newBlock == _blocks) {
+				int n = _blocks * 2;
+				T** a = (T**) _block_allocator(sizeof(T*) * (n + 1));
+				memcpy(a, _arrays, sizeof(T*) * _blocks);
+				memset(&a[_blocks], 0, sizeof(T*) * (n - _blocks));
+				a[n] = (T*) _arrays;
+				__COMPILER_FENCE;
+				_arrays = a;
+				_blocks = n;
+			}
+			if (_arrays[newBlock] == NULL) {
+				_arrays[newBlock] = (T*) _block_allocator(sizeof(T) * (1 << _block_size2));
+			}
+		}
+	}
+
+
+	/**
+	 * Free the block directories
+	 */
+	void free_directories(void) {
+
+		T** d = _arrays;
+		int blocks = _blocks;
+
+		while (d != NULL) {
+			T** prev = (T**) d[blocks];
+			_block_deallocator(d);
+			d = prev;
+			blocks /= 2;
+		}
+	}
+};
+
+
+/**
+ * The number of elements in the first segment of ll_level_array (log 2)
+ */
+#define LL_LEVEL_ARRAY_BASE2		4
+
+/**
+ * The maximum number of segments of ll_level_array
+ */
+#define LL_LEVEL_ARRAY_SEGMENTS		48
+
+
+/**
+ * A growable per-level array whose elements never move once appended
+ *
+ * The elements are stored in segments of geometrically increasing sizes
+ * that are addressed through a fixed segment directory, so growing the
+ * array never relocates the existing elements. Readers can thus index a
+ * level that they know exists without synchronizing with a concurrent
+ * push_back() from the writer, such as when a checkpoint adds a new level
+ * while the previous levels are being read. Only one thread may append at
+ * a time. The element type must be trivially copyable.
+ */
+template <typename T>
+class ll_level_array {
+
+private:
+
+	/// The segments; segment k holds 2^(BASE2 + k) elements
+	T* _segments[LL_LEVEL_ARRAY_SEGMENTS];
+
+	/// The number of elements
+	volatile size_t _size;
+
+
+public:
+
+	/**
+	 * Create an empty array
+	 */
+	ll_level_array() {
+		_size = 0;
+		memset(_segments, 0, sizeof(_segments));
+	}
+
+
+	/**
+	 * Destroy the array
+	 */
+	~ll_level_array() {
+		for (int k = 0; k < LL_LEVEL_ARRAY_SEGMENTS; k++) {
+			if (_segments[k] != NULL) free(_segments[k]);
+		}
+	}
+
+
+	/**
+	 * Get the number of elements in the array
+	 *
+	 * @return the size of the array
+	 */
+	inline size_t size() const {
+		return _size;
+	}
+
+
+	/**
+	 * Determine if the array is empty
+	 *
+	 * @return true if it is empty
+	 */
+	inline bool empty() const {
+		return _size == 0;
+	}
+
+
+	/**
+	 * Get the number of elements for which space is already allocated
+	 *
+	 * @return the capacity
+	 */
+	size_t capacity() const {
+		size_t c = 0;
+		for (int k = 0; k < LL_LEVEL_ARRAY_SEGMENTS; k++) {
+			if (_segments[k] == NULL) break;
+			c += segment_length(k);
+		}
+		return c;
+	}
+
+
+	/**
+	 * Append a value. The value is stored before the size is increased, so
+	 * that a concurrent reader never sees an uninitialized cell.
+	 *
+	 * @param value the value to append
+	 */
+	void push_back(const T& value) {
+
+		size_t offset;
+		int k = segment_of(_size, &offset);
+		assert(k < LL_LEVEL_ARRAY_SEGMENTS);
+
+		if (_segments[k] == NULL) {
+			T* s = (T*) malloc(sizeof(T) * segment_length(k));
+			if (s == NULL) {
+				LL_E_PRINT("** out of memory **\n");
+				abort();
+			}
+			memset(s, 0, sizeof(T) * segment_length(k));
+			__COMPILER_FENCE;
+			_segments[k] = s;
+		}
+
+		_segments[k][offset] = value;
+		__COMPILER_FENCE;
+		_size = _size + 1;
+	}
+
+
+	/**
+	 * Read from the array
+	 *
+	 * @param index the index to read
+	 * @return the element at that position
+	 */
+	inline T& operator[] (size_t index) {
+		assert(index < _size);
+		size_t offset;
+		int k = segment_of(index, &offset);
+		return _segments[k][offset];
+	}
+
+
+	/**
+	 * Read from the array
+	 *
+	 * @param index the index to read
+	 * @return the element at that position
+	 */
+	inline const T& operator[] (size_t index) const {
+		assert(index < _size);
+		size_t offset;
+		int k = segment_of(index, &offset);
+		return _segments[k][offset];
+	}
+
+
+private:
+
+	/**
+	 * Get the number of elements in a segment
+	 *
+	 * @param k the segment number
+	 * @return the number of elements
+	 */
+	static inline size_t segment_length(int k) {
+		return ((size_t) 1) << (LL_LEVEL_ARRAY_BASE2 + k);
+	}
+
+
+	/**
+	 * Find the segment that holds the given index
+	 *
+	 * @param index the index
+	 * @param offset the pointer to store the offset within the segment
+	 * @return the segment number
+	 */
+	static inline int segment_of(size_t index, size_t* offset) {
+		size_t j = (index >> LL_LEVEL_ARRAY_BASE2) + 1;
+		int k = 63 - __builtin_clzll((unsigned long long) j);
+		*offset = index - ((((size_t) 1) << k) - 1) * (1 << LL_LEVEL_ARRAY_BASE2);
+		return k;
+	}
+
+
+	/**
+	 * Disable the copy constructor
+	 */
+	ll_level_array(const ll_level_array& other);
+
+
+	/**
+	 * Disable the assignment operator
+	 */
+	ll_level_array& operator= (const ll_level_array& other);
 };
 
 #endif
@@ -39,6 +39,21 @@
 
 #include <stdint.h>
 
+#ifdef __linux__
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+#else
+#include <sched.h>
+#endif
+
+#include "llama/ll_counters.h"
+
+
+//==========================================================================//
+// Spinlock                                                                 //
+//==========================================================================//
+
 /**
  * Spinlock
  */
@@ -82,6 +97,124 @@ inline void ll_spinlock_release(ll_spinlock_t* ptr) {
 }
 
 
+//==========================================================================//
+// Adaptive Lock                                                            //
+//==========================================================================//
+
+/*
+ * A lock that spins with exponential backoff while the holder is likely to
+ * release it soon, and then parks the thread on a futex, so that threads
+ * do not burn their time slices when the holder gets preempted, such as
+ * when the loaders and the analytics oversubscribe the cores. The lock word
+ * is 0 if unlocked, 1 if locked, and 2 if locked with possible waiters.
+ */
+
+/// The number of backoff rounds (each twice as long as the previous one)
+#ifndef LL_ADAPTIVE_LOCK_SPIN_ROUNDS
+#define LL_ADAPTIVE_LOCK_SPIN_ROUNDS	10
+#endif
+
+
+/**
+ * Adaptive lock
+ */
+typedef volatile int32_t ll_adaptive_lock_t;
+
+
+/**
+ * Park the calling thread while the value at the given address equals the
+ * expected value
+ *
+ * @param ptr the address
+ * @param value the expected value
+ */
+inline void ll_futex_wait(volatile int32_t* ptr, int32_t value) {
+#ifdef __linux__
+	syscall(SYS_futex, (int32_t*) ptr, FUTEX_WAIT_PRIVATE, value,
+			NULL, NULL, 0);
+#else
+	if (*ptr == value) sched_yield();
+#endif
+}
+
+
+/**
+ * Wake up threads parked on the given address
+ *
+ * @param ptr the address
+ * @param count the maximum number of threads to wake up
+ */
+inline void ll_futex_wake(volatile int32_t* ptr, int count) {
+#ifdef __linux__
+	syscall(SYS_futex, (int32_t*) ptr, FUTEX_WAKE_PRIVATE, count,
+			NULL, NULL, 0);
+#endif
+}
+
+
+/**
+ * Try to acquire an adaptive lock
+ *
+ * @param ptr the lock
+ * @return true if acquired
+ */
+inline bool ll_adaptive_lock_try_acquire(ll_adaptive_lock_t* ptr) {
+	return __sync_bool_compare_and_swap(ptr, 0, 1);
+}
+
+
+/**
+ * Acquire an adaptive lock
+ *
+ * @param ptr the lock
+ * @param site the lock site for the contention statistics (LL_L_*)
+ */
+inline void ll_adaptive_lock_acquire(ll_adaptive_lock_t* ptr,
+		int site = LL_L_OTHER) {
+
+	LL_COUNT_LOCK(site, LL_LS_ACQUISITIONS, 1);
+	if (__builtin_expect(__sync_bool_compare_and_swap(ptr, 0, 1), 1)) return;
+
+
+	// Spin with exponential backoff
+
+	int backoff = 1;
+	for (int r = 0; r < LL_ADAPTIVE_LOCK_SPIN_ROUNDS; r++, backoff <<= 1) {
+		for (int i = 0; i < backoff; i++) {
+			asm volatile ("pause" ::: "memory");
+		}
+		LL_COUNT_LOCK(site, LL_LS_SPINS, 1);
+		if (*ptr == 0 && __sync_bool_compare_and_swap(ptr, 0, 1)) return;
+	}
+
+
+	// Park: mark the lock as contended and sleep until the holder releases
+	// it; the lock then stays marked, since there might be other waiters
+
+	while (__sync_lock_test_and_set(ptr, 2) != 0) {
+		LL_COUNT_LOCK(site, LL_LS_PARKS, 1);
+		ll_futex_wait(ptr, 2);
+	}
+}
+
+
+/**
+ * Release an adaptive lock
+ *
+ * @param ptr the lock
+ */
+inline void ll_adaptive_lock_release(ll_adaptive_lock_t* ptr) {
+	if (__sync_fetch_and_sub(ptr, 1) != 1) {
+		*ptr = 0;
+		ll_futex_wake(ptr, 1);
+	}
+}
+
+
+//==========================================================================//
+// Spinlock Table                                                           //
+//==========================================================================//
+
 #define LL_CACHELINE            8
 
 
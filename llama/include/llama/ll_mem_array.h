@@ -57,6 +57,7 @@
 #include <unordered_map>
 #include <vector>
 
+#include "llama/ll_growable_array.h"
 #include "llama/ll_mlcsr_helpers.h"
 #include "llama/ll_page_manager.h"
 #include "llama/ll_writable_elements.h"
@@ -88,7 +89,7 @@ typedef struct {
 template <class VT, typename T>
 class ll_mem_array_collection {
 
-	std::vector<VT*> _levels;
+	ll_level_array<VT*> _levels;
 	ll_page_manager<T>* _page_manager;
 	bool _own_page_manager;
 
@@ -42,21 +42,155 @@
 #include <vector>
 
 #include "llama/ll_lock.h"
+#include "llama/ll_mem_policy.h"
 #include "llama/ll_utils.h"
 
 #define LL_MEM_POOL_ALIGN_BITS				3
 #define	LL_MEM_POOL_ALIGN					(1 << (LL_MEM_POOL_ALIGN_BITS))
 
 
+/**
+ * A directory of the chunks of several memory pools, which numbers the
+ * chunks uniquely across all of them, so that a chunk number and an offset
+ * identify an object without knowing which pool owns it
+ */
+class ll_memory_pool_directory {
+
+	size_t _max_chunks;
+	void* volatile* _buffers;
+	size_t _next;
+	std::vector<size_t> _free;
+
+	ll_spinlock_t _lock;
+
+
+public:
+
+	/**
+	 * Initialize
+	 *
+	 * @param max_chunks the maximum number of chunks
+	 */
+	ll_memory_pool_directory(size_t max_chunks) {
+
+		_max_chunks = max_chunks;
+		_buffers = (void* volatile*) calloc(max_chunks, sizeof(void*));
+		if (_buffers == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+
+		_next = 0;
+		_lock = 0;
+	}
+
+
+	/**
+	 * Destroy
+	 */
+	~ll_memory_pool_directory() {
+		::free((void*) _buffers);
+	}
+
+
+	/**
+	 * Add a chunk
+	 *
+	 * @param buffer the chunk buffer, or NULL to only reserve the number
+	 * @return the chunk number
+	 */
+	size_t add(void* buffer) {
+
+		ll_spinlock_acquire(&_lock);
+
+		size_t c;
+		if (!_free.empty()) {
+			c = _free.back();
+			_free.pop_back();
+		}
+		else {
+			if (_next >= _max_chunks) {
+				LL_E_PRINT("Too many chunks in the memory pools\n");
+				abort();
+			}
+			c = _next++;
+		}
+
+		_buffers[c] = buffer;
+
+		ll_spinlock_release(&_lock);
+		return c;
+	}
+
+
+	/**
+	 * Replace the buffer of a chunk
+	 *
+	 * @param chunk the chunk number
+	 * @param buffer the new buffer, or NULL
+	 */
+	inline void set(size_t chunk, void* buffer) {
+		assert(chunk < _next);
+		_buffers[chunk] = buffer;
+	}
+
+
+	/**
+	 * Remove a chunk and free its number
+	 *
+	 * @param chunk the chunk number
+	 */
+	void remove(size_t chunk) {
+
+		ll_spinlock_acquire(&_lock);
+
+		assert(chunk < _next);
+		_buffers[chunk] = NULL;
+		_free.push_back(chunk);
+
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Get a pointer to the given location within a chunk
+	 *
+	 * @param chunk the chunk number
+	 * @param offset the given offset
+	 * @return the pointer
+	 */
+	inline void* pointer(size_t chunk, size_t offset) const {
+		assert(chunk < _next && _buffers[chunk] != NULL);
+		return ((char*) _buffers[chunk]) + offset;
+	}
+};
+
+
 /**
  * Memory pool
+ *
+ * The chunks are addressed by their index, which stays stable for as long as
+ * the chunk is in use. The chunks allocated since the last call to retire()
+ * form the current generation; a retired generation can be released back to
+ * the pool later, such as after all of its readers are done, while the pool
+ * continues to serve allocations from the other chunks.
+ *
+ * If the pool is registered with a directory, the chunks are addressed by
+ * their directory numbers instead, which are shared with the other pools in
+ * the same directory.
  */
 class ll_memory_pool {
 
 	size_t _chunk_size;
 	ssize_t _retain_max;
+	size_t _max_chunks;
 
 	std::vector<void*> _buffers;
+	std::vector<size_t> _free;
+	std::vector<size_t> _generation;
+
+	ll_memory_pool_directory* _directory;
+	std::vector<size_t> _numbers;
 
 	ll_spinlock_t _lock;
 
@@ -71,15 +205,23 @@ public:
 	 *
 	 * @param chunk_size the chunk size
 	 * @param retain_max the maximum number of chunks to retain (-1 = all)
+	 * @param max_chunks the maximum number of chunks (0 = unlimited), which
+	 *                   makes pointer() safe to call concurrently with allocate()
+	 * @param directory the chunk directory, or NULL for none
 	 */
 	ll_memory_pool(size_t chunk_size = 32 * 1048576ul,
-			ssize_t retain_max = -1) {
+			ssize_t retain_max = -1, size_t max_chunks = 0,
+			ll_memory_pool_directory* directory = NULL) {
 
 		_chunk_size = chunk_size;
 		_retain_max = retain_max;
+		_max_chunks = max_chunks;
+		_directory = directory;
+
+		if (_max_chunks > 0) _buffers.reserve(_max_chunks);
 
 		_chunk_index = 0;
-		_last_used = 0;
+		_last_used = _chunk_size;
 		_lock = 0;
 	}
 
@@ -90,7 +232,8 @@ public:
 	~ll_memory_pool() {
 
 		for (int i = ((int) _buffers.size()) - 1; i >= 0; i--) {
-			::free(_buffers[i]);
+			if (_directory != NULL) _directory->remove(_numbers[i]);
+			if (_buffers[i] != NULL) ::free(_buffers[i]);
 		}
 	}
 
@@ -106,7 +249,8 @@ public:
 
 
 	/**
-	 * Free the entire memory pool
+	 * Free the entire memory pool, including the retired generations that
+	 * have not been released yet
 	 *
 	 * @param retain true to retain all allocated buffers (default)
 	 */
@@ -117,15 +261,68 @@ public:
 		if (_retain_max >= 0 || !retain) {
 			ssize_t m = retain ? _retain_max : 0;
 			for (ssize_t i = ((ssize_t) _buffers.size()) - 1; i >= m; i--) {
-				::free(_buffers[i]);
+				if (_directory != NULL) _directory->remove(_numbers[i]);
+				if (_buffers[i] != NULL) ::free(_buffers[i]);
 			}
-			_buffers.resize(std::min((size_t) _retain_max, _buffers.size()));
+			_buffers.resize(std::min((size_t) m, _buffers.size()));
+			if (_directory != NULL) _numbers.resize(_buffers.size());
+		}
+
+		_free.clear();
+		for (ssize_t i = ((ssize_t) _buffers.size()) - 1; i >= 0; i--) {
+			_free.push_back(i);
 		}
 
+		_generation.clear();
 		_chunk_index = 0;
-		_last_used = 0;
+		_last_used = _chunk_size;
+
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Retire the current generation of chunks; the subsequent allocations
+	 * will not share a chunk with any of the retired objects
+	 *
+	 * @return the retired chunks, to be passed to release() or deleted
+	 */
+	std::vector<size_t>* retire(void) {
+
+		ll_spinlock_acquire(&_lock);
+
+		std::vector<size_t>* r = new std::vector<size_t>();
+		r->swap(_generation);
+		_last_used = _chunk_size;
+
+		ll_spinlock_release(&_lock);
+
+		return r;
+	}
+
+
+	/**
+	 * Return the retired chunks to the pool and delete the vector
+	 *
+	 * @param chunks the chunks returned by retire()
+	 */
+	void release(std::vector<size_t>* chunks) {
+
+		ll_spinlock_acquire(&_lock);
+
+		for (size_t i = 0; i < chunks->size(); i++) {
+			size_t c = (*chunks)[i];
+			if (_retain_max >= 0 && _free.size() >= (size_t) _retain_max) {
+				if (_directory != NULL) _directory->set(_numbers[c], NULL);
+				::free(_buffers[c]);
+				_buffers[c] = NULL;
+			}
+			_free.push_back(c);
+		}
 
 		ll_spinlock_release(&_lock);
+
+		delete chunks;
 	}
 
 
@@ -137,7 +334,9 @@ public:
 	 * @return the pointer
 	 */
 	void* pointer(size_t chunk, size_t offset) {
-		assert(chunk <= _chunk_index && offset < _chunk_size);
+		assert(offset < _chunk_size);
+		if (_directory != NULL) return _directory->pointer(chunk, offset);
+		assert(chunk < _buffers.size());
 		return ((char*) _buffers[chunk]) + offset;
 	}
 
@@ -161,44 +360,66 @@ public:
 			abort();
 		}
 
-		if (_buffers.empty()) {
-			void* b = malloc(_chunk_size);
-			if (b == NULL) {
-				LL_E_PRINT("** OUT OF MEMORY **\n");
-				abort();
-			}
-			_buffers.push_back(b);
+		if (_last_used + bytes > _chunk_size) {
+			_chunk_index = next_chunk();
+			_generation.push_back(_chunk_index);
 			_last_used = 0;
 		}
 
 		void* p = ((char*) _buffers[_chunk_index]) + _last_used;
+
+		if (o_chunk  != NULL) {
+			*o_chunk = _directory == NULL ? _chunk_index
+				: _numbers[_chunk_index];
+		}
+		if (o_offset != NULL) *o_offset = _last_used;
+
 		_last_used += bytes;
 
 		size_t lu_remainder = _last_used & ((1ul << LL_MEM_POOL_ALIGN_BITS) - 1);
 		if (lu_remainder != 0) _last_used += LL_MEM_POOL_ALIGN - lu_remainder;
+		
+		ll_spinlock_release(&_lock);
 
-		if (_last_used > _chunk_size) {
-			_chunk_index++;
-			if (_chunk_index < _buffers.size()) {
-				p = _buffers[_chunk_index];
-			}
-			else {
-				p = malloc(_chunk_size);
-				if (p == NULL) {
-					LL_E_PRINT("** OUT OF MEMORY **\n");
-					abort();
-				}
-				_buffers.push_back(p);
+		return (T*) p;
+	}
+
+
+private:
+
+	/**
+	 * Get a free chunk, allocating it if necessary; must be called while
+	 * holding the lock
+	 *
+	 * @return the chunk index
+	 */
+	size_t next_chunk(void) {
+
+		size_t c;
+		if (!_free.empty()) {
+			c = _free.back();
+			_free.pop_back();
+			if (_buffers[c] != NULL) return c;
+		}
+		else {
+			if (_max_chunks > 0 && _buffers.size() >= _max_chunks) {
+				LL_E_PRINT("Too many chunks in the memory pool\n");
+				abort();
 			}
-			_last_used = bytes;
+			c = _buffers.size();
+			_buffers.push_back(NULL);
+			if (_directory != NULL) _numbers.push_back(_directory->add(NULL));
 		}
 
-		if (o_chunk  != NULL) *o_chunk  = _chunk_index;
-		if (o_offset != NULL) *o_offset = _last_used - bytes;
-		
-		ll_spinlock_release(&_lock);
+		void* b = malloc(_chunk_size);
+		if (b == NULL) {
+			LL_E_PRINT("** OUT OF MEMORY **\n");
+			abort();
+		}
+		_buffers[c] = b;
+		if (_directory != NULL) _directory->set(_numbers[c], b);
 
-		return (T*) p;
+		return c;
 	}
 };
 
@@ -379,7 +600,7 @@ public:
 	 */
 	~ll_memory_helper() {
 		for (int i = ((int) _buffers.size()) - 1; i >= 0; i--) {
-			free(_buffers[i]);
+			ll_large_free(_buffers[i]);
 		}
 	}
 
@@ -391,7 +612,7 @@ public:
 	 * @return the allocated memory
 	 */
 	template<typename T> T* allocate(size_t num) {
-		T* p = (T*) malloc(sizeof(T) * num);
+		T* p = (T*) ll_large_alloc(sizeof(T) * num);
 		ll_spinlock_acquire(&_lock);
 		_buffers.push_back(p);
 		ll_spinlock_release(&_lock);
@@ -0,0 +1,459 @@
+/*
+ * ll_mem_policy.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_MEM_POLICY_H_
+#define LL_MEM_POLICY_H_
+
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+
+#include "llama/ll_common.h"
+#include "llama/ll_utils.h"
+
+
+/*
+ * The huge page policies
+ */
+
+#define LL_MP_HUGE_NONE					0	/* regular pages */
+#define LL_MP_HUGE_THP					1	/* transparent huge pages */
+#define LL_MP_HUGE_HUGETLB				2	/* hugetlb, fall back to THP */
+
+
+/*
+ * The NUMA placement policies
+ */
+
+#define LL_MP_NUMA_DEFAULT				0	/* the kernel default */
+#define LL_MP_NUMA_INTERLEAVE			1	/* interleave across nodes */
+#define LL_MP_NUMA_FIRST_TOUCH			2	/* partition by the OpenMP threads */
+
+
+/// The huge page size
+#ifndef LL_MP_HUGE_PAGE_SIZE
+#define LL_MP_HUGE_PAGE_SIZE			(2ul << 20)
+#endif
+
+/// The smallest allocation to which a non-default policy applies
+#ifndef LL_MP_MIN_SIZE
+#define LL_MP_MIN_SIZE					(1ul << 20)
+#endif
+
+/// The size of the allocation header
+#define LL_MP_HEADER_SIZE				64
+
+#define LL_MP_MAGIC						0x6c6c6d70ul
+
+#ifndef MPOL_INTERLEAVE
+#define MPOL_INTERLEAVE					3
+#endif
+
+
+/**
+ * The memory allocation policy for large arrays
+ */
+typedef struct {
+
+	/// The huge page policy (LL_MP_HUGE_*)
+	int mp_huge_pages;
+
+	/// The NUMA placement policy (LL_MP_NUMA_*)
+	int mp_numa;
+
+	/// The smallest allocation to which the policy applies
+	size_t mp_min_size;
+
+} ll_memory_policy_t;
+
+
+/**
+ * The number of bytes allocated by each of the applied policies
+ */
+typedef struct {
+	volatile size_t mps_default_bytes;
+	volatile size_t mps_thp_bytes;
+	volatile size_t mps_hugetlb_bytes;
+	volatile size_t mps_hugetlb_fallbacks;
+	volatile size_t mps_interleaved_bytes;
+	volatile size_t mps_first_touch_bytes;
+} ll_memory_policy_stats_t;
+
+
+/**
+ * The allocation header, which precedes the returned memory
+ */
+typedef struct {
+	size_t mh_magic;
+	void* mh_base;
+	size_t mh_length;			/* 0 if allocated using malloc */
+	char mh_padding[LL_MP_HEADER_SIZE - 3 * sizeof(size_t)];
+} ll_memory_header_t;
+
+
+/// The current policy
+ll_memory_policy_t g_ll_memory_policy
+	= { LL_MP_HUGE_NONE, LL_MP_NUMA_DEFAULT, LL_MP_MIN_SIZE };
+
+/// The allocation statistics
+ll_memory_policy_stats_t g_ll_memory_policy_stats;
+
+
+
+//==========================================================================//
+// Policy Configuration                                                     //
+//==========================================================================//
+
+/**
+ * Set the memory policy for the subsequent large allocations
+ *
+ * @param policy the policy
+ */
+inline void ll_set_memory_policy(const ll_memory_policy_t& policy) {
+	g_ll_memory_policy = policy;
+}
+
+
+/**
+ * Get the memory policy
+ *
+ * @return the policy
+ */
+inline const ll_memory_policy_t& ll_memory_policy() {
+	return g_ll_memory_policy;
+}
+
+
+/**
+ * Parse the huge page policy name
+ *
+ * @param s the name (none, thp, or hugetlb)
+ * @return the policy (LL_MP_HUGE_*), or -1 if invalid
+ */
+inline int ll_parse_huge_page_policy(const char* s) {
+	if (strcmp(s, "none") == 0) return LL_MP_HUGE_NONE;
+	if (strcmp(s, "thp") == 0) return LL_MP_HUGE_THP;
+	if (strcmp(s, "hugetlb") == 0) return LL_MP_HUGE_HUGETLB;
+	return -1;
+}
+
+
+/**
+ * Parse the NUMA policy name
+ *
+ * @param s the name (default, interleave, or first-touch)
+ * @return the policy (LL_MP_NUMA_*), or -1 if invalid
+ */
+inline int ll_parse_numa_policy(const char* s) {
+	if (strcmp(s, "default") == 0) return LL_MP_NUMA_DEFAULT;
+	if (strcmp(s, "interleave") == 0) return LL_MP_NUMA_INTERLEAVE;
+	if (strcmp(s, "first-touch") == 0) return LL_MP_NUMA_FIRST_TOUCH;
+	return -1;
+}
+
+
+/**
+ * Get the number of the online NUMA nodes
+ *
+ * @return the number of nodes (at least 1)
+ */
+inline int ll_numa_num_nodes() {
+
+	static int num_nodes = 0;
+	if (num_nodes > 0) return num_nodes;
+
+	int n = 1;
+	FILE* f = fopen("/sys/devices/system/node/online", "r");
+	if (f != NULL) {
+		int from, to;
+		n = 0;
+		while (fscanf(f, "%d", &from) == 1) {
+			to = from;
+			int c = fgetc(f);
+			if (c == '-') {
+				if (fscanf(f, "%d", &to) != 1) break;
+				c = fgetc(f);
+			}
+			n += to - from + 1;
+			if (c != ',') break;
+		}
+		fclose(f);
+		if (n <= 0) n = 1;
+	}
+
+	num_nodes = n;
+	return n;
+}
+
+
+/**
+ * Get the number of bytes of anonymous memory of this process that are
+ * backed by transparent huge pages
+ *
+ * @return the number of bytes, or 0 if not known
+ */
+inline size_t ll_memory_anon_huge_pages() {
+
+	FILE* f = fopen("/proc/self/smaps_rollup", "r");
+	if (f == NULL) return 0;
+
+	char line[256];
+	size_t kb = 0;
+	while (fgets(line, sizeof(line), f) != NULL) {
+		if (sscanf(line, "AnonHugePages: %lu kB", &kb) == 1) break;
+	}
+
+	fclose(f);
+	return kb << 10;
+}
+
+
+/**
+ * Describe the memory policy and how it was applied
+ *
+ * @return the description
+ */
+inline std::string ll_memory_policy_summary() {
+
+	const char* huge[] = { "none", "thp", "hugetlb" };
+	const char* numa[] = { "default", "interleave", "first-touch" };
+	const ll_memory_policy_stats_t& s = g_ll_memory_policy_stats;
+
+	char b[512];
+	snprintf(b, sizeof(b), "huge pages: %s, NUMA: %s (%d nodes); "
+			"%0.2lf MB default, %0.2lf MB THP, %0.2lf MB hugetlb "
+			"(%lu fallbacks), %0.2lf MB interleaved, %0.2lf MB first-touch",
+			huge[g_ll_memory_policy.mp_huge_pages],
+			numa[g_ll_memory_policy.mp_numa], ll_numa_num_nodes(),
+			s.mps_default_bytes / 1048576.0, s.mps_thp_bytes / 1048576.0,
+			s.mps_hugetlb_bytes / 1048576.0, s.mps_hugetlb_fallbacks,
+			s.mps_interleaved_bytes / 1048576.0,
+			s.mps_first_touch_bytes / 1048576.0);
+
+	return std::string(b);
+}
+
+
+
+//==========================================================================//
+// Allocation                                                               //
+//==========================================================================//
+
+/**
+ * Allocate a large array according to the current memory policy. Arrays
+ * smaller than mp_min_size, and all arrays if the policy is the default,
+ * are allocated using malloc(). The memory is zeroed only if it is
+ * mapped, so use ll_large_calloc() if it needs to be zeroed.
+ *
+ * @param size the size in bytes
+ * @return the allocated memory, or NULL if out of memory
+ */
+inline void* ll_large_alloc(size_t size) {
+
+	const ll_memory_policy_t& p = g_ll_memory_policy;
+	ll_memory_policy_stats_t& s = g_ll_memory_policy_stats;
+
+	if (size < p.mp_min_size || (p.mp_huge_pages == LL_MP_HUGE_NONE
+				&& p.mp_numa == LL_MP_NUMA_DEFAULT)) {
+
+		ll_memory_header_t* h = (ll_memory_header_t*)
+			malloc(LL_MP_HEADER_SIZE + size);
+		if (h == NULL) return NULL;
+
+		h->mh_magic = LL_MP_MAGIC;
+		h->mh_base = h;
+		h->mh_length = 0;
+
+		__sync_fetch_and_add(&s.mps_default_bytes, size);
+		return ((char*) h) + LL_MP_HEADER_SIZE;
+	}
+
+
+	// Map the memory, aligned to the huge page size
+
+	size_t length = size + LL_MP_HEADER_SIZE;
+	length += (LL_MP_HUGE_PAGE_SIZE - length % LL_MP_HUGE_PAGE_SIZE)
+		% LL_MP_HUGE_PAGE_SIZE;
+
+	char* m = (char*) MAP_FAILED;
+	bool thp = p.mp_huge_pages == LL_MP_HUGE_THP;
+
+#ifdef MAP_HUGETLB
+	if (p.mp_huge_pages == LL_MP_HUGE_HUGETLB) {
+		m = (char*) mmap(NULL, length, PROT_READ | PROT_WRITE,
+				MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+		if (m != MAP_FAILED) {
+			__sync_fetch_and_add(&s.mps_hugetlb_bytes, size);
+		}
+		else {
+			__sync_fetch_and_add(&s.mps_hugetlb_fallbacks, 1);
+			thp = true;
+		}
+	}
+#else
+	if (p.mp_huge_pages == LL_MP_HUGE_HUGETLB) {
+		__sync_fetch_and_add(&s.mps_hugetlb_fallbacks, 1);
+		thp = true;
+	}
+#endif
+
+	if (m == MAP_FAILED) {
+
+		char* r = (char*) mmap(NULL, length + LL_MP_HUGE_PAGE_SIZE,
+				PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+		if (r == MAP_FAILED) return NULL;
+
+		m = r + (LL_MP_HUGE_PAGE_SIZE - ((uintptr_t) r) % LL_MP_HUGE_PAGE_SIZE)
+			% LL_MP_HUGE_PAGE_SIZE;
+		if (m > r) munmap(r, m - r);
+		if (r + LL_MP_HUGE_PAGE_SIZE > m) {
+			munmap(m + length, (r + LL_MP_HUGE_PAGE_SIZE) - m);
+		}
+
+#ifdef MADV_HUGEPAGE
+		if (thp) {
+			if (madvise(m, length, MADV_HUGEPAGE) == 0) {
+				__sync_fetch_and_add(&s.mps_thp_bytes, size);
+			}
+			else {
+				__sync_fetch_and_add(&s.mps_default_bytes, size);
+			}
+		}
+		else {
+			__sync_fetch_and_add(&s.mps_default_bytes, size);
+		}
+#else
+		__sync_fetch_and_add(&s.mps_default_bytes, size);
+#endif
+	}
+
+
+	// Place the memory on the NUMA nodes before it is first touched
+
+	int num_nodes = ll_numa_num_nodes();
+
+	if (p.mp_numa == LL_MP_NUMA_INTERLEAVE && num_nodes > 1) {
+		unsigned long mask[16];
+		memset(mask, 0, sizeof(mask));
+		for (int i = 0; i < num_nodes && i < (int) (sizeof(mask) * 8); i++) {
+			mask[i / (8 * sizeof(*mask))] |= 1ul << (i % (8 * sizeof(*mask)));
+		}
+		if (syscall(SYS_mbind, m, length, MPOL_INTERLEAVE, mask,
+					sizeof(mask) * 8, 0) == 0) {
+			__sync_fetch_and_add(&s.mps_interleaved_bytes, size);
+		}
+		else {
+			LL_W_PRINT("mbind failed: %s\n", strerror(errno));
+		}
+	}
+
+	if (p.mp_numa == LL_MP_NUMA_FIRST_TOUCH) {
+
+		// Touch each page from the thread that would process it under the
+		// static OpenMP schedule, so that it is allocated on its node
+
+		size_t page = p.mp_huge_pages != LL_MP_HUGE_NONE
+			? LL_MP_HUGE_PAGE_SIZE : sysconf(_SC_PAGESIZE);
+		ssize_t num_pages = length / page;
+
+#pragma omp parallel for schedule(static)
+		for (ssize_t i = 0; i < num_pages; i++) {
+			m[i * page] = 0;
+		}
+
+		__sync_fetch_and_add(&s.mps_first_touch_bytes, size);
+	}
+
+	ll_memory_header_t* h = (ll_memory_header_t*) m;
+	h->mh_magic = LL_MP_MAGIC;
+	h->mh_base = m;
+	h->mh_length = length;
+
+	return m + LL_MP_HEADER_SIZE;
+}
+
+
+/**
+ * Allocate a large zeroed array according to the current memory policy
+ *
+ * @param size the size in bytes
+ * @return the allocated memory, or NULL if out of memory
+ */
+inline void* ll_large_calloc(size_t size) {
+
+	void* p = ll_large_alloc(size);
+	if (p == NULL) return NULL;
+
+	ll_memory_header_t* h = (ll_memory_header_t*)
+		(((char*) p) - LL_MP_HEADER_SIZE);
+	if (h->mh_length == 0) memset(p, 0, size);
+
+	return p;
+}
+
+
+/**
+ * Free an array allocated using ll_large_alloc()
+ *
+ * @param ptr the array (can be NULL)
+ */
+inline void ll_large_free(void* ptr) {
+
+	if (ptr == NULL) return;
+
+	ll_memory_header_t* h = (ll_memory_header_t*)
+		(((char*) ptr) - LL_MP_HEADER_SIZE);
+	if (h->mh_magic != LL_MP_MAGIC) {
+		LL_E_PRINT("** Invalid free **\n");
+		abort();
+	}
+
+	h->mh_magic = 0;
+	if (h->mh_length == 0) {
+		free(h->mh_base);
+	}
+	else {
+		munmap(h->mh_base, h->mh_length);
+	}
+}
+
+#endif
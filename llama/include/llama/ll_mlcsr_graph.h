@@ -444,6 +444,19 @@ public:
 	}
 
 
+#ifdef LL_PERSISTENCE
+
+	/**
+	 * Get the persistent storage
+	 *
+	 * @return the persistent storage
+	 */
+	inline ll_persistent_storage* storage() {
+		return _storage;
+	}
+#endif
+
+
 	/*-----------------------------------------------------------------------*
 	 * Graph structure                                                       *
 	 *-----------------------------------------------------------------------*/
@@ -488,6 +501,28 @@ public:
 	}
 
 
+	/**
+	 * Get the out-degree prefix sums of the latest level, such as for
+	 * ll_edge_balanced_partition
+	 *
+	 * @return the prefix sums, or NULL if there are no levels
+	 */
+	inline const ll_degree_prefix_sums* out_degree_prefix_sums() {
+		return _out.degree_prefix_sums();
+	}
+
+
+	/**
+	 * Get the in-degree prefix sums of the latest level, such as for
+	 * ll_edge_balanced_partition
+	 *
+	 * @return the prefix sums, or NULL if there are no levels or in-edges
+	 */
+	inline const ll_degree_prefix_sums* in_degree_prefix_sums() {
+		return _in.degree_prefix_sums();
+	}
+
+
 	/**
 	 * Get the graph CSRs
 	 *
@@ -769,6 +804,24 @@ public:
 	}
 
 
+	/**
+	 * Create iterator over the outgoing edges starting at the given position
+	 * of the adjacency list (counting also the deleted edges) and get the
+	 * first item
+	 *
+	 * @param iter the iterator
+	 * @param v the vertex
+	 * @param from the position within the adjacency list
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 * @return the next item, or LL_NIL_EDGE if none
+	 */
+	inline edge_t out_iter_begin_next_at(ll_edge_iterator& iter, node_t v,
+			size_t from, int level=-1, int max_level=-1) {
+		return _out.iter_begin_next_at(iter, v, from, level, max_level);
+	}
+
+
 	/**
 	 * Determine if there are any more items left
 	 *
@@ -791,6 +844,72 @@ public:
 	}
 
 
+	/**
+	 * Start iterating over the outgoing edges one contiguous span at a time
+	 *
+	 * @param iter the iterator
+	 * @param v the vertex
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 */
+	void out_span_begin(ll_edge_iterator& iter, node_t v,
+			int level=-1, int max_level=-1) {
+		_out.span_begin(iter, v, level, max_level);
+	}
+
+
+	/**
+	 * Get the next span of the outgoing edges
+	 *
+	 * @param iter the iterator
+	 * @param span the output span
+	 * @return true if there was a span, false if at the end
+	 */
+	bool out_span_next(ll_edge_iterator& iter, ll_adjacency_span& span) {
+		return _out.span_next(iter, span);
+	}
+
+
+	/**
+	 * Compute the mask of the edges in a span of the outgoing edges that are
+	 * not deleted
+	 *
+	 * @param span the span
+	 * @param mask the output with LL_SPAN_MASK_WORDS words, bit i set if live
+	 * @return the number of edges that are not deleted
+	 */
+	size_t out_span_live_mask(const ll_adjacency_span& span, uint64_t* mask) {
+		return _out.span_live_mask(span, mask);
+	}
+
+
+	/**
+	 * Scan all outgoing edges in the storage order, one level at a time;
+	 * the nodes in each block are the sources and the neighbors the targets
+	 *
+	 * @param f the functor, called concurrently as f(const ll_edge_block&)
+	 * @param level the level (-1 for the latest level)
+	 * @param max_level the max level for deletions
+	 */
+	template <class F>
+	void out_scan(F& f, int level=-1, int max_level=-1) {
+		_out.scan(f, level, max_level);
+	}
+
+
+	/**
+	 * Advise the OS about the upcoming accesses to the outgoing edges
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void out_advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
+		_out.advise(nodes, count, advice);
+	}
+
+
 	/**
 	 * Get the node in-degree
 	 *
@@ -876,6 +995,19 @@ public:
 	}
 
 
+	/**
+	 * Advise the OS about the upcoming accesses to the incoming edges
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void in_advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
+		_in.advise(nodes, count, advice);
+	}
+
+
 	/**
 	 * Create iterator over all incoming nodes
 	 *
@@ -915,6 +1047,61 @@ public:
 	}
 
 
+	/**
+	 * Start iterating over the incoming edges one contiguous span at a time
+	 *
+	 * @param iter the iterator
+	 * @param v the vertex
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 */
+	void in_span_begin(ll_edge_iterator& iter, node_t v,
+			int level=-1, int max_level=-1) {
+		_in.span_begin(iter, v, level, max_level);
+	}
+
+
+	/**
+	 * Get the next span of the incoming edges; the values are the source
+	 * nodes and the edge IDs are those of the in-edges (in().translate_edge())
+	 *
+	 * @param iter the iterator
+	 * @param span the output span
+	 * @return true if there was a span, false if at the end
+	 */
+	bool in_span_next(ll_edge_iterator& iter, ll_adjacency_span& span) {
+		return _in.span_next(iter, span);
+	}
+
+
+	/**
+	 * Compute the mask of the edges in a span of the incoming edges that are
+	 * not deleted
+	 *
+	 * @param span the span
+	 * @param mask the output with LL_SPAN_MASK_WORDS words, bit i set if live
+	 * @return the number of edges that are not deleted
+	 */
+	size_t in_span_live_mask(const ll_adjacency_span& span, uint64_t* mask) {
+		return _in.span_live_mask(span, mask);
+	}
+
+
+	/**
+	 * Scan all incoming edges in the storage order, one level at a time;
+	 * the nodes in each block are the targets, the neighbors the sources,
+	 * and the edge IDs are those of the in-edges (in().translate_edge())
+	 *
+	 * @param f the functor, called concurrently as f(const ll_edge_block&)
+	 * @param level the level (-1 for the latest level)
+	 * @param max_level the max level for deletions
+	 */
+	template <class F>
+	void in_scan(F& f, int level=-1, int max_level=-1) {
+		_in.scan(f, level, max_level);
+	}
+
+
 	/**
 	 * Find the given edge
 	 *
@@ -948,117 +1135,311 @@ public:
 
 
 	/**
-	 * Make the reverse edges
+	 * Make the reverse edges for the levels that do not have them yet, which
+	 * is usually just the newest level
 	 *
 	 * @param deletedInEdgeCounts the number of deleted in-edges per node (NULL for Level 0)
+	 * @param max_buffer_size the max buffer size in bytes (0 = unlimited)
 	 */
-	void make_reverse_edges(degree_t* deletedInEdgeCounts=NULL) {
+	void make_reverse_edges(degree_t* deletedInEdgeCounts=NULL,
+			size_t max_buffer_size=0) {
 
 		for (size_t level = _in.num_levels();
 				level < _out.num_levels(); level++) {
+			make_reverse_edges_level(level, deletedInEdgeCounts,
+					max_buffer_size);
+		}
+	}
+
+
+private:
+
+	/**
+	 * An out-edge of a level being reversed
+	 */
+	typedef struct {
+		node_t re_source;
+		node_t re_target;
+		edge_t re_edge;
+	} reverse_edge_t;
+
+
+	/**
+	 * Make the reverse edges of the given level from its out-edges using
+	 * a parallel counting sort by the target node.
+	 *
+	 * The sources are split into contiguous partitions of roughly equal edge
+	 * counts (using the cached degree prefix sums of the level) and the
+	 * targets into contiguous blocks. Each partition counts its edges per target block
+	 * and then scatters them into a buffer grouped by the block, so that
+	 * each block can be processed by a single thread without atomics, which
+	 * also keeps the in-edges of each node sorted by the source. The
+	 * out-to-in and in-to-out translation maps are written in the same pass
+	 * as the in-edges.
+	 *
+	 * The given size bounds the edge buffer together with the counts and
+	 * the cursors of the (source partition, target block) pairs, which get
+	 * at most half of it by capping the number of blocks. If the buffer for
+	 * all edges of the level would not fit into the rest, the in-degrees are
+	 * computed with atomic increments in the counting pass, and the target
+	 * blocks are processed in batches that fit, at the cost of one more scan
+	 * of the out-edges per batch. A single target block can still exceed the
+	 * limit if its nodes have a very large in-degree.
+	 *
+	 * @param level the level, which must be the next level without in-edges
+	 * @param deletedInEdgeCounts the number of deleted in-edges per node (NULL for Level 0)
+	 * @param max_buffer_size the max buffer size in bytes (0 = unlimited)
+	 */
+	void make_reverse_edges_level(size_t level,
+			degree_t* deletedInEdgeCounts=NULL, size_t max_buffer_size=0) {
+
+		assert(level == _in.num_levels());
+
+		node_t max_nodes = _out.max_nodes(level);
+
+
+		// Partition the sources by their out-degrees and the targets into
+		// equally sized blocks, with enough blocks to form batches that fit
+		// into the buffer, but few enough for their counts and cursors to
+		// take at most half of it
+
+		ll_edge_balanced_partition parts(_out.degree_prefix_sums(level),
+				max_nodes, false, 4);
+		size_t num_parts = parts.size();
+		if (num_parts == 0) num_parts = 1;
+
+		size_t min_blocks = 2 * num_parts;
+		if (max_buffer_size > 0) {
+			size_t b = 4 * (sizeof(reverse_edge_t) * _out.max_edges(level)
+					/ (max_buffer_size / 2 + 1) + 1);
+			if (b > min_blocks) min_blocks = b;
+
+			size_t max_blocks = max_buffer_size / 2
+				/ (sizeof(size_t) * (2 * num_parts + 1));
+			if (min_blocks > max_blocks) min_blocks = max_blocks;
+		}
+
+		int block_bits = 0;
+		while ((((size_t) max_nodes) >> block_bits) > min_blocks) block_bits++;
+		size_t num_blocks = (((size_t) max_nodes) >> block_bits) + 1;
+
+		size_t* counts = (size_t*) malloc(sizeof(size_t)
+				* num_parts * num_blocks);
+		memset(counts, 0, sizeof(size_t) * num_parts * num_blocks);
 
-			node_t max_nodes = _out.max_nodes(level);
+		size_t metadata_size = sizeof(size_t)
+			* (2 * num_parts * num_blocks + num_blocks + 1);
+		size_t edges_size = max_buffer_size > metadata_size
+			? max_buffer_size - metadata_size : 0;
 
 
-			// Compute the in-degrees
+		// Count the edges for each (source partition, target block) pair,
+		// and if the edges will not fit into the buffer at once, also the
+		// in-degrees, so that the batches do not need to scan the out-edges
+		// just for them
 
-			degree_t* a = (degree_t*) malloc(sizeof(degree_t) * max_nodes);
-			memset(a, 0, sizeof(degree_t) * max_nodes);
+		degree_t* a = (degree_t*) malloc(sizeof(degree_t) * max_nodes);
+		memset(a, 0, sizeof(degree_t) * max_nodes);
 
-			// Add max_nodes just in case sometimes in the future
-			int* loc = (int*) malloc(sizeof(int) * _out.edge_table_length(level));
+		bool batched = max_buffer_size > 0
+			&& sizeof(reverse_edge_t) * _out.max_edges(level) > edges_size;
 
-#			pragma omp parallel for schedule(dynamic,4096)
-			for (node_t source = 0; source < _out.max_nodes(); source++) {
+#		pragma omp parallel for schedule(dynamic,1)
+		for (size_t p = 0; p < num_parts; p++) {
+			if (p >= parts.size()) continue;
+			size_t* c = &counts[p * num_blocks];
+			for (node_t source = parts[p].ec_begin;
+					source < parts[p].ec_end; source++) {
 				ll_edge_iterator iter;
 				_out.iter_begin_within_level(iter, source, level);
 				FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
 					node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
-					loc[LL_EDGE_INDEX(e)]
-						= __sync_fetch_and_add(&a[target], 1);
+					c[target >> block_bits]++;
+					if (batched) __sync_fetch_and_add(&a[target], 1);
 				}
 			}
+		}
+
+
+		// Turn the counts into the offsets, ordered by the block and then by
+		// the partition
+
+		size_t* block_starts = (size_t*) malloc(sizeof(size_t)
+				* (num_blocks + 1));
 
-			/*int zeros = 0;
-			for (node_t source = 0; source < _out.max_nodes(); source++) {
-				printf("%lu: %lu\t", source, a[source]);
-				if ((source & 0xf) == 0xe) printf("\n");
-				if (a[source] == 0) zeros++;
+		size_t num_edges = 0;
+		for (size_t b = 0; b < num_blocks; b++) {
+			block_starts[b] = num_edges;
+			for (size_t p = 0; p < num_parts; p++) {
+				size_t n = counts[p * num_blocks + b];
+				counts[p * num_blocks + b] = num_edges;
+				num_edges += n;
 			}
-			printf("\n\nZeros: %d\n\n", zeros);*/
+		}
+		block_starts[num_blocks] = num_edges;
 
 
-			// Initialize the level and the vertex table
+		// Group the blocks into batches
 
-			assert(_in.has_edge_translation()
-					== _out.has_edge_translation());
-			bool has_edge_translation = _in.has_edge_translation()
-				&& _out.has_edge_translation();
+		std::vector<size_t> batches;
+		batches.push_back(0);
 
-			if (has_edge_translation) {
-				_out.edge_translation().cow_init_level(_out.max_edges(level));
+		size_t max_batch_edges = num_edges;
+		if (batched) {
+			size_t limit = edges_size / sizeof(reverse_edge_t);
+			max_batch_edges = 0;
+			for (size_t b = 0; b < num_blocks; b++) {
+				size_t start = block_starts[batches.back()];
+				if (b > batches.back() && block_starts[b + 1] - start > limit) {
+					max_batch_edges = std::max(max_batch_edges,
+							block_starts[b] - start);
+					batches.push_back(b);
+				}
 			}
+			max_batch_edges = std::max(max_batch_edges,
+					num_edges - block_starts[batches.back()]);
+		}
+		batches.push_back(num_blocks);
 
-			_in.init_level_from_degrees(_out.max_nodes(), a,
-					deletedInEdgeCounts,
-					has_edge_translation ? in_copy_edge_callback : NULL,
-					this);
+		size_t num_batches = batches.size() - 1;
+		reverse_edge_t* edges = (reverse_edge_t*) malloc(sizeof(reverse_edge_t)
+				* (max_batch_edges + 1));
+		size_t* cursors = (size_t*) malloc(sizeof(size_t)
+				* num_parts * num_blocks);
 
-			if (has_edge_translation) {
-				_in.edge_translation().cow_init_level(_in.max_edges(level));
+
+		// Compute the in-degrees from the scattered edges, unless the
+		// counting pass already did
+
+		if (!batched) {
+			assert(num_batches == 1);
+			reverse_edges_scatter(level, parts, counts, cursors, num_blocks,
+					block_bits, 0, num_blocks, block_starts, edges);
+
+#			pragma omp parallel for schedule(dynamic,1)
+			for (size_t b = 0; b < num_blocks; b++) {
+				for (size_t j = block_starts[b]; j < block_starts[b + 1]; j++) {
+					a[edges[j].re_target]++;
+				}
 			}
+		}
 
 
-			// Copy the data
+		// Initialize the level and the vertex table
 
-#ifdef _DEBUG
-			degree_t* degrees = a; a = (degree_t*) malloc(sizeof(degree_t)
-					* _out.max_nodes());
-			/*fprintf(stderr, "\n");
-			for (size_t i = 0; i < _out.max_nodes(); i++) {
-				if ((i+0) % 25 == 0) fprintf(stderr, "%4lu:", i);
-				fprintf(stderr, " %3lu", degrees[i]);
-				if ((i+1) % 25 == 0) fprintf(stderr, "\n");
-			}*/
-#endif
-			memset(a, 0, sizeof(degree_t) * _out.max_nodes());
+		assert(_in.has_edge_translation()
+				== _out.has_edge_translation());
+		bool has_edge_translation = _in.has_edge_translation()
+			&& _out.has_edge_translation();
+
+		if (has_edge_translation) {
+			_out.edge_translation().cow_init_level(_out.max_edges(level));
+		}
+
+		_in.init_level_from_degrees(max_nodes, a,
+				deletedInEdgeCounts,
+				has_edge_translation ? in_copy_edge_callback : NULL,
+				this);
+
+		if (has_edge_translation) {
+			_in.edge_translation().cow_init_level(_in.max_edges(level));
+		}
 
-#			pragma omp parallel for schedule(dynamic,4096)
-			for (node_t source = 0; source < _out.max_nodes(); source++) {
-				ll_edge_iterator iter;
-				_out.iter_begin_within_level(iter, source, level);
-				FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
-					node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
-					size_t index = loc[LL_EDGE_INDEX(e)];
-						//__sync_fetch_and_add(&a[target], 1);
-					edge_t in_edge = _in.write_value(target, index, source);
+
+		// Write the in-edges and the translation maps, reusing the scattered
+		// edges if they all fit into a single batch
+
+		memset(a, 0, sizeof(degree_t) * max_nodes);
+
+		for (size_t i = 0; i < num_batches; i++) {
+			if (batched) {
+				reverse_edges_scatter(level, parts, counts, cursors, num_blocks,
+						block_bits, batches[i], batches[i + 1], block_starts,
+						edges);
+			}
+
+			size_t base = block_starts[batches[i]];
+
+#			pragma omp parallel for schedule(dynamic,1)
+			for (size_t b = batches[i]; b < batches[i + 1]; b++) {
+				for (size_t j = block_starts[b]; j < block_starts[b + 1]; j++) {
+					reverse_edge_t& r = edges[j - base];
+					edge_t in_edge = _in.write_value(r.re_target,
+							a[r.re_target]++, r.re_source);
 
 					if (has_edge_translation) {
-						_in.edge_translation().cow_write(in_edge, e);
-						_out.edge_translation().cow_write(e, in_edge);
+						_in.edge_translation().cow_write(in_edge, r.re_edge);
+						_out.edge_translation().cow_write(r.re_edge, in_edge);
 					}
 				}
 			}
+		}
 
-			_in.finish_level_edges();
+		_in.finish_level_edges();
 
-			if (has_edge_translation) {
-				_out.edge_translation().cow_finish_level();
-				_in.edge_translation().cow_finish_level();
-			}
+		if (has_edge_translation) {
+			_out.edge_translation().cow_finish_level();
+			_in.edge_translation().cow_finish_level();
+		}
 
 
-			// Finish
+		// Finish
 
-			free(a);
-#ifdef _DEBUG
-			free(degrees);
-#endif
-			if (loc != NULL) free(loc);
+		free(a);
+		free(edges);
+		free(cursors);
+		free(counts);
+		free(block_starts);
+	}
+
+
+	/**
+	 * Scatter the out-edges of a level that point into a batch of target
+	 * blocks into the buffer, grouped by the block
+	 *
+	 * @param level the level
+	 * @param parts the source partitions
+	 * @param offsets the offset of each (source partition, target block) pair
+	 * @param cursors the scratch space of the same size as the offsets
+	 * @param num_blocks the number of target blocks
+	 * @param block_bits the number of bits to shift a node to get its block
+	 * @param batch_begin the first block of the batch
+	 * @param batch_end the block after the last block of the batch
+	 * @param block_starts the offset of each block
+	 * @param edges the buffer, which starts at the first block of the batch
+	 */
+	void reverse_edges_scatter(size_t level,
+			const ll_edge_balanced_partition& parts, const size_t* offsets,
+			size_t* cursors, size_t num_blocks, int block_bits,
+			size_t batch_begin, size_t batch_end, const size_t* block_starts,
+			reverse_edge_t* edges) {
+
+		size_t base = block_starts[batch_begin];
+		memcpy(cursors, offsets, sizeof(size_t) * parts.size() * num_blocks);
+
+#		pragma omp parallel for schedule(dynamic,1)
+		for (size_t p = 0; p < parts.size(); p++) {
+			size_t* c = &cursors[p * num_blocks];
+			for (node_t source = parts[p].ec_begin;
+					source < parts[p].ec_end; source++) {
+				ll_edge_iterator iter;
+				_out.iter_begin_within_level(iter, source, level);
+				FOREACH_ITER_WITHIN_LEVEL(e, _out, iter) {
+					node_t target = LL_ITER_OUT_NEXT_NODE(_out, iter, e);
+					size_t b = target >> block_bits;
+					if (b < batch_begin || b >= batch_end) continue;
+					reverse_edge_t& r = edges[c[b]++ - base];
+					r.re_source = source;
+					r.re_target = target;
+					r.re_edge = e;
+				}
+			}
 		}
 	}
 
 
+public:
+
 	/**
 	 * Set the maximum visibility level for an edge
 	 *
@@ -1086,14 +1467,17 @@ public:
 	 *
 	 * @param edge the edge
 	 * @param mlevel the maximum visibility level
+	 * @param o_old_level the output for the previous level if lowered
 	 * @return true if the value was lowered
 	 */
-	bool update_max_visible_level_lower_only(edge_t edge, int mlevel) {
+	bool update_max_visible_level_lower_only(edge_t edge, int mlevel,
+			int* o_old_level = NULL) {
 
 		// I do not think this needs to be locked...
 		//ll_spinlock_acquire(&_update_lock);
 
-		bool r = _out.update_max_visible_level_lower_only(edge, mlevel);
+		bool r = _out.update_max_visible_level_lower_only(edge, mlevel,
+				o_old_level);
 
 		if (r) {
 			if (has_reverse_edges()) {
@@ -1108,6 +1492,30 @@ public:
 	}
 
 
+	/**
+	 * Undo update_max_visible_level_lower_only() for an edge, unless the
+	 * level has been lowered further in the meantime
+	 *
+	 * @param edge the edge
+	 * @param mlevel the maximum visibility level that was set
+	 * @param old_level the previous level
+	 * @return true if the value was restored
+	 */
+	bool restore_max_visible_level(edge_t edge, int mlevel, int old_level) {
+
+		bool r = _out.restore_max_visible_level(edge, mlevel, old_level);
+
+		if (r) {
+			if (has_reverse_edges()) {
+				edge_t in_edge = out_to_in(edge);
+				_in.restore_max_visible_level(in_edge, mlevel, old_level);
+			}
+		}
+
+		return r;
+	}
+
+
 	/**
 	 * Get all 32-bit node properties
 	 *
@@ -1513,7 +1921,10 @@ public:
 		// TODO Apply deletions for LL_TIMESTAMPS
 
 
-		// Initialize
+		// Initialize; the level syncs of all contexts are deferred until the
+		// whole checkpoint is written, so that they can proceed concurrently
+
+		IF_LL_PERSISTENCE(_storage->begin_deferred_sync());
 
 		size_t level = _out.num_levels();
 		//size_t num_total_nodes = _out.max_nodes() + source->num_new_nodes();
@@ -1828,6 +2239,11 @@ public:
 				assert(it->second->max_level() == _out.max_level());
 			}
 		}
+
+
+		// Sync all levels written by the checkpoint
+
+		IF_LL_PERSISTENCE(_storage->end_deferred_sync());
 	}
 
 
@@ -61,6 +61,8 @@ struct ll_edge_iterator {
 	const void* ptr;
 
 	node_t last_node;
+
+	int ro_levels;	// the RO levels under the writable level at the start
 	
 #ifdef LL_DELETIONS
 	size_t max_level;
@@ -69,6 +71,108 @@ struct ll_edge_iterator {
 
 
 
+//==========================================================================//
+// Support: ll_adjacency_span                                               //
+//==========================================================================//
+
+/// The maximum length of a span, so that its deletion mask fits on the stack
+#define LL_SPAN_MAX_LENGTH		1024
+
+/// The number of words in the deletion mask of a span
+#define LL_SPAN_MASK_WORDS		(LL_SPAN_MAX_LENGTH / 64)
+
+/**
+ * A contiguous piece of an adjacency list within a single level, so that
+ * kernels can run tight (and vectorizable) loops over the raw edge table.
+ * The values are node IDs, but with deletions enabled they also carry the
+ * deletion level, so use LL_VALUE_PAYLOAD() to extract the node.
+ */
+struct ll_adjacency_span {
+
+	/// The values
+	const node_t* as_values;
+
+	/// The number of values
+	size_t as_length;
+
+	/// The ID of the first edge (the following edges have consecutive IDs)
+	edge_t as_edge;
+
+	/// The level
+	int as_level;
+
+#ifdef LL_DELETIONS
+	/// The max level for deletions
+	size_t as_max_level;
+#endif
+};
+
+
+/**
+ * Fill the mask of a span with no deleted edges
+ *
+ * @param length the span length
+ * @param mask the output with LL_SPAN_MASK_WORDS words
+ * @return the number of edges
+ */
+inline size_t ll_adjacency_span_fill_mask(size_t length, uint64_t* mask) {
+
+	size_t words = (length + 63) >> 6;
+	for (size_t w = 0; w < words; w++) mask[w] = ~((uint64_t) 0);
+	if ((length & 63) != 0) {
+		mask[words - 1] = (((uint64_t) 1) << (length & 63)) - 1;
+	}
+
+	return length;
+}
+
+
+/**
+ * Determine whether the given edge in a span is live according to its mask
+ *
+ * @param mask the mask
+ * @param i the index within the span
+ * @return true if it is not deleted
+ */
+inline bool ll_adjacency_span_is_live(const uint64_t* mask, size_t i) {
+	return ((mask[i >> 6] >> (i & 63)) & 1) != 0;
+}
+
+
+
+//==========================================================================//
+// Support: ll_edge_block                                                   //
+//==========================================================================//
+
+/// The maximum number of edges in a block produced by an edge-centric scan
+#define LL_EDGE_BLOCK_LENGTH	1024
+
+/**
+ * A block of edges produced by an edge-centric scan, in the storage order.
+ * The nodes are the owners of the adjacency lists, so for the out-edges
+ * they are the sources and the neighbors are the targets, and the other way
+ * around for the in-edges. Deleted edges are never included.
+ */
+struct ll_edge_block {
+
+	/// The number of edges in the block
+	size_t eb_length;
+
+	/// The level that stores the edges
+	int eb_level;
+
+	/// The nodes that own the adjacency lists
+	node_t eb_nodes[LL_EDGE_BLOCK_LENGTH];
+
+	/// The neighbors (without any deletion bits)
+	node_t eb_neighbors[LL_EDGE_BLOCK_LENGTH];
+
+	/// The edge IDs
+	edge_t eb_edges[LL_EDGE_BLOCK_LENGTH];
+};
+
+
+
 //==========================================================================//
 // Additional APIs                                                          //
 //==========================================================================//
@@ -214,6 +318,76 @@ struct ll_edge_iterator {
 			node_var = (graph).inm_iter_next(ll_tmp_var(i)))
 
 
+//
+// Span iterators: a contiguous piece of the adjacency list at a time
+//
+
+#define ll_foreach_out_span(span_var, graph, source_node) \
+	ll_tmp_with_begin() \
+	ll_tmp_with(ll_edge_iterator ll_tmp_var(i)) \
+	ll_tmp_with(ll_adjacency_span span_var) \
+	ll_tmp_with((graph).out_span_begin(ll_tmp_var(i), source_node)) \
+	for (ll_tmp_with_end(); \
+			(graph).out_span_next(ll_tmp_var(i), span_var); )
+
+#define ll_foreach_in_span(span_var, graph, source_node) \
+	ll_tmp_with_begin() \
+	ll_tmp_with(ll_edge_iterator ll_tmp_var(i)) \
+	ll_tmp_with(ll_adjacency_span span_var) \
+	ll_tmp_with((graph).in_span_begin(ll_tmp_var(i), source_node)) \
+	for (ll_tmp_with_end(); \
+			(graph).in_span_next(ll_tmp_var(i), span_var); )
+
+
+//
+// Out-edge iterators over a range of positions [from, to) of a node's
+// adjacency list, such as for a node split across several chunks of
+// ll_edge_balanced_partition. The positions count also the deleted edges,
+// so that the iterator can seek directly to the first position using the
+// lengths of the level fragments; the range then covers the edges that are
+// not deleted from the first one at or after "from" up to (but excluding)
+// the first one at or after "to", so that adjacent ranges never overlap or
+// leave a gap between them.
+//
+
+/**
+ * Get the edge at which an iteration over a range of positions of a node's
+ * out-edges stops, which is the first edge at or after the given position
+ * that is not deleted
+ *
+ * @param graph the graph
+ * @param iter the iterator
+ * @param node the node
+ * @param to the end of the range (SIZE_MAX = the end of the list)
+ * @return the edge, or LL_NIL_EDGE if the range extends to the end
+ */
+template <class Graph>
+inline edge_t ll_out_iter_range_end(Graph& graph, ll_edge_iterator& iter,
+		node_t node, size_t to) {
+
+	if (to == SIZE_MAX) return LL_NIL_EDGE;
+	return graph.out_iter_begin_next_at(iter, node, to);
+}
+
+#define ll_foreach_out_range_ext(edge_var, node_var, graph, source_node, \
+		from, to) \
+	ll_tmp_with_begin() \
+	ll_tmp_with(ll_edge_iterator ll_tmp_var(i)) \
+	ll_tmp_with(edge_t ll_tmp_var(t) = ll_out_iter_range_end((graph), \
+				ll_tmp_var(i), source_node, (to))) \
+	ll_tmp_with(edge_t edge_var = (graph).out_iter_begin_next_at( \
+				ll_tmp_var(i), source_node, (from))) \
+	ll_tmp_with(node_t node_var = (ll_tmp_var(i)).last_node) \
+	for (ll_tmp_with_end(); \
+			edge_var != ll_tmp_var(t); \
+			edge_var = (graph).out_iter_next(ll_tmp_var(i)), \
+			node_var = (ll_tmp_var(i)).last_node)
+
+#define ll_foreach_out_range(node_var, graph, source_node, from, to) \
+	ll_foreach_out_range_ext(ll_tmp_var(e), node_var, graph, source_node, \
+			from, to)
+
+
 
 //==========================================================================//
 // Support: ll_common_neighbor_iter                                         //
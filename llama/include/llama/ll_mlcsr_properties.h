@@ -37,6 +37,8 @@
 #ifndef LL_MLCSR_PROPERTY_H_
 #define LL_MLCSR_PROPERTY_H_
 
+#include "llama/ll_buffer_pool.h"
+#include "llama/ll_growable_array.h"
 #include "llama/ll_mem_array.h"
 #include "llama/ll_writable_elements.h"
 
@@ -287,7 +289,17 @@ public:
 	inline short type() const {
 		return _type;
 	}
-	
+
+
+	/**
+	 * Get the name
+	 *
+	 * @return the name
+	 */
+	inline const char* name() const {
+		return _name.c_str();
+	}
+
 
 #ifdef LL_MIN_LEVEL
 
@@ -341,7 +353,13 @@ public:
 	 * @return the property value
 	 */
 	inline const T get(size_t index) {
+#ifdef LL_BUFFER_POOL
+		const T& v = (*_latest_properties)[index];
+		ll_buffer_pool::touch(&v, sizeof(T));
+		return v;
+#else
 		return (*_latest_properties)[index];
+#endif
 	}
 
 
@@ -737,8 +755,9 @@ class ll_mlcsr_edge_property {
 	/// The master copy (if this is a read-only clone)
 	ll_mlcsr_edge_property<T>* _master;
 
-	/// The properties per edge level
-	std::vector<ll_multiversion_property_array<T>*> _properties;
+	/// The properties per edge level, which do not move when a level is
+	/// added, so that the readers can index them during a checkpoint
+	ll_level_array<ll_multiversion_property_array<T>*> _properties;
 
 	/// The page manager
 	ll_page_manager<T>* _page_manager;
@@ -37,51 +37,21 @@
 #ifndef LL_MLCSR_SP_H_
 #define LL_MLCSR_SP_H_
 
+#include "llama/ll_counters.h"
 #include "llama/ll_mem_array.h"
 #include "llama/ll_edge_table.h"
+#include "llama/ll_growable_array.h"
 
 #ifdef LL_PERSISTENCE
 #include "llama/ll_persistent_storage.h"
 #endif
 
 #include "llama/ll_mlcsr_iterator.h"
+#include "llama/ll_parallel.h"
 #include "llama/ll_mlcsr_properties.h"
 
 
 
-//==========================================================================//
-// Counters                                                                 //
-//==========================================================================//
-
-#ifdef LL_COUNTERS
-std::atomic<size_t> g_iter_begin;
-std::atomic<size_t> g_iter_descend;
-std::atomic<size_t> g_iter_next;
-
-/**
- * Clear the counters
- */
-void ll_clear_counters() {
-	g_iter_begin = 0;
-	g_iter_descend = 0;
-	g_iter_next = 0;
-}
-
-/**
- * Print the counters
- *
- * @param f the output file
- * @param sep the separator
- */
-void ll_print_counters(FILE* f = stderr, const char* sep = ":\t") {
-	fprintf(f, "iter_begin%s%lu\n", sep, g_iter_begin.load());
-	fprintf(f, "iter_descend%s%lu\n", sep, g_iter_descend.load());
-	fprintf(f, "iter_next%s%lu\n", sep, g_iter_next.load());
-}
-#endif
-
-
-
 //==========================================================================//
 // The base class: ll_csr_base                                              //
 //==========================================================================//
@@ -120,13 +90,13 @@ protected:
 	int _maxLevel;
 
 	/// The per-level number of nodes
-	std::vector<node_t> _perLevelNodes;
+	ll_level_array<node_t> _perLevelNodes;
 
 	/// The per-level number of adjacency lists
-	std::vector<node_t> _perLevelAdjLists;
+	ll_level_array<node_t> _perLevelAdjLists;
 
 	/// The per-level number of edges
-	std::vector<edge_t> _perLevelEdges;
+	ll_level_array<edge_t> _perLevelEdges;
 
 	/// The external deletions
 	ll_mlcsr_external_deletions* _deletions;
@@ -136,7 +106,7 @@ protected:
 	VT_TABLE<VT_ELEMENT>* _latest_begin;
 
 	/// The edge table for each level: edge ID --> the associated value
-	std::vector<LL_ET<T>*> _values;
+	ll_level_array<LL_ET<T>*> _values;
 	LL_ET<T>* _latest_values;
 
 	/// The edge translation property
@@ -160,13 +130,13 @@ protected:
 	void* _copy_edge_callback_data;
 
 	/// The vertex IDs for the sparse column-store like representation
-	std::vector<node_t*> _sparse_node_ids;
+	ll_level_array<node_t*> _sparse_node_ids;
 
 	/// The vertex data for the sparse column-store like representation
-	std::vector<VT_ELEMENT*> _sparse_node_data;
+	ll_level_array<VT_ELEMENT*> _sparse_node_data;
 
 	/// The length of the arrays for the sparse column-store like representation
-	std::vector<size_t> _sparse_length;
+	ll_level_array<size_t> _sparse_length;
 
 	/// The memory pool for sparse node IDs
 	ll_memory_pool_for_large_allocations* _pool_for_sparse_node_ids;
@@ -174,6 +144,9 @@ protected:
 	/// The memory pool for sparse node data
 	ll_memory_pool_for_large_allocations* _pool_for_sparse_node_data;
 
+	/// The cached degree prefix sums of the complete levels
+	ll_degree_prefix_sums_cache _degree_prefix_sums;
+
 
 public:
 
@@ -220,10 +193,13 @@ public:
 		_maxLevel = -1;
 
 #ifdef LL_PERSISTENCE
+		// Do not materialize the levels yet (other than the latest one); the
+		// edge table and the size are available from the level header
+
 		for (size_t l = 0; l < _begin.size(); l++) {
-			VT_TABLE<VT_ELEMENT>& b = *_begin[l];
+			VT_TABLE<VT_ELEMENT>& b = *_begin.peek(l);
 
-			_latest_begin = _begin[l];
+			_latest_begin = _begin.peek(l);
 			_perLevelNodes.push_back(b.size());
 			_max_nodes = b.size();
 
@@ -245,6 +221,8 @@ public:
 			_sparse_length.push_back(0);
 		}
 
+		if (_latest_begin != NULL) _latest_begin->ensure_materialized();
+
 		_has_edge_translation = _begin.size() == 0
 			? edge_translation : _edge_translation.max_level_id() >= 0;
 #endif
@@ -514,6 +492,7 @@ public:
 		_minLevel = m;
 
 		_begin.set_min_level(_minLevel);
+		_edge_translation.set_min_level(_minLevel);
 	}
 
 #endif
@@ -844,15 +823,18 @@ public:
 	 *
 	 * @param edge the edge
 	 * @param mlevel the new value of max-level
+	 * @param o_old_level the output for the previous max-level if lowered
 	 * @return true if the value was lowered
 	 */
-	bool update_max_visible_level_lower_only(edge_t edge, int mlevel) {
+	bool update_max_visible_level_lower_only(edge_t edge, int mlevel,
+			int* o_old_level = NULL) {
 		bool r = false;
 #ifdef LL_DELETIONS
 		_lt.acquire_for(edge);
 		T& v = (*this->edge_table(LL_EDGE_LEVEL(edge)))[LL_EDGE_INDEX(edge)];
 		if (mlevel < (int) LL_VALUE_MAX_LEVEL(v)) {
 			r = true;
+			if (o_old_level != NULL) *o_old_level = (int) LL_VALUE_MAX_LEVEL(v);
 			v = LL_VALUE_CREATE_EXT(
 					LL_VALUE_PAYLOAD(v),
 					mlevel);
@@ -863,6 +845,33 @@ public:
 	}
 
 
+	/**
+	 * Undo update_max_visible_level_lower_only(): restore the previous
+	 * max-level part of the payload, but only if nobody has lowered it
+	 * further in the meantime
+	 *
+	 * @param edge the edge
+	 * @param mlevel the max-level that was set
+	 * @param old_level the previous max-level
+	 * @return true if the value was restored
+	 */
+	bool restore_max_visible_level(edge_t edge, int mlevel, int old_level) {
+		bool r = false;
+#ifdef LL_DELETIONS
+		_lt.acquire_for(edge);
+		T& v = (*this->edge_table(LL_EDGE_LEVEL(edge)))[LL_EDGE_INDEX(edge)];
+		if ((int) LL_VALUE_MAX_LEVEL(v) == mlevel) {
+			r = true;
+			v = LL_VALUE_CREATE_EXT(
+					LL_VALUE_PAYLOAD(v),
+					old_level);
+		}
+		_lt.release_for(edge);
+#endif
+		return r;
+	}
+
+
 	/**
 	 * Determine if the given node exists in the latest level
 	 *
@@ -924,7 +933,7 @@ public:
 			if (LL_VALUE_MAX_LEVEL(value) == num_levels() && _deletions != NULL) {
 				// We might get here even if the edge was deleted BEFORE the writable
 				// level, but we don't care - the result will be correct nonetheless
-				return _deletions->is_edge_deleted(iter.edge);
+				return !_deletions->is_edge_deleted(edge);
 			}
 #	else
 			return false;
@@ -977,6 +986,8 @@ public:
 			this->_values[level] = NULL;
 		}
 
+		this->_degree_prefix_sums.invalidate(level);
+
 		if (level < this->_perLevelNodes.size()) {
 			this->_perLevelNodes[level] = 0;
 			this->_perLevelAdjLists[level] = 0;
@@ -1089,7 +1100,7 @@ public:
 		size_t tail_index = length;
 		if (pages > 0) {
 			VT_ELEMENT* page = vt->page(pages-1);
-			for (ssize_t i = 0; i < size - pages * LL_ENTRIES_PER_PAGE; i++) {
+			for (ssize_t i = 0; i < size - (pages-1) * LL_ENTRIES_PER_PAGE; i++) {
 				if ((int) LL_EDGE_LEVEL(page[i].adj_list_start) == level) {
 					length++;
 				}
@@ -1133,7 +1144,7 @@ public:
 		if (pages > 0) {
 			VT_ELEMENT* page = vt->page(pages-1);
 			node_t n = (pages-1) << LL_ENTRIES_PER_PAGE_BITS;
-			for (ssize_t i = 0; i < size - pages * LL_ENTRIES_PER_PAGE; i++, n++) {
+			for (ssize_t i = 0; i < size - (pages-1) * LL_ENTRIES_PER_PAGE; i++, n++) {
 				if ((int) LL_EDGE_LEVEL(page[i].adj_list_start) == level) {
 					ids[tail_index] = n;
 					data[tail_index] = page[i];
@@ -1292,14 +1303,34 @@ protected:
 		return false;
 #else
 		if (iter.edge == LL_NIL_EDGE) return false;
+		LL_COUNT(LL_C_DELETION_CHECKS);
 		const T& value = this->edge_table(LL_EDGE_LEVEL(iter.edge))
 			->edge_value(iter.node, LL_EDGE_INDEX(iter.edge));
-		if (LL_VALUE_IS_DELETED(value, iter.max_level)) {
+		return is_value_deleted(value, iter.edge, iter.max_level);
+#endif
+	}
+
+
+	/**
+	 * Determine if the given edge table value denotes an edge that has
+	 * already been deleted as of the given level.
+	 *
+	 * @param value the value from the edge table
+	 * @param edge the edge
+	 * @param max_level the max level for deletions
+	 * @return true if it has already been deleted
+	 */
+	inline bool is_value_deleted(const T& value, edge_t edge, size_t max_level)
+		const {
+#ifndef LL_DELETIONS
+		return false;
+#else
+		if (LL_VALUE_IS_DELETED(value, max_level)) {
 #	ifdef LL_TIMESTAMPS
 			if (LL_VALUE_MAX_LEVEL(value) == num_levels() && _deletions != NULL) {
 				// We might get here even if the edge was deleted BEFORE the writable
 				// level, but we don't care - the result will be correct nonetheless
-				return _deletions->is_edge_deleted(iter.edge);
+				return _deletions->is_edge_deleted(edge);
 			}
 #	else
 			return true;
@@ -1465,7 +1496,9 @@ public:
 		// continues for levels > 0 if the following conditions are met:
 		//   * LL_MLCSR_CONTINUATIONS is enabled
 		//   * If this is not the very first level (Level > 0 in most cases)
-		//   * The adjacency list resides in this level
+		//   * The adjacency list resides in this level (a node with only
+		//     deleted edges keeps pointing to the previous level, and the edge
+		//     table has no space reserved for its continuation)
 		//   * The adjacency list is not copied
 		// If the adjacency list is copied, write the NULL record.
 
@@ -1473,7 +1506,7 @@ public:
 
 #ifdef LL_MLCSR_CONTINUATIONS
 		if (IFE_LL_MLCSR_LEVEL_ID_WRAP(this->_begin.has_prev_level(level), level > 0)
-				&& e.adj_list_start != LL_NIL_EDGE) {
+				&& new_edges > 0 && e.adj_list_start != LL_NIL_EDGE) {
 			size_t t = this->_et_write_index + delta_edges;
 			T* ptr = this->_latest_values->edge_ptr(node, t);
 			LL_XD_PRINT("%4ld) e=%lu wp=%lu, no copy\n", node,
@@ -1814,6 +1847,7 @@ public:
 		assert((ssize_t) this->_minLevel <= (ssize_t) m);
 
 		_begin.set_min_level(m);
+		this->_edge_translation.set_min_level(m);
 
 #	if defined(LL_S_UPDATE_PRECOMPUTED_DEGREES) \
 		|| defined(LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES)
@@ -1984,57 +2018,119 @@ public:
 
 
 	/**
-	 * Start the iterator for the given node
+	 * Get the degree prefix sums of a complete level, which are computed on
+	 * the first use and cached until the level is deleted
 	 *
-	 * @param iter the iterator
-	 * @param n the node
-	 * @param level the level
-	 * @param max_level the max level for deletions
+	 * @param level the level (-1 for the latest level)
+	 * @return the prefix sums, or NULL if there is no such level
 	 */
-	void iter_begin(ll_edge_iterator& iter, node_t n,
-			int level=-1, int max_level=-1) const {
+	const ll_degree_prefix_sums* degree_prefix_sums(int level = -1) {
+		if (level < 0) level = ((int) this->num_levels()) - 1;
+		return this->_degree_prefix_sums.get(*this, level);
+	}
 
-#ifdef LL_COUNTERS
-		g_iter_begin++;
-#endif
 
-#ifdef LL_CHECK_NODE_EXISTS_IN_RO
-#ifndef FORCE_L0
-		if (!this->node_exists(n)) {
-			iter.edge = LL_NIL_EDGE;
-			return;
-		}
-#endif
-#endif
+	/**
+	 * Advise the OS about the upcoming accesses to the adjacency lists of
+	 * the given nodes, such as the next frontier of a traversal. The edge
+	 * table ranges of all levels are sorted and coalesced, so that lists
+	 * that are close to each other are covered by a single call.
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
 
-		iter.owner = LL_I_OWNER_RO_CSR;
-		iter.node = n;
-#ifdef LL_DELETIONS
-		int l = (level == -1) ? this->max_level() : level;
-		iter.max_level = max_level < 0 ? l : max_level;
+		if (count == 0 || this->_latest_begin == NULL) return;
+
+#ifdef LL_MLCSR_CONTINUATIONS
+		size_t continuation_size = sizeof(ll_mlcsr_core__begin_t) / sizeof(T);
+		if (sizeof(ll_mlcsr_core__begin_t) % sizeof(T) != 0) continuation_size++;
+#else
+		size_t continuation_size = 0;
 #endif
 
-		const ll_mlcsr_core__begin_t& b = level == -1
-			? (*this->_latest_begin)[n] : (*this->vertex_table(level))[n];
-		iter.edge = b.adj_list_start;
 
+		// Collect the ranges of the edge table indices, including the
+		// continuation records, by following the vertex tables
+
+		std::vector<std::pair<edge_t, edge_t>> ranges;
+		ranges.reserve(count);
+
+		for (size_t i = 0; i < count; i++) {
+
+			node_t n = nodes[i];
+			if (n >= (node_t) this->_latest_begin->size()) continue;
+
+			const ll_mlcsr_core__begin_t* b = &(*this->_latest_begin)[n];
+
+			while (b->adj_list_start != LL_NIL_EDGE && b->level_length > 0) {
+
+				size_t level = LL_EDGE_LEVEL(b->adj_list_start);
 #ifdef LL_MIN_LEVEL
-		if (LL_EDGE_LEVEL(iter.edge) < (size_t) this->_minLevel) {
-			iter.left = 0;
-			iter.edge = LL_NIL_EDGE;
-			return;
-		}
+				if (level < (size_t) this->_minLevel) break;
 #endif
 
-		iter.left = b.level_length;
+				ranges.push_back(std::pair<edge_t, edge_t>(b->adj_list_start,
+							b->adj_list_start + b->level_length
+							+ continuation_size));
 
-		if (iter.left == 0)
-			iter.edge = LL_NIL_EDGE;
-		else {
-			iter.ptr = this->edge_table(LL_EDGE_LEVEL(iter.edge))
-				->edge_ptr(iter.node, LL_EDGE_INDEX(iter.edge));
-			__builtin_prefetch(iter.ptr);
+				if (level == 0 || this->_begin[level-1] == NULL
+						|| n >= (node_t) this->_begin[level-1]->size()) break;
+				b = &(*this->_begin[level-1])[n];
+			}
+		}
+
+		if (ranges.empty()) return;
+
+
+		// Sort and coalesce; since the level is in the high bits of edge_t,
+		// the ranges get grouped by level
+
+		std::sort(ranges.begin(), ranges.end());
+
+		size_t gap = LL_ADVISE_COALESCE_GAP / sizeof(T);
+		edge_t from = ranges[0].first;
+		edge_t to = ranges[0].second;
+
+		for (size_t i = 1; i <= ranges.size(); i++) {
+
+			if (i < ranges.size()
+					&& LL_EDGE_LEVEL(ranges[i].first) == LL_EDGE_LEVEL(from)
+					&& ranges[i].first <= to + (edge_t) gap) {
+				if (ranges[i].second > to) to = ranges[i].second;
+				continue;
+			}
+
+			this->edge_table(LL_EDGE_LEVEL(from))->advise(LL_EDGE_INDEX(from),
+					LL_EDGE_INDEX(to), advice);
+
+			if (i < ranges.size()) {
+				from = ranges[i].first;
+				to = ranges[i].second;
+			}
 		}
+	}
+
+
+	/**
+	 * Start the iterator for the given node
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 */
+	void iter_begin(ll_edge_iterator& iter, node_t n,
+			int level=-1, int max_level=-1) const {
+
+		LL_COUNT(LL_C_ITER_BEGIN);
+
+		const ll_mlcsr_core__begin_t* b
+			= iter_begin_fragment(iter, n, level, max_level);
+		if (b == NULL) return;
 
 #ifdef LL_DELETIONS
 		if (this->is_edge_deleted(iter)) {
@@ -2048,7 +2144,7 @@ public:
 				IF_LL_PRECOMPUTED_DEGREE(", degree=%ld")
 				IF_LL_DELETIONS(", max_level=%d")
 				"]\n", (long) iter.left
-				IF_LL_PRECOMPUTED_DEGREE(, (long) b.degree)
+				IF_LL_PRECOMPUTED_DEGREE(, (long) b->degree)
 				IF_LL_DELETIONS(, (int) iter.max_level));
 	}
 
@@ -2069,6 +2165,74 @@ public:
 	}
 
 
+	/**
+	 * Start the iterator for the given node at the given position of its
+	 * adjacency list, skipping whole level fragments using their lengths
+	 * instead of visiting the individual edges. The position counts all
+	 * edges stored in the fragments, including the deleted ones, and the
+	 * iterator then proceeds to the first edge at or after it that is not
+	 * deleted.
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param from the position within the adjacency list
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 */
+	void iter_begin_at(ll_edge_iterator& iter, node_t n, size_t from,
+			int level=-1, int max_level=-1) const {
+
+		LL_COUNT(LL_C_ITER_BEGIN);
+
+		const ll_mlcsr_core__begin_t* b
+			= iter_begin_fragment(iter, n, level, max_level);
+		if (b == NULL) return;
+
+		while (iter.edge != LL_NIL_EDGE && from >= iter.left) {
+			from -= iter.left;
+#if defined(FORCE_L0)
+			iter.edge = LL_NIL_EDGE;
+#else
+			// iter_descend() expects the pointer at the last edge
+			iter.ptr = ((T*) iter.ptr) + (iter.left - 1);
+			iter_descend(iter);
+#endif
+		}
+
+		if (iter.edge == LL_NIL_EDGE) return;
+
+		iter.left -= from;
+		iter.edge += from;
+		iter.ptr = ((T*) iter.ptr) + from;
+
+#ifdef LL_DELETIONS
+		if (this->is_edge_deleted(iter)) {
+			node_t n = iter.last_node;
+			iter_next(iter);
+			iter.last_node = n;
+		}
+#endif
+	}
+
+
+	/**
+	 * Start an iterator at the given position and get the next value
+	 * immediately
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param from the position within the adjacency list
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 * @return the next item, or LL_NIL_EDGE if none
+	 */
+	inline edge_t iter_begin_next_at(ll_edge_iterator& iter, node_t n,
+			size_t from, int level=-1, int max_level=-1) const {
+		iter_begin_at(iter, n, from, level, max_level);
+		return iter_next(iter);
+	}
+
+
 	/**
 	 * Determine if there are any more items left
 	 *
@@ -2082,6 +2246,70 @@ public:
 
 private:
 
+	/**
+	 * Position the iterator at the beginning of the first fragment of the
+	 * adjacency list of the given node, without skipping deleted edges
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 * @return the vertex table element, or NULL if there is nothing to iterate
+	 */
+	inline const ll_mlcsr_core__begin_t* iter_begin_fragment(
+			ll_edge_iterator& iter, node_t n, int level, int max_level) const {
+
+		// Set the fields that are otherwise written only on the first
+		// iter_next(), so that an iterator that ends up empty is fully set
+
+		iter.ptr = NULL;
+		iter.last_node = LL_NIL_NODE;
+
+#ifdef LL_CHECK_NODE_EXISTS_IN_RO
+#ifndef FORCE_L0
+		if (!this->node_exists(n)) {
+			iter.edge = LL_NIL_EDGE;
+			return NULL;
+		}
+#endif
+#endif
+
+		iter.owner = LL_I_OWNER_RO_CSR;
+		iter.node = n;
+#ifdef LL_DELETIONS
+		int l = (level == -1) ? this->max_level() : level;
+		iter.max_level = max_level < 0 ? l : max_level;
+#endif
+
+		const ll_mlcsr_core__begin_t& b = level == -1
+			? (*this->_latest_begin)[n] : (*this->vertex_table(level))[n];
+		iter.edge = b.adj_list_start;
+
+#ifdef LL_MIN_LEVEL
+		if (LL_EDGE_LEVEL(iter.edge) < (size_t) this->_minLevel) {
+			iter.left = 0;
+			iter.edge = LL_NIL_EDGE;
+			return NULL;
+		}
+#endif
+
+		iter.left = b.level_length;
+
+		if (iter.left == 0)
+			iter.edge = LL_NIL_EDGE;
+		else {
+			LL_COUNT(LL_C_LEVELS_VISITED);
+			iter.ptr = this->edge_table(LL_EDGE_LEVEL(iter.edge))
+				->edge_ptr(iter.node, LL_EDGE_INDEX(iter.edge));
+			__builtin_prefetch(iter.ptr);
+			IF_LL_BUFFER_POOL(ll_buffer_pool::touch(iter.ptr,
+						iter.left * sizeof(T)));
+		}
+
+		return &b;
+	}
+
+
 	/**
 	 * Descend to the next level
 	 *
@@ -2112,9 +2340,8 @@ private:
 			else {
 #endif
 
-#ifdef LL_COUNTERS
-				g_iter_descend++;
-#endif
+				LL_COUNT(LL_C_ITER_DESCEND);
+				IF_LL_MLCSR_CONTINUATIONS(LL_COUNT(LL_C_CONTINUATIONS));
 
 				iter.left = b.level_length;
 				//
@@ -2123,9 +2350,12 @@ private:
 				if (iter.left == 0)
 					iter.edge = LL_NIL_EDGE;		// HACK!
 				else {
+					LL_COUNT(LL_C_LEVELS_VISITED);
 					iter.ptr = this->edge_table(LL_EDGE_LEVEL(iter.edge))
 						->edge_ptr(iter.node, LL_EDGE_INDEX(iter.edge));
 					__builtin_prefetch(iter.ptr);
+					IF_LL_BUFFER_POOL(ll_buffer_pool::touch(iter.ptr,
+								iter.left * sizeof(T)));
 				}
 #ifdef LL_MIN_LEVEL
 			}
@@ -2144,9 +2374,7 @@ public:
 	 */
 	ITERATOR_DECL edge_t iter_next(ll_edge_iterator& iter) const {
 
-#ifdef LL_COUNTERS
-		g_iter_next++;
-#endif
+		LL_COUNT(LL_C_ITER_NEXT);
 
 #ifdef D_DEBUG_NODE
 		T _v = 0;
@@ -2196,6 +2424,236 @@ public:
 	}
 
 
+	/**
+	 * Start iterating over the adjacency list of the given node one span at
+	 * a time, where a span is a contiguous piece of a level's fragment
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param level the level
+	 * @param max_level the max level for deletions
+	 */
+	void span_begin(ll_edge_iterator& iter, node_t n,
+			int level=-1, int max_level=-1) const {
+
+		LL_COUNT(LL_C_ITER_BEGIN);
+		iter_begin_fragment(iter, n, level, max_level);
+	}
+
+
+	/**
+	 * Get the next span of the adjacency list; the spans can contain deleted
+	 * edges, which can be identified using span_live_mask()
+	 *
+	 * @param iter the iterator
+	 * @param span the output span
+	 * @return true if there was a span, false if at the end
+	 */
+	bool span_next(ll_edge_iterator& iter, ll_adjacency_span& span) const {
+
+		if (iter.edge == LL_NIL_EDGE) return false;
+
+		size_t length = iter.left;
+		if (length > LL_SPAN_MAX_LENGTH) length = LL_SPAN_MAX_LENGTH;
+
+		LL_COUNT_N(LL_C_ITER_NEXT, length);
+
+		span.as_values = (const T*) iter.ptr;
+		span.as_length = length;
+		span.as_edge = iter.edge;
+		span.as_level = (int) LL_EDGE_LEVEL(iter.edge);
+		IF_LL_DELETIONS(span.as_max_level = iter.max_level);
+
+		if (iter.left > length) {
+			iter.left -= length;
+			iter.edge += length;
+			iter.ptr = ((T*) iter.ptr) + length;
+		}
+		else {
+#if defined(FORCE_L0)
+			iter.edge = LL_NIL_EDGE;
+#else
+			// iter_descend() expects the pointer at the last edge
+			iter.ptr = ((T*) iter.ptr) + (length - 1);
+			iter_descend(iter);
+#endif
+		}
+
+		return true;
+	}
+
+
+	/**
+	 * Compute the mask of the edges in a span that are not deleted
+	 *
+	 * @param span the span
+	 * @param mask the output with LL_SPAN_MASK_WORDS words, bit i set if live
+	 * @return the number of edges that are not deleted
+	 */
+	size_t span_live_mask(const ll_adjacency_span& span, uint64_t* mask)
+		const {
+
+#ifndef LL_DELETIONS
+		return ll_adjacency_span_fill_mask(span.as_length, mask);
+#else
+		size_t words = (span.as_length + 63) >> 6;
+		size_t r = 0;
+
+		for (size_t w = 0; w < words; w++) {
+			uint64_t m = 0;
+			size_t end = std::min((w + 1) << 6, span.as_length);
+			for (size_t i = w << 6; i < end; i++) {
+				bool deleted = this->is_value_deleted(span.as_values[i],
+						span.as_edge + i, span.as_max_level);
+				m |= ((uint64_t) !deleted) << (i & 63);
+			}
+			mask[w] = m;
+			r += __builtin_popcountll(m);
+		}
+
+		return r;
+#endif
+	}
+
+
+	/**
+	 * Scan all edges of the graph as of the given level, one level at a
+	 * time, by streaming the edge table of each level in the storage order
+	 * instead of following the adjacency lists of the individual vertices.
+	 * Deleted edges are skipped. The functor is called for each full block
+	 * of edges, concurrently from multiple threads, so this must not be
+	 * called from within a parallel region.
+	 *
+	 * @param f the functor, called as f(const ll_edge_block&)
+	 * @param level the level (-1 for the latest level)
+	 * @param max_level the max level for deletions
+	 */
+	template <class F>
+	void scan(F& f, int level=-1, int max_level=-1) {
+
+		int l = level < 0 ? ((int) this->num_levels()) - 1 : level;
+		if (max_level < 0) max_level = level < 0 ? this->max_level() : level;
+
+#ifdef LL_MIN_LEVEL
+		int min_level = this->_minLevel;
+#else
+		int min_level = 0;
+#endif
+
+		for (int i = min_level; i <= l; i++) {
+			scan_level(i, f, max_level);
+		}
+	}
+
+
+	/**
+	 * Scan the edges that are stored in the edge table of the given level,
+	 * i.e. the adjacency list fragments that were added in this level, in
+	 * the storage order, skipping the edges deleted as of max_level. Each
+	 * thread streams a contiguous range of the edge table at a time.
+	 *
+	 * @param level the level
+	 * @param f the functor, called as f(const ll_edge_block&)
+	 * @param max_level the max level for deletions
+	 */
+	template <class F>
+	void scan_level(int level, F& f, int max_level) {
+
+		if (!this->_begin.level_exists(level)) return;
+
+
+		// Use the sparse representation of the vertex table if available,
+		// or otherwise visit only the nodes modified in this level
+
+		if (this->has_sparse_representation(level)) {
+			size_t length = this->sparse_length(level);
+			const node_t* ids = this->sparse_node_ids(level);
+			const ll_mlcsr_core__begin_t* data = this->sparse_node_data(level);
+
+#			pragma omp parallel
+			{
+				ll_edge_block block;
+				block.eb_length = 0;
+				block.eb_level = level;
+
+#				pragma omp for schedule(dynamic,4096)
+				for (size_t i = 0; i < length; i++) {
+					scan_fragment(ids[i], data[i], block, max_level, f);
+				}
+
+				if (block.eb_length > 0) f(block);
+			}
+		}
+		else {
+			auto vt = this->vertex_table(level);
+
+#			pragma omp parallel
+			{
+				ll_edge_block block;
+				block.eb_length = 0;
+				block.eb_level = level;
+
+#				pragma omp for schedule(dynamic,1)
+				for (node_t s = 0; s < (node_t) vt->size(); s += 4096) {
+					ll_vertex_iterator vi;
+					for (node_t n = vt->modified_node_iter_begin_next(vi, s,
+								s + 4096);
+							n != LL_NIL_NODE;
+							n = vt->modified_node_iter_next(vi)) {
+						scan_fragment(n, (*vt)[n], block, max_level, f);
+					}
+				}
+
+				if (block.eb_length > 0) f(block);
+			}
+		}
+	}
+
+
+private:
+
+	/**
+	 * Append the live edges of the given node's fragment in the block's
+	 * level to the block, passing each full block to the functor
+	 *
+	 * @param n the node
+	 * @param b the vertex table element
+	 * @param block the block
+	 * @param max_level the max level for deletions
+	 * @param f the functor
+	 */
+	template <class F>
+	inline void scan_fragment(node_t n, const ll_mlcsr_core__begin_t& b,
+			ll_edge_block& block, int max_level, F& f) {
+
+		if (b.adj_list_start == LL_NIL_EDGE || b.level_length == 0) return;
+		if ((int) LL_EDGE_LEVEL(b.adj_list_start) != block.eb_level) return;
+
+		const T* ptr = this->edge_table(block.eb_level)
+			->edge_ptr(n, LL_EDGE_INDEX(b.adj_list_start));
+		IF_LL_BUFFER_POOL(ll_buffer_pool::touch(ptr,
+					b.level_length * sizeof(T)));
+
+		for (size_t i = 0; i < b.level_length; i++) {
+			edge_t e = b.adj_list_start + i;
+			if (this->is_value_deleted(ptr[i], e, max_level)) continue;
+
+			size_t k = block.eb_length++;
+			block.eb_nodes[k] = n;
+			block.eb_neighbors[k] = LL_VALUE_PAYLOAD(ptr[i]);
+			block.eb_edges[k] = e;
+
+			if (block.eb_length == LL_EDGE_BLOCK_LENGTH) {
+				f(block);
+				block.eb_length = 0;
+			}
+		}
+	}
+
+
+public:
+
+
 	/**
 	 * Start the iterator for the given node, but only within this level
 	 *
@@ -2210,6 +2668,8 @@ public:
 
 		iter.owner = LL_I_OWNER_RO_CSR;
 		iter.node = n;
+		iter.ptr = NULL;
+		iter.last_node = LL_NIL_NODE;
 
 		IF_LL_DELETIONS(iter.max_level = max_level < 0 ? level : max_level);
 
@@ -2244,6 +2704,8 @@ public:
 			iter.ptr = this->edge_table(LL_EDGE_LEVEL(iter.edge))
 				->edge_ptr(iter.node, LL_EDGE_INDEX(iter.edge));
 			__builtin_prefetch(iter.ptr);
+			IF_LL_BUFFER_POOL(ll_buffer_pool::touch(iter.ptr,
+						iter.left * sizeof(T)));
 		}
 
 #ifdef LL_DELETIONS
@@ -48,7 +48,9 @@
 #include <cassert>
 #include <cstdio>
 
+#include "llama/ll_counters.h"
 #include "llama/ll_growable_array.h"
+#include "llama/ll_mem_policy.h"
 
 #ifndef LL_PM_ALLOCATION_STEP_BITS
 #define LL_PM_ALLOCATION_STEP_BITS			8
@@ -83,7 +85,7 @@ class ll_page_manager {
 
 	struct _pages_deallocator {
 		void operator() (_pages_t* p) {
-			free(p);
+			ll_large_free(p);
 		}
 	};
 
@@ -91,6 +93,7 @@ class ll_page_manager {
 
 	ssize_t _zero_page;
 	ssize_t* _free_list_next;
+	int _num_free_lists;
 
 
 #ifdef LL_PM_COUNTERS
@@ -120,10 +123,14 @@ public:
 		_lock = 0;
 		_zero_page = -1;
 
+		// One free list per thread, but the number of threads can change
+		// later, so threads beyond this number share the free lists
+
+		_num_free_lists = omp_get_max_threads();
 		_free_list_next = (ssize_t*) malloc(sizeof(ssize_t)
-				* 8 * omp_get_max_threads());
+				* 8 * _num_free_lists);
 		memset(_free_list_next, 0xff, sizeof(ssize_t)
-				* 8 * omp_get_max_threads());
+				* 8 * _num_free_lists);
 		
 #ifdef LL_PM_COUNTERS
 		_counter_free = 0;
@@ -289,6 +296,7 @@ public:
 
 		size_t p = allocate(out, true);
 		memcpy(*out, src_ptr, _page_bytes);
+		LL_COUNT(LL_C_COW_PAGE_COPIES);
 
 		release_page(src_id);
 
@@ -311,8 +319,8 @@ public:
 		ssize_t n = __sync_add_and_fetch(&p->refcounts[index_inner], -1);
 		assert(n >= 0);
 
-		if (n == 0 && n != _zero_page) {
-			int i = omp_get_thread_num() << 3;
+		if (n == 0 && (ssize_t) id != _zero_page) {
+			int i = (omp_get_thread_num() % _num_free_lists) << 3;
 
 #ifdef LL_PM_COUNTERS
 			__sync_add_and_fetch(&_counter_free, (size_t) 1);
@@ -433,8 +441,8 @@ protected:
 
 		// First check the free-list
 		
-		int max = omp_get_max_threads();
-		int t = omp_get_thread_num();
+		int max = _num_free_lists;
+		int t = omp_get_thread_num() % _num_free_lists;
 
 		for (int i = 0; i < max; i++) {
 			int k = ((t + i) % max) << 3;
@@ -492,7 +500,7 @@ protected:
 				while (index_outer >= _pages.size()) {
 					size_t size = sizeof(_pages_t)
 						+ LL_PM_ALLOCATION_STEP * _page_bytes;
-					p = (_pages_t*) malloc(size);
+					p = (_pages_t*) ll_large_alloc(size);
 					if (p == NULL) {
 						fprintf(stderr, "*** Out of memory ***\n");
 						abort();
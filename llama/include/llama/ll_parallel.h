@@ -0,0 +1,572 @@
+/*
+ * ll_parallel.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_PARALLEL_H_
+#define LL_PARALLEL_H_
+
+#include "llama/ll_common.h"
+#include "llama/ll_lock.h"
+#include "llama/ll_utils.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+
+/*
+ * Edge-balanced parallel loops
+ *
+ * A plain "#pragma omp for schedule(dynamic,4096)" over the node IDs hands
+ * out chunks of equal node counts, which on a power-law graph means that a
+ * handful of chunks carry most of the edges and a single hub can keep one
+ * thread busy long after the others went idle. The classes below instead
+ * cut the node range into chunks of roughly equal edge counts using the
+ * degree prefix sums of a level (which are immutable once the level is
+ * complete, so they are computed once and cached by the CSR), and optionally
+ * split a single very-high-degree node into several chunks, each of which
+ * covers a contiguous range of the node's adjacency list.
+ *
+ * Usage:
+ *
+ *   ll_edge_balanced_partition P(G.out_degree_prefix_sums(), G.max_nodes(),
+ *           true);
+ *
+ *   #pragma omp parallel for schedule(dynamic,1)
+ *   for (size_t c = 0; c < P.size(); c++) {
+ *       const ll_edge_balanced_chunk& chunk = P[c];
+ *       for (node_t n = chunk.ec_begin; n < chunk.ec_end; n++) {
+ *           ll_foreach_out_range(w, G, n, chunk.ec_edge_begin,
+ *                   chunk.ec_edge_end) { ... }
+ *       }
+ *   }
+ *
+ * A chunk that splits a node always has ec_end == ec_begin + 1, so the
+ * per-node work outside of the edge loop needs to be either idempotent or
+ * restricted to the chunk with ec_edge_begin == 0.
+ */
+
+
+
+//==========================================================================//
+// Class: ll_degree_prefix_sums                                             //
+//==========================================================================//
+
+/**
+ * The degree prefix sums of a level: element n is the sum of the degrees of
+ * nodes 0 ... n-1, so there are max_nodes(level) + 1 elements. The sums can
+ * be also computed over a list of nodes, in which case the "nodes" are the
+ * indices into the list.
+ */
+class ll_degree_prefix_sums {
+
+	/// The prefix sums
+	size_t* _sums;
+
+	/// The number of nodes
+	node_t _nodes;
+
+
+public:
+
+	/**
+	 * Compute the degree prefix sums of a complete level of a CSR
+	 *
+	 * @param csr the CSR
+	 * @param level the level
+	 */
+	template <class CSR>
+	ll_degree_prefix_sums(CSR& csr, int level) {
+		level_degree<CSR> d(csr, level);
+		init(csr.max_nodes(level), d);
+	}
+
+
+	/**
+	 * Compute the out-degree prefix sums of a list of nodes, such as of a
+	 * sparse frontier, so that element i is the sum of the out-degrees of
+	 * nodes[0] ... nodes[i-1]
+	 *
+	 * @param G the graph
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 */
+	template <class Graph>
+	ll_degree_prefix_sums(Graph& G, const node_t* nodes, size_t count) {
+		list_out_degree<Graph> d(G, nodes);
+		init(count, d);
+	}
+
+
+	/**
+	 * Destroy the object
+	 */
+	~ll_degree_prefix_sums() {
+		free(_sums);
+	}
+
+
+	/**
+	 * Get the number of nodes
+	 *
+	 * @return the number of nodes
+	 */
+	inline node_t nodes() const {
+		return _nodes;
+	}
+
+
+	/**
+	 * Get the total number of edges
+	 *
+	 * @return the sum of all degrees
+	 */
+	inline size_t edges() const {
+		return _sums[_nodes];
+	}
+
+
+	/**
+	 * Get the sum of the degrees of all nodes before the given node
+	 *
+	 * @param n the node, between 0 and nodes() inclusive
+	 * @return the prefix sum
+	 */
+	inline size_t operator[] (node_t n) const {
+		return _sums[n];
+	}
+
+
+	/**
+	 * Get the degree of a node
+	 *
+	 * @param n the node
+	 * @return the degree
+	 */
+	inline size_t degree(node_t n) const {
+		return _sums[n + 1] - _sums[n];
+	}
+
+
+	/**
+	 * Return the in-memory size
+	 *
+	 * @return the number of bytes occupied by this instance
+	 */
+	size_t in_memory_size() const {
+		return sizeof(*this) + sizeof(size_t) * (_nodes + 1);
+	}
+
+
+private:
+
+	/**
+	 * The degree of a node at the given level of a CSR
+	 */
+	template <class CSR>
+	struct level_degree {
+
+		CSR& ld_csr;
+		int ld_level;
+
+		level_degree(CSR& csr, int level) : ld_csr(csr), ld_level(level) {}
+
+		inline size_t operator() (node_t n) const {
+			return ld_csr.degree(n, ld_level);
+		}
+	};
+
+
+	/**
+	 * The out-degree of the i-th node of a list
+	 */
+	template <class Graph>
+	struct list_out_degree {
+
+		Graph& lo_graph;
+		const node_t* lo_nodes;
+
+		list_out_degree(Graph& G, const node_t* nodes)
+			: lo_graph(G), lo_nodes(nodes) {}
+
+		inline size_t operator() (node_t i) const {
+			return lo_graph.out_degree(lo_nodes[i]);
+		}
+	};
+
+
+	/**
+	 * Compute the prefix sums
+	 *
+	 * @param count the number of elements
+	 * @param degree the function that returns the degree of an element
+	 */
+	template <class D>
+	void init(size_t count, D& degree) {
+
+		_nodes = (node_t) count;
+		_sums = (size_t*) malloc(sizeof(size_t) * (_nodes + 1));
+		if (_sums == NULL) {
+			LL_E_PRINT("Out of memory\n");
+			abort();
+		}
+
+
+		// Per-block exclusive scans, then add the block offsets
+
+		size_t num_blocks = omp_get_max_threads();
+		std::vector<size_t> offsets(num_blocks + 1, 0);
+
+#pragma omp parallel for schedule(static,1)
+		for (size_t b = 0; b < num_blocks; b++) {
+			node_t from = (node_t) (b * _nodes / num_blocks);
+			node_t to = (node_t) ((b + 1) * _nodes / num_blocks);
+			size_t s = 0;
+			for (node_t n = from; n < to; n++) {
+				_sums[n] = s;
+				s += degree(n);
+			}
+			offsets[b + 1] = s;
+		}
+
+		for (size_t b = 0; b < num_blocks; b++) {
+			offsets[b + 1] += offsets[b];
+		}
+
+#pragma omp parallel for schedule(static,1)
+		for (size_t b = 1; b < num_blocks; b++) {
+			node_t from = (node_t) (b * _nodes / num_blocks);
+			node_t to = (node_t) ((b + 1) * _nodes / num_blocks);
+			for (node_t n = from; n < to; n++) {
+				_sums[n] += offsets[b];
+			}
+		}
+
+		_sums[_nodes] = offsets[num_blocks];
+	}
+
+
+	/**
+	 * Disable the copy constructor
+	 */
+	ll_degree_prefix_sums(const ll_degree_prefix_sums& other);
+
+
+	/**
+	 * Disable the assignment operator
+	 */
+	ll_degree_prefix_sums& operator= (const ll_degree_prefix_sums& other);
+};
+
+
+
+//==========================================================================//
+// Class: ll_degree_prefix_sums_cache                                       //
+//==========================================================================//
+
+/**
+ * The per-level cache of the degree prefix sums of a CSR
+ */
+class ll_degree_prefix_sums_cache {
+
+	/// The per-level prefix sums (NULL if not computed yet)
+	std::vector<ll_degree_prefix_sums*> _levels;
+
+	/// The lock
+	ll_spinlock_t _lock;
+
+
+public:
+
+	/**
+	 * Create a new instance of ll_degree_prefix_sums_cache
+	 */
+	ll_degree_prefix_sums_cache() {
+		_lock = 0;
+	}
+
+
+	/**
+	 * Destroy the cache
+	 */
+	~ll_degree_prefix_sums_cache() {
+		for (size_t l = 0; l < _levels.size(); l++) {
+			if (_levels[l] != NULL) delete _levels[l];
+		}
+	}
+
+
+	/**
+	 * Get the prefix sums of the given level, computing them on the first
+	 * use; the level must be complete
+	 *
+	 * @param csr the CSR that owns this cache
+	 * @param level the level
+	 * @return the prefix sums, or NULL if the level does not exist
+	 */
+	template <class CSR>
+	const ll_degree_prefix_sums* get(CSR& csr, int level) {
+
+		if (level < 0 || level >= (int) csr.num_levels()) return NULL;
+
+		ll_spinlock_acquire(&_lock);
+
+		if ((size_t) level >= _levels.size()) _levels.resize(level + 1, NULL);
+		if (_levels[level] == NULL) {
+			_levels[level] = new ll_degree_prefix_sums(csr, level);
+		}
+
+		ll_degree_prefix_sums* r = _levels[level];
+		ll_spinlock_release(&_lock);
+
+		return r;
+	}
+
+
+	/**
+	 * Drop the prefix sums of a level, such as when the level is deleted
+	 *
+	 * @param level the level
+	 */
+	void invalidate(size_t level) {
+
+		ll_spinlock_acquire(&_lock);
+
+		if (level < _levels.size() && _levels[level] != NULL) {
+			delete _levels[level];
+			_levels[level] = NULL;
+		}
+
+		ll_spinlock_release(&_lock);
+	}
+
+
+	/**
+	 * Return the in-memory size
+	 *
+	 * @return the number of bytes occupied by this instance
+	 */
+	size_t in_memory_size() const {
+
+		size_t s = sizeof(*this)
+			+ _levels.capacity() * sizeof(ll_degree_prefix_sums*);
+
+		for (size_t l = 0; l < _levels.size(); l++) {
+			if (_levels[l] != NULL) s += _levels[l]->in_memory_size();
+		}
+
+		return s;
+	}
+
+
+private:
+
+	/**
+	 * Disable the copy constructor
+	 */
+	ll_degree_prefix_sums_cache(const ll_degree_prefix_sums_cache& other);
+
+
+	/**
+	 * Disable the assignment operator
+	 */
+	ll_degree_prefix_sums_cache& operator=
+		(const ll_degree_prefix_sums_cache& other);
+};
+
+
+
+//==========================================================================//
+// Class: ll_edge_balanced_partition                                        //
+//==========================================================================//
+
+/**
+ * A chunk of an edge-balanced partition
+ */
+struct ll_edge_balanced_chunk {
+
+	/// The first node
+	node_t ec_begin;
+
+	/// The node after the last node
+	node_t ec_end;
+
+	/// The position of the first edge within each node's adjacency list
+	size_t ec_edge_begin;
+
+	/// The position after the last edge (SIZE_MAX for the rest of the list)
+	size_t ec_edge_end;
+};
+
+
+/**
+ * A partition of the node range into chunks of roughly equal work
+ *
+ * The cost of a node is its degree plus one (for the per-node work), so
+ * that long runs of low-degree nodes still end up in reasonably sized
+ * chunks. Nodes beyond the range of the prefix sums, such as the nodes that
+ * were added to the writable graph since the last checkpoint, are treated as
+ * having degree 0; the degrees only need to be approximately right, since
+ * the last chunk of a split node always extends to the end of its list.
+ */
+class ll_edge_balanced_partition {
+
+	/// The chunks
+	std::vector<ll_edge_balanced_chunk> _chunks;
+
+	/// The prefix sums (can be NULL)
+	const ll_degree_prefix_sums* _sums;
+
+	/// The number of nodes covered by the prefix sums
+	node_t _sums_nodes;
+
+
+public:
+
+	/**
+	 * Create the partition
+	 *
+	 * @param sums the degree prefix sums (NULL to balance just the nodes)
+	 * @param max_nodes the number of nodes to cover
+	 * @param split_nodes true to split the nodes with a very high degree
+	 * @param chunks_per_thread the target number of chunks per thread
+	 * @param min_chunk_cost the minimum cost (edges + nodes) of a chunk
+	 */
+	ll_edge_balanced_partition(const ll_degree_prefix_sums* sums,
+			node_t max_nodes, bool split_nodes = false,
+			size_t chunks_per_thread = 16, size_t min_chunk_cost = 2048) {
+
+		_sums = sums;
+		_sums_nodes = sums == NULL ? 0 : std::min(sums->nodes(), max_nodes);
+
+		if (max_nodes <= 0) return;
+
+		size_t target = chunks_per_thread * omp_get_max_threads();
+		size_t w = (cost(max_nodes) + target - 1) / target;
+		if (w < min_chunk_cost) w = min_chunk_cost;
+
+		ll_edge_balanced_chunk c;
+		node_t start = 0;
+
+		while (start < max_nodes) {
+
+			// Find the first node at which the cost reaches the target
+
+			size_t goal = cost(start) + w;
+			node_t lo = start + 1;
+			node_t hi = max_nodes;
+			while (lo < hi) {
+				node_t mid = lo + (hi - lo) / 2;
+				if (cost(mid) >= goal) hi = mid; else lo = mid + 1;
+			}
+			node_t end = lo;
+
+
+			// Start a new chunk before a heavy node, so that it can be split
+
+			if (end - 1 > start && degree(end - 1) > w) end--;
+
+			c.ec_begin = start;
+			c.ec_end = end;
+			c.ec_edge_begin = 0;
+			c.ec_edge_end = SIZE_MAX;
+
+			if (split_nodes && end == start + 1 && degree(start) > w) {
+				size_t d = degree(start);
+				size_t pieces = (d + w - 1) / w;
+				for (size_t p = 0; p < pieces; p++) {
+					c.ec_edge_begin = p * d / pieces;
+					c.ec_edge_end = p + 1 == pieces
+						? SIZE_MAX : (p + 1) * d / pieces;
+					_chunks.push_back(c);
+				}
+			}
+			else {
+				_chunks.push_back(c);
+			}
+
+			start = end;
+		}
+	}
+
+
+	/**
+	 * Get the number of chunks
+	 *
+	 * @return the number of chunks
+	 */
+	inline size_t size() const {
+		return _chunks.size();
+	}
+
+
+	/**
+	 * Get a chunk
+	 *
+	 * @param index the chunk index
+	 * @return the chunk
+	 */
+	inline const ll_edge_balanced_chunk& operator[] (size_t index) const {
+		return _chunks[index];
+	}
+
+
+private:
+
+	/**
+	 * Get the degree of a node according to the prefix sums
+	 *
+	 * @param n the node
+	 * @return the degree
+	 */
+	inline size_t degree(node_t n) const {
+		return n < _sums_nodes ? _sums->degree(n) : 0;
+	}
+
+
+	/**
+	 * Get the total cost of the nodes before the given node
+	 *
+	 * @param n the node
+	 * @return the cost
+	 */
+	inline size_t cost(node_t n) const {
+		if (_sums_nodes == 0) return n;
+		return n + (*_sums)[n < _sums_nodes ? n : _sums_nodes];
+	}
+};
+
+#endif
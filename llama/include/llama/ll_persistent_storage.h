@@ -37,17 +37,26 @@
 #ifndef LL_PERSISTENT_STORAGE_H_
 #define LL_PERSISTENT_STORAGE_H_
 
+#include "llama/ll_async_io.h"
+#include "llama/ll_buffer_pool.h"
 #include "llama/ll_common.h"
+#include "llama/ll_counters.h"
 #include "llama/ll_growable_array.h"
+#include "llama/ll_utils.h"
 
 #include <sys/stat.h>
 #include <sys/types.h>
 
+#include <algorithm>
 #include <cctype>
 #include <cstring>
 #include <dirent.h>
+#include <map>
+#include <pthread.h>
 #include <string>
 #include <unistd.h>
+#include <utility>
+#include <vector>
 
 
 /*
@@ -64,6 +73,18 @@
 #define LL_PERSISTENCE_SEPARATOR			"__"
 #define LL_PERSISTENCE_HEADER_INDICATOR		"-"
 
+#define LL_PERSISTENCE_MANIFEST				"manifest.idx"
+#define LL_PERSISTENCE_MANIFEST_MAGIC		0x31464d414d414c4cul	/* LLAMAMF1 */
+
+#define LL_PERSISTENCE_ROOT					"root-%d.idx"
+#define LL_PERSISTENCE_ROOT_MAGIC			0x315452414d414c4cul	/* LLAMART1 */
+
+#define LL_PERSISTENCE_FD_NOT_OPEN			(-2)
+
+#ifndef LL_PERSISTENT_COW_SLAB_PAGES
+#define LL_PERSISTENT_COW_SLAB_PAGES		16
+#endif
+
 
 /*
  * Persistence On-Disk Format
@@ -129,6 +150,61 @@
  * TODO Move the edge table to a separate file, which would enable the users
  * to create it without knowing its size in advance -- which is for example
  * useful for junction tree construction.
+ *
+ *
+ * Manifest
+ * --------
+ *
+ * The database directory can also contain LL_PERSISTENCE_MANIFEST, which
+ * caches everything that opening the database would otherwise discover by
+ * listing the directory and opening and reading every file: the list of
+ * contexts, their headers, and the lengths and level metadata of all of
+ * their ML files. The ML files are then opened only once they are accessed.
+ *
+ * +--------+---------+-----+---------+
+ * | Header | Entry 0 | ... | Entry N |
+ * +--------+---------+-----+---------+
+ *
+ * The header is ll_persistence_manifest_header_t, and each entry consists of
+ * the namespace, the context name, the header contents, and the list of
+ * ll_persistence_manifest_file_t records, each prefixed by its length.
+ *
+ * The manifest is written atomically (through a temporary file and a rename)
+ * by ll_persistent_storage::write_manifest(), and it is deleted before the
+ * first subsequent modification of any file in the database, so that the
+ * manifest is either up to date or missing. If it is missing or invalid, the
+ * database falls back to scanning the directory.
+ *
+ *
+ * Root Record
+ * -----------
+ *
+ * A level becomes visible in its ML file as soon as its level metadata are
+ * written, which happens before the level is complete, so the ML files alone
+ * cannot tell a finished level from the remains of an interrupted checkpoint
+ * or load. The root record publishes the number of complete levels of each
+ * context; it is rewritten only after the data of the new levels are durable.
+ *
+ * +--------+---------+-----+---------+
+ * | Header | Entry 0 | ... | Entry N |
+ * +--------+---------+-----+---------+
+ *
+ * The header is ll_persistence_root_header_t, and each entry consists of the
+ * number of published levels followed by the length and the file name prefix
+ * of the context. There are two copies of the root record, LL_PERSISTENCE_ROOT
+ * with 0 and 1, written in turns and each carrying a version number and
+ * a checksum, so that a torn write leaves the previous version intact. The
+ * database opens with the valid copy with the higher version, and each
+ * context discards the metadata of the levels past its published count when
+ * it is opened, without reading any level data. The space of a discarded
+ * level is not reclaimed.
+ *
+ * A database with no valid copy of the root record, which includes one that
+ * was created before the root record existed, is seeded with every level
+ * that has level metadata in its ML files, and this seed is published right
+ * away. A level that such a database left half-written is therefore
+ * accepted on the first open; the open warns about it, since the database
+ * should be reloaded if it may have been interrupted.
  */
 
 
@@ -230,10 +306,107 @@ struct ll_length_and_data {
 
 
 
+//==========================================================================//
+// Class: ll_persistence_level_meta                                         //
+//==========================================================================//
+
+/**
+ * The metadata for each level
+ */
+struct ll_persistence_level_meta {
+
+	unsigned lm_level;			// The level
+	unsigned lm_sub_level;		// The sub-level for 2D level structures
+
+	unsigned lm_header_size;	// In non-zero, the length of the header
+	unsigned lm_base_level;		// If non-zero, the level that this copies
+
+	size_t lm_vt_size;			// Vertex table size (number of nodes)
+	size_t lm_vt_partitions;	// The number of vertex table chunks/pages
+
+	size_t lm_vt_offset;		// VT offset within the level file
+	size_t lm_header_offset;	// The header offset
+};
+
+
+
+//==========================================================================//
+// Manifest Structures                                                      //
+//==========================================================================//
+
+/**
+ * The header of the manifest file
+ */
+typedef struct {
+	uint64_t mh_magic;				// LL_PERSISTENCE_MANIFEST_MAGIC
+	uint64_t mh_levels_per_file;	// LL_LEVELS_PER_ML_FILE
+	uint64_t mh_level_meta_size;	// sizeof(ll_persistence_level_meta)
+	uint64_t mh_num_entries;		// The number of contexts
+	uint64_t mh_length;				// The total length of the file
+} ll_persistence_manifest_header_t;
+
+
+/**
+ * The header of a root record
+ */
+typedef struct {
+	uint64_t rh_magic;				// LL_PERSISTENCE_ROOT_MAGIC
+	uint64_t rh_version;			// The publication sequence number
+	uint64_t rh_num_entries;		// The number of contexts
+	uint64_t rh_length;				// The total length of the record
+	uint32_t rh_checksum;			// ll_checksum() with this field zeroed
+	uint32_t rh_reserved;
+} ll_persistence_root_header_t;
+
+
+/**
+ * The manifest record of an ML file
+ */
+typedef struct {
+	uint64_t mf_index;				// The ML file index
+	uint64_t mf_length;				// The length of the file
+	ll_persistence_level_meta mf_level_meta[LL_LEVELS_PER_ML_FILE];
+} ll_persistence_manifest_file_t;
+
+
+/**
+ * The manifest entry of a persistence context
+ */
+struct ll_persistence_manifest_entry {
+
+	/// The namespace
+	std::string me_namespace;
+
+	/// The context name
+	std::string me_name;
+
+	/// Whether the context has a header
+	bool me_has_header;
+
+	/// The contents of the header
+	std::string me_header;
+
+	/// The ML files
+	std::vector<ll_persistence_manifest_file_t> me_files;
+
+
+	/**
+	 * Create an empty entry
+	 */
+	ll_persistence_manifest_entry() {
+		me_has_header = false;
+	}
+};
+
+
+
 //==========================================================================//
 // Class: ll_persistent_storage                                             //
 //==========================================================================//
 
+class ll_persistence_context;
+
+
 /**
  * The persistent storage
  */
@@ -250,6 +423,19 @@ public:
 
 		struct stat st;
 
+		_manifest_lock = 0;
+		_manifest_file_lock = 0;
+		_manifest_valid = false;
+		_modifications = 0;
+
+		_deferred_syncs = 0;
+		_pending_syncs_lock = 0;
+
+		_root_lock = 0;
+		_root_version = 0;
+		_root_dirty = false;
+		pthread_mutex_init(&_publish_lock, NULL);
+
 
 		// Set the database directory
 
@@ -276,6 +462,26 @@ public:
 				abort();
 			}
 		}
+
+
+		// Load the manifest, or reconstruct it from the directory contents
+
+		if (!load_manifest()) scan_directory();
+
+
+		// Load the root record, or publish all existing levels if there is
+		// none, such as in a new database or in one that predates the root
+		// record (see "Root Record" above)
+
+		if (!load_root()) {
+			seed_root();
+			if (!_root.empty()) {
+				LL_W_PRINT("No valid root record in %s; publishing all %lu "
+						"existing context(s) as complete\n",
+						_directory.c_str(), _root.size());
+			}
+			publish_root();
+		}
 	}
 
 
@@ -283,6 +489,7 @@ public:
 	 * Destroy the instance of the class
 	 */
 	~ll_persistent_storage() {
+		pthread_mutex_destroy(&_publish_lock);
 	}
 
 
@@ -297,360 +504,1028 @@ public:
 
 
 	/**
-	 * Get the collection of persience_context names within the given namespace
+	 * Get the I/O engine shared by all persistence contexts
 	 *
-	 * @param ns the namespace
-	 * @return the collection of names
+	 * @return the I/O engine
 	 */
-	std::vector<std::string> list_context_names(const char* ns) {
-
-		std::vector<std::string> v;
+	inline ll_async_io& io() {
+		return _io;
+	}
 
-		DIR* dir;
-		dirent* ent;
+#ifdef LL_BUFFER_POOL
 
-		if ((dir = opendir(directory())) == NULL) {
-			perror("opendir");
-			LL_E_PRINT("Cannot open the database directory\n");
-			abort();
-		}
+	/**
+	 * Get the buffer pool that bounds the residency of the mapped levels
+	 *
+	 * @return the buffer pool
+	 */
+	inline ll_buffer_pool& buffer_pool() {
+		return _buffer_pool;
+	}
+#endif
 
-		std::string p = ns;
-		p += LL_PERSISTENCE_SEPARATOR;
-		size_t l = p.length();
 
-		while ((ent = readdir(dir)) != NULL) {
-			size_t dl = strlen(ent->d_name);
-			if (dl > l + 4
-					&& strncmp(ent->d_name, p.c_str(), l) == 0
-					&& strncmp(ent->d_name + (dl - 4), ".dat", 4) == 0) {
+	/**
+	 * Determine whether the manifest on disk is up to date
+	 *
+	 * @return true if it is valid
+	 */
+	inline bool has_valid_manifest() const {
+		return _manifest_valid;
+	}
 
-				char* s = strdup(ent->d_name + l);
-				*(s + (strlen(s) - 4)) = '\0';
 
-				char* x = strstr(s, LL_PERSISTENCE_SEPARATOR);
-				if (x == NULL) {
-					free(s);
-					continue;
-				}
-				*x = '\0';
+	/**
+	 * Get the collection of persience_context names within the given namespace
+	 *
+	 * @param ns the namespace
+	 * @return the collection of names
+	 */
+	std::vector<std::string> list_context_names(const char* ns) {
 
-				std::string str = s;
-				free(s);
+		std::vector<std::string> v;
 
-				bool found = false;
-				for (size_t i = 0; i < v.size(); i++) {
-					if (v[i] == str) {
-						found = true;
-						break;
-					}
-				}
+		ll_spinlock_acquire(&_manifest_lock);
+		collect_contexts();
 
-				if (!found) v.push_back(str);
+		for (std::map<std::string, ll_persistence_manifest_entry>::iterator
+				it = _manifest.begin(); it != _manifest.end(); it++) {
+			const ll_persistence_manifest_entry& e = it->second;
+			if (e.me_namespace == ns
+					&& (e.me_has_header || !e.me_files.empty())) {
+				v.push_back(e.me_name);
 			}
 		}
 
-		closedir(dir);
+		ll_spinlock_release(&_manifest_lock);
 		return v;
 	}
 
 
-private:
-
-	/// The database directory
-	std::string _directory;
-};
-
+	/**
+	 * Find the manifest entry of the given context
+	 *
+	 * @param prefix the file name prefix of the context
+	 * @param out the output entry
+	 * @return true if found
+	 */
+	bool find_manifest_entry(const char* prefix,
+			ll_persistence_manifest_entry* out) {
 
+		ll_spinlock_acquire(&_manifest_lock);
+		collect_contexts();
 
-//==========================================================================//
-// Class: ll_persistence_context                                            //
-//==========================================================================//
+		std::map<std::string, ll_persistence_manifest_entry>::iterator it
+			= _manifest.find(prefix);
+		bool found = it != _manifest.end();
+		if (found) *out = it->second;
 
-/**
- * A persistence context, such as outgoing edges, incoming edges, or a
- * property. This is similar to a database table.
- *
- * A context consists of one or more multi-level (ML) files, each representing
- * at most LL_LEVELS_PER_ML_FILE consecutive levels. Each ML file starts with
- * an index table with the metadata for each of those levels.
- */
-class ll_persistence_context {
+		ll_spinlock_release(&_manifest_lock);
+		return found;
+	}
 
-protected:
 
 	/**
-	 * The metadata for each level
+	 * Read the header of the given context from the manifest
+	 *
+	 * @param prefix the file name prefix of the context
+	 * @return length + data (to be freed by the caller), or NULL if none
 	 */
-	struct level_meta {
-
-		unsigned lm_level;			// The level
-		unsigned lm_sub_level;		// The sub-level for 2D level structures
+	ll_length_and_data* read_header(const char* prefix) {
 
-		unsigned lm_header_size;	// In non-zero, the length of the header
-		unsigned lm_base_level;		// If non-zero, the level that this copies
+		ll_length_and_data* ld = NULL;
 
-		size_t lm_vt_size;			// Vertex table size (number of nodes)
-		size_t lm_vt_partitions;	// The number of vertex table chunks/pages
+		ll_spinlock_acquire(&_manifest_lock);
+		collect_contexts();
 
-		size_t lm_vt_offset;		// VT offset within the level file
-		size_t lm_header_offset;	// The header offset
-	};
+		std::map<std::string, ll_persistence_manifest_entry>::iterator it
+			= _manifest.find(prefix);
+		if (it != _manifest.end() && it->second.me_has_header) {
+			size_t l = it->second.me_header.length();
+			ld = (ll_length_and_data*) malloc(sizeof(ll_length_and_data) + l);
+			ld->ld_length = l;
+			memcpy(ld->ld_data, it->second.me_header.data(), l);
+		}
 
+		ll_spinlock_release(&_manifest_lock);
+		return ld;
+	}
 
-public:
 
 	/**
-	 * Create an instance of the persistence context
+	 * Register an open persistence context
 	 *
-	 * @param storage the persistent storage engine
-	 * @param name the name - must be a valid file name prefix
-	 * @param ns the namespace - must also be a valid file name prefix
+	 * @param context the context
 	 */
-	ll_persistence_context(ll_persistent_storage* storage, const char* name,
-			const char* ns) {
+	void register_context(ll_persistence_context* context) {
 
-		_storage = storage;
-		_name = name;
-		_namespace = ns;
+		ll_spinlock_acquire(&_manifest_lock);
+		_contexts.push_back(context);
+		ll_spinlock_release(&_manifest_lock);
+	}
 
-		_fds_lock = 0;
-		_lengths_lock = 0;
-		_mmaped_regions_lock = 0;
 
-		_header_fd = 0;
-		_header_lock = 0;
+	/**
+	 * Unregister a persistence context that is being closed, remembering
+	 * its final state in the manifest
+	 *
+	 * @param context the context
+	 */
+	void unregister_context(ll_persistence_context* context);
 
-		_auto_sync = true;
 
+	/**
+	 * Invalidate the manifest before a modification of any file in the
+	 * database, so that a crash does not leave behind a stale manifest
+	 */
+	void invalidate_manifest() {
 
-		// Check
+		__sync_fetch_and_add(&_modifications, 1);
+		if (!_manifest_valid) return;
 
-		if (!is_name_valid(ns)) {
-			LL_E_PRINT("Invalid namespace name: %s\n", ns);
-			abort();
+		ll_spinlock_acquire(&_manifest_file_lock);
+		if (_manifest_valid) {
+			remove_manifest();
 		}
+		ll_spinlock_release(&_manifest_file_lock);
+	}
 
-		if (!is_name_valid(name)) {
-			LL_E_PRINT("Invalid context name: %s\n", name);
-			abort();
-		}
 
+	/**
+	 * Write the manifest if it is not up to date. The data files need to be
+	 * already synced, and the caller should make sure that there are no
+	 * concurrent modifications, or the manifest will be just removed again.
+	 */
+	void write_manifest();
 
-		// Open all relevant files
 
-		DIR* dir;
-		dirent* ent;
+	/**
+	 * Start deferring the level syncs of all contexts, so that the files
+	 * written by a multi-context operation, such as a checkpoint or a bulk
+	 * load, are synced together by end_deferred_sync(). The calls can be
+	 * nested.
+	 */
+	void begin_deferred_sync() {
+		__sync_fetch_and_add(&_deferred_syncs, 1);
+	}
 
-		if ((dir = opendir(_storage->directory())) == NULL) {
-			perror("opendir");
-			LL_E_PRINT("Cannot open the database directory\n");
-			abort();
-		}
 
-		_prefix = _namespace;
-		_prefix += LL_PERSISTENCE_SEPARATOR;
-		_prefix += _name;
-		size_t nl = _prefix.length();
+	/**
+	 * Stop deferring the level syncs. The outermost call starts the write-back
+	 * of the dirty ranges of all pending files, syncs the files concurrently,
+	 * and then publishes the levels completed in the meantime in the root
+	 * record, so that they become visible all at once.
+	 */
+	void end_deferred_sync();
 
-		while ((ent = readdir(dir)) != NULL) {
-			size_t dl = strlen(ent->d_name);
-			if (dl > nl + 4
-					&& strncmp(ent->d_name, _prefix.c_str(), nl) == 0
-					&& strncmp(ent->d_name + (dl - 4), ".dat", 4) == 0) {
 
-				char* p = ent->d_name + nl;
-				if (strncmp(p, LL_PERSISTENCE_SEPARATOR,
-							strlen(LL_PERSISTENCE_SEPARATOR)) != 0) continue;
-				p += strlen(LL_PERSISTENCE_SEPARATOR);
+	/**
+	 * Determine whether the level syncs are currently deferred
+	 *
+	 * @return true if they are deferred
+	 */
+	inline bool sync_deferred() const {
+		return *((volatile size_t*) &_deferred_syncs) > 0;
+	}
 
 
-				// Construct the file name
+	/**
+	 * Remember an ML file of a context to be synced by end_deferred_sync()
+	 *
+	 * @param context the context
+	 * @param fi the file index
+	 */
+	void defer_sync(ll_persistence_context* context, size_t fi) {
 
-				std::string s = _storage->directory();
-				s = s + "/" + ent->d_name;
+		ll_spinlock_acquire(&_pending_syncs_lock);
 
+		for (size_t i = 0; i < _pending_syncs.size(); i++) {
+			if (_pending_syncs[i].first == context
+					&& _pending_syncs[i].second == fi) {
+				ll_spinlock_release(&_pending_syncs_lock);
+				return;
+			}
+		}
 
-				// Header file
+		_pending_syncs.push_back(std::make_pair(context, fi));
 
-				if (strncmp(p, LL_PERSISTENCE_HEADER_INDICATOR,
-							strlen(LL_PERSISTENCE_HEADER_INDICATOR)) == 0
-						&& strcmp(p + strlen(LL_PERSISTENCE_HEADER_INDICATOR),
-							".dat") == 0) {
-					int f = open(s.c_str(), O_RDWR);
-					if (f < 0) {
-						perror("open");
-						LL_E_PRINT("Cannot open %s\n", s.c_str());
-						abort();
-					}
-					_header_fd = f;
-					continue;
-				}
+		ll_spinlock_release(&_pending_syncs_lock);
+	}
 
 
-				// ML data file
+	/**
+	 * Sync the pending files of a context that is being closed before the
+	 * end of the deferral
+	 *
+	 * @param context the context
+	 */
+	void sync_pending(ll_persistence_context* context);
 
-				char* e;
-				long x = strtol(p, &e, 10);
-				if (e != ent->d_name + (dl - 4) || x < 0
-						|| (size_t) x > (LL_MAX_LEVEL
-							>> LL_LEVELS_PER_ML_FILE_BITS)) {
-					LL_W_PRINT("Invalid file name: %s\n", ent->d_name);
-					continue;
-				}
-				
-				int f = open(s.c_str(), O_RDWR);
-				if (f < 0) {
-					perror("open");
-					LL_E_PRINT("Cannot open %s\n", s.c_str());
-					abort();
-				}
 
-				while ((size_t) x >= _fds.size()) _fds.append(-1);
-				_fds[x] = f;
+	/**
+	 * Get the number of published levels of a context
+	 *
+	 * @param prefix the file name prefix of the context
+	 * @return the number of levels, which is 0 for a new context
+	 */
+	size_t published_levels(const char* prefix) {
 
+		ll_spinlock_acquire(&_root_lock);
+		std::map<std::string, size_t>::iterator it = _root.find(prefix);
+		size_t r = it == _root.end() ? 0 : it->second;
+		ll_spinlock_release(&_root_lock);
 
-				// Determine the length of the ML file
+		return r;
+	}
 
-				off_t l = lseek(f, 0, SEEK_END);
-				if (l == (off_t) -1) {
-					perror("lseek");
-					LL_E_PRINT("Cannot determine the size of %s\n", s.c_str());
-					abort();
-				}
 
-				while ((size_t) x >= _lengths.size()) _lengths.append(0);
-				_lengths[x] = l;
+	/**
+	 * Mark a level of a context as complete. The level is published with the
+	 * next root record, which is written right away unless the syncs are
+	 * deferred, in which case it is written by end_deferred_sync(). The level
+	 * data must be already synced or the sync must be pending.
+	 *
+	 * @param prefix the file name prefix of the context
+	 * @param level the level number
+	 */
+	void complete_level(const char* prefix, size_t level) {
 
-				while ((size_t) x >= _append_locks.size())
-					_append_locks.append(0);
-			}
-		}
+		ll_spinlock_acquire(&_root_lock);
+		size_t& n = _root[prefix];
+		if (n < level + 1) n = level + 1;
+		_root_dirty = true;
+		ll_spinlock_release(&_root_lock);
 
-		closedir(dir);
+		if (!sync_deferred()) publish_root();
 	}
 
 
 	/**
-	 * Destroy the persistence context
+	 * Write the next version of the root record if any levels were completed
+	 * since the last one, after waiting for the outstanding I/O. The record
+	 * is serialized under the root lock, but written and synced outside of
+	 * it, so that complete_level() and published_levels() do not spin on
+	 * the I/O; the publishers are serialized by a separate mutex, so that
+	 * the versions alternate between the two copies.
 	 */
-	~ll_persistence_context() {
+	void publish_root() {
 
-		for (size_t i = 0; i < _mmaped_regions.size(); i++) {
-			if (_mmaped_regions[i].mr_address == NULL) continue;
-			munmap(_mmaped_regions[i].mr_address, _mmaped_regions[i].mr_length);
+		_io.flush();
+
+		pthread_mutex_lock(&_publish_lock);
+		ll_spinlock_acquire(&_root_lock);
+
+		if (!_root_dirty) {
+			ll_spinlock_release(&_root_lock);
+			pthread_mutex_unlock(&_publish_lock);
+			return;
 		}
 
-		for (size_t i = 0; i < _fds.size(); i++) {
-			if (_fds[i] > 0) close(_fds[i]);
+
+		// Serialize; the levels completed from now on mark the root dirty
+		// again and go to the next version
+
+		ll_persistence_root_header_t h;
+		memset(&h, 0, sizeof(h));
+		h.rh_magic = LL_PERSISTENCE_ROOT_MAGIC;
+		h.rh_version = _root_version + 1;
+		h.rh_num_entries = _root.size();
+
+		std::string b;
+		b.append((const char*) &h, sizeof(h));
+
+		for (std::map<std::string, size_t>::iterator it = _root.begin();
+				it != _root.end(); it++) {
+			uint64_t x = it->second;
+			b.append((const char*) &x, sizeof(x));
+			x = it->first.length();
+			b.append((const char*) &x, sizeof(x));
+			b.append(it->first);
 		}
 
-		if (_header_fd > 0) close(_header_fd);
-	}
+		h.rh_length = b.length();
+		memcpy(&b[0], &h, sizeof(h));
+		h.rh_checksum = ll_checksum(b.data(), b.length());
+		memcpy(&b[0], &h, sizeof(h));
 
+		_root_dirty = false;
+		ll_spinlock_release(&_root_lock);
 
-	/**
-	 * Get the name of the persistence context
-	 *
-	 * @return the name
-	 */
-	inline const char* name() const {
-		return _name.c_str();
-	}
 
+		// Overwrite the older copy
 
-	/**
-	 * Read the header
+		std::string s = root_path(h.rh_version & 1);
+		bool exists = access(s.c_str(), F_OK) == 0;
+
+		int f = open(s.c_str(), O_CREAT | O_WRONLY, 0644);
+		if (f < 0) {
+			perror("open");
+			LL_E_PRINT("Cannot open %s\n", s.c_str());
+			abort();
+		}
+
+		ssize_t r = pwrite(f, b.data(), b.length(), 0);
+		if (r < (ssize_t) b.length()) {
+			perror("pwrite");
+			LL_E_PRINT("Cannot write %s\n", s.c_str());
+			abort();
+		}
+
+		if (fdatasync(f) != 0) {
+			LL_E_PRINT("fdatasync() failed: %s\n", strerror(errno));
+			abort();
+		}
+
+		close(f);
+		if (!exists) sync_directory();
+
+		_root_version = h.rh_version;
+
+		pthread_mutex_unlock(&_publish_lock);
+	}
+
+
+private:
+
+	/**
+	 * Get the full path of a file in the database directory
 	 *
-	 * @return length + data (to be freed by the caller), or NULL if none
+	 * @param file the file name
+	 * @return the path
 	 */
-	ll_length_and_data* read_header() {
+	std::string path(const char* file) const {
+		std::string s = _directory;
+		s += "/";
+		s += file;
+		return s;
+	}
 
-		ll_spinlock_acquire(&_header_lock);
 
-		if (_header_fd <= 0) {
-			ll_spinlock_release(&_header_lock);
-			return NULL;
+	/**
+	 * Sync the database directory, so that creating, renaming, or removing
+	 * the files in it is durable
+	 */
+	void sync_directory() {
+
+		int f = open(directory(), O_RDONLY);
+		if (f < 0) {
+			perror("open");
+			LL_E_PRINT("Cannot open the database directory\n");
+			abort();
 		}
 
-		off_t l = lseek(_header_fd, 0, SEEK_END);
-		if (l == (off_t) -1) {
-			perror("lseek");
-			LL_E_PRINT("Cannot determine the size of the header file for "
-					"context %s\n", _name.c_str());
-			ll_spinlock_release(&_header_lock);
+		if (fsync(f) != 0) {
+			LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
 			abort();
 		}
 
-		ll_length_and_data* ld = NULL;
-		ld = (ll_length_and_data*) malloc(sizeof(ll_length_and_data) + l);
-		ld->ld_length = (size_t) l;
+		close(f);
+	}
 
-		ssize_t r = pread(_header_fd, ld->ld_data, l, 0);
-		if (r < (ssize_t) l) {
-			perror("pread");
-			LL_E_PRINT("Cannot read header information for context %s\n",
-					_name.c_str());
-			ll_spinlock_release(&_header_lock);
+
+	/**
+	 * Remove the manifest file. Must be called with _manifest_file_lock
+	 */
+	void remove_manifest() {
+
+		std::string s = path(LL_PERSISTENCE_MANIFEST);
+		if (unlink(s.c_str()) != 0 && errno != ENOENT) {
+			perror("unlink");
+			LL_E_PRINT("Cannot remove %s\n", s.c_str());
 			abort();
 		}
 
-		ll_spinlock_release(&_header_lock);
-		return ld;
+		sync_directory();
+		_manifest_valid = false;
 	}
 
 
 	/**
-	 * Read the header without opening the context
+	 * Load the manifest file
 	 *
-	 * @param storage the persistent storage
-	 * @param name the context name
-	 * @param ns the context namespace
-	 * @return length + data (to be freed by the caller), or NULL if none
+	 * @return true if the manifest was loaded, false if it is absent or bad
 	 */
-	static ll_length_and_data* read_header(ll_persistent_storage* storage,
-			const char* name, const char* ns) {
+	bool load_manifest() {
 
-		std::string s = storage->directory();
-		s += "/";
-		s += ns;
-		s += LL_PERSISTENCE_SEPARATOR;
-		s += name;
-		s += LL_PERSISTENCE_SEPARATOR;
-		s += LL_PERSISTENCE_HEADER_INDICATOR;
-		s += ".dat";
+		std::string s = path(LL_PERSISTENCE_MANIFEST);
 
 		int f = open(s.c_str(), O_RDONLY);
 		if (f < 0) {
+			if (errno == ENOENT) return false;
 			perror("open");
 			LL_E_PRINT("Cannot open %s\n", s.c_str());
 			abort();
 		}
 
-		off_t l = lseek(f, 0, SEEK_END);
-		if (l == (off_t) -1) {
-			perror("lseek");
-			LL_E_PRINT("Cannot determine the size of the header file for "
-					"context %s\n", name);
+		struct stat st;
+		if (fstat(f, &st) != 0) {
+			perror("fstat");
+			LL_E_PRINT("Cannot stat %s\n", s.c_str());
+			abort();
+		}
+
+		size_t l = st.st_size;
+		char* buffer = (char*) malloc(l + 1);
+		ssize_t r = pread(f, buffer, l, 0);
+		if (r < (ssize_t) l) {
+			perror("pread");
+			LL_E_PRINT("Cannot read %s\n", s.c_str());
+			abort();
+		}
+		close(f);
+
+		bool ok = parse_manifest(buffer, l);
+		free(buffer);
+
+		if (!ok) {
+			LL_W_PRINT("Ignoring an invalid manifest\n");
+			_manifest.clear();
+			return false;
+		}
+
+		_manifest_valid = true;
+		return true;
+	}
+
+
+	/**
+	 * Consume the given number of bytes from the manifest buffer
+	 *
+	 * @param p the pointer to the current position
+	 * @param end the end of the buffer
+	 * @param out the output buffer
+	 * @param length the number of bytes
+	 * @return true if successful, false if there is not enough data
+	 */
+	static bool manifest_consume(const char** p, const char* end, void* out,
+			size_t length) {
+
+		if ((size_t) (end - *p) < length) return false;
+		memcpy(out, *p, length);
+		*p += length;
+		return true;
+	}
+
+
+	/**
+	 * Consume a length-prefixed string from the manifest buffer
+	 *
+	 * @param p the pointer to the current position
+	 * @param end the end of the buffer
+	 * @param out the output string
+	 * @return true if successful, false if there is not enough data
+	 */
+	static bool manifest_consume(const char** p, const char* end,
+			std::string& out) {
+
+		uint64_t l;
+		if (!manifest_consume(p, end, &l, sizeof(l))) return false;
+		if ((uint64_t) (end - *p) < l) return false;
+		out.assign(*p, l);
+		*p += l;
+		return true;
+	}
+
+
+	/**
+	 * Parse the contents of the manifest file
+	 *
+	 * @param buffer the buffer
+	 * @param length the length of the buffer
+	 * @return true if successful
+	 */
+	bool parse_manifest(const char* buffer, size_t length) {
+
+		const char* p = buffer;
+		const char* end = buffer + length;
+
+		ll_persistence_manifest_header_t h;
+		if (!manifest_consume(&p, end, &h, sizeof(h))) return false;
+
+		if (h.mh_magic != LL_PERSISTENCE_MANIFEST_MAGIC
+				|| h.mh_levels_per_file != LL_LEVELS_PER_ML_FILE
+				|| h.mh_level_meta_size != sizeof(ll_persistence_level_meta)
+				|| h.mh_length != length) return false;
+
+		for (uint64_t i = 0; i < h.mh_num_entries; i++) {
+
+			ll_persistence_manifest_entry e;
+			uint64_t has_header;
+			uint64_t num_files;
+
+			if (!manifest_consume(&p, end, e.me_namespace)) return false;
+			if (!manifest_consume(&p, end, e.me_name)) return false;
+			if (!manifest_consume(&p, end, &has_header, sizeof(has_header)))
+				return false;
+			if (!manifest_consume(&p, end, e.me_header)) return false;
+			if (!manifest_consume(&p, end, &num_files, sizeof(num_files)))
+				return false;
+			if ((uint64_t) (end - p) / sizeof(ll_persistence_manifest_file_t)
+					< num_files) return false;
+
+			e.me_has_header = has_header != 0;
+			e.me_files.resize(num_files);
+			for (uint64_t j = 0; j < num_files; j++) {
+				manifest_consume(&p, end, &e.me_files[j],
+						sizeof(ll_persistence_manifest_file_t));
+			}
+
+			std::string prefix = e.me_namespace;
+			prefix += LL_PERSISTENCE_SEPARATOR;
+			prefix += e.me_name;
+			_manifest[prefix] = e;
+		}
+
+		return p == end;
+	}
+
+
+	/**
+	 * Reconstruct the manifest by scanning the database directory
+	 */
+	void scan_directory() {
+
+		DIR* dir;
+		dirent* ent;
+
+		if ((dir = opendir(directory())) == NULL) {
+			perror("opendir");
+			LL_E_PRINT("Cannot open the database directory\n");
+			abort();
+		}
+
+		size_t sl = strlen(LL_PERSISTENCE_SEPARATOR);
+
+		while ((ent = readdir(dir)) != NULL) {
+
+			size_t dl = strlen(ent->d_name);
+			if (dl <= 4 || strcmp(ent->d_name + (dl - 4), ".dat") != 0)
+				continue;
+
+
+			// Split the file name into the namespace, name, and the suffix
+
+			const char* n = strstr(ent->d_name, LL_PERSISTENCE_SEPARATOR);
+			if (n == NULL) continue;
+			n += sl;
+
+			const char* x = strstr(n, LL_PERSISTENCE_SEPARATOR);
+			if (x == NULL) continue;
+
+			std::string prefix(ent->d_name, x - ent->d_name);
+			x += sl;
+
+			ll_persistence_manifest_entry& e = _manifest[prefix];
+			if (e.me_name.empty()) {
+				e.me_namespace.assign(ent->d_name, n - sl - ent->d_name);
+				e.me_name.assign(n, x - sl - n);
+			}
+
+			std::string s = path(ent->d_name);
+
+
+			// Header file
+
+			if (strncmp(x, LL_PERSISTENCE_HEADER_INDICATOR,
+						strlen(LL_PERSISTENCE_HEADER_INDICATOR)) == 0
+					&& strcmp(x + strlen(LL_PERSISTENCE_HEADER_INDICATOR),
+						".dat") == 0) {
+
+				int f = open(s.c_str(), O_RDONLY);
+				if (f < 0) {
+					perror("open");
+					LL_E_PRINT("Cannot open %s\n", s.c_str());
+					abort();
+				}
+
+				off_t l = lseek(f, 0, SEEK_END);
+				if (l == (off_t) -1) {
+					perror("lseek");
+					LL_E_PRINT("Cannot determine the size of %s\n", s.c_str());
+					abort();
+				}
+
+				e.me_header.resize(l);
+				ssize_t r = pread(f, &e.me_header[0], l, 0);
+				if (r < (ssize_t) l) {
+					perror("pread");
+					LL_E_PRINT("Cannot read %s\n", s.c_str());
+					abort();
+				}
+
+				e.me_has_header = true;
+				close(f);
+				continue;
+			}
+
+
+			// ML data file
+
+			char* p;
+			long fi = strtol(x, &p, 10);
+			if (p != ent->d_name + (dl - 4) || fi < 0
+					|| (size_t) fi > (LL_MAX_LEVEL
+						>> LL_LEVELS_PER_ML_FILE_BITS)) {
+				LL_W_PRINT("Invalid file name: %s\n", ent->d_name);
+				continue;
+			}
+
+			int f = open(s.c_str(), O_RDONLY);
+			if (f < 0) {
+				perror("open");
+				LL_E_PRINT("Cannot open %s\n", s.c_str());
+				abort();
+			}
+
+			off_t l = lseek(f, 0, SEEK_END);
+			if (l == (off_t) -1) {
+				perror("lseek");
+				LL_E_PRINT("Cannot determine the size of %s\n", s.c_str());
+				abort();
+			}
+
+			ll_persistence_manifest_file_t mf;
+			mf.mf_index = fi;
+			mf.mf_length = l;
+
+			ssize_t r = pread(f, mf.mf_level_meta, sizeof(mf.mf_level_meta), 0);
+			if (r < (ssize_t) sizeof(mf.mf_level_meta)) {
+				perror("pread");
+				LL_E_PRINT("Cannot read level-meta information from %s\n",
+						s.c_str());
+				abort();
+			}
+
+			close(f);
+			e.me_files.push_back(mf);
+		}
+
+		closedir(dir);
+	}
+
+
+	/**
+	 * Update the manifest entries of all open contexts. Must be called with
+	 * _manifest_lock
+	 */
+	void collect_contexts();
+
+
+	/**
+	 * Get the path of a copy of the root record
+	 *
+	 * @param copy the copy number (0 or 1)
+	 * @return the path
+	 */
+	std::string root_path(int copy) const {
+		char b[64];
+		snprintf(b, sizeof(b), LL_PERSISTENCE_ROOT, copy);
+		return path(b);
+	}
+
+
+	/**
+	 * Load the valid copy of the root record with the higher version
+	 *
+	 * @return true if it was loaded, false if there is no valid copy
+	 */
+	bool load_root() {
+
+		bool found = false;
+
+		for (int copy = 0; copy < 2; copy++) {
+
+			std::string s = root_path(copy);
+			int f = open(s.c_str(), O_RDONLY);
+			if (f < 0) continue;
+
+			off_t l = lseek(f, 0, SEEK_END);
+			if (l < (off_t) sizeof(ll_persistence_root_header_t)) {
+				close(f);
+				continue;
+			}
+
+			std::string b;
+			b.resize(l);
+			ssize_t r = pread(f, &b[0], l, 0);
 			close(f);
+			if (r < (ssize_t) l) continue;
+
+
+			// Validate
+
+			ll_persistence_root_header_t h;
+			memcpy(&h, b.data(), sizeof(h));
+			if (h.rh_magic != LL_PERSISTENCE_ROOT_MAGIC
+					|| h.rh_length < sizeof(h) || h.rh_length > (uint64_t) l)
+				continue;
+			if (found && h.rh_version <= _root_version) continue;
+
+			uint32_t checksum = h.rh_checksum;
+			h.rh_checksum = 0;
+			memcpy(&b[0], &h, sizeof(h));
+			if (ll_checksum(b.data(), h.rh_length) != checksum) {
+				LL_W_PRINT("Ignoring a torn copy of the root record: %s\n",
+						s.c_str());
+				continue;
+			}
+
+
+			// Parse
+
+			std::map<std::string, size_t> m;
+			const char* p = b.data() + sizeof(h);
+			const char* end = b.data() + h.rh_length;
+			bool ok = true;
+
+			for (uint64_t i = 0; i < h.rh_num_entries; i++) {
+				uint64_t n, x;
+				if (!manifest_consume(&p, end, &n, sizeof(n))
+						|| !manifest_consume(&p, end, &x, sizeof(x))
+						|| (uint64_t) (end - p) < x) {
+					ok = false;
+					break;
+				}
+				m[std::string(p, x)] = n;
+				p += x;
+			}
+
+			if (!ok) continue;
+
+			_root.swap(m);
+			_root_version = h.rh_version;
+			found = true;
+		}
+
+		return found;
+	}
+
+
+	/**
+	 * Initialize the root record from the level metadata in the manifest,
+	 * treating all existing levels as published, including any that were
+	 * not finished
+	 */
+	void seed_root() {
+
+		_root.clear();
+
+		for (std::map<std::string, ll_persistence_manifest_entry>::iterator
+				it = _manifest.begin(); it != _manifest.end(); it++) {
+
+			size_t n = 0;
+			const ll_persistence_manifest_entry& e = it->second;
+
+			for (size_t i = 0; i < e.me_files.size(); i++) {
+				for (size_t li = 0; li < LL_LEVELS_PER_ML_FILE; li++) {
+					const ll_persistence_level_meta& l
+						= e.me_files[i].mf_level_meta[li];
+					if (l.lm_vt_offset != 0 && n < l.lm_level + 1ul)
+						n = l.lm_level + 1;
+				}
+			}
+
+			if (n > 0) _root[it->first] = n;
+		}
+
+		_root_dirty = true;
+	}
+
+
+private:
+
+	/// The database directory
+	std::string _directory;
+
+	/// The I/O engine
+	ll_async_io _io;
+
+#ifdef LL_BUFFER_POOL
+	/// The buffer pool
+	ll_buffer_pool _buffer_pool;
+#endif
+
+	/// The manifest entries, keyed by the file name prefix of the context
+	std::map<std::string, ll_persistence_manifest_entry> _manifest;
+
+	/// The open persistence contexts
+	std::vector<ll_persistence_context*> _contexts;
+
+	/// The lock for the manifest entries and the open contexts
+	ll_spinlock_t _manifest_lock;
+
+	/// The lock for the manifest file
+	ll_spinlock_t _manifest_file_lock;
+
+	/// Whether the manifest file is up to date
+	volatile bool _manifest_valid;
+
+	/// The modification counter
+	volatile size_t _modifications;
+
+	/// The nesting depth of begin_deferred_sync()
+	volatile size_t _deferred_syncs;
+
+	/// The context ML files with deferred syncs
+	std::vector<std::pair<ll_persistence_context*, size_t>> _pending_syncs;
+
+	/// The lock for _pending_syncs
+	ll_spinlock_t _pending_syncs_lock;
+
+	/// The number of published levels, keyed by the file name prefix
+	std::map<std::string, size_t> _root;
+
+	/// The version of the last root record
+	uint64_t _root_version;
+
+	/// Whether there are completed levels that are not yet published
+	bool _root_dirty;
+
+	/// The lock for the root record
+	ll_spinlock_t _root_lock;
+
+	/// The lock that serializes writing the root record
+	pthread_mutex_t _publish_lock;
+};
+
+
+
+//==========================================================================//
+// Class: ll_persistence_context                                            //
+//==========================================================================//
+
+/**
+ * A persistence context, such as outgoing edges, incoming edges, or a
+ * property. This is similar to a database table.
+ *
+ * A context consists of one or more multi-level (ML) files, each representing
+ * at most LL_LEVELS_PER_ML_FILE consecutive levels. Each ML file starts with
+ * an index table with the metadata for each of those levels.
+ */
+class ll_persistence_context {
+
+public:
+
+	/// The metadata for each level
+	typedef ll_persistence_level_meta level_meta;
+
+
+	/**
+	 * Create an instance of the persistence context
+	 *
+	 * @param storage the persistent storage engine
+	 * @param name the name - must be a valid file name prefix
+	 * @param ns the namespace - must also be a valid file name prefix
+	 */
+	ll_persistence_context(ll_persistent_storage* storage, const char* name,
+			const char* ns) {
+
+		_storage = storage;
+		_name = name;
+		_namespace = ns;
+
+		_fds_lock = 0;
+		_lengths_lock = 0;
+		_mmaped_regions_lock = 0;
+		_dirty_lock = 0;
+
+		_header_fd = 0;
+		_header_lock = 0;
+		_has_header = false;
+
+		_auto_sync = true;
+
+
+		// Check
+
+		if (!is_name_valid(ns)) {
+			LL_E_PRINT("Invalid namespace name: %s\n", ns);
+			abort();
+		}
+
+		if (!is_name_valid(name)) {
+			LL_E_PRINT("Invalid context name: %s\n", name);
 			abort();
 		}
 
-		ll_length_and_data* ld = NULL;
-		ld = (ll_length_and_data*) malloc(sizeof(ll_length_and_data) + l);
-		ld->ld_length = (size_t) l;
 
-		ssize_t r = pread(f, ld->ld_data, l, 0);
-		if (r < (ssize_t) l) {
-			perror("pread");
-			LL_E_PRINT("Cannot read header information for context %s\n",
-					name);
-			close(f);
-			abort();
-		}
+		// Initialize the context from the manifest entry, if any. The ML
+		// files are opened only when they are first accessed.
+
+		_prefix = _namespace;
+		_prefix += LL_PERSISTENCE_SEPARATOR;
+		_prefix += _name;
+
+		ll_persistence_manifest_entry e;
+		if (_storage->find_manifest_entry(_prefix.c_str(), &e)) {
+
+			_has_header = e.me_has_header;
+			_header = e.me_header;
+
+			for (size_t i = 0; i < e.me_files.size(); i++) {
+				const ll_persistence_manifest_file_t& mf = e.me_files[i];
+				size_t x = mf.mf_index;
+
+				while (x >= _fds.size()) _fds.append(-1);
+				_fds[x] = LL_PERSISTENCE_FD_NOT_OPEN;
+
+				while (x >= _lengths.size()) _lengths.append(0);
+				_lengths[x] = mf.mf_length;
+
+				while (x >= _append_locks.size()) _append_locks.append(0);
+
+				if (_level_metas.size() < (x + 1) * LL_LEVELS_PER_ML_FILE) {
+					level_meta z;
+					memset(&z, 0, sizeof(z));
+					_level_metas.resize((x + 1) * LL_LEVELS_PER_ML_FILE, z);
+				}
+				memcpy(&_level_metas[x * LL_LEVELS_PER_ML_FILE],
+						mf.mf_level_meta, sizeof(mf.mf_level_meta));
+			}
+		}
+
+		_storage->register_context(this);
+
+		discard_unpublished_levels();
+	}
+
+
+	/**
+	 * Destroy the persistence context
+	 */
+	~ll_persistence_context() {
+
+		_storage->sync_pending(this);
+		_storage->unregister_context(this);
+		_storage->io().flush();
+
+		for (size_t i = 0; i < _mmaped_regions.size(); i++) {
+			if (_mmaped_regions[i].mr_address == NULL) continue;
+			IF_LL_BUFFER_POOL(if (_mmaped_regions[i].mr_buffered)
+					_storage->buffer_pool().unregister_region(
+						_mmaped_regions[i].mr_address));
+			munmap(_mmaped_regions[i].mr_address, _mmaped_regions[i].mr_length);
+		}
+
+		for (size_t i = 0; i < _fds.size(); i++) {
+			if (_fds[i] > 0) close(_fds[i]);
+		}
+
+		if (_header_fd > 0) close(_header_fd);
+	}
+
+
+	/**
+	 * Get the name of the persistence context
+	 *
+	 * @return the name
+	 */
+	inline const char* name() const {
+		return _name.c_str();
+	}
+
+
+	/**
+	 * Read the header
+	 *
+	 * @return length + data (to be freed by the caller), or NULL if none
+	 */
+	ll_length_and_data* read_header() {
+
+		ll_spinlock_acquire(&_header_lock);
+
+		if (!_has_header) {
+			ll_spinlock_release(&_header_lock);
+			return NULL;
+		}
+
+		size_t l = _header.length();
+		ll_length_and_data* ld = NULL;
+		ld = (ll_length_and_data*) malloc(sizeof(ll_length_and_data) + l);
+		ld->ld_length = l;
+		memcpy(ld->ld_data, _header.data(), l);
+
+		ll_spinlock_release(&_header_lock);
+		return ld;
+	}
+
+
+	/**
+	 * Read the header without opening the context
+	 *
+	 * @param storage the persistent storage
+	 * @param name the context name
+	 * @param ns the context namespace
+	 * @return length + data (to be freed by the caller), or NULL if none
+	 */
+	static ll_length_and_data* read_header(ll_persistent_storage* storage,
+			const char* name, const char* ns) {
+
+		std::string prefix = ns;
+		prefix += LL_PERSISTENCE_SEPARATOR;
+		prefix += name;
 
-		close(f);
-		return ld;
+		return storage->read_header(prefix.c_str());
 	}
 
 
@@ -662,6 +1537,8 @@ public:
 	 */
 	void write_header(void* data, size_t length) {
 
+		_storage->invalidate_manifest();
+
 		ll_spinlock_acquire(&_header_lock);
 
 		if (_header_fd <= 0) {
@@ -673,7 +1550,8 @@ public:
 			s += LL_PERSISTENCE_HEADER_INDICATOR;
 			s += ".dat";
 
-			int f = open(s.c_str(), O_CREAT | O_EXCL | O_RDWR, 0777);
+			int f = open(s.c_str(),
+					_has_header ? O_RDWR : O_CREAT | O_EXCL | O_RDWR, 0777);
 			if (f < 0) {
 				perror("open");
 				LL_E_PRINT("Cannot open %s\n", s.c_str());
@@ -683,7 +1561,8 @@ public:
 
 			_header_fd = f;
 		}
-		else {
+
+		if (_has_header) {
 
 			int r = ftruncate(_header_fd, 0);
 			if (r != 0) {
@@ -695,19 +1574,12 @@ public:
 			}
 		}
 
-		ssize_t r = pwrite(_header_fd, data, length, 0);
-		if (r < (ssize_t) length) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write header information for context %s\n",
-					_name.c_str());
-			ll_spinlock_release(&_header_lock);
-			abort();
-		}
+		_storage->io().pwrite(_header_fd, data, length, 0,
+				"the context header");
+		_storage->io().fsync(_header_fd);
 
-		if (fsync(_header_fd) != 0) {
-			LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
-			abort();
-		}
+		_header.assign((const char*) data, length);
+		_has_header = true;
 
 		ll_spinlock_release(&_header_lock);
 	}
@@ -719,7 +1591,7 @@ public:
 	 * @return true if we have header
 	 */
 	inline bool has_header() const {
-		return _header_fd > 0;
+		return _has_header;
 	}
 
 
@@ -740,7 +1612,8 @@ public:
 	 * @return true if it exists and is a part of this context
 	 */
 	inline bool ml_check_file_index(size_t fi) const {
-		return fi < _fds.size() && _fds[fi] > 0;
+		return fi < _fds.size()
+			&& (_fds[fi] > 0 || _fds[fi] == LL_PERSISTENCE_FD_NOT_OPEN);
 	}
 
 
@@ -764,15 +1637,14 @@ public:
 	 */
 	level_meta* read_level_meta(size_t fi) {
 
+		if (!ml_check_file_index(fi)) file_for_index(fi);
+
 		size_t l = sizeof(level_meta) * LL_LEVELS_PER_ML_FILE;
 		level_meta* buffer = (level_meta*) malloc(l);
-		ssize_t r = pread(file_for_index(fi), buffer, l, 0);
-		if (r < (ssize_t) l) {
-			perror("pread");
-			LL_E_PRINT("Cannot read level-meta information from ML file %lu\n",
-					fi);
-			abort();
-		}
+
+		ll_spinlock_acquire(&_fds_lock);
+		memcpy(buffer, &_level_metas[fi * LL_LEVELS_PER_ML_FILE], l);
+		ll_spinlock_release(&_fds_lock);
 
 		return buffer;
 	}
@@ -828,6 +1700,8 @@ public:
 	 * @return the offset
 	 */
 	size_t allocate_page_aligned_space(size_t fi, size_t size) {
+
+		_storage->invalidate_manifest();
 		
 		ll_spinlock_acquire(&_lengths_lock);
 		
@@ -872,6 +1746,8 @@ public:
 
 		// TODO Make sure that this space is not wasted if the program crashes
 		// before truncating the file...
+
+		_storage->invalidate_manifest();
 		
 		ll_spinlock_acquire(&_lengths_lock);
 		
@@ -915,12 +1791,15 @@ public:
 		mr.mr_offset = offset;
 		mr.mr_file_index = fi;
 		mr.mr_writable = true;
+		mr.mr_buffered = false;
 
 		ll_spinlock_acquire(&_mmaped_regions_lock);
 		size_t mi = _mmaped_regions.size();
 		_mmaped_regions.push_back(mr);
 		ll_spinlock_release(&_mmaped_regions_lock);
 
+		mark_dirty(fi, offset, s);
+
 		*p_offset = offset;
 		*p_address = m;
 		*p_map_index = mi;
@@ -937,6 +1816,8 @@ public:
 	void finish_preallocated_and_mmaped_page_aligned_space(size_t mi,
 			size_t size) {
 
+		_storage->invalidate_manifest();
+
 		ll_spinlock_acquire(&_mmaped_regions_lock);
 		mmaped_region_t& mr = _mmaped_regions[mi];
 		size_t fi = mr.mr_file_index;
@@ -1021,8 +1902,9 @@ public:
 	level_meta* allocate_level(size_t level, size_t headerSize,
 			size_t max_nodes, size_t numPartitions) {
 
+		_storage->invalidate_manifest();
+
 		size_t fi = ml_file_index(level);
-		int fd = file_for_index(fi);
 
 		level_meta* l = (level_meta*) calloc(1, sizeof(level_meta));
 		l->lm_level = level;
@@ -1034,14 +1916,13 @@ public:
 				sizeof(ll_persistent_chunk) * numPartitions);
 		l->lm_vt_offset = l->lm_header_offset + headerSize;
 
-		ssize_t r = pwrite(fd, l, sizeof(level_meta),
-				(level - ml_base_level(fi)) * sizeof(level_meta));
-		if (r < (ssize_t) sizeof(level_meta)) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write level-meta information to ML file %lu\n", fi);
-			free(l);
-			abort();
-		}
+		write_ml_file(fi, l, sizeof(level_meta),
+				(level - ml_base_level(fi)) * sizeof(level_meta),
+				"level-meta information");
+
+		ll_spinlock_acquire(&_fds_lock);
+		_level_metas[level] = *l;
+		ll_spinlock_release(&_fds_lock);
 		
 		return l;
 	}
@@ -1056,8 +1937,9 @@ public:
 	 */
 	level_meta* duplicate_level(size_t level, const level_meta* source) {
 
+		_storage->invalidate_manifest();
+
 		size_t fi = ml_file_index(level);
-		int fd = file_for_index(fi);
 
 		level_meta* l = (level_meta*) calloc(1, sizeof(level_meta));
 		memcpy(l, source, sizeof(*l));
@@ -1072,92 +1954,82 @@ public:
 			l->lm_header_offset = 0;
 		}
 
-		ssize_t r = pwrite(fd, l, sizeof(level_meta),
-				(level - ml_base_level(fi)) * sizeof(level_meta));
-		if (r < (ssize_t) sizeof(level_meta)) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write level-meta information to ML file %lu\n", fi);
-			free(l);
-			abort();
-		}
+		write_ml_file(fi, l, sizeof(level_meta),
+				(level - ml_base_level(fi)) * sizeof(level_meta),
+				"level-meta information");
+
+		ll_spinlock_acquire(&_fds_lock);
+		_level_metas[level] = *l;
+		ll_spinlock_release(&_fds_lock);
 		
 		return l;
 	}
 
 
 	/**
-	 * Mmap an existing level. This code assumes that all the previous levels
-	 * are already mmap-ed. The persistent array will be mmap-ed as read-only.
+	 * Mmap an existing level. The persistent array will be mmap-ed as
+	 * read-only. The previous levels do not need to be mmap-ed: the chunks
+	 * inherited from them are mapped directly, reusing an existing mapping
+	 * if there is one.
 	 *
 	 * @param lm the level meta
 	 * @param chunks the chunk table
 	 * @param indirection the indirection table to populate
-	 * @param prev_indirection the indirection table of the previous level
 	 * @param zero_page the zero page
 	 */
 	void mmap_level_ro(level_meta* lm, ll_persistent_chunk* chunks,
-			void** indirection, void** prev_indirection, void* zero_page) {
+			void** indirection, void* zero_page) {
+
+		_storage->io().flush();
 
-		// First, get the range of offsets
+		// First, get the range of offsets within each of the referenced levels
 
-		size_t offset_from = (size_t) -1;
-		size_t offset_to   = 0;
+		std::map<unsigned, ll_large_persistent_chunk> ranges;
 
 		for (size_t i = 0; i < lm->lm_vt_partitions; i++) {
-			if (chunks[i].pc_level == lm->lm_level) {
-				if (offset_from > chunks[i].pc_offset) {
-					offset_from = chunks[i].pc_offset;
-				}
-				if (offset_to < chunks[i].pc_offset + chunks[i].pc_length) {
-					offset_to = chunks[i].pc_offset + chunks[i].pc_length;
-				}
+			if (chunks[i].pc_length == 0) continue;
+
+			std::map<unsigned, ll_large_persistent_chunk>::iterator it
+				= ranges.find(chunks[i].pc_level);
+			if (it == ranges.end()) {
+				ll_large_persistent_chunk& r = ranges[chunks[i].pc_level];
+				r.pc_level = chunks[i].pc_level;
+				r.pc_offset = chunks[i].pc_offset;
+				r.pc_length = chunks[i].pc_length;
+				continue;
 			}
-		}
 
-		if (offset_to <= offset_from) return;
+			ll_large_persistent_chunk& r = it->second;
+			size_t from = std::min<size_t>(r.pc_offset, chunks[i].pc_offset);
+			size_t to = std::max<size_t>(r.pc_offset + r.pc_length,
+					chunks[i].pc_offset + chunks[i].pc_length);
+			r.pc_offset = from;
+			r.pc_length = to - from;
+		}
 
 
 		// Mmap
 
-		size_t ps = sysconf(_SC_PAGE_SIZE);
-		offset_from -= offset_from % ps;
-		offset_to   += (ps - (offset_to % ps)) % ps;
-
-		size_t size = offset_to - offset_from;
-		size_t fi = ml_file_index(lm->lm_level);
-		void* m = mmap(NULL, size, PROT_READ, MAP_SHARED,
-				file_for_index(fi), offset_from);
+		std::map<unsigned, char*> addresses;
 
-		if (m == MAP_FAILED) {
-			perror("mmap");
-			LL_E_PRINT("Cannot mmap level %u\n", (unsigned) lm->lm_level);
-			abort();
+		for (std::map<unsigned, ll_large_persistent_chunk>::iterator it
+				= ranges.begin(); it != ranges.end(); it++) {
+			addresses[it->first] = (char*) mmap_large_chunk(&it->second,
+					true /* check for existing mapping */, false /* ro */,
+					_namespace != "csr" /* buffer the property levels */);
 		}
 
-		mmaped_region_t mr;
-		mr.mr_address = m;
-		mr.mr_length = size;
-		mr.mr_offset = offset_from;
-		mr.mr_file_index = fi;
-		mr.mr_writable = false;
-
-		ll_spinlock_acquire(&_mmaped_regions_lock);
-		_mmaped_regions.push_back(mr);
-		ll_spinlock_release(&_mmaped_regions_lock);
-
 
-		// Set the indirection table, assuming that the previous level has
-		// been built properly
+		// Set the indirection table
 
 		for (size_t i = 0; i < lm->lm_vt_partitions; i++) {
 			if (chunks[i].pc_length == 0) {
 				indirection[i] = zero_page;
 			}
-			else if (chunks[i].pc_level == lm->lm_level) {
-				indirection[i] = (char*) m + (chunks[i].pc_offset-offset_from);
-			}
 			else {
-				indirection[i] = prev_indirection[i];
+				unsigned l = chunks[i].pc_level;
+				indirection[i] = addresses[l]
+					+ (chunks[i].pc_offset - ranges[l].pc_offset);
 			}
 		}
 	}
@@ -1169,14 +2041,18 @@ public:
 	 * @param chunk the chunk
 	 * @param check_for_existing_mapping true to check for an existing mapping
 	 * @param writable true to map it writable
+	 * @param buffered true to manage its residency by the buffer pool
 	 * @return the address
 	 */
 	void* mmap_large_chunk(ll_large_persistent_chunk* pc,
 			bool check_for_existing_mapping=true,
-			bool writable=true) {
+			bool writable=true,
+			bool buffered=false) {
 
 		size_t fi = ml_file_index(pc->pc_level);
 
+		_storage->io().flush();
+
 		if (check_for_existing_mapping) {
 			ll_spinlock_acquire(&_mmaped_regions_lock);
 			for (size_t i = 0; i < _mmaped_regions.size(); i++) {
@@ -1189,6 +2065,7 @@ public:
 					void* p = (char*) m.mr_address + (pc->pc_offset
 							- m.mr_offset);
 					ll_spinlock_release(&_mmaped_regions_lock);
+					if (writable) mark_dirty(fi, pc->pc_offset, pc->pc_length);
 					return p;
 				}
 			}
@@ -1218,11 +2095,22 @@ public:
 		mr.mr_offset = offset_from;
 		mr.mr_file_index = fi;
 		mr.mr_writable = writable;
+		mr.mr_buffered = false;
+
+#ifdef LL_BUFFER_POOL
+		if (buffered) {
+			mr.mr_buffered = true;
+			_storage->buffer_pool().register_region(m, size,
+					file_for_index(fi), offset_from);
+		}
+#endif
 
 		ll_spinlock_acquire(&_mmaped_regions_lock);
 		_mmaped_regions.push_back(mr);
 		ll_spinlock_release(&_mmaped_regions_lock);
 
+		if (writable) mark_dirty(fi, offset_from, size);
+
 		return (char*) m + (pc->pc_offset - offset_from);
 	}
 
@@ -1238,6 +2126,8 @@ public:
 		size_t fi = ml_file_index(lm->lm_level);
 		int fd = file_for_index(fi);
 
+		_storage->io().flush();
+
 		ssize_t r = pread(fd, header, lm->lm_header_size, lm->lm_header_offset);
 		if (r < lm->lm_header_size) {
 			perror("pread");
@@ -1256,14 +2146,9 @@ public:
 	void write_level_header(level_meta* lm, void* header) {
 
 		size_t fi = ml_file_index(lm->lm_level);
-		int fd = file_for_index(fi);
 
-		ssize_t r = pwrite(fd, header, lm->lm_header_size, lm->lm_header_offset);
-		if (r < lm->lm_header_size) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write level header to ML file %lu\n", fi);
-			abort();
-		}
+		write_ml_file(fi, header, lm->lm_header_size,
+				lm->lm_header_offset, "the level header");
 	}
 
 
@@ -1281,6 +2166,8 @@ public:
 		size_t fi = ml_file_index(l);
 		int fd = file_for_index(fi);
 
+		_storage->io().flush();
+
 		size_t size = sizeof(ll_persistent_chunk) * lm->lm_vt_partitions;
 		ssize_t r = pread(fd, chunks, size, lm->lm_vt_offset);
 		if (r < (ssize_t) size) {
@@ -1306,15 +2193,9 @@ public:
 		assert(lm->lm_base_level == 0);
 
 		size_t fi = ml_file_index(lm->lm_level);
-		int fd = file_for_index(fi);
 
 		size_t size = sizeof(ll_persistent_chunk) * lm->lm_vt_partitions;
-		ssize_t r = pwrite(fd, chunks, size, lm->lm_vt_offset);
-		if (r < (ssize_t) size) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write chunk table to ML file %lu\n", fi);
-			abort();
-		}
+		write_ml_file(fi, chunks, size, lm->lm_vt_offset, "the chunk table");
 	}
 
 
@@ -1384,6 +2265,8 @@ public:
 	 */
 	void* read(const ll_persistent_chunk& chunk) {
 
+		_storage->io().flush();
+
 		void* buffer = malloc(chunk.pc_length);
 		ssize_t r = pread(file_for_index(ml_file_index(chunk.pc_level)),
 				buffer, chunk.pc_length, chunk.pc_offset);
@@ -1407,14 +2290,8 @@ public:
 	 */
 	void* write(const ll_persistent_chunk& chunk, void* buffer) {
 
-		ssize_t r = pwrite(file_for_index(ml_file_index(chunk.pc_level)),
-				buffer, chunk.pc_length, chunk.pc_offset);
-		if (r < chunk.pc_length) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write chunk Level=%u, Offset=%lu, Length=%u\n",
-					chunk.pc_level, chunk.pc_offset, chunk.pc_length);
-			abort();
-		}
+		write_ml_file(ml_file_index(chunk.pc_level), buffer, chunk.pc_length,
+				chunk.pc_offset, "a chunk");
 
 		return buffer;
 	}
@@ -1454,31 +2331,27 @@ public:
 
 
 	/**
-	 * Sync all files and mmap-ed regions for the given level
+	 * Sync the data written to the ML file of the given level since its last
+	 * sync, which is a no-op if the file is clean. While the storage defers
+	 * syncs, this only adds the file to its pending list. With asynchronous
+	 * I/O, this only queues an fdatasync, which on Linux also writes back the
+	 * pages dirtied through the shared mappings; the data are durable once
+	 * ll_persistent_storage::io() is flushed.
 	 *
 	 * @param level the level number
 	 */
 	void sync(size_t level) {
 
 		size_t fi = ml_file_index(level);
-		int fd = file_for_index(fi);
+		if (!is_dirty(fi)) return;
 
-		for (size_t i = 0; i < _mmaped_regions.size(); i++) {
-			if (_mmaped_regions[i].mr_address == NULL) continue;
-			if (_mmaped_regions[i].mr_file_index == fi) {
-				int r = msync(_mmaped_regions[i].mr_address,
-						_mmaped_regions[i].mr_length, MS_SYNC);
-				if (r != 0) {
-					LL_E_PRINT("msync() failed: %s\n", strerror(errno));
-					abort();
-				}
-			}
+		if (_storage->sync_deferred() && !_storage->io().is_async()) {
+			_storage->defer_sync(this, fi);
+			return;
 		}
 
-		if (fsync(fd) != 0) {
-			LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
-			abort();
-		}
+		start_writeback(fi);
+		finish_sync(fi);
 	}
 
 
@@ -1495,27 +2368,177 @@ public:
 
 
 	/**
-	 * Sync everything
+	 * Finish a level: sync it if _auto_sync is enabled, and then publish it
+	 * in the root record, either right away or at the end of the current
+	 * deferral of syncs
+	 *
+	 * @param level the level number
+	 */
+	void finish_level(size_t level) {
+
+		do_auto_sync(level);
+		_storage->complete_level(_prefix.c_str(), level);
+	}
+
+
+	/**
+	 * Sync all dirty ML files, concurrently (see sync(size_t) for deferred
+	 * syncs and asynchronous I/O)
 	 */
 	void sync() {
 
-		for (size_t i = 0; i < _mmaped_regions.size(); i++) {
-			if (_mmaped_regions[i].mr_address == NULL) continue;
-			int r = msync(_mmaped_regions[i].mr_address,
-					_mmaped_regions[i].mr_length, MS_SYNC);
-			if (r != 0) {
-				LL_E_PRINT("msync() failed: %s\n", strerror(errno));
-				abort();
+		std::vector<size_t> files;
+		for (size_t fi = 0; fi < _dirty_ranges.size(); fi++) {
+			if (is_dirty(fi)) files.push_back(fi);
+		}
+
+		if (_storage->sync_deferred() && !_storage->io().is_async()) {
+			for (size_t i = 0; i < files.size(); i++) {
+				_storage->defer_sync(this, files[i]);
 			}
+			return;
 		}
 
-		for (size_t i = 0; i < _fds.size(); i++) {
-			int fd = _fds[i];
-			if (fsync(fd) != 0) {
-				LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
+		for (size_t i = 0; i < files.size(); i++) {
+			start_writeback(files[i]);
+		}
+
+#pragma omp parallel for schedule(dynamic,1) if(files.size() > 1)
+		for (size_t i = 0; i < files.size(); i++) {
+			finish_sync(files[i]);
+		}
+	}
+
+
+	/**
+	 * Determine whether the given ML file has data that were not synced yet
+	 *
+	 * @param fi the file index
+	 * @return true if it is dirty
+	 */
+	bool is_dirty(size_t fi) {
+
+		ll_spinlock_acquire(&_dirty_lock);
+		bool r = fi < _dirty_ranges.size() && !_dirty_ranges[fi].empty();
+		ll_spinlock_release(&_dirty_lock);
+
+		return r;
+	}
+
+
+	/**
+	 * Start writing back the dirty ranges of an ML file without waiting for
+	 * the I/O to complete, so that the writes to several files overlap
+	 * before finish_sync() waits for each of them
+	 *
+	 * @param fi the file index
+	 */
+	void start_writeback(size_t fi) {
+
+		if (_storage->io().is_async()) return;
+
+		ll_spinlock_acquire(&_dirty_lock);
+		std::vector<dirty_range_t> ranges;
+		if (fi < _dirty_ranges.size()) ranges = _dirty_ranges[fi];
+		ll_spinlock_release(&_dirty_lock);
+
+#if defined(__linux__)
+		int fd = file_for_index(fi);
+		for (size_t i = 0; i < ranges.size(); i++) {
+			if (sync_file_range(fd, ranges[i].dr_offset, ranges[i].dr_length,
+						SYNC_FILE_RANGE_WRITE) != 0) {
+				LL_E_PRINT("sync_file_range() failed: %s\n", strerror(errno));
 				abort();
 			}
 		}
+#else
+		// Elsewhere, fsync() does not necessarily write back the pages
+		// dirtied through the shared mappings
+
+		ll_spinlock_acquire(&_mmaped_regions_lock);
+		for (size_t m = 0; m < _mmaped_regions.size(); m++) {
+			const mmaped_region_t& mr = _mmaped_regions[m];
+			if (mr.mr_address == NULL || mr.mr_file_index != fi) continue;
+			for (size_t i = 0; i < ranges.size(); i++) {
+				if (ranges[i].dr_offset >= mr.mr_offset + mr.mr_length
+						|| ranges[i].dr_offset + ranges[i].dr_length
+							<= mr.mr_offset) continue;
+				if (msync(mr.mr_address, mr.mr_length, MS_SYNC) != 0) {
+					LL_E_PRINT("msync() failed: %s\n", strerror(errno));
+					abort();
+				}
+				break;
+			}
+		}
+		ll_spinlock_release(&_mmaped_regions_lock);
+#endif
+	}
+
+
+	/**
+	 * Make the dirty ranges of an ML file durable and mark the file clean.
+	 * The finished levels are immutable, so the ranges that are written again
+	 * only after this call has started are tracked for the next sync.
+	 *
+	 * @param fi the file index
+	 */
+	void finish_sync(size_t fi) {
+
+		ll_spinlock_acquire(&_dirty_lock);
+		if (fi >= _dirty_ranges.size() || _dirty_ranges[fi].empty()) {
+			ll_spinlock_release(&_dirty_lock);
+			return;
+		}
+		_dirty_ranges[fi].clear();
+		ll_spinlock_release(&_dirty_lock);
+
+		_storage->io().fsync(file_for_index(fi), true /* datasync */);
+	}
+
+
+	/**
+	 * Get the file name prefix of the context
+	 *
+	 * @return the prefix
+	 */
+	inline const char* prefix() const {
+		return _prefix.c_str();
+	}
+
+
+	/**
+	 * Describe the current state of the context for the manifest
+	 *
+	 * @param out the manifest entry to fill in
+	 */
+	void describe(ll_persistence_manifest_entry* out) {
+
+		out->me_namespace = _namespace;
+		out->me_name = _name;
+
+		ll_spinlock_acquire(&_header_lock);
+		out->me_has_header = _has_header;
+		out->me_header = _header;
+		ll_spinlock_release(&_header_lock);
+
+		out->me_files.clear();
+
+		ll_spinlock_acquire(&_fds_lock);
+		ll_spinlock_acquire(&_lengths_lock);
+
+		for (size_t fi = 0; fi < _fds.size(); fi++) {
+			if (_fds[fi] == -1) continue;
+
+			ll_persistence_manifest_file_t mf;
+			mf.mf_index = fi;
+			mf.mf_length = _lengths[fi];
+			memcpy(mf.mf_level_meta, &_level_metas[fi * LL_LEVELS_PER_ML_FILE],
+					sizeof(mf.mf_level_meta));
+			out->me_files.push_back(mf);
+		}
+
+		ll_spinlock_release(&_lengths_lock);
+		ll_spinlock_release(&_fds_lock);
 	}
 
 
@@ -1543,6 +2566,9 @@ protected:
 			return f;
 		}
 
+		bool exists = f == LL_PERSISTENCE_FD_NOT_OPEN;
+		if (!exists) _storage->invalidate_manifest();
+
 		char sb[64];
 		sprintf(sb, "%lu", fi);
 
@@ -1553,7 +2579,7 @@ protected:
 		s += sb;
 		s += ".dat";
 
-		f = open(s.c_str(), O_CREAT | O_EXCL | O_RDWR, 0777);
+		f = open(s.c_str(), exists ? O_RDWR : O_CREAT | O_EXCL | O_RDWR, 0777);
 		if (f < 0) {
 			perror("open");
 			LL_E_PRINT("Cannot open %s\n", s.c_str());
@@ -1561,15 +2587,18 @@ protected:
 		}
 		_fds[fi] = f;
 
-		void* b = calloc(LL_LEVELS_PER_ML_FILE, sizeof(level_meta));
-		ssize_t r = pwrite(f, b, LL_LEVELS_PER_ML_FILE * sizeof(level_meta), 0);
-		if (r < (ssize_t) (LL_LEVELS_PER_ML_FILE * sizeof(level_meta))) {
-			perror("pwrite");
-			LL_E_PRINT("Cannot write the file header of %s\n", s.c_str());
-			abort();
+		if (exists) {
+			ll_spinlock_release(&_fds_lock);
+			return f;
 		}
+
+		void* b = calloc(LL_LEVELS_PER_ML_FILE, sizeof(level_meta));
+		_storage->io().pwrite(f, b, LL_LEVELS_PER_ML_FILE * sizeof(level_meta),
+				0, "the file header of an ML file");
 		free(b);
 
+		mark_dirty(fi, 0, LL_LEVELS_PER_ML_FILE * sizeof(level_meta));
+
 
 		// No need to acquire _lengths_lock, since that only applies to already
 		// existing lengths
@@ -1579,6 +2608,12 @@ protected:
 
 		while (fi >= _append_locks.size()) _append_locks.append(0);
 
+		if (_level_metas.size() < (fi + 1) * LL_LEVELS_PER_ML_FILE) {
+			level_meta z;
+			memset(&z, 0, sizeof(z));
+			_level_metas.resize((fi + 1) * LL_LEVELS_PER_ML_FILE, z);
+		}
+
 
 		// Finish
 
@@ -1587,8 +2622,108 @@ protected:
 	}
 
 
+	/**
+	 * Discard the metadata of the levels that the root record does not
+	 * publish, which are the remains of an interrupted checkpoint or load.
+	 * This takes O(levels) time and does not read any level data.
+	 */
+	void discard_unpublished_levels() {
+
+		size_t published = _storage->published_levels(_prefix.c_str());
+		size_t discarded = 0;
+
+		level_meta z;
+		memset(&z, 0, sizeof(z));
+
+		for (size_t level = published; level < _level_metas.size(); level++) {
+			if (_level_metas[level].lm_vt_offset == 0) continue;
+
+			if (discarded == 0) _storage->invalidate_manifest();
+
+			size_t fi = ml_file_index(level);
+			write_ml_file(fi, &z, sizeof(level_meta),
+					(level - ml_base_level(fi)) * sizeof(level_meta),
+					"level-meta information");
+
+			ll_spinlock_acquire(&_fds_lock);
+			_level_metas[level] = z;
+			ll_spinlock_release(&_fds_lock);
+
+			discarded++;
+		}
+
+		if (discarded > 0) {
+			sync();
+			LL_W_PRINT("Discarded %lu unpublished level(s) of %s\n",
+					discarded, _prefix.c_str());
+		}
+	}
+
+
+	/**
+	 * Remember that a range of an ML file was written and needs to be synced.
+	 * The range is merged with the previous one if they overlap or touch,
+	 * which is the common case when appending a level.
+	 *
+	 * @param fi the file index
+	 * @param offset the file offset
+	 * @param length the length
+	 */
+	void mark_dirty(size_t fi, size_t offset, size_t length) {
+
+		if (length == 0) return;
+
+		ll_spinlock_acquire(&_dirty_lock);
+
+		if (fi >= _dirty_ranges.size()) _dirty_ranges.resize(fi + 1);
+		std::vector<dirty_range_t>& v = _dirty_ranges[fi];
+
+		if (!v.empty()) {
+			dirty_range_t& d = v.back();
+			if (offset <= d.dr_offset + d.dr_length
+					&& offset + length >= d.dr_offset) {
+				size_t e = std::max(d.dr_offset + d.dr_length, offset + length);
+				d.dr_offset = std::min(d.dr_offset, offset);
+				d.dr_length = e - d.dr_offset;
+				ll_spinlock_release(&_dirty_lock);
+				return;
+			}
+		}
+
+		dirty_range_t d;
+		d.dr_offset = offset;
+		d.dr_length = length;
+		v.push_back(d);
+
+		ll_spinlock_release(&_dirty_lock);
+	}
+
+
+	/**
+	 * Write to an ML file and remember the written range
+	 *
+	 * @param fi the file index
+	 * @param data the data
+	 * @param length the length
+	 * @param offset the file offset
+	 * @param what the description of the data for error messages
+	 */
+	void write_ml_file(size_t fi, const void* data, size_t length,
+			size_t offset, const char* what) {
+
+		_storage->io().pwrite(file_for_index(fi), data, length, offset, what);
+		mark_dirty(fi, offset, length);
+	}
+
+
 private:
 
+	/// A dirty range of an ML file
+	typedef struct {
+		size_t dr_offset;
+		size_t dr_length;
+	} dirty_range_t;
+
 	/// A mapped region
 	typedef struct {
 		void* mr_address;
@@ -1596,6 +2731,7 @@ private:
 		size_t mr_file_index;
 		size_t mr_offset;
 		bool mr_writable;
+		bool mr_buffered;
 	} mmaped_region_t;
 
 	/// The persistent storage manager
@@ -1616,12 +2752,21 @@ private:
 	/// The header lock
 	ll_spinlock_t _header_lock;
 
+	/// Whether the context has a header
+	bool _has_header;
+
+	/// The contents of the header
+	std::string _header;
+
 	/// File descriptors for multi-level files
 	ll_growable_array<int, 6, ll_nop_deallocator<int>> _fds;
 
-	/// The fds lock
+	/// The fds lock (also protects _level_metas)
 	ll_spinlock_t _fds_lock;
 
+	/// The level metadata of all levels in the ML files
+	std::vector<level_meta> _level_metas;
+
 	/// The current length of the file
 	ll_growable_array<size_t, 6, ll_nop_deallocator<size_t>> _lengths;
 
@@ -1634,6 +2779,12 @@ private:
 	/// The mmaped regions lock
 	ll_spinlock_t _mmaped_regions_lock;
 
+	/// The ranges of each ML file written since its last sync
+	std::vector<std::vector<dirty_range_t>> _dirty_ranges;
+
+	/// The dirty ranges lock
+	ll_spinlock_t _dirty_lock;
+
 	/// The do-not-allocate flag for a file
 	ll_growable_array<int, 6, ll_nop_deallocator<int>> _append_locks;
 
@@ -1643,6 +2794,220 @@ private:
 
 
 
+//==========================================================================//
+// Class: ll_persistent_storage - Deferred Syncs                            //
+//==========================================================================//
+
+/**
+ * Stop deferring the level syncs, and if this is the outermost call, sync all
+ * pending files and then publish the completed levels
+ */
+inline void ll_persistent_storage::end_deferred_sync() {
+
+	if (__sync_sub_and_fetch(&_deferred_syncs, 1) > 0) return;
+
+	ll_spinlock_acquire(&_pending_syncs_lock);
+	std::vector<std::pair<ll_persistence_context*, size_t>> p;
+	p.swap(_pending_syncs);
+	ll_spinlock_release(&_pending_syncs_lock);
+
+	// Start the write-back of all files first, so that the device sees the
+	// data of all of them at once, and then wait for each file separately
+
+	for (size_t i = 0; i < p.size(); i++) {
+		p[i].first->start_writeback(p[i].second);
+	}
+
+#pragma omp parallel for schedule(dynamic,1) if(p.size() > 1)
+	for (size_t i = 0; i < p.size(); i++) {
+		p[i].first->finish_sync(p[i].second);
+	}
+
+
+	// Publish the levels completed during the deferral
+
+	publish_root();
+}
+
+
+/**
+ * Sync the pending files of a context that is being closed
+ *
+ * @param context the context
+ */
+inline void ll_persistent_storage::sync_pending(
+		ll_persistence_context* context) {
+
+	std::vector<size_t> files;
+
+	ll_spinlock_acquire(&_pending_syncs_lock);
+	for (size_t i = 0; i < _pending_syncs.size(); ) {
+		if (_pending_syncs[i].first == context) {
+			files.push_back(_pending_syncs[i].second);
+			_pending_syncs.erase(_pending_syncs.begin() + i);
+		}
+		else {
+			i++;
+		}
+	}
+	ll_spinlock_release(&_pending_syncs_lock);
+
+	for (size_t i = 0; i < files.size(); i++) {
+		context->start_writeback(files[i]);
+	}
+	for (size_t i = 0; i < files.size(); i++) {
+		context->finish_sync(files[i]);
+	}
+}
+
+
+
+//==========================================================================//
+// Class: ll_persistent_storage - Manifest                                  //
+//==========================================================================//
+
+/**
+ * Unregister a persistence context that is being closed, remembering its
+ * final state in the manifest
+ *
+ * @param context the context
+ */
+inline void ll_persistent_storage::unregister_context(
+		ll_persistence_context* context) {
+
+	ll_spinlock_acquire(&_manifest_lock);
+
+	context->describe(&_manifest[context->prefix()]);
+
+	for (size_t i = 0; i < _contexts.size(); i++) {
+		if (_contexts[i] == context) {
+			_contexts.erase(_contexts.begin() + i);
+			break;
+		}
+	}
+
+	ll_spinlock_release(&_manifest_lock);
+}
+
+
+/**
+ * Update the manifest entries of all open contexts. Must be called with
+ * _manifest_lock
+ */
+inline void ll_persistent_storage::collect_contexts() {
+
+	for (size_t i = 0; i < _contexts.size(); i++) {
+		_contexts[i]->describe(&_manifest[_contexts[i]->prefix()]);
+	}
+}
+
+
+/**
+ * Write the manifest if it is not up to date. The data files need to be
+ * already synced, and the caller should make sure that there are no
+ * concurrent modifications, or the manifest will be just removed again.
+ */
+inline void ll_persistent_storage::write_manifest() {
+
+	// Wait until the queued writes and syncs of all contexts are durable
+
+	_io.flush();
+
+	if (_manifest_valid) return;
+
+	ll_spinlock_acquire(&_manifest_lock);
+
+	size_t modifications = _modifications;
+	__sync_synchronize();
+
+	collect_contexts();
+
+
+	// Serialize
+
+	ll_persistence_manifest_header_t h;
+	h.mh_magic = LL_PERSISTENCE_MANIFEST_MAGIC;
+	h.mh_levels_per_file = LL_LEVELS_PER_ML_FILE;
+	h.mh_level_meta_size = sizeof(ll_persistence_level_meta);
+	h.mh_num_entries = 0;
+
+	std::string b((const char*) &h, sizeof(h));
+
+	for (std::map<std::string, ll_persistence_manifest_entry>::iterator
+			it = _manifest.begin(); it != _manifest.end(); it++) {
+		const ll_persistence_manifest_entry& e = it->second;
+		if (!e.me_has_header && e.me_files.empty()) continue;
+
+		uint64_t x;
+		x = e.me_namespace.length(); b.append((const char*) &x, sizeof(x));
+		b.append(e.me_namespace);
+		x = e.me_name.length(); b.append((const char*) &x, sizeof(x));
+		b.append(e.me_name);
+		x = e.me_has_header ? 1 : 0; b.append((const char*) &x, sizeof(x));
+		x = e.me_header.length(); b.append((const char*) &x, sizeof(x));
+		b.append(e.me_header);
+		x = e.me_files.size(); b.append((const char*) &x, sizeof(x));
+		if (!e.me_files.empty()) {
+			b.append((const char*) &e.me_files[0],
+					e.me_files.size() * sizeof(ll_persistence_manifest_file_t));
+		}
+
+		h.mh_num_entries++;
+	}
+
+	h.mh_length = b.length();
+	b.replace(0, sizeof(h), (const char*) &h, sizeof(h));
+
+
+	// Write it to a temporary file and then atomically replace the manifest
+
+	ll_spinlock_acquire(&_manifest_file_lock);
+
+	std::string s = path(LL_PERSISTENCE_MANIFEST);
+	std::string t = s + ".tmp";
+
+	int f = open(t.c_str(), O_CREAT | O_TRUNC | O_WRONLY, 0666);
+	if (f < 0) {
+		perror("open");
+		LL_E_PRINT("Cannot open %s\n", t.c_str());
+		abort();
+	}
+
+	ssize_t r = pwrite(f, b.data(), b.length(), 0);
+	if (r < (ssize_t) b.length()) {
+		perror("pwrite");
+		LL_E_PRINT("Cannot write %s\n", t.c_str());
+		abort();
+	}
+
+	if (fsync(f) != 0) {
+		LL_E_PRINT("fsync() failed: %s\n", strerror(errno));
+		abort();
+	}
+	close(f);
+
+	if (rename(t.c_str(), s.c_str()) != 0) {
+		perror("rename");
+		LL_E_PRINT("Cannot rename %s\n", t.c_str());
+		abort();
+	}
+
+	sync_directory();
+
+
+	// Pairs with invalidate_manifest(): either it sees the manifest as valid
+	// and removes it, or we see the modification here
+
+	_manifest_valid = true;
+	__sync_synchronize();
+	if (_modifications != modifications) remove_manifest();
+
+	ll_spinlock_release(&_manifest_file_lock);
+	ll_spinlock_release(&_manifest_lock);
+}
+
+
+
 //==========================================================================//
 // Class: ll_persistent_array_collection                                    //
 //==========================================================================//
@@ -1681,6 +3046,8 @@ public:
 				ll_persistence_context::level_meta& l = lm[li];
 				if (l.lm_vt_offset == 0) continue;
 
+				// The chunk table and the mappings are loaded on demand
+
 				A* a = new A(this, &l);
 
 				while (_levels.size() <= l.lm_level) _levels.push_back(NULL);
@@ -1736,23 +3103,39 @@ public:
 
 
 	/**
-	 * Get the appropriate level
+	 * Get the appropriate level, materializing it on the first access
 	 *
 	 * @param index the index
 	 * @return the level
 	 */
 	inline A* operator[] (int index) {
-		return _levels[index];
+		A* a = _levels[index];
+		if (a != NULL) a->ensure_materialized();
+		return a;
 	}
 
 
 	/**
-	 * Get the appropriate level
+	 * Get the appropriate level, materializing it on the first access
 	 *
 	 * @param index the index
 	 * @return the level
 	 */
 	inline const A* operator[] (int index) const {
+		A* a = _levels[index];
+		if (a != NULL) a->ensure_materialized();
+		return a;
+	}
+
+
+	/**
+	 * Get the appropriate level without materializing it, which is
+	 * sufficient for accessing its metadata
+	 *
+	 * @param index the index
+	 * @return the level
+	 */
+	inline A* peek(int index) {
 		return _levels[index];
 	}
 
@@ -1785,7 +3168,7 @@ public:
 	 * @param true if there is a previous level
 	 */
 	inline bool has_prev_level(int level) const {
-		return level > 0 && (*this)[level-1] != NULL;
+		return level > 0 && _levels[level-1] != NULL;
 	}
 
 
@@ -1965,7 +3348,7 @@ public:
 private:
 
 	/// The levels
-	std::vector<A*> _levels;
+	ll_level_array<A*> _levels;
 
 	/// The persistence context
 	ll_persistence_context* _persistence;
@@ -1976,6 +3359,103 @@ private:
 
 
 
+//==========================================================================//
+// COW Allocation Slab Indices                                              //
+//==========================================================================//
+
+/// The next COW allocation slab index to claim
+volatile size_t g_ll_cow_next_slab = 0;
+
+/// The COW allocation slab index of the current thread
+__thread size_t g_ll_cow_slab = (size_t) -1;
+
+/// The COW allocation slab indices released by the threads that exited
+std::vector<size_t> g_ll_cow_free_slabs;
+
+/// The lock for g_ll_cow_free_slabs
+ll_spinlock_t g_ll_cow_free_slabs_lock = 0;
+
+/// The key that releases the slab index of a thread when it exits
+pthread_key_t g_ll_cow_slab_key;
+
+/// The initialization of g_ll_cow_slab_key
+pthread_once_t g_ll_cow_slab_key_once = PTHREAD_ONCE_INIT;
+
+
+/**
+ * Release the COW allocation slab index of a thread that is exiting, so
+ * that the next new thread reuses it
+ *
+ * @param data the slab index plus one
+ */
+inline void ll_cow_slab_release(void* data) {
+
+	ll_spinlock_acquire(&g_ll_cow_free_slabs_lock);
+	g_ll_cow_free_slabs.push_back(((size_t) data) - 1);
+	ll_spinlock_release(&g_ll_cow_free_slabs_lock);
+}
+
+
+/**
+ * Create the key that releases the COW allocation slab indices
+ */
+inline void ll_cow_slab_key_create() {
+	pthread_key_create(&g_ll_cow_slab_key, ll_cow_slab_release);
+}
+
+
+/**
+ * Claim a COW allocation slab index for the current thread, preferring the
+ * smallest index released by a thread that exited
+ *
+ * @return the slab index
+ */
+inline size_t ll_cow_slab_claim() {
+
+	pthread_once(&g_ll_cow_slab_key_once, ll_cow_slab_key_create);
+
+	size_t i = (size_t) -1;
+
+	ll_spinlock_acquire(&g_ll_cow_free_slabs_lock);
+	if (!g_ll_cow_free_slabs.empty()) {
+		std::vector<size_t>::iterator it = std::min_element(
+				g_ll_cow_free_slabs.begin(), g_ll_cow_free_slabs.end());
+		i = *it;
+		*it = g_ll_cow_free_slabs.back();
+		g_ll_cow_free_slabs.pop_back();
+	}
+	ll_spinlock_release(&g_ll_cow_free_slabs_lock);
+
+	if (i == (size_t) -1) i = __sync_fetch_and_add(&g_ll_cow_next_slab, 1);
+
+	pthread_setspecific(g_ll_cow_slab_key, (void*) (i + 1));
+	return i;
+}
+
+
+/**
+ * Get the COW allocation slab index of the current thread, claiming one on
+ * the first call. Unlike omp_get_thread_num(), this is unique across nested
+ * parallel regions and threads not created by OpenMP; the threads that got
+ * an index beyond the number of slabs of a level use its shared slab. The
+ * index is released when the thread exits, so that the threads created
+ * later, such as by each new OpenMP team, do not run out of the slabs.
+ *
+ * @return the slab index
+ */
+inline size_t ll_cow_slab_index() {
+
+	size_t i = g_ll_cow_slab;
+	if (__builtin_expect(i == (size_t) -1, 0)) {
+		i = ll_cow_slab_claim();
+		g_ll_cow_slab = i;
+	}
+
+	return i;
+}
+
+
+
 //==========================================================================//
 // Class: ll_persistent_array_swcow                                         //
 //==========================================================================//
@@ -2046,24 +3526,48 @@ public:
 
 		_persistence.read_level_header(_level_meta, &_header);
 
-		if (_level > 0) {
-			ll_persistent_chunk*& prev_chunks = (*_collection)[_level-1]->_chunks;
-			if (prev_chunks != NULL) {
-				free(prev_chunks);
-				prev_chunks = NULL;
-			}
-		}
 
-		_chunks = (ll_persistent_chunk*) malloc((_num_pages+1)*sizeof(*_chunks));
-		memset(&_chunks[_num_pages], 0, sizeof(*_chunks));
-		_persistence.read_chunk_table(_level_meta, _chunks);
+		// Load the chunk table and map the level only on the first access
 
-		T** prev_indirection = NULL;
-		if (_level > 0) {
-			prev_indirection = (*_collection)[_level-1]->_indirection;
+		_materialized = false;
+	}
+
+
+	/**
+	 * Ensure that the level is materialized, i.e. that its indirection table
+	 * is populated and the data are mapped
+	 */
+	inline void ensure_materialized() {
+		if (__builtin_expect(!_materialized, 0)) materialize();
+	}
+
+
+	/**
+	 * Materialize the level: read the chunk table, mmap the data, and
+	 * populate the indirection table. This is thread-safe and idempotent.
+	 */
+	void materialize() {
+
+		ll_spinlock_acquire(&_materialize_lock);
+		if (_materialized) {
+			ll_spinlock_release(&_materialize_lock);
+			return;
 		}
-		_persistence.mmap_level_ro(_level_meta, _chunks, (void**) _indirection,
-				(void**) prev_indirection, (void*) _zero_page);
+
+		ll_persistent_chunk* chunks = (ll_persistent_chunk*)
+			malloc((_num_pages + 1) * sizeof(*chunks));
+		memset(&chunks[_num_pages], 0, sizeof(*chunks));
+		_persistence.read_chunk_table(_level_meta, chunks);
+
+		_persistence.mmap_level_ro(_level_meta, chunks, (void**) _indirection,
+				(void*) _zero_page);
+
+		free(chunks);
+
+		__sync_synchronize();
+		_materialized = true;
+
+		ll_spinlock_release(&_materialize_lock);
 	}
 
 
@@ -2081,11 +3585,22 @@ private:
 		_cow_spinlock = 0;
 		_modified_chunks = 0;
 		_highest_cowed_page = -1;
+
+		_cow_region_address = NULL;
+		_cow_region_length = 0;
+		_cow_region_offset = 0;
+		_cow_region_used = 0;
+		_cow_slabs = NULL;
+		_cow_num_slabs = 0;
+		_cow_slab_size = 0;
 		_duplicate_of_prev_level = false;
 
 		_finished_vertices = false;
 		_finished_edges = false;
 
+		_materialized = true;
+		_materialize_lock = 0;
+
 		_indirection = (T**) calloc(_num_pages + 1, sizeof(T*));
 
 		_zero_page = (T*) malloc(sizeof(T) << LL_ENTRIES_PER_PAGE_BITS);
@@ -2110,14 +3625,15 @@ public:
 
 		// Free the other data structures
 
-		if (_level > 0) {
-			T** prev_indirection = (*_collection)[_level-1]->_indirection;
+		if (_level > 0 && _collection->peek(_level-1) != NULL) {
+			T** prev_indirection = _collection->peek(_level-1)->_indirection;
 			if (prev_indirection != _indirection) free(_indirection);
 		}
 		else {
 			free(_indirection);
 		}
 		if (_chunks != NULL) free(_chunks);
+		if (_cow_slabs != NULL) free(_cow_slabs);
 
 		if (_level_meta != NULL) free(_level_meta);
 		free(_zero_page);
@@ -2201,7 +3717,8 @@ public:
 			free(*_edge_table_ptr);
 		}
 		*_edge_table_ptr = (LL_ET<node_t>*)
-			_persistence.mmap_large_chunk(&_header.h_et_chunk);
+			_persistence.mmap_large_chunk(&_header.h_et_chunk,
+					true, true, true /* buffered */);
 	}
 
 
@@ -2258,7 +3775,8 @@ public:
 		 assert(!_finished_vertices);
 		 assert(_chunks == NULL);
 
-		 assert(_level == 0 || (*_collection)[_level-1]->_level_meta != NULL);
+		 assert(_level == 0
+				 || _collection->peek(_level-1)->_level_meta != NULL);
 
 		_edge_table_ptr = p_et;
 		_header.h_et_size = et_max_edges;
@@ -2290,7 +3808,17 @@ public:
 			for (size_t i = prev_num_pages; i < _num_pages; i++)
 				_indirection[i] = _zero_page;
 
-			assert(prev_chunks != NULL);
+			// The chunk table of a level loaded from disk is not kept in
+			// memory after it is materialized, so read it again
+
+			if (prev_chunks == NULL) {
+				auto* prev = (*_collection)[_level-1];
+				prev_chunks = (ll_persistent_chunk*) malloc(
+						(prev_num_pages + 1) * sizeof(*_chunks));
+				memset(&prev_chunks[prev_num_pages], 0, sizeof(*_chunks));
+				_persistence.read_chunk_table(prev->_level_meta, prev_chunks);
+			}
+
 			_chunks = (ll_persistent_chunk*) realloc(prev_chunks,
 					sizeof(*_chunks) * _num_pages);
 
@@ -2314,16 +3842,37 @@ public:
 				free(*_edge_table_ptr);
 			}
 			*_edge_table_ptr = (LL_ET<node_t>*)
-				_persistence.mmap_large_chunk(&_header.h_et_chunk);
+				_persistence.mmap_large_chunk(&_header.h_et_chunk,
+						true, true, true /* buffered */);
 		}
 
 
-		// Preallocate the vertex table
+		// Set up the per-thread allocation slabs within the COW region; the
+		// last slab is shared by the threads with ll_cow_slab_index() beyond
+		// omp_get_max_threads()
+
+		size_t page_size = sizeof(T) * LL_ENTRIES_PER_PAGE;
+		size_t nt = omp_get_max_threads();
+		size_t slab_pages = _num_pages / (4 * nt);
+		if (slab_pages > LL_PERSISTENT_COW_SLAB_PAGES)
+			slab_pages = LL_PERSISTENT_COW_SLAB_PAGES;
+		if (slab_pages < 1) slab_pages = 1;
+
+		_cow_slab_size = slab_pages * page_size;
+		_cow_num_slabs = nt;
+		_cow_slabs = (cow_slab_t*) calloc(nt + 1, sizeof(cow_slab_t));
+
+
+		// Preallocate the vertex table, leaving enough room for the unused
+		// tails of the slabs; the rest is truncated in cow_finish()
 
+		_cow_region_length = (_num_pages + (nt + 1) * slab_pages) * page_size;
+
+		void* address;
 		_persistence.preallocate_and_mmap_page_aligned_space(fi,
-				_num_pages * sizeof(T) * LL_ENTRIES_PER_PAGE,
-				&_cow_current_offset, &_cow_current_address,
+				_cow_region_length, &_cow_region_offset, &address,
 				&_cow_current_mapping);
+		_cow_region_address = (char*) address;
 	}
 
 
@@ -2342,55 +3891,139 @@ public:
 		T* page = _indirection[wp];
 
 
-		// Do a COW if we do not own the given level, or it is a zero page
-		
-		if (_chunks[wp].pc_level != _level || page == _zero_page) {
-			ll_spinlock_acquire(&_cow_spinlock);
-			page = *((T** volatile) &_indirection[wp]);
-			if (*((unsigned* volatile) &_chunks[wp].pc_level) != _level
-					|| page == _zero_page) {
+		// Do a COW if the page is not in this level's COW region, i.e. if it
+		// belongs to a previous level or it is a zero page
 
-				if ((ssize_t) wp > _highest_cowed_page) _highest_cowed_page=wp;
-				_modified_chunks++;
+		if (!owns_page(page)) page = cow_page(wp, page);
 
 
-				// Allocate the chunk
+		// Write
+
+		page[wi] = value;
+	}
 
-				ll_persistent_chunk prev_chunk = _chunks[wp];
-				size_t size = prev_chunk.pc_length;
-				if (size == 0) size = sizeof(T) * LL_ENTRIES_PER_PAGE;
 
-				//_persistence.allocate_chunk(&_chunks[wp], _level, size);
-				memset(&_chunks[wp], 0, sizeof(*_chunks));
-				_chunks[wp].pc_level = _level;
-				_chunks[wp].pc_offset = _cow_current_offset;
-				_chunks[wp].pc_length = size;
-				_cow_current_offset += size;
+private:
 
+	/**
+	 * A per-thread allocation slab within the COW region
+	 */
+	typedef struct {
+		char* cs_next;
+		char* cs_end;
+		char cs_padding[64 - 2 * sizeof(char*)];
+	} cow_slab_t;
 
-				// Copy or zero-allocate the new page
 
-				//_indirection[wp] = page = (T*) malloc(size);
-				_indirection[wp] = page = (T*) _cow_current_address;
-				_cow_current_address = ((char*) _cow_current_address) + size;
-				if (prev_chunk.pc_length > 0) {
-					auto prev = (*_collection)[_level-1];
-					memcpy(page, prev->_indirection[wp], size);
-				}
-				else {
-					memset(page, 0, size);
-				}
+	/**
+	 * Determine whether the page was allocated in this level's COW region
+	 *
+	 * @param page the page
+	 * @return true if it belongs to this level
+	 */
+	inline bool owns_page(const T* page) const {
+		return (const char*) page >= _cow_region_address
+			&& (const char*) page < _cow_region_address + _cow_region_length;
+	}
+
+
+	/**
+	 * Allocate space from a slab, refilling it from the COW region if needed
+	 *
+	 * @param slab the slab
+	 * @param size the size
+	 * @return the allocated space
+	 */
+	char* cow_slab_allocate(cow_slab_t* slab, size_t size) {
+
+		if (slab->cs_next + size > slab->cs_end) {
+			size_t s = std::max(size, _cow_slab_size);
+			size_t o = __sync_fetch_and_add(&_cow_region_used, s);
+			if (o + s > _cow_region_length) {
+				LL_E_PRINT("The COW region of level %lu is full\n", _level);
+				abort();
 			}
-			ll_spinlock_release(&_cow_spinlock);
+			slab->cs_next = _cow_region_address + o;
+			slab->cs_end = slab->cs_next + s;
 		}
 
+		char* p = slab->cs_next;
+		slab->cs_next += size;
+		return p;
+	}
 
-		// Write
 
-		page[wi] = value;
+	/**
+	 * Copy the given page into this level's COW region and install it
+	 *
+	 * @param wp the page number
+	 * @param page the current page, which is not owned by this level
+	 * @return the page owned by this level
+	 */
+	T* cow_page(size_t wp, T* page) {
+
+		size_t size = _chunks[wp].pc_length;
+		if (size == 0) size = sizeof(T) * LL_ENTRIES_PER_PAGE;
+
+
+		// Allocate the new page from this thread's slab, or from the shared
+		// slab under the spinlock if there are more threads than slabs
+
+		size_t t = ll_cow_slab_index();
+		bool shared = t >= _cow_num_slabs;
+		cow_slab_t* slab = &_cow_slabs[shared ? _cow_num_slabs : t];
+
+		if (shared) ll_spinlock_acquire(&_cow_spinlock);
+		T* p = (T*) cow_slab_allocate(slab, size);
+		if (shared) ll_spinlock_release(&_cow_spinlock);
+
+
+		// Copy or zero-fill the new page before publishing it
+
+		if (page == _zero_page) {
+			memset(p, 0, size);
+		}
+		else {
+			memcpy(p, page, size);
+			LL_COUNT(LL_C_COW_PAGE_COPIES);
+		}
+
+
+		// Install; if another thread was faster, give back the space (it is
+		// still the last allocation in the slab) and use the other page
+
+		if (!__sync_bool_compare_and_swap(&_indirection[wp], page, p)) {
+			if (shared) ll_spinlock_acquire(&_cow_spinlock);
+			if (slab->cs_next == (char*) p + size) slab->cs_next = (char*) p;
+			if (shared) ll_spinlock_release(&_cow_spinlock);
+
+			T* r = *((T** volatile) &_indirection[wp]);
+			assert(owns_page(r));
+			return r;
+		}
+
+
+		// Only the thread that installed the page updates the chunk table
+
+		_chunks[wp].pc_level = _level;
+		_chunks[wp].pc_length = size;
+		_chunks[wp].pc_offset = _cow_region_offset
+			+ ((char*) p - _cow_region_address);
+
+		__sync_fetch_and_add(&_modified_chunks, 1);
+
+		ssize_t h;
+		while ((h = _highest_cowed_page) < (ssize_t) wp) {
+			if (__sync_bool_compare_and_swap(&_highest_cowed_page, h,
+						(ssize_t) wp)) break;
+		}
+
+		return p;
 	}
 
 
+public:
+
 	/**
 	 * Finish writing
 	 */
@@ -2409,7 +4042,10 @@ public:
 
 		_persistence.finish_preallocated_and_mmaped_page_aligned_space(
 				_cow_current_mapping,
-				_modified_chunks * sizeof(T) * LL_ENTRIES_PER_PAGE);
+				_cow_region_used);
+
+		free(_cow_slabs);
+		_cow_slabs = NULL;
 
 
 		// If there are no modified chunks, and this is not Level 0, make this
@@ -2424,7 +4060,7 @@ public:
 			_duplicate_of_prev_level = true;
 			assert(_modified_chunks == 0);
 			_level_meta = _persistence.duplicate_level(_level,
-					(*_collection)[_level-1]->_level_meta);
+					_collection->peek(_level-1)->_level_meta);
 		}
 		else {
 			assert(_level == 0 || _modified_chunks != 0);
@@ -2444,9 +4080,10 @@ public:
 		_persistence.write_level_header(_level_meta, &_header);
 		
 
-		// Sync if there are no edges; otherwise sync in finish_level_edges()
+		// Sync and publish if there are no edges; otherwise do so in
+		// finish_level_edges()
 
-		if (_edge_table_ptr == NULL) _persistence.do_auto_sync(_level);
+		if (_edge_table_ptr == NULL) _persistence.finish_level(_level);
 		
 
 		// Finish
@@ -2477,11 +4114,11 @@ public:
 		}
 
 
-		// Sync
+		// Sync and publish
 
 		// TODO mprotect the edge table if configured to do so?
 
-		if (_edge_table_ptr != NULL) _persistence.do_auto_sync(_level);
+		if (_edge_table_ptr != NULL) _persistence.finish_level(_level);
 
 
 		// Finish
@@ -2696,14 +4333,14 @@ private:
 	/// The number of pages
 	size_t _num_pages;
 
-	/// COW spinlock
+	/// COW spinlock for the shared slab
 	ll_spinlock_t _cow_spinlock;
 
 	/// The highest COWed page number
-	ssize_t _highest_cowed_page;
+	volatile ssize_t _highest_cowed_page;
 
 	/// The number of modified chunks
-	size_t _modified_chunks;
+	volatile size_t _modified_chunks;
 
 	/// Is this a duplicate of the previous level?
 	bool _duplicate_of_prev_level;
@@ -2720,6 +4357,13 @@ private:
 	/// The corresponding chunks
 	ll_persistent_chunk* _chunks;
 
+	/// Is the level materialized? (false until a level loaded from disk is
+	/// first accessed)
+	volatile bool _materialized;
+
+	/// The lock for materializing the level
+	ll_spinlock_t _materialize_lock;
+
 	/// The NIL element
 	T _nil;
 
@@ -2732,11 +4376,26 @@ private:
 	/// Are the edges finished?
 	bool _finished_edges;
 	
-	/// The chunk offset for COW
-	size_t _cow_current_offset;
+	/// The mmaped region for COW
+	char* _cow_region_address;
+
+	/// The length of the COW region
+	size_t _cow_region_length;
+
+	/// The file offset of the COW region
+	size_t _cow_region_offset;
+
+	/// The number of bytes of the COW region handed out to the slabs
+	volatile size_t _cow_region_used;
+
+	/// The per-thread allocation slabs, plus one shared slab at the end
+	cow_slab_t* _cow_slabs;
+
+	/// The number of per-thread slabs
+	size_t _cow_num_slabs;
 
-	/// The mmaped region address for COW
-	void* _cow_current_address;
+	/// The size of a slab in bytes
+	size_t _cow_slab_size;
 
 	/// The current mapping index for COW
 	size_t _cow_current_mapping;
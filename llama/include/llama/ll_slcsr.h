@@ -290,6 +290,39 @@ public:
 	}
 
 
+	/**
+	 * Get the degree prefix sums of a complete level, which are computed on
+	 * the first use and cached until the level is deleted
+	 *
+	 * @param level the level (-1 for the latest level)
+	 * @return the prefix sums, or NULL if there is no such level
+	 */
+	const ll_degree_prefix_sums* degree_prefix_sums(int level = -1) {
+		if (level < 0) level = ((int) this->num_levels()) - 1;
+		return this->_degree_prefix_sums.get(*this, level);
+	}
+
+
+	/**
+	 * Advise about the upcoming accesses to the adjacency lists of the
+	 * given nodes
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
+
+		for (size_t i = 0; i < count; i++) {
+			node_t n = nodes[i];
+			edge_t e = (*this->_latest_begin)[n].adj_list_start;
+			this->_latest_values->advise(e,
+					(*this->_latest_begin)[n+1].adj_list_start, advice);
+		}
+	}
+
+
 	/**
 	 * Start the iterator for the given node
 	 *
@@ -308,6 +341,7 @@ public:
 		iter.edge = (*this->_latest_begin)[n].adj_list_start;
 		iter.left = (*this->_latest_begin)[n+1].adj_list_start - iter.edge;
 		iter.ptr = &(*this->_latest_values)[iter.edge];
+		iter.last_node = LL_NIL_NODE;
 
 		LL_D_NODE_PRINT(n, "[left=%ld, edge=%lx, n_edge=%lx]\n",
 				(long) iter.left, (long) iter.edge,
@@ -348,6 +382,106 @@ public:
 	}
 
 
+	/**
+	 * Start iterating over the adjacency list of the given node one span at
+	 * a time
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param level the level (ignored)
+	 * @param max_level the max level for deletions (ignored)
+	 */
+	void span_begin(ll_edge_iterator& iter, node_t n,
+			int level=-1, int max_level=-1) const {
+		iter_begin(iter, n);
+	}
+
+
+	/**
+	 * Get the next span of the adjacency list
+	 *
+	 * @param iter the iterator
+	 * @param span the output span
+	 * @return true if there was a span, false if at the end
+	 */
+	bool span_next(ll_edge_iterator& iter, ll_adjacency_span& span) const {
+
+		if (iter.left == 0) return false;
+
+		size_t length = iter.left;
+		if (length > LL_SPAN_MAX_LENGTH) length = LL_SPAN_MAX_LENGTH;
+
+		span.as_values = (const T*) iter.ptr;
+		span.as_length = length;
+		span.as_edge = iter.edge;
+		span.as_level = 0;
+
+		iter.left -= length;
+		iter.edge += length;
+		iter.ptr = ((const T*) iter.ptr) + length;
+
+		return true;
+	}
+
+
+	/**
+	 * Compute the mask of the edges in a span that are not deleted
+	 *
+	 * @param span the span
+	 * @param mask the output with LL_SPAN_MASK_WORDS words, bit i set if live
+	 * @return the number of edges that are not deleted
+	 */
+	size_t span_live_mask(const ll_adjacency_span& span, uint64_t* mask)
+		const {
+		return ll_adjacency_span_fill_mask(span.as_length, mask);
+	}
+
+
+	/**
+	 * Scan all edges in the storage order; the functor is called for each
+	 * full block of edges, concurrently from multiple threads
+	 *
+	 * @param f the functor, called as f(const ll_edge_block&)
+	 * @param level the level (ignored)
+	 * @param max_level the max level for deletions (ignored)
+	 */
+	template <class F>
+	void scan(F& f, int level=-1, int max_level=-1) const {
+
+		node_t max_nodes = this->max_nodes();
+
+#		pragma omp parallel
+		{
+			ll_edge_block block;
+			block.eb_length = 0;
+			block.eb_level = 0;
+
+#			pragma omp for schedule(dynamic,1)
+			for (node_t s = 0; s < max_nodes; s += 4096) {
+				node_t e = std::min<node_t>(s + 4096, max_nodes);
+				for (node_t n = s; n < e; n++) {
+					edge_t start = (*this->_latest_begin)[n].adj_list_start;
+					edge_t end = (*this->_latest_begin)[n+1].adj_list_start;
+
+					for (edge_t x = start; x < end; x++) {
+						size_t k = block.eb_length++;
+						block.eb_nodes[k] = n;
+						block.eb_neighbors[k] = (*this->_latest_values)[x];
+						block.eb_edges[k] = x;
+
+						if (block.eb_length == LL_EDGE_BLOCK_LENGTH) {
+							f(block);
+							block.eb_length = 0;
+						}
+					}
+				}
+			}
+
+			if (block.eb_length > 0) f(block);
+		}
+	}
+
+
 	/**
 	 * Start an iterator and get the next value immediately
 	 *
@@ -364,6 +498,43 @@ public:
 	}
 
 
+	/**
+	 * Start the iterator at the given position of the adjacency list
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param from the position within the adjacency list
+	 * @param level the level (ignored)
+	 * @param max_level the max level for deletions (ignored)
+	 */
+	void iter_begin_at(ll_edge_iterator& iter, node_t n, size_t from,
+			int level=-1, int max_level=-1) const {
+		iter_begin(iter, n);
+		if (from > iter.left) from = iter.left;
+		iter.left -= from;
+		iter.edge += from;
+		iter.ptr = &(*this->_latest_values)[iter.edge];
+	}
+
+
+	/**
+	 * Start an iterator at the given position of the adjacency list and get
+	 * the next value immediately
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param from the position within the adjacency list
+	 * @param level the level (ignored)
+	 * @param max_level the max level for deletions (ignored)
+	 * @return the next item, or LL_NIL_EDGE if none
+	 */
+	inline edge_t iter_begin_next_at(ll_edge_iterator& iter, node_t n,
+			size_t from, int level=-1, int max_level=-1) const {
+		iter_begin_at(iter, n, from);
+		return iter_next(iter);
+	}
+
+
 	/**
 	 * Start the iterator for the given node, but only within this level
 	 *
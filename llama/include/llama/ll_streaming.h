@@ -39,8 +39,11 @@
 
 #include "llama/ll_common.h"
 #include "llama/ll_mlcsr_graph.h"
+#include "llama/ll_utils.h"
 #include "llama/ll_writable_graph.h"
+#include "llama/loaders/ll_load_async_writable.h"
 
+#include <deque>
 #include <queue>
 
 
@@ -71,6 +74,16 @@ public:
 	 * @return true if data was loaded, false if there are no more data
 	 */
 	virtual bool pull(ll_writable_graph* graph, size_t max_edges) = 0;
+
+
+	/**
+	 * Load the next batch of data to the ingest service
+	 *
+	 * @param ingest the ingest service
+	 * @param max_edges the maximum number of edges
+	 * @return true if data was loaded, false if there are no more data
+	 */
+	virtual bool pull(ll_la_ingest* ingest, size_t max_edges) = 0;
 };
 
 
@@ -127,6 +140,34 @@ public:
 	 * @return true if data was loaded, false if there are no more data
 	 */
 	virtual bool pull(ll_writable_graph* graph, size_t max_edges) {
+		return pull_into(graph, max_edges);
+	}
+
+
+	/**
+	 * Load the next batch of data to the ingest service
+	 *
+	 * @param ingest the ingest service
+	 * @param max_edges the maximum number of edges
+	 * @return true if data was loaded, false if there are no more data
+	 */
+	virtual bool pull(ll_la_ingest* ingest, size_t max_edges) {
+		return pull_into(ingest, max_edges);
+	}
+
+
+private:
+
+	/**
+	 * Load the next batch of data, advancing to the next data source when
+	 * the current one runs out
+	 *
+	 * @param target the writable graph or the ingest service
+	 * @param max_edges the maximum number of edges
+	 * @return true if data was loaded, false if there are no more data
+	 */
+	template <class Target>
+	bool pull_into(Target* target, size_t max_edges) {
 
 		ll_spinlock_acquire(&_lock);
 
@@ -140,7 +181,7 @@ public:
 
 		while (true) {
 
-			bool r = d->pull(graph, max_edges);
+			bool r = d->pull(target, max_edges);
 			if (r) return r;
 
 			ll_spinlock_acquire(&_lock);
@@ -164,4 +205,253 @@ public:
 	}
 };
 
+
+
+#ifdef LL_MIN_LEVEL
+
+//==========================================================================//
+// Class: ll_sliding_window                                                 //
+//==========================================================================//
+
+/**
+ * The sliding window statistics
+ */
+typedef struct {
+
+	/// The number of levels in the window
+	size_t ws_live_levels;
+
+	/// The number of edges in the window (including the deleted edges)
+	size_t ws_live_edges;
+
+	/// The oldest and the newest levels in the window
+	int ws_min_level;
+	int ws_max_level;
+
+	/// The age of the oldest level in the window
+	double ws_oldest_age_ms;
+
+	/// The number of levels and edges that fell out of the window
+	size_t ws_retired_levels;
+	size_t ws_retired_edges;
+
+	/// The number of levels that were actually deleted, not counting the
+	/// deletions that are still deferred
+	size_t ws_deleted_levels;
+
+	/// The number of deletions deferred until the readers finish
+	size_t ws_pending_reclamation;
+
+} ll_window_stats_t;
+
+
+/**
+ * A sliding window over a streaming writable graph: each checkpoint adds a new
+ * level, and the levels that are either more than the given number of levels
+ * behind or older than the given time to live fall out of the window.
+ *
+ * Expiring a level only bumps the min level, which is O(1) in the number of
+ * levels, and the levels two below the min level are then deleted, which
+ * releases their vertex table and property pages through the refcounts of the
+ * page manager, so that the memory is recycled by the subsequent levels. The
+ * deletion is deferred by the graph while there are active snapshots.
+ */
+class ll_sliding_window {
+
+	typedef struct {
+		int li_level;
+		double li_created_ms;
+		size_t li_edges;
+	} level_info_t;
+
+
+	/// The graph
+	ll_writable_graph* _graph;
+
+	/// The max number of levels in the window (0 = unlimited)
+	size_t _window;
+
+	/// The time to live in ms (0 = unlimited)
+	double _ttl_ms;
+
+	/// The levels in the window, from the oldest
+	std::deque<level_info_t> _levels;
+
+	/// The next level to add to the window
+	size_t _next_level;
+
+	/// The current min level
+	int _min_level;
+
+	/// The oldest level that has not been deleted yet
+	int _next_delete;
+
+	/// The statistics
+	size_t _retired_levels;
+	size_t _retired_edges;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_sliding_window and include the existing levels
+	 * of the graph in the window
+	 *
+	 * @param graph the writable graph
+	 * @param window the max number of levels in the window (0 = unlimited)
+	 * @param ttl_ms the time to live of a level in ms (0 = unlimited)
+	 */
+	ll_sliding_window(ll_writable_graph* graph, size_t window,
+			double ttl_ms = 0) {
+
+		_graph = graph;
+		_window = window;
+		_ttl_ms = ttl_ms;
+
+		_min_level = _graph->ro_graph().out().min_level();
+		_next_delete = _min_level > 0 ? _min_level - 1 : 0;
+
+		_retired_levels = 0;
+		_retired_edges = 0;
+
+		_next_level = _min_level;
+		add_new_levels();
+	}
+
+
+	/**
+	 * Destroy the instance
+	 */
+	virtual ~ll_sliding_window() {
+	}
+
+
+	/**
+	 * Get the max number of levels in the window
+	 *
+	 * @return the window size, or 0 if unlimited
+	 */
+	inline size_t window() const {
+		return _window;
+	}
+
+
+	/**
+	 * Get the time to live of a level
+	 *
+	 * @return the time to live in ms, or 0 if unlimited
+	 */
+	inline double ttl_ms() const {
+		return _ttl_ms;
+	}
+
+
+	/**
+	 * Checkpoint the writable graph into a new level and then expire the
+	 * levels that fell out of the window
+	 *
+	 * @param config the loader config
+	 * @return the number of expired levels
+	 */
+	size_t checkpoint(const ll_loader_config* config = NULL) {
+
+		_graph->checkpoint(config);
+		return expire();
+	}
+
+
+	/**
+	 * Add the levels checkpointed since the last call to the window and then
+	 * expire the levels that fell out of it, such as due to their time to
+	 * live. The newest level is always kept.
+	 *
+	 * @return the number of expired levels
+	 */
+	size_t expire(void) {
+
+		add_new_levels();
+
+		double now = ll_get_time_ms();
+		size_t expired = 0;
+
+		while (_levels.size() > 1) {
+			level_info_t& l = _levels.front();
+			if ((_window == 0 || _levels.size() <= _window)
+					&& (_ttl_ms <= 0 || now - l.li_created_ms <= _ttl_ms)) break;
+
+			_retired_edges += l.li_edges;
+			_levels.pop_front();
+			expired++;
+		}
+
+		if (expired == 0) return 0;
+		_retired_levels += expired;
+
+
+		// Bump the min level
+
+		_min_level = _levels.front().li_level;
+		_graph->set_min_level(_min_level);
+
+
+		// Delete the levels that can no longer be reached; the level right
+		// below the min level is still needed to descend from the min level
+
+		while (_next_delete + 1 < _min_level) {
+			_graph->delete_level(_next_delete);
+			_next_delete++;
+		}
+
+		return expired;
+	}
+
+
+	/**
+	 * Get the window statistics
+	 *
+	 * @param out the output stats
+	 */
+	void stats(ll_window_stats_t* out) {
+
+		out->ws_live_levels = _levels.size();
+		out->ws_live_edges = 0;
+		for (size_t i = 0; i < _levels.size(); i++) {
+			out->ws_live_edges += _levels[i].li_edges;
+		}
+
+		out->ws_min_level = _levels.empty() ? -1 : _levels.front().li_level;
+		out->ws_max_level = _levels.empty() ? -1 : _levels.back().li_level;
+		out->ws_oldest_age_ms = _levels.empty() ? 0
+			: ll_get_time_ms() - _levels.front().li_created_ms;
+
+		out->ws_retired_levels = _retired_levels;
+		out->ws_retired_edges = _retired_edges;
+		out->ws_deleted_levels = _graph->num_deleted_levels();
+		out->ws_pending_reclamation = _graph->epochs().num_retired();
+	}
+
+
+private:
+
+	/**
+	 * Add the levels created since the last call to the window
+	 */
+	void add_new_levels(void) {
+
+		auto& ro = _graph->ro_graph();
+		double now = ll_get_time_ms();
+
+		for ( ; _next_level < ro.num_levels(); _next_level++) {
+			size_t l = _next_level;
+			level_info_t i;
+			i.li_level = l;
+			i.li_created_ms = now;
+			i.li_edges = ro.max_edges(l);
+			_levels.push_back(i);
+		}
+	}
+};
+
+#endif
+
 #endif
@@ -276,6 +276,30 @@ inline const char* ll_file_extension(const char* file_name) {
 }
 
 
+/**
+ * Compute a 32-bit FNV-1a checksum, which is sufficient to detect torn or
+ * partially written records in the on-disk logs
+ *
+ * @param data the data
+ * @param length the length in bytes
+ * @param seed the checksum of the preceding data, if computed piecewise
+ * @return the checksum
+ */
+inline uint32_t ll_checksum(const void* data, size_t length,
+		uint32_t seed = 2166136261u) {
+
+	const unsigned char* p = (const unsigned char*) data;
+	uint32_t h = seed;
+
+	for (size_t i = 0; i < length; i++) {
+		h ^= p[i];
+		h *= 16777619u;
+	}
+
+	return h;
+}
+
+
 /**
  * Extract the class name from the pretty function string
  *
@@ -532,6 +556,21 @@ static inline bool _ll_atomic_compare_and_swap(long long* dest, long long old_va
     return __sync_bool_compare_and_swap(dest, old_val, new_val);
 }
 
+static inline bool _ll_atomic_compare_and_swap(unsigned *dest, unsigned old_val,
+		unsigned new_val) {
+    return __sync_bool_compare_and_swap(dest, old_val, new_val);
+}
+
+static inline bool _ll_atomic_compare_and_swap(unsigned long *dest,
+		unsigned long old_val, unsigned long new_val) {
+    return __sync_bool_compare_and_swap(dest, old_val, new_val);
+}
+
+static inline bool _ll_atomic_compare_and_swap(unsigned long long* dest,
+		unsigned long long old_val, unsigned long long new_val) {
+    return __sync_bool_compare_and_swap(dest, old_val, new_val);
+}
+
 static inline bool _ll_atomic_compare_and_swap(float *dest, float old_val,
 		float new_val) {
     return _ll_cas_asm(dest, old_val, new_val);
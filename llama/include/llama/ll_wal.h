@@ -0,0 +1,840 @@
+/*
+ * ll_wal.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_WAL_H_
+#define LL_WAL_H_
+
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <unordered_set>
+
+#include "llama/ll_common.h"
+#include "llama/ll_utils.h"
+
+#ifdef LL_WAL
+
+
+/// The name of the write-ahead log file in the database directory
+#define LL_WAL_FILE					"wal.log"
+
+/// The magic number of the write-ahead log file ("LLWAL003")
+#define LL_WAL_MAGIC				0x3330304c41574c4cull
+
+/// The number of buffered bytes after which a writer flushes the log
+#ifndef LL_WAL_BUFFER_SIZE
+#define LL_WAL_BUFFER_SIZE			(4ul << 20)
+#endif
+
+/// The default number of microseconds a commit waits for more writers
+#ifndef LL_WAL_COMMIT_DELAY_US
+#define LL_WAL_COMMIT_DELAY_US		0
+#endif
+
+#define LL_WAL_ADD_NODE				1
+#define LL_WAL_DELETE_NODE			2
+#define LL_WAL_ADD_EDGE				3
+#define LL_WAL_DELETE_EDGE			4
+#define LL_WAL_NODE_PROPERTY_32		5
+#define LL_WAL_NODE_PROPERTY_64		6
+#define LL_WAL_EDGE_PROPERTY_32		7
+#define LL_WAL_EDGE_PROPERTY_64		8
+#define LL_WAL_ABORT				9
+#define LL_WAL_COMMIT				10
+
+
+/**
+ * The header of the write-ahead log file
+ */
+typedef struct {
+
+	/// The magic number
+	uint64_t wh_magic;
+
+	/// The number of read-only levels the log applies on top of
+	uint64_t wh_base_levels;
+
+	/// The LSN of the first record
+	uint64_t wh_first_lsn;
+
+	/// The checksum of the above
+	uint32_t wh_checksum;
+
+	/// Reserved
+	uint32_t wh_reserved;
+
+} ll_wal_header_t;
+
+
+/**
+ * A write-ahead log record, followed by the property name (if any) padded
+ * to a multiple of 8 bytes
+ */
+typedef struct {
+
+	/// The checksum of the record and the name
+	uint32_t wr_checksum;
+
+	/// The record type (LL_WAL_*)
+	uint16_t wr_type;
+
+	/// The length of the name
+	uint16_t wr_name_length;
+
+	/// The log sequence number
+	uint64_t wr_lsn;
+
+	/// The ID of the transaction, or 0 if none
+	uint64_t wr_tx;
+
+	/// The arguments: the node or the source and target nodes, the edge,
+	/// and the property value, depending on the type
+	int64_t wr_args[3];
+
+} ll_wal_record_t;
+
+
+/// The LSN of the last record appended by this thread
+__thread uint64_t g_wal_last_lsn = 0;
+
+
+
+//==========================================================================//
+// Class: ll_wal                                                            //
+//==========================================================================//
+
+/**
+ * The write-ahead log of the updates to the writable representation, so
+ * that they are durable without a checkpoint. The writers append records
+ * into a shared in-memory buffer and then commit; the first committer
+ * becomes the leader, optionally waits up to the commit delay for more
+ * writers to join, and then writes out and syncs the whole batch with a
+ * single fdatasync(), while the rest wait for it to finish (group commit).
+ *
+ * The log starts at the read-only levels that existed when it was last
+ * restarted, which happens after each checkpoint. On open, the valid
+ * prefix of the log is recovered and then replayed by the writable graph.
+ *
+ * The records of a transaction are appended as it applies its updates, so
+ * that they are ordered the same way as in memory. A committed transaction
+ * then appends a commit record (an aborted one appends an abort record),
+ * and the replay skips all records of the transactions without one.
+ */
+class ll_wal {
+
+public:
+
+	/**
+	 * Open or create the write-ahead log
+	 *
+	 * @param dir the database directory
+	 */
+	ll_wal(const char* dir) {
+
+		_file_name = dir;
+		_file_name += "/";
+		_file_name += LL_WAL_FILE;
+
+		pthread_mutex_init(&_lock, NULL);
+		pthread_cond_init(&_cond, NULL);
+		pthread_cond_init(&_leader_cond, NULL);
+
+		_synchronous = true;
+		_commit_delay_us = LL_WAL_COMMIT_DELAY_US;
+		_batch_size = LL_WAL_BUFFER_SIZE;
+
+		_buffer_capacity = _flush_buffer_capacity = 64 * 1024;
+		_buffer = (char*) malloc(_buffer_capacity);
+		_flush_buffer = (char*) malloc(_flush_buffer_capacity);
+		_buffer_used = 0;
+
+		_flushing = false;
+		_waiting_leader = false;
+		_num_syncs = 0;
+
+		_recovered = NULL;
+		_recovered_length = 0;
+		_num_recovered = 0;
+		_max_tx = 0;
+
+		_fd = open(_file_name.c_str(), O_CREAT | O_RDWR, 0666);
+		if (_fd < 0) {
+			perror("open");
+			LL_E_PRINT("Cannot open the write-ahead log %s\n",
+					_file_name.c_str());
+			abort();
+		}
+
+		recover();
+	}
+
+
+	/**
+	 * Make the log durable and close it
+	 */
+	virtual ~ll_wal() {
+
+		commit(_last_lsn);
+		close(_fd);
+
+		if (_recovered != NULL) free(_recovered);
+		free(_buffer);
+		free(_flush_buffer);
+
+		pthread_cond_destroy(&_leader_cond);
+		pthread_cond_destroy(&_cond);
+		pthread_mutex_destroy(&_lock);
+	}
+
+
+	/**
+	 * Determine whether each update is made durable before it returns
+	 *
+	 * @return true if synchronous
+	 */
+	inline bool synchronous() const {
+		return _synchronous;
+	}
+
+
+	/**
+	 * Set whether each update is made durable before it returns; if not,
+	 * the updates are durable only after an explicit commit
+	 *
+	 * @param s true for synchronous
+	 */
+	void set_synchronous(bool s) {
+		_synchronous = s;
+	}
+
+
+	/**
+	 * Set the latency bound of the group commit, which is the time that
+	 * the leader waits for more writers to join the batch
+	 *
+	 * @param us the delay in microseconds, or 0 to not wait
+	 */
+	void set_commit_delay(unsigned us) {
+		_commit_delay_us = us;
+	}
+
+
+	/**
+	 * Set the number of buffered bytes that ends the wait for more writers
+	 * early, and after which the writers flush the buffer without a commit
+	 *
+	 * @param bytes the size in bytes
+	 */
+	void set_batch_size(size_t bytes) {
+		_batch_size = std::max<size_t>(bytes, sizeof(ll_wal_record_t));
+	}
+
+
+	/**
+	 * Get the number of read-only levels on top of which the log applies
+	 *
+	 * @return the number of levels
+	 */
+	inline size_t base_levels() const {
+		return _base_levels;
+	}
+
+
+	/**
+	 * Get the LSN of the last appended record
+	 *
+	 * @return the LSN
+	 */
+	inline uint64_t last_lsn() const {
+		return _last_lsn;
+	}
+
+
+	/**
+	 * Get the LSN of the last durable record
+	 *
+	 * @return the LSN
+	 */
+	inline uint64_t durable_lsn() const {
+		return _durable_lsn;
+	}
+
+
+	/**
+	 * Get the number of the fdatasync() calls so far
+	 *
+	 * @return the number of syncs
+	 */
+	inline size_t num_syncs() const {
+		return _num_syncs;
+	}
+
+
+	/**
+	 * Get the number of records recovered on open that were not yet
+	 * replayed or discarded
+	 *
+	 * @return the number of records
+	 */
+	inline size_t num_recovered() const {
+		return _num_recovered;
+	}
+
+
+	/**
+	 * Get the largest transaction ID in the log, so that the new
+	 * transactions do not reuse the IDs of the recovered ones
+	 *
+	 * @return the transaction ID, or 0 if none
+	 */
+	inline uint64_t max_tx() const {
+		return _max_tx;
+	}
+
+
+	/**
+	 * Append a record
+	 *
+	 * @param type the record type (LL_WAL_*)
+	 * @param tx the transaction ID, or 0 if none
+	 * @param a the first argument
+	 * @param b the second argument
+	 * @param c the third argument
+	 * @param name the property name, or NULL
+	 * @return the LSN of the record
+	 */
+	uint64_t append(int type, uint64_t tx, int64_t a, int64_t b = 0,
+			int64_t c = 0, const char* name = NULL) {
+
+		size_t name_length = name == NULL ? 0 : strlen(name);
+		if (name_length > UINT16_MAX) {
+			LL_E_PRINT("The property name is too long\n");
+			abort();
+		}
+
+		size_t size = sizeof(ll_wal_record_t) + ((name_length + 7) & ~7ul);
+
+		pthread_mutex_lock(&_lock);
+
+		if (_buffer_used + size > _buffer_capacity) {
+			while (_buffer_used + size > _buffer_capacity) _buffer_capacity *= 2;
+			_buffer = (char*) realloc(_buffer, _buffer_capacity);
+			if (_buffer == NULL) {
+				LL_E_PRINT("Out of memory\n");
+				abort();
+			}
+		}
+
+		ll_wal_record_t* r = (ll_wal_record_t*) (_buffer + _buffer_used);
+		memset(r, 0, size);
+		r->wr_type = type;
+		r->wr_name_length = name_length;
+		r->wr_lsn = ++_last_lsn;
+		r->wr_tx = tx;
+		r->wr_args[0] = a;
+		r->wr_args[1] = b;
+		r->wr_args[2] = c;
+		if (name_length > 0) memcpy(r + 1, name, name_length);
+		r->wr_checksum = ll_checksum(r, size);
+
+		uint64_t lsn = r->wr_lsn;
+		_buffer_used += size;
+		if (tx > _max_tx) _max_tx = tx;
+
+		if (_buffer_used >= _batch_size) {
+			if (_waiting_leader) {
+				pthread_cond_signal(&_leader_cond);
+			}
+			else if (!_flushing) {
+				flush(false);
+			}
+		}
+
+		pthread_mutex_unlock(&_lock);
+
+		g_wal_last_lsn = lsn;
+		return lsn;
+	}
+
+
+	/**
+	 * Wait until the given record and all records before it are durable,
+	 * syncing the log if no other writer is already doing so
+	 *
+	 * @param lsn the LSN
+	 */
+	void commit(uint64_t lsn) {
+
+		pthread_mutex_lock(&_lock);
+		if (lsn > _last_lsn) lsn = _last_lsn;
+
+		while (_durable_lsn < lsn) {
+			if (_flushing) {
+				pthread_cond_wait(&_cond, &_lock);
+			}
+			else {
+				flush(true);
+			}
+		}
+
+		pthread_mutex_unlock(&_lock);
+	}
+
+
+	/**
+	 * Wait until all records appended by this thread are durable
+	 */
+	inline void commit() {
+		commit(g_wal_last_lsn);
+	}
+
+
+	/**
+	 * Replay the recovered records and then release them. A record of a
+	 * transaction (a non-zero transaction ID) is replayed only if the log
+	 * contains the commit record of the transaction, so that the updates of
+	 * aborted and of interrupted transactions are dropped. The commit and
+	 * the abort records are not replayed.
+	 *
+	 * @param visitor the visitor called as visitor(record, name), where the
+	 *                name is NULL if there is none
+	 * @return the number of replayed records
+	 */
+	template <class Visitor>
+	size_t replay(Visitor& visitor) {
+
+		size_t n = 0;
+		char name[UINT16_MAX + 1];
+
+
+		// Find the committed transactions
+
+		std::unordered_set<uint64_t> committed;
+
+		for (size_t p = 0; p < _recovered_length; ) {
+			ll_wal_record_t* r = (ll_wal_record_t*) (_recovered + p);
+			p += sizeof(ll_wal_record_t) + ((r->wr_name_length + 7) & ~7ul);
+			if (r->wr_type == LL_WAL_COMMIT) committed.insert(r->wr_tx);
+		}
+
+
+		// Replay their records and the records outside of transactions
+
+		for (size_t p = 0; p < _recovered_length; ) {
+
+			ll_wal_record_t* r = (ll_wal_record_t*) (_recovered + p);
+			p += sizeof(ll_wal_record_t) + ((r->wr_name_length + 7) & ~7ul);
+
+			if (r->wr_type == LL_WAL_COMMIT || r->wr_type == LL_WAL_ABORT)
+				continue;
+			if (r->wr_tx != 0 && committed.find(r->wr_tx) == committed.end())
+				continue;
+
+			n++;
+			if (r->wr_name_length > 0) {
+				memcpy(name, r + 1, r->wr_name_length);
+				name[r->wr_name_length] = '\0';
+			}
+
+			visitor(r, r->wr_name_length > 0 ? name : NULL);
+		}
+
+		release_recovered();
+		return n;
+	}
+
+
+	/**
+	 * Discard all records and restart the log on top of the given number
+	 * of levels, after they were durably checkpointed. No writer may
+	 * append concurrently.
+	 *
+	 * @param base_levels the number of read-only levels
+	 */
+	void restart(size_t base_levels) {
+
+		pthread_mutex_lock(&_lock);
+		while (_flushing) pthread_cond_wait(&_cond, &_lock);
+
+		_buffer_used = 0;
+		release_recovered();
+
+		// Write the header first: if we crash before the truncate, the old
+		// records are below the first LSN, so they would not be recovered
+
+		write_header(base_levels, _last_lsn + 1);
+
+		if (ftruncate(_fd, sizeof(ll_wal_header_t)) != 0) {
+			perror("ftruncate");
+			LL_E_PRINT("Cannot truncate the write-ahead log\n");
+			abort();
+		}
+
+		sync();
+
+		_file_end = sizeof(ll_wal_header_t);
+		_durable_lsn = _last_lsn;
+
+		pthread_cond_broadcast(&_cond);
+		pthread_mutex_unlock(&_lock);
+	}
+
+
+private:
+
+	/**
+	 * Recover the valid prefix of the log, and truncate any torn tail
+	 */
+	void recover() {
+
+		_last_lsn = 0;
+		_base_levels = 0;
+
+		struct stat st;
+		if (fstat(_fd, &st) != 0) {
+			perror("fstat");
+			LL_E_PRINT("Cannot stat the write-ahead log\n");
+			abort();
+		}
+
+
+		// Read and check the header; create a new log if it is not valid
+
+		ll_wal_header_t h;
+		if ((size_t) st.st_size < sizeof(h)
+				|| pread(_fd, &h, sizeof(h), 0) != (ssize_t) sizeof(h)
+				|| h.wh_magic != LL_WAL_MAGIC
+				|| h.wh_checksum != ll_checksum(&h,
+					offsetof(ll_wal_header_t, wh_checksum))) {
+
+			if (st.st_size > 0) {
+				LL_W_PRINT("Invalid write-ahead log header, starting a new "
+						"log\n");
+			}
+
+			write_header(0, 1);
+			if (ftruncate(_fd, sizeof(ll_wal_header_t)) != 0) {
+				perror("ftruncate");
+				LL_E_PRINT("Cannot truncate the write-ahead log\n");
+				abort();
+			}
+
+			sync();
+
+			_file_end = sizeof(ll_wal_header_t);
+			_durable_lsn = _last_lsn;
+			return;
+		}
+
+		_base_levels = h.wh_base_levels;
+		_last_lsn = h.wh_first_lsn - 1;
+
+
+		// Read the records and stop at the first one that is torn, corrupt,
+		// or out of sequence
+
+		size_t length = st.st_size - sizeof(h);
+		_recovered = (char*) malloc(std::max<size_t>(length, 1));
+		if (_recovered == NULL) {
+			LL_E_PRINT("Out of memory\n");
+			abort();
+		}
+
+		size_t done = 0;
+		while (done < length) {
+			ssize_t r = pread(_fd, _recovered + done, length - done,
+					sizeof(h) + done);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) {
+				perror("pread");
+				LL_E_PRINT("Cannot read the write-ahead log\n");
+				abort();
+			}
+			done += r;
+		}
+
+		size_t p = 0;
+		while (p + sizeof(ll_wal_record_t) <= length) {
+
+			ll_wal_record_t* r = (ll_wal_record_t*) (_recovered + p);
+			size_t size = sizeof(ll_wal_record_t)
+				+ ((r->wr_name_length + 7) & ~7ul);
+
+			if (p + size > length) break;
+			if (r->wr_lsn != _last_lsn + 1) break;
+
+			uint32_t checksum = r->wr_checksum;
+			r->wr_checksum = 0;
+			bool valid = ll_checksum(r, size) == checksum;
+			r->wr_checksum = checksum;
+			if (!valid) break;
+
+			_last_lsn++;
+			_num_recovered++;
+			if (r->wr_tx > _max_tx) _max_tx = r->wr_tx;
+			p += size;
+		}
+
+		_recovered_length = p;
+		_file_end = sizeof(h) + p;
+		_durable_lsn = _last_lsn;
+
+		if (p < length) {
+			LL_W_PRINT("Discarding %lu bytes of a torn or corrupt "
+					"write-ahead log tail\n", length - p);
+			if (ftruncate(_fd, _file_end) != 0) {
+				perror("ftruncate");
+				LL_E_PRINT("Cannot truncate the write-ahead log\n");
+				abort();
+			}
+			sync();
+		}
+	}
+
+
+	/**
+	 * Release the recovered records
+	 */
+	void release_recovered() {
+
+		if (_recovered != NULL) free(_recovered);
+
+		_recovered = NULL;
+		_recovered_length = 0;
+		_num_recovered = 0;
+	}
+
+
+	/**
+	 * Write the header (but do not sync)
+	 *
+	 * @param base_levels the number of read-only levels
+	 * @param first_lsn the LSN of the first record
+	 */
+	void write_header(size_t base_levels, uint64_t first_lsn) {
+
+		ll_wal_header_t h;
+		memset(&h, 0, sizeof(h));
+
+		h.wh_magic = LL_WAL_MAGIC;
+		h.wh_base_levels = base_levels;
+		h.wh_first_lsn = first_lsn;
+		h.wh_checksum = ll_checksum(&h, offsetof(ll_wal_header_t, wh_checksum));
+
+		write_fully(&h, sizeof(h), 0);
+		_base_levels = base_levels;
+	}
+
+
+	/**
+	 * Write the buffer to the file
+	 *
+	 * @param data the data
+	 * @param length the length
+	 * @param offset the file offset
+	 */
+	void write_fully(const void* data, size_t length, off_t offset) {
+
+		const char* p = (const char*) data;
+
+		while (length > 0) {
+			ssize_t r = pwrite(_fd, p, length, offset);
+			if (r < 0 && errno == EINTR) continue;
+			if (r <= 0) {
+				perror("pwrite");
+				LL_E_PRINT("Cannot write to the write-ahead log\n");
+				abort();
+			}
+			p += r;
+			offset += r;
+			length -= r;
+		}
+	}
+
+
+	/**
+	 * Sync the file
+	 */
+	void sync() {
+
+		if (fdatasync(_fd) != 0) {
+			perror("fdatasync");
+			LL_E_PRINT("Cannot sync the write-ahead log\n");
+			abort();
+		}
+
+		_num_syncs++;
+	}
+
+
+	/**
+	 * Write out the buffer as the leader of a batch. Must be called with
+	 * _lock held and no flush in progress; the lock is released during the
+	 * I/O and held again on return.
+	 *
+	 * @param durable true to also sync the file and wait for the batch
+	 */
+	void flush(bool durable) {
+
+		_flushing = true;
+
+
+		// Give the other writers a chance to join the batch
+
+		if (durable && _commit_delay_us > 0 && _buffer_used < _batch_size) {
+
+			struct timeval now;
+			gettimeofday(&now, NULL);
+
+			long ns = (now.tv_usec + (long) _commit_delay_us) * 1000l;
+			struct timespec deadline;
+			deadline.tv_sec = now.tv_sec + ns / 1000000000l;
+			deadline.tv_nsec = ns % 1000000000l;
+
+			_waiting_leader = true;
+			while (_buffer_used < _batch_size) {
+				if (pthread_cond_timedwait(&_leader_cond, &_lock, &deadline)
+						== ETIMEDOUT) break;
+			}
+			_waiting_leader = false;
+		}
+
+
+		// Take the batch and write it out
+
+		std::swap(_buffer, _flush_buffer);
+		std::swap(_buffer_capacity, _flush_buffer_capacity);
+
+		size_t length = _buffer_used;
+		off_t offset = _file_end;
+		uint64_t lsn = _last_lsn;
+
+		_buffer_used = 0;
+		_file_end += length;
+
+		pthread_mutex_unlock(&_lock);
+
+		if (length > 0) write_fully(_flush_buffer, length, offset);
+		if (durable) sync();
+
+		pthread_mutex_lock(&_lock);
+
+		if (durable) _durable_lsn = lsn;
+		_flushing = false;
+
+		pthread_cond_broadcast(&_cond);
+	}
+
+
+private:
+
+	/// The file name
+	std::string _file_name;
+
+	/// The file descriptor
+	int _fd;
+
+	/// The end of the written part of the file
+	off_t _file_end;
+
+	/// The number of read-only levels the log applies on top of
+	size_t _base_levels;
+
+	/// The lock
+	pthread_mutex_t _lock;
+
+	/// The condition signaled at the end of each flush
+	pthread_cond_t _cond;
+
+	/// The condition signaled when the batch of a waiting leader is full
+	pthread_cond_t _leader_cond;
+
+	/// Whether each update is made durable before it returns
+	bool _synchronous;
+
+	/// The group commit delay in microseconds
+	unsigned _commit_delay_us;
+
+	/// The batch size in bytes
+	size_t _batch_size;
+
+	/// The buffer of the records that are appended
+	char* _buffer;
+	size_t _buffer_capacity;
+	size_t _buffer_used;
+
+	/// The buffer of the records that are being written out
+	char* _flush_buffer;
+	size_t _flush_buffer_capacity;
+
+	/// Whether a leader is writing out a batch
+	bool _flushing;
+
+	/// Whether the leader waits for more writers
+	bool _waiting_leader;
+
+	/// The LSN of the last appended record
+	uint64_t _last_lsn;
+
+	/// The LSN of the last durable record
+	uint64_t _durable_lsn;
+
+	/// The largest transaction ID in the log
+	uint64_t _max_tx;
+
+	/// The number of syncs
+	size_t _num_syncs;
+
+	/// The recovered records (not yet replayed)
+	char* _recovered;
+	size_t _recovered_length;
+	size_t _num_recovered;
+};
+
+#endif
+
+#endif
@@ -66,8 +66,10 @@ public:
 	 * Create an instance of ll_w_vt_array
 	 *
 	 * @param size the number of elements
+	 * @param a the element allocator
 	 */
-	ll_w_vt_array(size_t size) {
+	ll_w_vt_array(size_t size, const allocator& a = allocator())
+		: _allocator(a) {
 		_size = size;
 		_array = (std::atomic<T>*) malloc(sizeof(*_array) * size);
 		
@@ -400,8 +402,10 @@ public:
 	 * Create an instance of ll_w_vt_swcow_array
 	 *
 	 * @param size the number of elements
+	 * @param a the element allocator
 	 */
-	ll_w_vt_swcow_array(size_t size) : _array(size / LL_ENTRIES_PER_PAGE + 1) {
+	ll_w_vt_swcow_array(size_t size, const allocator& a = allocator())
+		: _allocator(a), _array(size / LL_ENTRIES_PER_PAGE + 1) {
 		_size = size;
 	}
 
@@ -70,7 +70,7 @@
 #endif
 
 #ifdef LL_WRITABLE_USE_MEMORY_POOL
-#define LL_EDGE_GET_WRITABLE(x)				((w_edge*) (__w_pool.pointer( \
+#define LL_EDGE_GET_WRITABLE(x)				((w_edge*) (__w_pool_chunks.pointer( \
 				(((x) >> LL_W_MEM_POOL_MAX_OFFSET_BITS) \
 					 & (LL_W_MEM_POOL_MAX_BUFFERS - 1)), \
 				((x) & ((1ul << LL_W_MEM_POOL_MAX_OFFSET_BITS)-1)) \
@@ -340,7 +340,12 @@ struct w_edge_noop {
 
 #ifdef LL_WRITABLE_USE_MEMORY_POOL
 
-static ll_memory_pool __w_pool;
+/// The memory pool of the w_node's and w_edge's of a writable graph
+typedef ll_memory_pool ll_w_pool_t;
+
+/// The chunks of all w_pools, so that the position of a w_edge in its pool
+/// identifies it across all graphs
+static ll_memory_pool_directory __w_pool_chunks(LL_W_MEM_POOL_MAX_BUFFERS);
 
 
 /**
@@ -348,6 +353,16 @@ static ll_memory_pool __w_pool;
  */
 struct w_generic_allocator {
 
+	/// The pool
+	ll_w_pool_t* _pool;
+
+	/**
+	 * Create the allocator
+	 *
+	 * @param pool the pool
+	 */
+	w_generic_allocator(ll_w_pool_t* pool = NULL) : _pool(pool) {}
+
 	/**
 	 * Allocate a new object
 	 *
@@ -355,7 +370,7 @@ struct w_generic_allocator {
 	 * @return the new object
 	 */
 	void* operator() (size_t size) {
-		return __w_pool.allocate<char>(size);
+		return _pool->allocate<char>(size);
 	}
 };
 
@@ -365,13 +380,23 @@ struct w_generic_allocator {
  */
 struct w_edge_allocator {
 
+	/// The pool
+	ll_w_pool_t* _pool;
+
+	/**
+	 * Create the allocator
+	 *
+	 * @param pool the pool
+	 */
+	w_edge_allocator(ll_w_pool_t* pool = NULL) : _pool(pool) {}
+
 	/**
 	 * Allocate a new writable edge
 	 *
 	 * @return the writable edge
 	 */
 	w_edge* operator() (void) {
-		w_edge* w = __w_pool.allocate<w_edge>();
+		w_edge* w = _pool->allocate<w_edge>();
 		new (w) w_edge();
 		return w;
 	}
@@ -384,7 +409,7 @@ struct w_edge_allocator {
 	 * @return the writable edge
 	 */
 	w_edge* operator() (size_t* o_chunk, size_t* o_offset) {
-		w_edge* w = __w_pool.allocate<w_edge>(1, o_chunk, o_offset);
+		w_edge* w = _pool->allocate<w_edge>(1, o_chunk, o_offset);
 		new (w) w_edge();
 		return w;
 	}
@@ -426,12 +451,22 @@ typedef ll_growable_array<w_edge*, 4, w_edge_noop, false,
 #define FREE_W_EDGES_LENGTH		(4*8)
 static w_edge* __free_w_edges[FREE_W_EDGES_LENGTH] = { THIRTY_TWO_NULLS };
 
+/// No pool: the w_node's and w_edge's are allocated individually
+typedef void ll_w_pool_t;
+
 
 /**
  * The writable edge allocator
  */
 struct w_edge_allocator {
 
+	/**
+	 * Create the allocator
+	 *
+	 * @param pool ignored
+	 */
+	w_edge_allocator(ll_w_pool_t* pool = NULL) {}
+
 	/**
 	 * Allocate a new writable edge
 	 *
@@ -539,7 +574,7 @@ class w_node {
 public:
 
 	/// Update lock
-	ll_spinlock_t wn_lock;
+	ll_adaptive_lock_t wn_lock;
 
 	/// The out-edges
 	ll_w_out_edges_t wn_out_edges;
@@ -590,8 +625,15 @@ public:
 
 	/**
 	 * Create an instance of w_node
+	 *
+	 * @param pool the pool for the edge arrays
 	 */
-	w_node(void) {
+	w_node(ll_w_pool_t* pool = NULL)
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+		: wn_out_edges(w_generic_allocator(pool)),
+		  wn_in_edges(w_generic_allocator(pool))
+#endif
+	{
 
 		wn_lock = 0;
 		wn_out_edges_delta = 0;
@@ -664,14 +706,24 @@ public:
 template <typename Output = w_node*>
 struct w_node_allocator_ext {
 
+	/// The pool
+	ll_w_pool_t* _pool;
+
+	/**
+	 * Create the allocator
+	 *
+	 * @param pool the pool
+	 */
+	w_node_allocator_ext(ll_w_pool_t* pool = NULL) : _pool(pool) {}
+
 	/**
 	 * Allocate a new writable node
 	 *
 	 * @return the writable node
 	 */
 	Output operator() (void) {
-		w_node* w = __w_pool.allocate<w_node>();
-		new (w) w_node();
+		w_node* w = _pool->allocate<w_node>();
+		new (w) w_node(_pool);
 		return (Output) w;
 	}
 };
@@ -707,14 +759,6 @@ struct w_node_deallocator_ext {
 typedef struct w_node_deallocator_ext<> w_node_deallocator;
 
 
-/**
- * Delete all w_node's in the free list
- */
-inline void ll_free_w_pool(void) {
-	__w_pool.free();
-}
-
-
 #else /* LL_WRITABLE_USE_MEMORY_POOL */
 
 #define FREE_W_NODES_LENGTH			4
@@ -727,6 +771,13 @@ static w_node* __free_w_nodes[FREE_W_NODES_LENGTH] = { FOUR_NULLS };
 template <typename Output = w_node*>
 struct w_node_allocator_ext {
 
+	/**
+	 * Create the allocator
+	 *
+	 * @param pool ignored
+	 */
+	w_node_allocator_ext(ll_w_pool_t* pool = NULL) {}
+
 	/**
 	 * Allocate a new writable node
 	 *
@@ -50,7 +50,10 @@
 #include <vector>
 
 #include "llama/ll_common.h"
+#include "llama/ll_counters.h"
+#include "llama/ll_epoch.h"
 #include "llama/ll_mlcsr_graph.h"
+#include "llama/ll_wal.h"
 #include "llama/ll_writable_array.h"
 #include "llama/ll_writable_elements.h"
 
@@ -74,6 +77,12 @@ std::atomic<long> g_last_timestamp(0);
 /// The total number of active transactions
 std::atomic<int> g_active_transactions(0);
 
+/// The start timestamps of the active transactions
+ll_slot_registry g_tx_active;
+
+/// The slot of this thread's transaction in g_tx_active
+__thread int g_tx_slot;
+
 #ifdef LL_TIMESTAMPS
 #define LL_TX_TIMESTAMP		g_tx_timestamp
 #else
@@ -84,19 +93,115 @@ std::atomic<int> g_active_transactions(0);
 #define LL_TX_TIMESTAMP		0
 #endif
 
+#if defined(LL_TIMESTAMPS) && !defined(LL_TX)
+#	error "LL_TIMESTAMPS requires LL_TX"
+#endif
+
+#ifndef NDEBUG
+/// The number of read_begin() calls without a matching read_end() in this
+/// thread, which the debug builds use to catch the unprotected readers
+__thread int g_read_depth;
+#endif
+
+
+#ifdef LL_TIMESTAMPS
+
+#define LL_TX_UNDO_ADD_NODE				1
+#define LL_TX_UNDO_DELETE_NODE			2
+#define LL_TX_UNDO_ADD_EDGE				3
+#define LL_TX_UNDO_DELETE_EDGE			4
+#define LL_TX_UNDO_DELETE_FROZEN_EDGE	5
+
+#define LL_TX_UNDO_F_NEW_OUT			1	/* created the out-map entry */
+#define LL_TX_UNDO_F_NEW_IN				2	/* created the in-map entry */
+#define LL_TX_UNDO_F_LOWERED			4	/* lowered the max. level */
+
+/**
+ * An undo record of a transaction, used to roll back the transaction
+ */
+typedef struct {
+
+	/// The type of the record (LL_TX_UNDO_*)
+	int u_type;
+
+	/// The affected w_node or w_edge
+	void* u_object;
+
+	/// The affected frozen out-edge and the corresponding in-edge
+	edge_t u_out_edge;
+	edge_t u_in_edge;
+
+	/// The previous deletion timestamps of the out-edge and the in-edge
+	long u_old_out;
+	long u_old_in;
+
+	/// The endpoints of the frozen edge
+	node_t u_source;
+	node_t u_target;
+
+	/// The side effects of deleting the frozen edge (LL_TX_UNDO_F_*)
+	int u_flags;
+
+	/// The previous max. visibility level of the frozen edge
+	int u_old_level;
+
+} ll_tx_undo_t;
+
+/// The undo log of this thread's transaction
+__thread std::vector<ll_tx_undo_t>* g_tx_undo = NULL;
+
+#endif
+
+
+/**
+ * Get the latest timestamp that is stable, i.e. such that no active or
+ * future transaction can write anything at or below it. Reading at this
+ * timestamp thus never observes a partially applied transaction.
+ *
+ * @return the stable timestamp, or 0 if transactions are not enabled
+ */
+inline long ll_tx_stable_timestamp(void) {
+#ifdef LL_TX
+	long last = g_last_timestamp.load();
+	long oldest = g_tx_active.min(last + 1);
+	return std::min(last, oldest - 1);
+#else
+	return 0;
+#endif
+}
+
 
 
 /**
  * The writable graph
  *
+ * A checkpoint can run concurrently with the readers that bracket their
+ * reads with read_begin() and read_end(), but not with the writers, which
+ * must be quiescent for its whole duration; ll_la_ingest parks its appliers
+ * for that reason. The debug builds assert that no thread starts an edge
+ * iterator outside of read_begin() and read_end() while another thread
+ * checkpoints.
+ *
  * @author Peter Macko
  */
 class ll_writable_graph {
 
+	friend class ll_writable_snapshot;
+
 	typedef struct {
 		std::vector<edge_t> an_deleted_edges;
 	} affected_node_by_edge_deletion_t;
 
+	/**
+	 * A generation of the writable representation; each checkpoint starts
+	 * a new one and retires the old one until no reader can observe it
+	 */
+	typedef struct {
+		ll_w_vt_vertices_t* wg_vertices;
+		volatile int wg_levels;		// the RO levels under it, or -1 = all
+		std::vector<size_t>* wg_retired_pool;
+	} w_generation_t;
+
 
 public:
 
@@ -112,7 +217,10 @@ public:
 			size_t max_nodes)
 
 		: _ro_graph(database IF_LL_PERSISTENCE(, storage)),
-		  _vertices(max_nodes),
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+		  _w_pool(32 * 1048576ul, -1, LL_W_MEM_POOL_MAX_BUFFERS,
+				  &__w_pool_chunks),
+#endif
 		  _deletions_adapter_out(*this),
 		  _deletions_adapter_in(*this)
 	{
@@ -126,6 +234,12 @@ public:
 		_deletions_out_lock = 0;
 		_deletions_in_lock = 0;
 		_property_lock = 0;
+		_snapshot_lock = 0;
+		_deleted_levels = 0;
+		_checkpointing = 0;
+
+		_generation = new_generation(max_nodes);
+		IF_LL_WAL(_wal = NULL);
 
 		_ro_graph.set_deletion_checkers(&_deletions_adapter_out,
 				&_deletions_adapter_in);
@@ -133,8 +247,8 @@ public:
 		_next_new_node_id = _ro_graph.max_nodes();
 
 #ifdef LL_WRITABLE_USE_MEMORY_POOL
-		if (__w_pool.chunk_size() > ((1ul << LL_MEM_POOL_ALIGN_BITS) << LL_W_MEM_POOL_MAX_OFFSET_BITS)) {
-			LL_E_PRINT("__w_pool.chunk_size() is too large\n");
+		if (_w_pool.chunk_size() > ((1ul << LL_MEM_POOL_ALIGN_BITS) << LL_W_MEM_POOL_MAX_OFFSET_BITS)) {
+			LL_E_PRINT("_w_pool.chunk_size() is too large\n");
 			abort();
 		}
 #endif
@@ -146,9 +260,10 @@ public:
 	 */
 	virtual ~ll_writable_graph(void) {
 
-#ifdef LL_WRITABLE_USE_MEMORY_POOL
-		ll_free_w_pool();
-#else
+		_epochs.flush();
+		delete_generation(_generation);
+
+#ifndef LL_WRITABLE_USE_MEMORY_POOL
 		delete_free_w_nodes();
 		delete_free_w_edges();
 #endif
@@ -176,8 +291,20 @@ public:
 	long tx_begin() {
 #ifdef LL_TX
 		g_active_transactions.fetch_add(1);
+
+		// Publish a lower bound of the timestamp before taking it, so that
+		// ll_tx_stable_timestamp() never skips over this transaction
+
+		g_tx_slot = g_tx_active.acquire(g_last_timestamp.load() + 1);
 		g_tx_timestamp = g_last_timestamp.fetch_add(1) + 1;
+		g_tx_active.update(g_tx_slot, g_tx_timestamp);
 		g_tx_write = false;
+
+#ifdef LL_TIMESTAMPS
+		if (g_tx_undo == NULL) g_tx_undo = new std::vector<ll_tx_undo_t>();
+		g_tx_undo->clear();
+#endif
+
 		return g_tx_timestamp;
 #else
 		return 0;
@@ -190,26 +317,62 @@ public:
 	 */
 	void tx_commit() {
 #ifdef LL_TX
+#ifdef LL_TIMESTAMPS
+		g_tx_undo->clear();
+
+		// The replay skips the logged updates of a transaction without a
+		// commit record, such as one interrupted by a crash
+
+		if (g_tx_write) {
+			IF_LL_WAL(wal_log(LL_WAL_COMMIT, 0));
+		}
+#endif
 		g_tx_timestamp = 0;
+		g_tx_active.release(g_tx_slot);
 		int n = g_active_transactions.fetch_add(-1);
 		assert(n > 0); (void) n;
 #endif
+
+		IF_LL_WAL(if (_wal != NULL) _wal->commit());
 	}
 
 
 	/**
-	 * Abort the transaction
+	 * Abort the transaction, rolling back all of its writes. The rollback
+	 * requires the per-version timestamps (LL_TIMESTAMPS); without them, only
+	 * read-only transactions can be aborted.
 	 */
 	void tx_abort() {
 #ifdef LL_TX
+#ifdef LL_TIMESTAMPS
+		std::vector<ll_tx_undo_t>& log = *g_tx_undo;
+		for (ssize_t i = ((ssize_t) log.size()) - 1; i >= 0; i--) {
+			tx_undo(log[i]);
+		}
+		log.clear();
+
+		// The logged updates may be already durable; the replay skips them,
+		// since there is no commit record, but record the abort explicitly
+
+		if (g_tx_write) {
+			IF_LL_WAL(wal_log(LL_WAL_ABORT, 0));
+			IF_LL_WAL(wal_sync());
+		}
+#else
+		if (g_tx_write) {
+			LL_E_PRINT("Cannot roll back a transaction with writes "
+					"without LL_TIMESTAMPS\n");
+			abort();
+		}
+#endif
 		g_tx_timestamp = 0;
+		g_tx_active.release(g_tx_slot);
 		int n = g_active_transactions.fetch_add(-1);
 		assert(n > 0); (void) n;
-#endif
-
-		// TODO What to do now?
-
+#else
+		LL_E_PRINT("Cannot roll back a transaction without LL_TX\n");
 		abort();
+#endif
 	}
 
 
@@ -285,9 +448,9 @@ public:
 	 */
 	void callback_ro_changed(void) {
 
-		ll_spinlock_acquire(&_new_node_lock);
+		ll_adaptive_lock_acquire(&_new_node_lock, LL_L_NEW_NODE);
 		_next_new_node_id = _ro_graph.max_nodes();
-		ll_spinlock_release(&_new_node_lock);
+		ll_adaptive_lock_release(&_new_node_lock);
 	}
 
 
@@ -299,7 +462,7 @@ public:
 	 */
 	inline bool node_exists(node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		w_node* r = (w_node*) _generation->wg_vertices->get(node);
 		if (r != NULL) return true;
 
 		return _ro_graph.node_exists(node);
@@ -313,10 +476,10 @@ public:
 	 */
 	node_t add_node() {
 
-		ll_spinlock_acquire(&_new_node_lock);
+		ll_adaptive_lock_acquire(&_new_node_lock, LL_L_NEW_NODE);
 
-		if (_next_new_node_id + 1 >= (node_t) _vertices.size()) {
-			ll_spinlock_release(&_new_node_lock);
+		if (_next_new_node_id + 1 >= (node_t) _generation->wg_vertices->size()) {
+			ll_adaptive_lock_release(&_new_node_lock);
 			return LL_NIL_NODE;
 		}
 
@@ -329,16 +492,19 @@ public:
 
 		// TODO We just want to allocate - or do we need to
 		// do that spinlock thing? Maybe it's not necessary.
-		w_node* r = (w_node*) _vertices.get_or_allocate(n);
+		w_node* r = (w_node*) _generation->wg_vertices->get_or_allocate(n);
 		(void) r;
 
 #ifdef LL_TIMESTAMPS
 		r->wn_timestamp_creation = LL_TX_TIMESTAMP;
+		tx_log(LL_TX_UNDO_ADD_NODE, r);
 #endif
 
 		_newNodes++;
-		ll_spinlock_release(&_new_node_lock);
+		IF_LL_WAL(wal_log(LL_WAL_ADD_NODE, n));
+		ll_adaptive_lock_release(&_new_node_lock);
 
+		IF_LL_WAL(wal_sync());
 		return n;
 	}
 
@@ -351,10 +517,10 @@ public:
 	 */
 	bool add_node(node_t id) {
 
-		ll_spinlock_acquire(&_new_node_lock);
+		ll_adaptive_lock_acquire(&_new_node_lock, LL_L_NEW_NODE);
 
-		if (id >= (node_t) _vertices.size()) {
-			ll_spinlock_release(&_new_node_lock);
+		if (id >= (node_t) _generation->wg_vertices->size()) {
+			ll_adaptive_lock_release(&_new_node_lock);
 			return false;
 		}
 
@@ -362,24 +528,27 @@ public:
 		g_tx_write = true;
 #endif
 
-		if (id > _next_new_node_id) _next_new_node_id = id;
 		if (node_exists(id)) {
-			ll_spinlock_release(&_new_node_lock);
+			ll_adaptive_lock_release(&_new_node_lock);
 			return false;
 		}
+		if (id >= _next_new_node_id) _next_new_node_id = id + 1;
 
 		// TODO We just want to allocate - or do we need to
 		// do that spinlock thing? Maybe it's not necessary.
-		w_node* r = (w_node*) _vertices.get_or_allocate(id);
+		w_node* r = (w_node*) _generation->wg_vertices->get_or_allocate(id);
 		(void) r;
 
 #ifdef LL_TIMESTAMPS
 		r->wn_timestamp_creation = LL_TX_TIMESTAMP;
+		tx_log(LL_TX_UNDO_ADD_NODE, r);
 #endif
 
 		_newNodes++;	// TODO Make checkpointing to work
-		ll_spinlock_release(&_new_node_lock);
+		IF_LL_WAL(wal_log(LL_WAL_ADD_NODE, id));
+		ll_adaptive_lock_release(&_new_node_lock);
 
+		IF_LL_WAL(wal_sync());
 		return true;
 	}
 
@@ -439,12 +608,19 @@ public:
 		// Mark the node as deleted
 
 #ifdef LL_TIMESTAMPS
+		tx_log(LL_TX_UNDO_DELETE_NODE, p_node, p_node->wn_timestamp_deletion);
 		p_node->wn_timestamp_deletion = LL_TX_TIMESTAMP;
 #else
 		p_node->wn_deleted = true;
 #endif
 
 
+		// Log it under the node lock, so that the log orders it relative to
+		// the concurrent updates of the node's edges as they are applied
+
+		IF_LL_WAL(wal_log(LL_WAL_DELETE_NODE, node));
+
+
 		if (_ro_graph.node_exists(node)) {
 
 			// Delete the frozen out-edges
@@ -456,7 +632,7 @@ public:
 			ll_edge_iterator iter;
 			_ro_graph.out_iter_begin(iter, node);
 			FOREACH_OUTEDGE_ITER(edge, _ro_graph, iter) {
-				delete_edge(node, edge);
+				delete_edge_unlogged(node, edge);
 			}
 
 
@@ -468,7 +644,7 @@ public:
 #endif
 			_ro_graph.in_iter_begin(iter, node);
 			FOREACH_INEDGE_ITER(edge, _ro_graph, iter) {
-				delete_edge(iter.last_node, edge);
+				delete_edge_unlogged(iter.last_node, edge);
 			}
 		}
 
@@ -494,6 +670,7 @@ public:
 
 #ifdef LL_TIMESTAMPS
 			if (t < e->we_timestamp_deletion) {
+				tx_log(LL_TX_UNDO_DELETE_EDGE, e, e->we_timestamp_deletion);
 				e->we_timestamp_deletion = t;
 				if (t > p_target->wn_timestamp_update) p_target->wn_timestamp_update = t;
 				p_target->wn_in_edges_delta--;	// TODO What kind of condition do I need for this?
@@ -532,6 +709,7 @@ public:
 
 #ifdef LL_TIMESTAMPS
 			if (t < e->we_timestamp_deletion) {
+				tx_log(LL_TX_UNDO_DELETE_EDGE, e, e->we_timestamp_deletion);
 				e->we_timestamp_deletion = t;
 				if (t > p_source->wn_timestamp_update) p_source->wn_timestamp_update = t;
 				p_source->wn_out_edges_delta--;
@@ -557,6 +735,8 @@ public:
 		// Cleanup
 
 		release_node(p_node);
+
+		IF_LL_WAL(wal_sync());
 #endif
 	}
 
@@ -576,7 +756,7 @@ protected:
 
 		LL_D_NODE2_PRINT(source, target, "Add %ld --> %ld\n", source, target);
 
-		w_edge_allocator _allocator;
+		w_edge_allocator _allocator(w_pool());
 #ifdef LL_WRITABLE_USE_MEMORY_POOL
 		size_t we_chunk, we_offset;
 		w_edge* we = _allocator(&we_chunk, &we_offset);
@@ -625,6 +805,7 @@ protected:
 		if (t > p_target->wn_timestamp_update) p_target->wn_timestamp_update = t;
 
 		p_edge->we_timestamp_deletion = LONG_MAX;
+		tx_log(LL_TX_UNDO_ADD_EDGE, p_edge);
 #else
 		p_edge->we_deleted = false;
 #endif
@@ -635,6 +816,7 @@ protected:
 		uint32_t id = _newEdges.fetch_add(1);
 		p_edge->we_numerical_id = id;
 
+		IF_LL_WAL(wal_log(LL_WAL_ADD_EDGE, source, target, out_edge));
 		return out_edge;
 	}
 
@@ -659,6 +841,7 @@ public:
 		out_edge = add_edge(source, target, p_source, p_target);
 		release_nodes(p_source, p_target);
 
+		IF_LL_WAL(wal_sync());
 		return out_edge;
 	}
 
@@ -704,6 +887,7 @@ public:
 		e = add_edge(source, target, p_source, p_target);
 		release_nodes(p_source, p_target);
 
+		IF_LL_WAL(wal_sync());
 		*out = e;
 		return true;
 	}
@@ -790,6 +974,22 @@ public:
 	 */
 	void delete_edge(node_t source, edge_t edge) {
 
+		IF_LL_WAL(wal_log(LL_WAL_DELETE_EDGE, source, edge));
+		delete_edge_unlogged(source, edge);
+		IF_LL_WAL(wal_sync());
+	}
+
+
+protected:
+
+	/**
+	 * Delete an edge without logging it in the write-ahead log
+	 *
+	 * @param source the source node
+	 * @return edge the edge
+	 */
+	void delete_edge_unlogged(node_t source, edge_t edge) {
+
 #ifdef LL_DELETIONS
 
 		// Needs edge sources
@@ -823,6 +1023,7 @@ public:
 
 #ifdef LL_TIMESTAMPS
 			if (t < w->we_timestamp_deletion) {
+				tx_log(LL_TX_UNDO_DELETE_EDGE, w, w->we_timestamp_deletion);
 				w->we_timestamp_deletion = t;
 				if (t > p_source->wn_timestamp_update) p_source->wn_timestamp_update = t;
 				if (t > p_target->wn_timestamp_update) p_target->wn_timestamp_update = t;
@@ -852,7 +1053,9 @@ public:
 		else {
 
 			//node_t source = _ro_graph.edge_src(edge);
-			assert(source == _ro_graph.in().value(_ro_graph.out_to_in(edge)));
+			assert(!_ro_graph.has_reverse_edges()
+					|| !_ro_graph.out().has_edge_translation()
+					|| source == _ro_graph.in().value(_ro_graph.out_to_in(edge)));
 			node_t target = _ro_graph.edge_dst(edge);
 
 			LL_D_NODE2_PRINT(source, target,
@@ -866,8 +1069,8 @@ public:
 			// TODO A finer granularity lock? The following are just intended to be latches
 			// for the deletion maps data structures
 
-			ll_spinlock_acquire(&_deletions_out_lock);
-			ll_spinlock_acquire(&_deletions_in_lock);
+			ll_adaptive_lock_acquire(&_deletions_out_lock, LL_L_DELETIONS);
+			ll_adaptive_lock_acquire(&_deletions_in_lock, LL_L_DELETIONS);
 
 
 			// Update the external deletion maps
@@ -878,10 +1081,17 @@ public:
 
 			auto it = _deletions_out_map.find(edge);
 			bool alreadyDeleted = false;
+			long old_out = LONG_MAX;
+			long old_in = LONG_MAX;
+			edge_t in_edge = LL_NIL_EDGE;
+			int flags = 0;
+			int old_level = 0;
 			if (it == _deletions_out_map.end()) {
 				_deletions_out_map[edge] = t;
+				flags |= LL_TX_UNDO_F_NEW_OUT;
 			}
 			else {
+				old_out = it->second;
 				it->second = std::min(t, it->second);
 				alreadyDeleted = true;
 			}
@@ -892,13 +1102,15 @@ public:
 			}
 
 			if (_ro_graph.has_reverse_edges()) {
-				edge_t in_edge = _ro_graph.out_to_in(edge);
+				in_edge = _ro_graph.out_to_in(edge);
 				it = _deletions_in_map.find(in_edge);
 				if (it == _deletions_in_map.end()) {
 					_deletions_in_map[in_edge] = t;
+					flags |= LL_TX_UNDO_F_NEW_IN;
 					alreadyDeleted = false;
 				}
 				else {
+					old_in = it->second;
 					it->second = std::min(t, it->second);
 					alreadyDeleted = true;
 				}
@@ -909,26 +1121,45 @@ public:
 				}
 			}
 
-
 			// TODO Update the timestamps at the nodes?
 
 
 			// Update the max. level in the CSR
 
-			if (_ro_graph.update_max_visible_level_lower_only(edge, LL_CHECK_EXT_DELETION)) {
+			if (_ro_graph.update_max_visible_level_lower_only(edge,
+						LL_CHECK_EXT_DELETION, &old_level)) {
 #	ifdef D_DEBUG_NODE
 				if (source == D_DEBUG_NODE || target == D_DEBUG_NODE) fprintf(stderr, " [ok]");
 #	endif
 				__sync_fetch_and_add(&writable_node(source)->wn_num_deleted_out_edges, 1);
 				__sync_fetch_and_add(&writable_node(target)->wn_num_deleted_in_edges , 1);
 				_delFrozenEdges++;
+				flags |= LL_TX_UNDO_F_LOWERED;
+			}
+
+
+			// Log all of the above, so that an abort can revert it
+
+			if (t < old_out) {
+				ll_tx_undo_t u;
+				u.u_type = LL_TX_UNDO_DELETE_FROZEN_EDGE;
+				u.u_object = NULL;
+				u.u_out_edge = edge;
+				u.u_in_edge = in_edge;
+				u.u_old_out = old_out;
+				u.u_old_in = old_in;
+				u.u_source = source;
+				u.u_target = target;
+				u.u_flags = flags;
+				u.u_old_level = old_level;
+				tx_log(u);
 			}
 
 
 			// Release locks
 
-			ll_spinlock_release(&_deletions_in_lock);
-			ll_spinlock_release(&_deletions_out_lock);
+			ll_adaptive_lock_release(&_deletions_in_lock);
+			ll_adaptive_lock_release(&_deletions_out_lock);
 
 #else /* !LL_TIMESTAMPS */
 
@@ -954,6 +1185,9 @@ public:
 	}
 
 
+public:
+
+
 	/**
 	 * Get the destination of the edge
 	 *
@@ -968,6 +1202,28 @@ public:
     }
 
 
+	/**
+	 * Get the out-degree prefix sums of the latest read-only level; the edges
+	 * added since the last checkpoint are not included
+	 *
+	 * @return the prefix sums, or NULL if there are no levels
+	 */
+	inline const ll_degree_prefix_sums* out_degree_prefix_sums() {
+		return _ro_graph.out_degree_prefix_sums();
+	}
+
+
+	/**
+	 * Get the in-degree prefix sums of the latest read-only level; the edges
+	 * added since the last checkpoint are not included
+	 *
+	 * @return the prefix sums, or NULL if there are no levels or in-edges
+	 */
+	inline const ll_degree_prefix_sums* in_degree_prefix_sums() {
+		return _ro_graph.in_degree_prefix_sums();
+	}
+
+
 	/**
 	 * Get the node out-degree
 	 *
@@ -976,7 +1232,7 @@ public:
 	 */
 	size_t out_degree(node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		w_node* r = (w_node*) _generation->wg_vertices->get(node);
 		size_t d = 0;
 
 		if (r != NULL) {
@@ -989,9 +1245,9 @@ public:
 
 			size_t n = r->wn_out_edges.size();
 			for (size_t i = 0; i < n; i++) {
-				const w_edge& e = r->wn_out_edges[i];
-				if (t >= e.we_timestamp_creation
-						&& t < e.we_timestamp_deletion) d++;
+				const w_edge* e = r->wn_out_edges[i];
+				if (t >= e->we_timestamp_creation
+						&& t < e->we_timestamp_deletion) d++;
 			}
 #	else
 			if (!r->exists()) return 0;
@@ -1049,7 +1305,7 @@ retry:
 	 */
 	size_t in_degree(node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		w_node* r = (w_node*) _generation->wg_vertices->get(node);
 		size_t d = 0;
 
 		if (r != NULL) {
@@ -1062,9 +1318,9 @@ retry:
 
 			size_t n = r->wn_in_edges.size();
 			for (size_t i = 0; i < n; i++) {
-				const w_edge& e = r->wn_in_edges[i];
-				if (t >= e.we_timestamp_creation
-						&& t < e.we_timestamp_deletion) d++;
+				const w_edge* e = r->wn_in_edges[i];
+				if (t >= e->we_timestamp_creation
+						&& t < e->we_timestamp_deletion) d++;
 			}
 #	else
 			if (!r->exists()) return 0;
@@ -1120,9 +1376,28 @@ retry:
 	 * @param v the vertex
 	 * @return the iterator
 	 */
-	void out_iter_begin(ll_edge_iterator& iter, node_t node) {
+	inline void out_iter_begin(ll_edge_iterator& iter, node_t node) {
+		out_iter_begin_at(iter, node, 0);
+	}
+
+
+	/**
+	 * Create iterator over the outgoing edges starting at the given position
+	 * of the adjacency list, which consists of the writable edges (newest
+	 * first) followed by the read-only levels. The position counts also the
+	 * deleted edges, and the read-only levels are entered without visiting
+	 * the skipped edges.
+	 *
+	 * @param iter the iterator
+	 * @param v the vertex
+	 * @param from the position within the adjacency list
+	 */
+	void out_iter_begin_at(ll_edge_iterator& iter, node_t node, size_t from) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		check_read_protected();
+
+		int levels;
+		w_node* r = writable_node(node, levels);
 		if (r == NULL) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
 			if (!_ro_graph.node_exists(node)) {
@@ -1132,14 +1407,18 @@ retry:
 				return;
 			}
 #endif
-			_ro_graph.out_iter_begin(iter, node, _ro_graph.num_levels()-1,
-					_ro_graph.num_levels());
+			_ro_graph.out().iter_begin_at(iter, node, from, levels-1, levels);
 			LL_D_NODE_PRINT(node, "[owner=%d, left=%ld]\n",
 					(int) iter.owner, (long) iter.left);
 			return;
 		}
 
 
+		// The node has a writable part
+
+		LL_COUNT(LL_C_WRITABLE_HITS);
+
+
 		// Check if the node is deleted
 
 #ifdef LL_DELETIONS
@@ -1165,8 +1444,9 @@ retry:
 		iter.ptr = r;
 		iter.node = node;
 		iter.left = r->wn_out_edges.size();
+		iter.ro_levels = levels;
 
-		if (iter.left == 0) {
+		if (iter.left <= from) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
 			if (!_ro_graph.node_exists(node)) {
 				_ro_graph.out().iter_set_to_end(iter);
@@ -1175,10 +1455,11 @@ retry:
 				return;
 			}
 #endif
-			_ro_graph.out_iter_begin(iter, node, _ro_graph.num_levels()-1,
-					_ro_graph.num_levels());
+			_ro_graph.out().iter_begin_at(iter, node, from - iter.left,
+					levels-1, levels);
 		}
 		else {
+			iter.left -= from;
 			w_edge* e = ((w_node*) iter.ptr)->wn_out_edges[--iter.left];
 			iter.edge = (long) e;
 #ifdef LL_DELETIONS
@@ -1242,7 +1523,8 @@ retry:
 					break;
 				}
 #endif
-				_ro_graph.out_iter_begin(iter, iter.node, _ro_graph.num_levels()-1, _ro_graph.num_levels());
+				_ro_graph.out_iter_begin(iter, iter.node, iter.ro_levels-1,
+						iter.ro_levels);
 				break;
 			}
 
@@ -1286,6 +1568,22 @@ retry:
 	}
 
 
+	/**
+	 * Start an iterator at the given position and get the next value
+	 * immediately
+	 *
+	 * @param iter the iterator
+	 * @param n the node
+	 * @param from the position within the adjacency list
+	 * @return the next item, or LL_NIL_EDGE if none
+	 */
+	inline edge_t out_iter_begin_next_at(ll_edge_iterator& iter, node_t n,
+			size_t from) {
+		this->out_iter_begin_at(iter, n, from);
+		return this->out_iter_next(iter);
+	}
+
+
 	/**
 	 * Finish the iterator
 	 *
@@ -1304,7 +1602,7 @@ retry:
 	 */
 	void out_iter_begin_within_level(ll_edge_iterator& iter, node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		w_node* r = (w_node*) _generation->wg_vertices->get(node);
 
 		if (r == NULL) {
 			iter.left = 0;
@@ -1426,7 +1724,10 @@ retry:
 	 */
 	void in_iter_begin_fast(ll_edge_iterator& iter, node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		check_read_protected();
+
+		int levels;
+		w_node* r = writable_node(node, levels);
 		if (r == NULL) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
 			if (!_ro_graph.node_exists(node)) {
@@ -1434,11 +1735,16 @@ retry:
 				return;
 			}
 #endif
-			_ro_graph.in_iter_begin_fast(iter, node);
+			_ro_graph.in_iter_begin_fast(iter, node, levels-1);
 			return;
 		}
 
 
+		// The node has a writable part
+
+		LL_COUNT(LL_C_WRITABLE_HITS);
+
+
 		// Check if the node is deleted
 
 #ifdef LL_DELETIONS
@@ -1464,6 +1770,7 @@ retry:
 		iter.ptr = r;
 		iter.node = node;
 		iter.left = r->wn_in_edges.size();
+		iter.ro_levels = levels;
 
 		if (iter.left == 0) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
@@ -1472,7 +1779,7 @@ retry:
 				return;
 			}
 #endif
-			_ro_graph.in_iter_begin_fast(iter, node);
+			_ro_graph.in_iter_begin_fast(iter, node, levels-1);
 		}
 		else {
 			w_edge* e = ((w_node*) iter.ptr)->wn_in_edges[--iter.left];
@@ -1535,7 +1842,7 @@ retry:
 					break;
 				}
 #endif
-				_ro_graph.in_iter_begin_fast(iter, iter.node);
+				_ro_graph.in_iter_begin_fast(iter, iter.node, iter.ro_levels-1);
 				break;
 			}
 
@@ -1563,6 +1870,34 @@ retry:
 	}
 
 
+	/**
+	 * Advise the OS about the upcoming accesses to the outgoing edges of the
+	 * given nodes in the read-only levels
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void out_advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
+		_ro_graph.out_advise(nodes, count, advice);
+	}
+
+
+	/**
+	 * Advise the OS about the upcoming accesses to the incoming edges of the
+	 * given nodes in the read-only levels
+	 *
+	 * @param nodes the nodes
+	 * @param count the number of nodes
+	 * @param advice the advice (LL_ADV_*)
+	 */
+	void in_advise(const node_t* nodes, size_t count,
+			int advice = LL_ADV_WILLNEED) {
+		_ro_graph.in_advise(nodes, count, advice);
+	}
+
+
 	/**
 	 * Create iterator over all incoming nodes
 	 *
@@ -1572,7 +1907,10 @@ retry:
 	 */
 	void inm_iter_begin(ll_edge_iterator& iter, node_t node) {
 
-		w_node* r = (w_node*) _vertices.get(node);
+		check_read_protected();
+
+		int levels;
+		w_node* r = writable_node(node, levels);
 		if (r == NULL) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
 			if (!_ro_graph.node_exists(node)) {
@@ -1582,11 +1920,15 @@ retry:
 			}
 #endif
 			LL_D_NODE_PRINT(node, "Not in ll_writable_graph, descending\n");
-			_ro_graph.inm_iter_begin(iter, node, _ro_graph.num_levels()-1,
-					_ro_graph.num_levels());
+			_ro_graph.inm_iter_begin(iter, node, levels-1, levels);
 			return;
 		}
 
+		// The node has a writable part
+
+		LL_COUNT(LL_C_WRITABLE_HITS);
+
+
 		// Check if the node is deleted
 
 #ifdef LL_DELETIONS
@@ -1615,6 +1957,7 @@ retry:
 		iter.ptr = r;
 		iter.node = node;
 		iter.left = r->wn_in_edges.size();
+		iter.ro_levels = levels;
 
 		if (iter.left == 0) {
 #ifndef LL_CHECK_NODE_EXISTS_IN_RO
@@ -1623,8 +1966,7 @@ retry:
 				return;
 			}
 #endif
-			_ro_graph.inm_iter_begin(iter, node, _ro_graph.num_levels()-1,
-					_ro_graph.num_levels());
+			_ro_graph.inm_iter_begin(iter, node, levels-1, levels);
 			LL_D_NODE_PRINT(node, "No writable edges, descending\n");
 		}
 		else {
@@ -1689,7 +2031,8 @@ retry:
 					break;
 				}
 #endif
-				_ro_graph.inm_iter_begin(iter, iter.node, _ro_graph.num_levels()-1, _ro_graph.num_levels());
+				_ro_graph.inm_iter_begin(iter, iter.node, iter.ro_levels-1,
+						iter.ro_levels);
 				break;
 			}
 
@@ -1749,6 +2092,48 @@ retry:
 	}
 
 
+	/**
+	 * Set a node property in the writable level, and log it in the
+	 * write-ahead log if there is one. The value is logged bitwise, so it
+	 * must not be a pointer.
+	 *
+	 * @param p the property
+	 * @param node the node
+	 * @param value the value
+	 */
+	template<typename T>
+	void set_node_property(ll_mlcsr_node_property<T>* p, node_t node,
+			const T& value) {
+
+		IF_LL_WAL(wal_log(sizeof(T) == 4 ? LL_WAL_NODE_PROPERTY_32
+					: LL_WAL_NODE_PROPERTY_64, node, wal_value(value), 0,
+					p->name()));
+		p->set(node, value);
+		IF_LL_WAL(wal_sync());
+	}
+
+
+	/**
+	 * Set an edge property in the writable level, and log it in the
+	 * write-ahead log if there is one. The value is logged bitwise, so it
+	 * must not be a pointer.
+	 *
+	 * @param p the property
+	 * @param edge the edge
+	 * @param value the value
+	 */
+	template<typename T>
+	void set_edge_property(ll_mlcsr_edge_property<T>* p, edge_t edge,
+			const T& value) {
+
+		IF_LL_WAL(wal_log(sizeof(T) == 4 ? LL_WAL_EDGE_PROPERTY_32
+					: LL_WAL_EDGE_PROPERTY_64, edge, wal_value(value), 0,
+					p->name()));
+		p->set(edge, value);
+		IF_LL_WAL(wal_sync());
+	}
+
+
 	/**
 	 * Get a 32-bit node property
 	 *
@@ -1761,7 +2146,7 @@ retry:
 		if (p == NULL) return NULL;
 
 		ll_spinlock_acquire(&_property_lock);
-		if (!p->writable()) p->writable_init(_vertices.size());
+		if (!p->writable()) p->writable_init(_generation->wg_vertices->size());
 		ll_spinlock_release(&_property_lock);
 
 		return p;
@@ -1780,7 +2165,7 @@ retry:
 		if (p == NULL) return NULL;
 
 		ll_spinlock_acquire(&_property_lock);
-		if (!p->writable()) p->writable_init(_vertices.size());
+		if (!p->writable()) p->writable_init(_generation->wg_vertices->size());
 		ll_spinlock_release(&_property_lock);
 
 		return p;
@@ -1867,10 +2252,10 @@ protected:
 		virtual size_t num_new_nodes() { return _owner._newNodes.load(); }
 		virtual size_t num_new_edges() { return _owner._newEdges.load(); }
 		virtual size_t max_node_id() { return _owner._next_new_node_id - 1; }
-		virtual ll_w_vt_vertices_t* vertex_table() { return &_owner._vertices; }
+		virtual ll_w_vt_vertices_t* vertex_table() { return _owner._generation->wg_vertices; }
 
 		virtual void get_out_edges(node_t node, std::vector<node_t>& new_edges) {
-			w_node* w = (w_node*) _owner._vertices.fast_get(node);
+			w_node* w = (w_node*) _owner._generation->wg_vertices->fast_get(node);
 			size_t num = w->wn_out_edges.size();
 			for (size_t i = 0; i < num; i++) {
 				if (w->wn_out_edges[i]->exists()) {
@@ -1895,19 +2280,19 @@ protected:
 		
 		virtual bool is_edge_deleted(edge_t edge) {
 #ifdef LL_DELETIONS
-			ll_spinlock_acquire(&_owner._deletions_out_lock);
+			ll_adaptive_lock_acquire(&_owner._deletions_out_lock, LL_L_DELETIONS);
 			auto it = _owner._deletions_out_map.find(edge);
 			if (it != _owner._deletions_out_map.end()) {
 #ifdef LL_TIMESTAMPS
 				bool r = g_tx_timestamp >= it->second;
-				ll_spinlock_release(&_owner._deletions_out_lock);
+				ll_adaptive_lock_release(&_owner._deletions_out_lock);
 				return r;
 #else
-				ll_spinlock_release(&_owner._deletions_out_lock);
+				ll_adaptive_lock_release(&_owner._deletions_out_lock);
 				return true;
 #endif
 			}
-			ll_spinlock_release(&_owner._deletions_out_lock);
+			ll_adaptive_lock_release(&_owner._deletions_out_lock);
 #endif
 			return false;
 		}
@@ -1928,19 +2313,19 @@ protected:
 		
 		virtual bool is_edge_deleted(edge_t edge) {
 #ifdef LL_DELETIONS
-			ll_spinlock_acquire(&_owner._deletions_in_lock);
+			ll_adaptive_lock_acquire(&_owner._deletions_in_lock, LL_L_DELETIONS);
 			auto it = _owner._deletions_in_map.find(edge);
 			if (it != _owner._deletions_in_map.end()) {
 #ifdef LL_TIMESTAMPS
 				bool r = g_tx_timestamp >= it->second;
-				ll_spinlock_release(&_owner._deletions_in_lock);
+				ll_adaptive_lock_release(&_owner._deletions_in_lock);
 				return r;
 #else
-				ll_spinlock_release(&_owner._deletions_in_lock);
+				ll_adaptive_lock_release(&_owner._deletions_in_lock);
 				return true;
 #endif
 			}
-			ll_spinlock_release(&_owner._deletions_in_lock);
+			ll_adaptive_lock_release(&_owner._deletions_in_lock);
 #endif
 			return false;
 		}
@@ -1950,7 +2335,8 @@ protected:
 public:
 
 	/**
-	 * Checkpoint
+	 * Checkpoint. The concurrent readers must be inside read_begin() and
+	 * read_end(), and there must be no concurrent writers.
 	 *
 	 * @param config the loader config
 	 */
@@ -1962,6 +2348,9 @@ public:
 				&& _delNewEdges.load() == 0
 				&& _delFrozenEdges.load() == 0) return;
 
+		_checkpoint_thread = pthread_self();
+		__sync_fetch_and_add(&_checkpointing, 1);
+
 		ll_loader_config default_config;
 		default_config.lc_reverse_edges = has_reverse_edges();
 		default_config.lc_reverse_maps = has_reverse_edges()
@@ -1977,16 +2366,29 @@ public:
 		}*/
 		
 		
-		// Create the new level
+		// Create the new level. The readers that started before see the old
+		// generation of the writable representation stacked on top of the
+		// levels that existed before, so pin that number first.
 
 		checkpoint_adapter adapter(*this);
+		w_generation_t* old = _generation;
+
+		ll_spinlock_acquire(&_snapshot_lock);
+
+		old->wg_levels = _ro_graph.num_levels();
 
 		__COMPILER_FENCE;
 		_ro_graph.checkpoint(&adapter, c);
 		__COMPILER_FENCE;
 
 
-		// Clear the writable representation
+		// Switch to a new generation of the writable representation, and
+		// retire the old one until all readers that can see it are done
+
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+		old->wg_retired_pool = _w_pool.retire();
+#endif
+		_generation = new_generation(old->wg_vertices->size());
 
 		_newNodes.store(0);
 		_delNodes.store(0);
@@ -1994,12 +2396,6 @@ public:
 		_delNewEdges.store(0);
 		_delFrozenEdges.store(0);
 
-		_vertices.clear();
-
-#ifdef LL_WRITABLE_USE_MEMORY_POOL
-		ll_free_w_pool();
-#endif
-
 		_deletions_out_map.clear();
 		_deletions_in_map.clear();
 
@@ -2008,7 +2404,28 @@ public:
 			_deletions_nodes_in[i].clear();
 		}
 
+		ll_spinlock_release(&_snapshot_lock);
+
+		retired_generation_t* d = new retired_generation_t;
+		d->rg_owner = this;
+		d->rg_generation = old;
+		_epochs.retire(retire_generation, d);
+
 		callback_ro_changed();
+		_epochs.collect();
+
+
+		// Record the new level in the manifest, so that the next open does not
+		// need to scan and read all the files
+
+		IF_LL_PERSISTENCE(_ro_graph.storage()->write_manifest());
+
+
+		// The new level now holds everything in the write-ahead log
+
+		IF_LL_WAL(if (_wal != NULL) _wal->restart(_ro_graph.num_levels()));
+
+		__sync_fetch_and_add(&_checkpointing, -1);
 
 
 		// Check whether we ran out of the level ID space
@@ -2027,8 +2444,256 @@ public:
 	 */
 	void delete_level(size_t level) {
 
-		_ro_graph.delete_level(level);
+		// The active readers and snapshots might have the level pinned, and
+		// read_begin() does not synchronize with this, so always defer the
+		// deletion until the readers that entered before are done (if there
+		// are none, the collection below deletes the level right away)
+
+		deferred_level_deletion_t* d = new deferred_level_deletion_t;
+		d->dl_owner = this;
+		d->dl_level = level;
+		_epochs.retire(deferred_delete_level, d);
+
 		callback_ro_changed();
+		_epochs.collect();
+	}
+
+
+	/**
+	 * Reclaim the retired objects and levels that are no longer visible to
+	 * any snapshot
+	 *
+	 * @return the number of reclaimed objects
+	 */
+	size_t collect_garbage(void) {
+		return _epochs.collect();
+	}
+
+
+	/**
+	 * Start reading the graph in a way that is safe with respect to the
+	 * concurrent checkpoints and level deletions, which would otherwise
+	 * reclaim the w_node's, w_edge's, and levels while the iterators still
+	 * point to them. The iterators do not do this on their own, since they
+	 * have no mandatory end call. This protects only the readers: the
+	 * writers must still not run concurrently with a checkpoint.
+	 *
+	 * @return the reader slot, to be passed to read_end()
+	 */
+	inline int read_begin(void) {
+#ifndef NDEBUG
+		g_read_depth++;
+#endif
+		return _epochs.enter();
+	}
+
+
+	/**
+	 * Finish reading the graph
+	 *
+	 * @param slot the reader slot returned by read_begin()
+	 */
+	inline void read_end(int slot) {
+		_epochs.exit(slot);
+#ifndef NDEBUG
+		assert(g_read_depth > 0);
+		g_read_depth--;
+#endif
+	}
+
+
+	/**
+	 * Check that the calling thread does not read outside of read_begin()
+	 * and read_end() while another thread checkpoints (a no-op unless this
+	 * is a debug build)
+	 */
+	inline void check_read_protected(void) const {
+#ifndef NDEBUG
+		assert(g_read_depth > 0 || _checkpointing == 0
+				|| pthread_equal(_checkpoint_thread, pthread_self()));
+#endif
+	}
+
+
+#ifdef LL_WAL
+
+	/**
+	 * Log all subsequent updates in the write-ahead log. Its recovered
+	 * contents are discarded if the log does not start at the current
+	 * read-only levels, i.e. if it was already checkpointed; otherwise they
+	 * are kept until replay_wal().
+	 *
+	 * @param wal the write-ahead log
+	 */
+	void attach_wal(ll_wal* wal) {
+
+		assert(_wal == NULL);
+
+		if (wal->base_levels() != _ro_graph.num_levels()) {
+			if (wal->num_recovered() > 0
+					&& wal->base_levels() > _ro_graph.num_levels()) {
+				LL_W_PRINT("The write-ahead log starts at level %lu, but "
+						"there are only %lu levels; discarding it\n",
+						wal->base_levels(), _ro_graph.num_levels());
+			}
+			wal->restart(_ro_graph.num_levels());
+		}
+
+		_wal = wal;
+	}
+
+
+	/**
+	 * Replay the recovered contents of the attached write-ahead log into the
+	 * writable representation. This must run before any other updates, but
+	 * after creating the writable properties, since the logged updates of
+	 * the properties that do not exist are skipped.
+	 *
+	 * @return the number of replayed records
+	 */
+	size_t replay_wal() {
+
+		ll_wal* wal = _wal;
+		size_t n = 0;
+
+		if (wal != NULL && wal->num_recovered() > 0) {
+
+			// The logged IDs of the writable edges are not stable across
+			// restarts, so map them to the IDs of the replayed edges
+
+			std::unordered_map<edge_t, edge_t> edges;
+			size_t missing = 0;
+
+			auto map_edge = [&edges](edge_t e) -> edge_t {
+				if (!LL_EDGE_IS_WRITABLE(e)) return e;
+				auto it = edges.find(e);
+				return it == edges.end() ? LL_NIL_EDGE : it->second;
+			};
+
+			auto replay = [&](const ll_wal_record_t* r, const char* name) {
+
+				const int64_t* a = r->wr_args;
+				edge_t e;
+
+				switch (r->wr_type) {
+
+				case LL_WAL_ADD_NODE:
+					add_node((node_t) a[0]);
+					break;
+
+				case LL_WAL_DELETE_NODE:
+					delete_node(a[0]);
+					break;
+
+				case LL_WAL_ADD_EDGE:
+					edges[a[2]] = add_edge(a[0], a[1]);
+					break;
+
+				case LL_WAL_DELETE_EDGE:
+					e = map_edge(a[1]);
+					if (e != LL_NIL_EDGE) delete_edge(a[0], e);
+					break;
+
+				case LL_WAL_NODE_PROPERTY_32: {
+					auto p = get_node_property_32(name);
+					if (p != NULL) p->set(a[0], (uint32_t) a[1]); else missing++;
+					break;
+				}
+
+				case LL_WAL_NODE_PROPERTY_64: {
+					auto p = get_node_property_64(name);
+					if (p != NULL) p->set(a[0], (uint64_t) a[1]); else missing++;
+					break;
+				}
+
+				case LL_WAL_EDGE_PROPERTY_32: {
+					auto p = get_edge_property_32(name);
+					e = map_edge(a[0]);
+					if (p != NULL && e != LL_NIL_EDGE)
+						p->set(e, (uint32_t) a[1]);
+					else
+						missing++;
+					break;
+				}
+
+				case LL_WAL_EDGE_PROPERTY_64: {
+					auto p = get_edge_property_64(name);
+					e = map_edge(a[0]);
+					if (p != NULL && e != LL_NIL_EDGE)
+						p->set(e, (uint64_t) a[1]);
+					else
+						missing++;
+					break;
+				}
+
+				default:
+					LL_E_PRINT("Invalid write-ahead log record type %d\n",
+							(int) r->wr_type);
+					abort();
+				}
+			};
+
+#ifdef LL_TX
+			// Do not reuse the IDs of the logged transactions, since the
+			// replay skips all records of the aborted ones
+
+			long max_tx = (long) wal->max_tx();
+			long last = g_last_timestamp.load();
+			while (last < max_tx
+					&& !g_last_timestamp.compare_exchange_weak(last, max_tx));
+#endif
+
+			// Detach the log for the duration of the replay, so that the
+			// replayed updates are not logged again
+
+			_wal = NULL;
+
+			tx_begin();
+			n = wal->replay(replay);
+			tx_commit();
+
+			_wal = wal;
+
+			if (missing > 0) {
+				LL_W_PRINT("Skipped %lu logged property updates of missing "
+						"properties or edges\n", missing);
+			}
+		}
+
+		return n;
+	}
+
+
+	/**
+	 * Get the write-ahead log
+	 *
+	 * @return the write-ahead log, or NULL if not attached
+	 */
+	inline ll_wal* wal(void) {
+		return _wal;
+	}
+
+#endif
+
+
+	/**
+	 * Get the epoch manager that protects the snapshots
+	 *
+	 * @return the epoch manager
+	 */
+	inline ll_epoch_manager& epochs(void) {
+		return _epochs;
+	}
+
+
+	/**
+	 * Get the number of levels deleted so far, not counting the deletions
+	 * still deferred until the readers are done
+	 *
+	 * @return the number of deleted levels
+	 */
+	inline size_t num_deleted_levels(void) const {
+		return _deleted_levels;
 	}
 
 
@@ -2041,16 +2706,22 @@ private:
 	/// The read-only graph
 	ll_mlcsr_ro_graph _ro_graph;
 
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+
+	/// The memory pool for the w_node's and w_edge's of this graph
+	ll_w_pool_t _w_pool;
+#endif
+
 
 	/*
 	 * The writable representation
 	 */
 
-	/// The adjacency lists
-	ll_w_vt_vertices_t _vertices;
+	/// The current generation of the adjacency lists
+	w_generation_t* volatile _generation;
 
 	/// Lock for creating new nodes
-	ll_spinlock_t _new_node_lock;
+	ll_adaptive_lock_t _new_node_lock;
 	volatile node_t _next_new_node_id;
 
 	/// The number of new and deleted nodes
@@ -2069,13 +2740,13 @@ private:
 	deletions_adapter_out _deletions_adapter_out;
 	deletions_adapter_in _deletions_adapter_in;
 
-	/// The deletions from the RO graph - map and a spinlock for out-edges
+	/// The deletions from the RO graph - map and a lock for out-edges
 	std::unordered_map<edge_t, long> _deletions_out_map;
-	ll_spinlock_t _deletions_out_lock;
+	ll_adaptive_lock_t _deletions_out_lock;
 
-	/// The deletions from the RO graph - map and a spinlock for in-edges
+	/// The deletions from the RO graph - map and a lock for in-edges
 	std::unordered_map<edge_t, long> _deletions_in_map;
-	ll_spinlock_t _deletions_in_lock;
+	ll_adaptive_lock_t _deletions_in_lock;
 
 	/// Affected nodes by the deletion of out-edges
 	std::unordered_map<node_t, affected_node_by_edge_deletion_t> _deletions_nodes_out[LL_D_STRIPES];
@@ -2092,6 +2763,380 @@ private:
 	ll_spinlock_t _property_lock;
 
 
+	/*
+	 * Snapshots
+	 */
+
+	/// The epochs of the active readers and snapshots, and the deferred
+	/// reclamation
+	ll_epoch_manager _epochs;
+
+	/// The lock that orders snapshot creation with checkpoints
+	ll_spinlock_t _snapshot_lock;
+
+	/// The number of levels deleted after their deferral
+	volatile size_t _deleted_levels;
+
+	/// The number of running checkpoints and the thread that runs them,
+	/// which the debug builds use to catch the unprotected readers
+	volatile int _checkpointing;
+	pthread_t _checkpoint_thread;
+
+
+#ifdef LL_WAL
+
+	/*
+	 * Durability
+	 */
+
+	/// The write-ahead log, or NULL if not attached
+	ll_wal* _wal;
+
+
+	/**
+	 * Log an update of the current transaction in the write-ahead log, if
+	 * attached
+	 *
+	 * @param type the record type (LL_WAL_*)
+	 * @param a the first argument
+	 * @param b the second argument
+	 * @param c the third argument
+	 * @param name the property name, or NULL
+	 */
+	inline void wal_log(int type, int64_t a, int64_t b = 0, int64_t c = 0,
+			const char* name = NULL) {
+		if (_wal != NULL) _wal->append(type, LL_TX_TIMESTAMP, a, b, c, name);
+	}
+
+
+	/**
+	 * Wait until the updates of this thread are durable, if the write-ahead
+	 * log is attached and synchronous
+	 */
+	inline void wal_sync() {
+		if (_wal != NULL && _wal->synchronous()) _wal->commit();
+	}
+
+
+	/**
+	 * Convert a property value to its logged representation
+	 *
+	 * @param value the value
+	 * @return the bits of the value
+	 */
+	template<typename T>
+	static inline int64_t wal_value(const T& value) {
+		int64_t v = 0;
+		memcpy(&v, &value, std::min(sizeof(T), sizeof(v)));
+		return v;
+	}
+#endif
+
+
+	/**
+	 * A level deletion deferred until the snapshots that pin it are done
+	 */
+	typedef struct {
+		ll_writable_graph* dl_owner;
+		size_t dl_level;
+	} deferred_level_deletion_t;
+
+
+	/**
+	 * Perform a deferred level deletion. This runs in whichever thread
+	 * collects the garbage, so it takes the lock held by the checkpoints and
+	 * the snapshot creation.
+	 *
+	 * @param data the deferred_level_deletion_t
+	 */
+	static void deferred_delete_level(void* data) {
+		deferred_level_deletion_t* d = (deferred_level_deletion_t*) data;
+		ll_writable_graph* g = d->dl_owner;
+
+		ll_spinlock_acquire(&g->_snapshot_lock);
+		g->_ro_graph.delete_level(d->dl_level);
+		g->_deleted_levels++;
+		ll_spinlock_release(&g->_snapshot_lock);
+
+		delete d;
+	}
+
+
+	/**
+	 * A generation of the writable representation retired by a checkpoint
+	 */
+	typedef struct {
+		ll_writable_graph* rg_owner;
+		w_generation_t* rg_generation;
+	} retired_generation_t;
+
+
+	/**
+	 * Reclaim a retired generation of the writable representation
+	 *
+	 * @param data the retired_generation_t
+	 */
+	static void retire_generation(void* data) {
+		retired_generation_t* d = (retired_generation_t*) data;
+		d->rg_owner->delete_generation(d->rg_generation);
+		delete d;
+	}
+
+
+	/**
+	 * Get the memory pool for the writable representation
+	 *
+	 * @return the pool, or NULL if the memory pool is not used
+	 */
+	inline ll_w_pool_t* w_pool() {
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+		return &_w_pool;
+#else
+		return NULL;
+#endif
+	}
+
+
+	/**
+	 * Create a new generation of the writable representation
+	 *
+	 * @param max_nodes the maximum number of nodes
+	 * @return the new generation
+	 */
+	w_generation_t* new_generation(size_t max_nodes) {
+		w_generation_t* g = new w_generation_t;
+		g->wg_vertices = new ll_w_vt_vertices_t(max_nodes,
+				w_node_allocator_ext<long>(w_pool()));
+		g->wg_levels = -1;
+		g->wg_retired_pool = NULL;
+		return g;
+	}
+
+
+	/**
+	 * Delete a generation of the writable representation, together with its
+	 * w_node's and w_edge's
+	 *
+	 * @param g the generation
+	 */
+	void delete_generation(w_generation_t* g) {
+		delete g->wg_vertices;
+#ifdef LL_WRITABLE_USE_MEMORY_POOL
+		if (g->wg_retired_pool != NULL) _w_pool.release(g->wg_retired_pool);
+#endif
+		delete g;
+	}
+
+
+	/**
+	 * Get the writable node together with the number of the RO levels under
+	 * it, consistently with respect to a concurrent checkpoint
+	 *
+	 * @param node the node
+	 * @param o_levels the output for the number of the RO levels
+	 * @return the writable node, or NULL if none
+	 */
+	inline w_node* writable_node(node_t node, int& o_levels) {
+
+		w_generation_t* g = _generation;
+		__COMPILER_FENCE;
+		int n = (int) _ro_graph.num_levels();
+		__COMPILER_FENCE;
+		int l = g->wg_levels;
+
+		o_levels = l < 0 ? n : l;
+		return (w_node*) g->wg_vertices->get(node);
+	}
+
+
+#ifdef LL_TIMESTAMPS
+
+	/**
+	 * Append to the undo log of the current transaction, if any
+	 *
+	 * @param type the record type (LL_TX_UNDO_*)
+	 * @param object the affected w_node or w_edge
+	 * @param old_out the previous deletion timestamp
+	 * @param out_edge the affected frozen out-edge
+	 * @param in_edge the affected frozen in-edge
+	 * @param old_in the previous deletion timestamp of the in-edge
+	 */
+	inline void tx_log(int type, void* object, long old_out = LONG_MAX,
+			edge_t out_edge = LL_NIL_EDGE, edge_t in_edge = LL_NIL_EDGE,
+			long old_in = LONG_MAX) {
+
+		if (g_tx_timestamp == 0 || g_tx_undo == NULL) return;
+
+		ll_tx_undo_t u;
+		u.u_type = type;
+		u.u_object = object;
+		u.u_out_edge = out_edge;
+		u.u_in_edge = in_edge;
+		u.u_old_out = old_out;
+		u.u_old_in = old_in;
+		u.u_source = LL_NIL_NODE;
+		u.u_target = LL_NIL_NODE;
+		u.u_flags = 0;
+		u.u_old_level = 0;
+
+		g_tx_undo->push_back(u);
+	}
+
+
+	/**
+	 * Append a complete record to the undo log of the current transaction,
+	 * if any
+	 *
+	 * @param u the undo record
+	 */
+	inline void tx_log(const ll_tx_undo_t& u) {
+
+		if (g_tx_timestamp == 0 || g_tx_undo == NULL) return;
+		g_tx_undo->push_back(u);
+	}
+
+
+	/**
+	 * Remove the last occurrence of an edge from the list of deleted frozen
+	 * edges of a node
+	 *
+	 * @param h the affected nodes stripe
+	 * @param node the node
+	 * @param edge the edge
+	 */
+	static void tx_undo_affected_node(
+			std::unordered_map<node_t, affected_node_by_edge_deletion_t>& h,
+			node_t node, edge_t edge) {
+
+		auto it = h.find(node);
+		if (it == h.end()) return;
+
+		auto& v = it->second.an_deleted_edges;
+		for (size_t i = v.size(); i > 0; i--) {
+			if (v[i-1] == edge) {
+				v.erase(v.begin() + (i-1));
+				break;
+			}
+		}
+	}
+
+
+	/**
+	 * Undo a single write of the current transaction. A rolled back version
+	 * gets its deletion timestamp equal to its creation timestamp, so that it
+	 * is not visible to anybody.
+	 *
+	 * @param u the undo record
+	 */
+	void tx_undo(const ll_tx_undo_t& u) {
+
+		long t = g_tx_timestamp;
+		w_node* p_source;
+		w_node* p_target;
+
+		switch (u.u_type) {
+
+			case LL_TX_UNDO_ADD_NODE: {
+				w_node* n = (w_node*) u.u_object;
+				ll_adaptive_lock_acquire(&n->wn_lock, LL_L_NODE);
+				if (n->exists()) _delNodes++;
+				n->wn_timestamp_deletion = n->wn_timestamp_creation;
+				ll_adaptive_lock_release(&n->wn_lock);
+				break;
+			}
+
+			case LL_TX_UNDO_DELETE_NODE: {
+				w_node* n = (w_node*) u.u_object;
+				ll_adaptive_lock_acquire(&n->wn_lock, LL_L_NODE);
+				if (n->wn_timestamp_deletion == t) {
+					n->wn_timestamp_deletion = u.u_old_out;
+					if (u.u_old_out == LONG_MAX) _delNodes--;
+				}
+				ll_adaptive_lock_release(&n->wn_lock);
+				break;
+			}
+
+			case LL_TX_UNDO_ADD_EDGE: {
+				w_edge* e = (w_edge*) u.u_object;
+				lock_nodes(e->we_source, e->we_target, p_source, p_target);
+				if (e->exists()) {
+					p_source->wn_out_edges_delta--;
+					p_target->wn_in_edges_delta--;
+					_delNewEdges++;
+				}
+				e->we_timestamp_deletion = e->we_timestamp_creation;
+				release_nodes(p_source, p_target);
+				break;
+			}
+
+			case LL_TX_UNDO_DELETE_EDGE: {
+				w_edge* e = (w_edge*) u.u_object;
+				lock_nodes(e->we_source, e->we_target, p_source, p_target);
+				if (e->we_timestamp_deletion == t) {
+					e->we_timestamp_deletion = u.u_old_out;
+					p_source->wn_out_edges_delta++;
+					p_target->wn_in_edges_delta++;
+					if (u.u_old_out == LONG_MAX) _delNewEdges--;
+				}
+				release_nodes(p_source, p_target);
+				break;
+			}
+
+			case LL_TX_UNDO_DELETE_FROZEN_EDGE: {
+				ll_adaptive_lock_acquire(&_deletions_out_lock, LL_L_DELETIONS);
+				ll_adaptive_lock_acquire(&_deletions_in_lock, LL_L_DELETIONS);
+
+				auto it = _deletions_out_map.find(u.u_out_edge);
+				if (it != _deletions_out_map.end() && it->second == t) {
+					if ((u.u_flags & LL_TX_UNDO_F_NEW_OUT) != 0) {
+						_deletions_out_map.erase(it);
+						tx_undo_affected_node(
+								_deletions_nodes_out[LL_D_STRIPE(u.u_source)],
+								u.u_source, u.u_out_edge);
+					}
+					else {
+						it->second = u.u_old_out;
+					}
+				}
+
+				if (u.u_in_edge != LL_NIL_EDGE) {
+					it = _deletions_in_map.find(u.u_in_edge);
+					if (it != _deletions_in_map.end() && it->second == t) {
+						if ((u.u_flags & LL_TX_UNDO_F_NEW_IN) != 0) {
+							_deletions_in_map.erase(it);
+							tx_undo_affected_node(
+									_deletions_nodes_in[LL_D_STRIPE(u.u_target)],
+									u.u_target, u.u_in_edge);
+						}
+						else {
+							it->second = u.u_old_in;
+						}
+					}
+				}
+
+				if ((u.u_flags & LL_TX_UNDO_F_LOWERED) != 0
+						&& _ro_graph.restore_max_visible_level(u.u_out_edge,
+							LL_CHECK_EXT_DELETION, u.u_old_level)) {
+					__sync_fetch_and_add(&writable_node(u.u_source)
+							->wn_num_deleted_out_edges, -1);
+					__sync_fetch_and_add(&writable_node(u.u_target)
+							->wn_num_deleted_in_edges , -1);
+					_delFrozenEdges--;
+				}
+
+				ll_adaptive_lock_release(&_deletions_in_lock);
+				ll_adaptive_lock_release(&_deletions_out_lock);
+				break;
+			}
+
+			default:
+				abort();
+		}
+	}
+
+#endif
+
+
 	/**
 	 * Get a writable node, creating it if necessary, but not locking it
 	 * 
@@ -2099,7 +3144,7 @@ private:
 	 * @return the node structure
 	 */
 	inline w_node* writable_node(node_t node) {
-		w_node* r = (w_node*) _vertices.get_or_allocate(node);
+		w_node* r = (w_node*) _generation->wg_vertices->get_or_allocate(node);
 		return r;
 	}
 
@@ -2111,18 +3156,18 @@ private:
 	 * @return the node structure
 	 */
 	w_node* lock_node(node_t node) {
-		w_node* r = (w_node*) _vertices.get_or_allocate(node);
-		ll_spinlock_acquire(&r->wn_lock);
+		w_node* r = (w_node*) _generation->wg_vertices->get_or_allocate(node);
+		ll_adaptive_lock_acquire(&r->wn_lock, LL_L_NODE);
 
 		// XXX Does this belong here? Certainly not if we have timestamps,
 		// or if there is any way we need to initialize the node
 		if (node >= _next_new_node_id) {
-			ll_spinlock_acquire(&_new_node_lock);
+			ll_adaptive_lock_acquire(&_new_node_lock, LL_L_NEW_NODE);
 			if (node >= _next_new_node_id) {
 				_next_new_node_id = node + 1;
 				_newNodes++;
 			}
-			ll_spinlock_release(&_new_node_lock);
+			ll_adaptive_lock_release(&_new_node_lock);
 		}
 
 		return r;
@@ -2136,8 +3181,8 @@ private:
 	 * @return the node structure, or NULL if already locked
 	 */
 	w_node* try_lock_node(node_t node) {
-		w_node* r = (w_node*) _vertices.get_or_allocate(node);
-		return ll_spinlock_try_acquire(&r->wn_lock) ? r : NULL;
+		w_node* r = (w_node*) _generation->wg_vertices->get_or_allocate(node);
+		return ll_adaptive_lock_try_acquire(&r->wn_lock) ? r : NULL;
 	}
 
 
@@ -2172,7 +3217,7 @@ private:
 	 * @param node the node
 	 */
 	void release_node(w_node* node) {
-		ll_spinlock_release(&node->wn_lock);
+		ll_adaptive_lock_release(&node->wn_lock);
 	}
 
 
@@ -2184,11 +3229,11 @@ private:
 	 */
 	void release_nodes(w_node* node1, w_node* node2) {
 		if (node1 == node2) {
-			ll_spinlock_release(&node1->wn_lock);
+			ll_adaptive_lock_release(&node1->wn_lock);
 		}
 		else {
-			ll_spinlock_release(&node1->wn_lock);
-			ll_spinlock_release(&node2->wn_lock);
+			ll_adaptive_lock_release(&node1->wn_lock);
+			ll_adaptive_lock_release(&node2->wn_lock);
 		}
 	}
 };
@@ -0,0 +1,579 @@
+/*
+ * ll_writable_snapshot.h
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+
+#ifndef LL_WRITABLE_SNAPSHOT_H_
+#define LL_WRITABLE_SNAPSHOT_H_
+
+#include <unordered_set>
+
+#include "llama/ll_common.h"
+#include "llama/ll_epoch.h"
+#include "llama/ll_mlcsr_graph.h"
+#include "llama/ll_writable_graph.h"
+
+
+
+//==========================================================================//
+// Class: ll_writable_snapshot                                              //
+//==========================================================================//
+
+/**
+ * A consistent read-only view of a writable graph that can be used
+ * concurrently with writes, transactions, checkpoints, and level deletions.
+ *
+ * The snapshot pins the read-only levels that existed at the time of its
+ * creation using a read-only clone, and with LL_TIMESTAMPS also the writable
+ * representation at the latest stable transaction timestamp, filtering the
+ * w_edge's and w_node's by their creation and deletion timestamps. Without
+ * LL_TIMESTAMPS there is no way to tell the versions of the writable edges
+ * apart, so the snapshot covers only the pinned read-only levels.
+ *
+ * The snapshot holds an epoch of the graph for its entire lifetime, which
+ * defers the reclamation of anything it can observe, including the generation
+ * of the writable representation retired by a subsequent checkpoint; the
+ * deletions of the frozen edges are copied at the creation time, since the
+ * checkpoint clears them from the graph. Unlike the graph's own
+ * iterators, the snapshot does not depend on the thread-local transaction
+ * timestamp, so it can be shared by all threads of a parallel query.
+ */
+class ll_writable_snapshot {
+
+	/// The graph
+	ll_writable_graph* _graph;
+
+	/// The pinned read-only levels, or NULL if there are none
+	ll_mlcsr_ro_graph* _ro;
+
+	/// The number of pinned read-only levels
+	size_t _num_levels;
+
+	/// The timestamp of the snapshot
+	long _timestamp;
+
+	/// The epoch slot
+	int _epoch_slot;
+
+	/// The pinned generation of the writable representation, or NULL if it
+	/// is not a part of the snapshot
+	ll_writable_graph::w_generation_t* _writable;
+
+	/// Whether to check the deletions of frozen edges in the writable level
+	bool _frozen_deletions;
+
+	/// The frozen out-edges deleted in the writable level
+	std::unordered_set<edge_t> _deleted_out;
+
+	/// The frozen in-edges deleted in the writable level
+	std::unordered_set<edge_t> _deleted_in;
+
+	/// The number of nodes
+	node_t _max_nodes;
+
+
+public:
+
+	/**
+	 * Create a snapshot of the current state of the graph
+	 *
+	 * @param graph the writable graph
+	 */
+	ll_writable_snapshot(ll_writable_graph* graph) {
+
+		_graph = graph;
+
+		ll_spinlock_acquire(&graph->_snapshot_lock);
+
+		_epoch_slot = graph->_epochs.enter();
+		_timestamp = ll_tx_stable_timestamp();
+
+		_num_levels = graph->_ro_graph.num_levels();
+		_ro = _num_levels == 0 ? NULL
+			: new ll_mlcsr_ro_graph(&graph->_ro_graph, _num_levels - 1);
+
+		// The clone would otherwise consult the graph's live deletion maps
+		// (and through them the thread-local transaction timestamp); the
+		// deletions as of the snapshot are instead copied below
+
+		if (_ro != NULL) _ro->set_deletion_checkers(NULL, NULL);
+
+#ifdef LL_TIMESTAMPS
+		_writable = graph->_generation;
+#else
+		_writable = NULL;
+#endif
+
+		if (_writable != NULL) {
+			copy_deletions(graph->_deletions_out_map,
+					graph->_deletions_out_lock, _deleted_out);
+			copy_deletions(graph->_deletions_in_map,
+					graph->_deletions_in_lock, _deleted_in);
+		}
+		_frozen_deletions = !_deleted_out.empty() || !_deleted_in.empty();
+
+		_max_nodes = _writable != NULL ? graph->max_nodes()
+			: (_ro == NULL ? 0 : _ro->max_nodes());
+
+		ll_spinlock_release(&graph->_snapshot_lock);
+	}
+
+
+	/**
+	 * Release the snapshot
+	 */
+	virtual ~ll_writable_snapshot(void) {
+
+		if (_ro != NULL) delete _ro;
+		_graph->_epochs.exit(_epoch_slot);
+	}
+
+
+	/**
+	 * Get the timestamp of the snapshot
+	 *
+	 * @return the timestamp
+	 */
+	inline long timestamp(void) const {
+		return _timestamp;
+	}
+
+
+	/**
+	 * Determine whether the writable representation is a part of the snapshot
+	 *
+	 * @return true if it is
+	 */
+	inline bool includes_writable(void) const {
+		return _writable != NULL;
+	}
+
+
+	/**
+	 * Get the pinned read-only levels
+	 *
+	 * @return the read-only graph, or NULL if there are no levels
+	 */
+	inline ll_mlcsr_ro_graph* ro_graph(void) {
+		return _ro;
+	}
+
+
+	/**
+	 * Get the number of pinned read-only levels
+	 *
+	 * @return the number of levels
+	 */
+	inline size_t num_levels(void) const {
+		return _num_levels;
+	}
+
+
+	/**
+	 * Return the number of nodes
+	 *
+	 * @return the number of nodes
+	 */
+	inline node_t max_nodes(void) const {
+		return _max_nodes;
+	}
+
+
+	/**
+	 * Determine if the given node exists in the snapshot
+	 *
+	 * @param node the node
+	 * @return true if it exists
+	 */
+	bool node_exists(node_t node) {
+
+		if (node < 0 || node >= _max_nodes) return false;
+
+		w_node* r = writable_node(node);
+		if (r != NULL) return visible(r);
+
+		return _ro != NULL && _ro->node_exists(node);
+	}
+
+
+	/**
+	 * Get the node out-degree
+	 *
+	 * @param node the node
+	 * @return the out-degree
+	 */
+	size_t out_degree(node_t node) {
+
+		if (node < 0 || node >= _max_nodes) return 0;
+
+		if (_writable == NULL && !_frozen_deletions) {
+			return _ro != NULL && _ro->node_exists(node)
+				? _ro->out_degree(node) : 0;
+		}
+
+		size_t d = 0;
+		ll_edge_iterator iter;
+		out_iter_begin(iter, node);
+		while (out_iter_next(iter) != LL_NIL_EDGE) d++;
+
+		return d;
+	}
+
+
+	/**
+	 * Get the node in-degree
+	 *
+	 * @param node the node
+	 * @return the in-degree
+	 */
+	size_t in_degree(node_t node) {
+
+		if (node < 0 || node >= _max_nodes) return 0;
+
+		if (_writable == NULL && !_frozen_deletions) {
+			return _ro != NULL && _ro->node_exists(node)
+				? _ro->in_degree(node) : 0;
+		}
+
+		size_t d = 0;
+		ll_edge_iterator iter;
+		in_iter_begin(iter, node);
+		while (in_iter_next(iter) != LL_NIL_EDGE) d++;
+
+		return d;
+	}
+
+
+	/**
+	 * Create iterator over all outgoing edges
+	 *
+	 * @param iter the iterator
+	 * @param node the node
+	 */
+	void out_iter_begin(ll_edge_iterator& iter, node_t node) {
+
+		w_node* r = writable_node(node);
+		if (r == NULL) {
+			ro_out_iter_begin(iter, node);
+			return;
+		}
+
+		if (!visible(r)) {
+			set_to_end(iter);
+			return;
+		}
+
+		iter.owner = LL_I_OWNER_WRITABLE;
+		iter.ptr = r;
+		iter.node = node;
+		iter.left = r->wn_out_edges.size();
+		iter.edge = LL_NIL_EDGE;
+
+		w_edge* e = next_visible(r->wn_out_edges, iter.left);
+		if (e == NULL)
+			ro_out_iter_begin(iter, node);
+		else
+			iter.edge = (long) e;
+	}
+
+
+	/**
+	 * Determine if there are any more items left
+	 *
+	 * @param iter the iterator
+	 * @return true if there are more items
+	 */
+	inline bool out_iter_has_next(ll_edge_iterator& iter) {
+		return iter.edge != LL_NIL_EDGE;
+	}
+
+
+	/**
+	 * Get the next item
+	 *
+	 * @param iter the iterator
+	 * @return the next item, or LL_NIL_EDGE if none
+	 */
+	edge_t out_iter_next(ll_edge_iterator& iter) {
+
+		if (iter.owner != LL_I_OWNER_WRITABLE) {
+			edge_t e;
+			do {
+				e = _ro->out_iter_next(iter);
+			}
+			while (e != LL_NIL_EDGE && _frozen_deletions
+					&& _deleted_out.find(e) != _deleted_out.end());
+			return e;
+		}
+
+		edge_t r = iter.edge;
+		if (r == LL_NIL_EDGE) return LL_NIL_EDGE;
+
+		iter.last_node = ((w_edge*) r)->we_target;
+
+		w_edge* e = next_visible(((w_node*) iter.ptr)->wn_out_edges, iter.left);
+		if (e == NULL)
+			ro_out_iter_begin(iter, iter.node);
+		else
+			iter.edge = (long) e;
+
+		return LL_W_EDGE_CREATE(r);
+	}
+
+
+	/**
+	 * Finish the iterator
+	 *
+	 * @param iter the iterator
+	 */
+	inline void out_iter_end(ll_edge_iterator& iter) {
+	}
+
+
+	/**
+	 * Create iterator over all incoming edges
+	 *
+	 * @param iter the iterator
+	 * @param node the node
+	 */
+	void in_iter_begin(ll_edge_iterator& iter, node_t node) {
+
+		w_node* r = writable_node(node);
+		if (r == NULL) {
+			ro_in_iter_begin(iter, node);
+			return;
+		}
+
+		if (!visible(r)) {
+			set_to_end(iter);
+			return;
+		}
+
+		iter.owner = LL_I_OWNER_WRITABLE;
+		iter.ptr = r;
+		iter.node = node;
+		iter.left = r->wn_in_edges.size();
+		iter.edge = LL_NIL_EDGE;
+
+		w_edge* e = next_visible(r->wn_in_edges, iter.left);
+		if (e == NULL)
+			ro_in_iter_begin(iter, node);
+		else
+			iter.edge = (long) e;
+	}
+
+
+	/**
+	 * Determine if there are any more items left
+	 *
+	 * @param iter the iterator
+	 * @return true if there are more items
+	 */
+	inline bool in_iter_has_next(ll_edge_iterator& iter) {
+		return iter.edge != LL_NIL_EDGE;
+	}
+
+
+	/**
+	 * Get the next item
+	 *
+	 * @param iter the iterator
+	 * @return the next edge (as an out-edge ID), or LL_NIL_EDGE if none
+	 */
+	edge_t in_iter_next(ll_edge_iterator& iter) {
+
+		if (iter.owner != LL_I_OWNER_WRITABLE) {
+			edge_t e;
+			do {
+				e = _ro->in_iter_next_fast(iter);
+			}
+			while (e != LL_NIL_EDGE && _frozen_deletions
+					&& _deleted_in.find(e) != _deleted_in.end());
+			if (e == LL_NIL_EDGE) return LL_NIL_EDGE;
+			return _ro->in().translate_edge(e);
+		}
+
+		edge_t r = iter.edge;
+		if (r == LL_NIL_EDGE) return LL_NIL_EDGE;
+
+		iter.last_node = ((w_edge*) r)->we_source;
+
+		w_edge* e = next_visible(((w_node*) iter.ptr)->wn_in_edges, iter.left);
+		if (e == NULL)
+			ro_in_iter_begin(iter, iter.node);
+		else
+			iter.edge = (long) e;
+
+		return LL_W_EDGE_CREATE(r);
+	}
+
+
+	/**
+	 * Finish the iterator
+	 *
+	 * @param iter the iterator
+	 */
+	inline void in_iter_end(ll_edge_iterator& iter) {
+	}
+
+
+private:
+
+	/**
+	 * Get the writable node if it is a part of the snapshot
+	 *
+	 * @param node the node
+	 * @return the writable node, or NULL if none or out of range
+	 */
+	inline w_node* writable_node(node_t node) {
+		if (_writable == NULL) return NULL;
+		if (node < 0 || node >= _max_nodes) return NULL;
+		return (w_node*) _writable->wg_vertices->get(node);
+	}
+
+
+	/**
+	 * Determine whether the writable node is visible in the snapshot
+	 *
+	 * @param r the writable node
+	 * @return true if it is visible
+	 */
+	inline bool visible(w_node* r) const {
+#if defined(LL_DELETIONS) && defined(LL_TIMESTAMPS)
+		return _timestamp >= r->wn_timestamp_creation
+			&& _timestamp < r->wn_timestamp_deletion;
+#else
+		return true;
+#endif
+	}
+
+
+	/**
+	 * Determine whether the writable edge is visible in the snapshot
+	 *
+	 * @param e the writable edge
+	 * @return true if it is visible
+	 */
+	inline bool visible(w_edge* e) const {
+#ifdef LL_TIMESTAMPS
+		return _timestamp >= e->we_timestamp_creation
+			&& _timestamp < e->we_timestamp_deletion;
+#else
+		return true;
+#endif
+	}
+
+
+	/**
+	 * Find the next visible writable edge, scanning the array backwards
+	 *
+	 * @param edges the array of edges
+	 * @param left the number of edges left, which will be updated
+	 * @return the edge, or NULL if there are no more visible edges
+	 */
+	template <class EdgeArray>
+	inline w_edge* next_visible(EdgeArray& edges, size_t& left) const {
+		while (left > 0) {
+			w_edge* e = edges[--left];
+			if (visible(e)) return e;
+		}
+		return NULL;
+	}
+
+
+	/**
+	 * Copy the writable-level deletions of frozen edges that are visible in
+	 * the snapshot
+	 *
+	 * @param map the deletions map
+	 * @param lock the lock for the map
+	 * @param out the output set of the deleted edges
+	 */
+	void copy_deletions(std::unordered_map<edge_t, long>& map,
+			ll_adaptive_lock_t& lock, std::unordered_set<edge_t>& out) {
+
+		ll_adaptive_lock_acquire(&lock, LL_L_DELETIONS);
+		for (auto it = map.begin(); it != map.end(); it++) {
+			if (it->second <= _timestamp) out.insert(it->first);
+		}
+		ll_adaptive_lock_release(&lock);
+	}
+
+
+	/**
+	 * Set the iterator to the end
+	 *
+	 * @param iter the iterator
+	 */
+	inline void set_to_end(ll_edge_iterator& iter) {
+		iter.owner = LL_I_OWNER_RO_CSR;
+		iter.edge = LL_NIL_EDGE;
+		iter.left = 0;
+	}
+
+
+	/**
+	 * Start iterating over the out-edges in the pinned read-only levels
+	 *
+	 * @param iter the iterator
+	 * @param node the node
+	 */
+	void ro_out_iter_begin(ll_edge_iterator& iter, node_t node) {
+		if (_ro == NULL || node < 0 || node >= _max_nodes
+				|| !_ro->node_exists(node)) {
+			set_to_end(iter);
+			return;
+		}
+		_ro->out_iter_begin(iter, node);
+	}
+
+
+	/**
+	 * Start iterating over the in-edges in the pinned read-only levels
+	 *
+	 * @param iter the iterator
+	 * @param node the node
+	 */
+	void ro_in_iter_begin(ll_edge_iterator& iter, node_t node) {
+		if (_ro == NULL || node < 0 || node >= _max_nodes
+				|| !_ro->node_exists(node)) {
+			set_to_end(iter);
+			return;
+		}
+		_ro->in_iter_begin_fast(iter, node);
+	}
+};
+
+#endif
@@ -37,6 +37,7 @@
 #ifndef LL_LOAD_ASYNC_WRITABLE_H_
 #define LL_LOAD_ASYNC_WRITABLE_H_
 
+#include "llama/ll_utils.h"
 #include "llama/ll_writable_graph.h"
 
 
@@ -48,7 +49,7 @@ class ll_la_request {
 public:
 
 	/// The next request in the queue
-	ll_la_request* _next;
+	ll_la_request* volatile _next;
 
 
 	/**
@@ -95,24 +96,34 @@ public:
 
 
 /**
- * A request queue
+ * A request queue. This is a lock-free multi-producer, single-consumer queue
+ * (an intrusive linked list with a stub node, so that the producers only
+ * need a single atomic exchange); the consumers are serialized by a separate
+ * lock, which is not contended if each queue has a dedicated consumer.
  */
 class ll_la_request_queue {
 
+	// The producer end
+
+	ll_la_request* volatile _tail;
+	volatile size_t _enqueued;
+
+	char __fill_1[64 - sizeof(_tail) - sizeof(_enqueued)];
+
+
+	// The consumer end
+
 	ll_spinlock_t _lock;
-	
 	ll_la_request* volatile _head;
-	ll_la_request* volatile _tail;
-	volatile size_t _length;
-	
-	volatile bool _shutdown_when_empty;
+	volatile size_t _dequeued;
+
+	char __fill_2[64 - sizeof(_lock) - sizeof(_head) - sizeof(_dequeued)];
 
 
-	// Make sure that the data structure is at least one cache-line in size...
-	// Do we need this?
-	
-	char __fill[64 - sizeof(_lock) - sizeof(_head) - sizeof(_tail)
-		- sizeof(_shutdown_when_empty)];
+	// The rest
+
+	ll_la_nop _stub;
+	volatile bool _shutdown_when_empty;
 
 
 public:
@@ -123,9 +134,10 @@ public:
 	ll_la_request_queue() {
 
 		_lock = 0;
-		_head = NULL;
-		_tail = NULL;
-		_length = 0;
+		_head = &_stub;
+		_tail = &_stub;
+		_enqueued = 0;
+		_dequeued = 0;
 
 		_shutdown_when_empty = false;
 	}
@@ -136,11 +148,8 @@ public:
 	 */
 	virtual ~ll_la_request_queue() {
 
-		while (_head != NULL) {
-			ll_la_request* n = _head->_next;
-			delete _head;
-			_head = n;
-		}
+		ll_la_request* r;
+		while ((r = dequeue()) != NULL) delete r;
 	}
 
 
@@ -151,18 +160,11 @@ public:
 	 */
 	void enqueue(ll_la_request* request) {
 
-		request->_next = NULL;
-
-		ll_spinlock_acquire(&_lock);
-
-		_length++;
-	
-		if (_tail != NULL)
-			_tail->_next = request;
-		_tail = request;
-		if (_head == NULL) _head = request;
+		// Count the request before it becomes visible, so that size() never
+		// misses a request that is being inserted
 
-		ll_spinlock_release(&_lock);
+		__sync_fetch_and_add(&_enqueued, 1);
+		push(request);
 	}
 
 
@@ -174,18 +176,8 @@ public:
 	ll_la_request* dequeue() {
 
 		ll_spinlock_acquire(&_lock);
-	
-		if (_head == NULL) {
-			ll_spinlock_release(&_lock);
-			return NULL;
-		}
-
-		_length--;
-
-		ll_la_request* r = (ll_la_request*) _head;
-		_head = r->_next;
-		if (_head == NULL) _tail = NULL;
-
+		ll_la_request* r = pop();
+		if (r != NULL) _dequeued++;
 		ll_spinlock_release(&_lock);
 
 		return r;
@@ -198,7 +190,17 @@ public:
 	 * @return the number of elements in the queue
 	 */
 	inline size_t size() const {
-		return _length;
+		return _enqueued - _dequeued;
+	}
+
+
+	/**
+	 * Get the total number of requests ever inserted into the queue
+	 *
+	 * @return the number of enqueued requests
+	 */
+	inline size_t num_enqueued() const {
+		return _enqueued;
 	}
 
 
@@ -219,10 +221,8 @@ public:
 	 */
 	void run(ll_writable_graph& graph) {
 
-		ll_la_request* r;
-		while ((r = dequeue()) != NULL) {
-			r->run(graph);
-			delete r;
+		while (size() > 0) {
+			if (!process_next(graph)) asm volatile ("pause" ::: "memory");
 		}
 	}
 
@@ -238,7 +238,7 @@ public:
 			ll_la_request* r = dequeue();
 
 			if (r == NULL) {
-				if (_shutdown_when_empty) return;
+				if (_shutdown_when_empty && size() == 0) return;
 				usleep(10);
 			}
 			else {
@@ -264,6 +264,63 @@ public:
 
 		return true;
 	}
+
+
+private:
+
+	/**
+	 * Append a request to the producer end
+	 *
+	 * @param request the request
+	 */
+	inline void push(ll_la_request* request) {
+
+		request->_next = NULL;
+		ll_la_request* prev = __atomic_exchange_n(&_tail, request,
+				__ATOMIC_ACQ_REL);
+		__atomic_store_n(&prev->_next, request, __ATOMIC_RELEASE);
+	}
+
+
+	/**
+	 * Remove a request from the consumer end (must hold the consumer lock)
+	 *
+	 * @return the request, or NULL if empty or if the next request is still
+	 *         being linked in by a producer
+	 */
+	ll_la_request* pop() {
+
+		ll_la_request* head = _head;
+		ll_la_request* next = __atomic_load_n(&head->_next, __ATOMIC_ACQUIRE);
+
+		if (head == &_stub) {
+			if (next == NULL) return NULL;
+			_head = next;
+			head = next;
+			next = __atomic_load_n(&next->_next, __ATOMIC_ACQUIRE);
+		}
+
+		if (next != NULL) {
+			_head = next;
+			return head;
+		}
+
+		if (head != __atomic_load_n(&_tail, __ATOMIC_ACQUIRE)) return NULL;
+
+
+		// This is the last request, so put the stub behind it in order to
+		// keep the list non-empty
+
+		push(&_stub);
+
+		next = __atomic_load_n(&head->_next, __ATOMIC_ACQUIRE);
+		if (next != NULL) {
+			_head = next;
+			return head;
+		}
+
+		return NULL;
+	}
 };
 
 
@@ -620,4 +677,430 @@ public:
 #endif
 
 
+//==========================================================================//
+// Class: ll_la_ingest                                                      //
+//==========================================================================//
+
+/**
+ * The ingest statistics
+ */
+typedef struct {
+
+	/// The number of submitted and applied requests
+	size_t is_submitted;
+	size_t is_applied;
+
+	/// The number of requests waiting to be applied, now and at most
+	size_t is_pending;
+	size_t is_max_pending;
+
+	/// The number of times the producers had to wait due to back-pressure
+	size_t is_stalls;
+
+	/// The total time the producers waited due to back-pressure
+	double is_stall_ms;
+
+	/// The number of checkpoints and their total duration
+	size_t is_checkpoints;
+	double is_checkpoint_ms;
+
+	/// The max number of requests submitted during a single checkpoint
+	size_t is_max_checkpoint_backlog;
+
+} ll_la_ingest_stats_t;
+
+
+/**
+ * A pipelined ingest service for the writable graph.
+ *
+ * The producers submit requests into sharded lock-free queues, one shard per
+ * range of vertices, each of which has a dedicated applier thread. The queues
+ * are double-buffered: a checkpoint switches the producers to the other set
+ * of queues, waits for the appliers to drain the previous set, and only then
+ * parks the appliers and converts the writable graph into a new read-only
+ * level. The producers thus do not pause during the checkpoint, but their
+ * requests only accumulate in the queues until it finishes, since there is
+ * a single writable graph; the application of the requests does pause. If a
+ * capacity is given, the producers wait while there are too many pending
+ * requests, which can include the backlog of a long checkpoint.
+ *
+ * The applier threads are not created here, so that the caller can use them
+ * from an OpenMP parallel region, such as:
+ *
+ *     #pragma omp parallel
+ *     {
+ *         if (omp_get_thread_num() == 0) {
+ *             ... ingest.submit(...), ingest.checkpoint() ...
+ *             ingest.shutdown();
+ *         }
+ *         else {
+ *             ingest.applier(omp_get_thread_num() - 1);
+ *         }
+ *     }
+ */
+class ll_la_ingest {
+
+	/// The graph
+	ll_writable_graph* _graph;
+
+	/// The number of shards and applier threads
+	size_t _num_shards;
+	size_t _num_appliers;
+
+	/// The max number of pending requests (0 = unlimited)
+	size_t _capacity;
+
+	/// The two sets of queues
+	ll_la_request_queue* _buffers[2];
+
+	/// The set the producers write to and the set the appliers read from
+	volatile int _active;
+	volatile int _applying;
+
+	/// The number of producers currently inserting into each set
+	volatile long _writers[2];
+
+	/// The applier control
+	volatile bool _paused;
+	volatile size_t _parked;
+	volatile size_t _exited;
+	volatile bool _shutdown;
+
+	/// The checkpoint lock
+	ll_spinlock_t _checkpoint_lock;
+
+	/// The statistics
+	volatile size_t _submitted;
+	volatile size_t _applied;
+	volatile size_t _max_pending;
+	volatile size_t _stalls;
+	double _stall_ms;
+	size_t _checkpoints;
+	double _checkpoint_ms;
+	size_t _max_checkpoint_backlog;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_la_ingest
+	 *
+	 * @param graph the writable graph
+	 * @param num_appliers the number of applier threads
+	 * @param capacity the max number of pending requests (0 = unlimited)
+	 * @param num_shards the number of shards (0 = same as the appliers)
+	 */
+	ll_la_ingest(ll_writable_graph* graph, size_t num_appliers,
+			size_t capacity = 0, size_t num_shards = 0) {
+
+		if (num_appliers == 0) {
+			LL_E_PRINT("The ingest service needs at least one applier\n");
+			abort();
+		}
+
+		_graph = graph;
+		_num_appliers = num_appliers;
+		_num_shards = num_shards == 0 ? num_appliers : num_shards;
+		_capacity = capacity;
+
+		_buffers[0] = new ll_la_request_queue[_num_shards];
+		_buffers[1] = new ll_la_request_queue[_num_shards];
+
+		_active = 0;
+		_applying = 0;
+		_writers[0] = 0;
+		_writers[1] = 0;
+
+		_paused = false;
+		_parked = 0;
+		_exited = 0;
+		_shutdown = false;
+
+		_checkpoint_lock = 0;
+
+		_submitted = 0;
+		_applied = 0;
+		_max_pending = 0;
+		_stalls = 0;
+		_stall_ms = 0;
+		_checkpoints = 0;
+		_checkpoint_ms = 0;
+		_max_checkpoint_backlog = 0;
+	}
+
+
+	/**
+	 * Destroy the instance, discarding any requests that were not applied
+	 */
+	virtual ~ll_la_ingest() {
+
+		delete[] _buffers[0];
+		delete[] _buffers[1];
+	}
+
+
+	/**
+	 * Get the number of shards
+	 *
+	 * @return the number of shards
+	 */
+	inline size_t num_shards() const {
+		return _num_shards;
+	}
+
+
+	/**
+	 * Get the number of pending requests
+	 *
+	 * @return the number of requests that were submitted but not applied
+	 */
+	inline size_t pending() const {
+		return _submitted - _applied;
+	}
+
+
+	/**
+	 * Submit a request
+	 *
+	 * @param request the request
+	 * @param n the node that determines the shard, such as the edge source
+	 */
+	void submit(ll_la_request* request, node_t n) {
+
+		size_t shard = (n >> (LL_ENTRIES_PER_PAGE_BITS + 3)) % _num_shards;
+
+
+		// Back-pressure
+
+		if (_capacity > 0 && pending() >= _capacity) {
+			double t = ll_get_time_ms();
+			while (pending() >= _capacity && !_shutdown) usleep(10);
+			__sync_fetch_and_add(&_stalls, 1);
+			ATOMIC_ADD<double>(&_stall_ms, ll_get_time_ms() - t);
+		}
+
+
+		// Insert into the active set; retry if a checkpoint switched the sets
+		// before we registered, since it might not wait for us
+
+		for (;;) {
+			int b = _active;
+			__sync_fetch_and_add(&_writers[b], 1);
+			if (b == _active) {
+				_buffers[b][shard].enqueue(request);
+				__sync_fetch_and_add(&_writers[b], -1);
+				break;
+			}
+			__sync_fetch_and_add(&_writers[b], -1);
+		}
+
+		size_t p = __sync_add_and_fetch(&_submitted, 1) - _applied;
+		size_t m = _max_pending;
+		while (p > m && !__sync_bool_compare_and_swap(&_max_pending, m, p)) {
+			m = _max_pending;
+		}
+	}
+
+
+	/**
+	 * Run an applier. This returns only after shutdown() and after all
+	 * submitted requests were applied.
+	 *
+	 * @param id the applier ID, between 0 and the number of appliers - 1
+	 */
+	void applier(size_t id) {
+
+		assert(id < _num_appliers);
+
+		for (;;) {
+
+			if (_paused) {
+				__sync_fetch_and_add(&_parked, 1);
+				while (_paused) usleep(10);
+				__sync_fetch_and_add(&_parked, -1);
+				continue;
+			}
+
+			ll_la_request_queue* q = _buffers[_applying];
+			size_t applied = 0;
+
+			_graph->tx_begin();
+
+			for (size_t s = id; s < _num_shards; s += _num_appliers) {
+				ll_la_request* r;
+				for (int i = 0; i < 256 && (r = q[s].dequeue()) != NULL; i++) {
+					r->run(*_graph);
+					delete r;
+					applied++;
+				}
+			}
+
+			_graph->tx_commit();
+
+			if (applied > 0) {
+				__sync_fetch_and_add(&_applied, applied);
+			}
+			else {
+				if (_shutdown && pending() == 0) {
+					__sync_fetch_and_add(&_exited, 1);
+					return;
+				}
+				usleep(10);
+			}
+		}
+	}
+
+
+	/**
+	 * Checkpoint the writable graph. The requests submitted before the call
+	 * are included in the new level, while the requests submitted during the
+	 * checkpoint are buffered and applied afterwards. This does nothing after
+	 * shutdown().
+	 *
+	 * @param config the loader config
+	 */
+	void checkpoint(const ll_loader_config* config = NULL) {
+		ll_la_graph_checkpoint f(_graph, config);
+		checkpoint_with(f);
+	}
+
+
+	/**
+	 * Checkpoint the writable graph using the given functor, which is called
+	 * while the appliers are parked, so that it can also modify the
+	 * read-only levels, such as to expire the levels that fell out of a
+	 * sliding window. The requests submitted before the call are included
+	 * in the new level, while the requests submitted during the checkpoint
+	 * are buffered and applied afterwards. This does nothing after
+	 * shutdown(), since the appliers may have already returned.
+	 *
+	 * @param f the functor that checkpoints the graph, called as f()
+	 */
+	template <class F>
+	void checkpoint_with(F& f) {
+
+		ll_spinlock_acquire(&_checkpoint_lock);
+
+		if (_shutdown) {
+			LL_W_PRINT("The ingest service is shut down, skipping the "
+					"checkpoint\n");
+			ll_spinlock_release(&_checkpoint_lock);
+			return;
+		}
+
+		double t = ll_get_time_ms();
+
+
+		// Switch the producers to the other set of queues
+
+		int old = _active;
+		size_t submitted = _submitted;
+		_active = 1 - old;
+		__sync_synchronize();
+		while (_writers[old] != 0) asm volatile ("pause" ::: "memory");
+
+
+		// Let the appliers drain the old set, and then park them so that the
+		// writable graph is quiescent; if shutdown() races with us, the
+		// appliers that already returned do not touch the graph anymore
+
+		while (!buffer_empty(old) && _exited < _num_appliers) usleep(10);
+
+		_paused = true;
+		__sync_synchronize();
+		while (_parked + _exited < _num_appliers) usleep(10);
+
+		f();
+
+		_applying = 1 - old;
+		__sync_synchronize();
+		_paused = false;
+
+
+		// Update the statistics
+
+		size_t backlog = _submitted - submitted;
+		if (backlog > _max_checkpoint_backlog) _max_checkpoint_backlog = backlog;
+		_checkpoints++;
+		_checkpoint_ms += ll_get_time_ms() - t;
+
+		ll_spinlock_release(&_checkpoint_lock);
+	}
+
+
+	/**
+	 * Wait until all requests submitted so far are applied
+	 */
+	void flush() {
+
+		size_t submitted = _submitted;
+		while (_applied < submitted) usleep(10);
+	}
+
+
+	/**
+	 * Shut down the service after all submitted requests are applied; this
+	 * makes the appliers return
+	 */
+	void shutdown() {
+		_shutdown = true;
+	}
+
+
+	/**
+	 * Get the statistics
+	 *
+	 * @param out the output stats
+	 */
+	void stats(ll_la_ingest_stats_t* out) {
+
+		out->is_submitted = _submitted;
+		out->is_applied = _applied;
+		out->is_pending = out->is_submitted - out->is_applied;
+		out->is_max_pending = _max_pending;
+		out->is_stalls = _stalls;
+		out->is_stall_ms = _stall_ms;
+		out->is_checkpoints = _checkpoints;
+		out->is_checkpoint_ms = _checkpoint_ms;
+		out->is_max_checkpoint_backlog = _max_checkpoint_backlog;
+	}
+
+
+private:
+
+	/**
+	 * The default checkpoint functor
+	 */
+	struct ll_la_graph_checkpoint {
+
+		ll_writable_graph* _graph;
+		const ll_loader_config* _config;
+
+		ll_la_graph_checkpoint(ll_writable_graph* graph,
+				const ll_loader_config* config)
+			: _graph(graph), _config(config) {}
+
+		void operator() (void) {
+			_graph->checkpoint(_config);
+		}
+	};
+
+
+	/**
+	 * Determine whether all queues in the given set are empty
+	 *
+	 * @param b the set
+	 * @return true if empty
+	 */
+	bool buffer_empty(int b) {
+
+		for (size_t s = 0; s < _num_shards; s++) {
+			if (_buffers[b][s].size() > 0) return false;
+		}
+
+		return true;
+	}
+};
+
+
 #endif
@@ -1425,7 +1425,9 @@ public:
 		config->assert_features(false /*direct*/, true /*error*/, features);
 
 
-		// Load
+		// Load; publish the out- and in-edges and the properties together
+
+		IF_LL_PERSISTENCE(graph->storage()->begin_deferred_sync());
 
 		ll_fgf_file fgf(file);
 		if (!fgf.okay()) {
@@ -1440,12 +1442,14 @@ public:
 		}
 
 		if (config->lc_reverse_edges) {
-			graph->make_reverse_edges();
+			graph->make_reverse_edges(NULL, config->lc_xs_buffer_size);
 		}
 		else {
 			graph->out().set_edge_translation(false);
 			graph->in().set_edge_translation(false);
 		}
+
+		IF_LL_PERSISTENCE(graph->storage()->end_deferred_sync());
 	}
 
 
@@ -320,6 +320,8 @@ public:
 
 		LL_D_PRINT("Load without stat, level=%lu\n", new_level);
 
+		IF_LL_PERSISTENCE(graph->storage()->begin_deferred_sync());
+
 
 		// Check features
 
@@ -356,15 +358,9 @@ public:
 
 		size_t degrees_capacity = 80 * 1000ul * 1000ul;
 		degree_t* degrees_out = NULL;
-		degree_t* degrees_in = NULL;
 		
 		degrees_out = (degree_t*) malloc(sizeof(*degrees_out)*degrees_capacity);
 		memset(degrees_out, 0, sizeof(*degrees_out) * degrees_capacity);
-		if (reverse) {
-			degrees_in = (degree_t*) malloc(
-					sizeof(*degrees_in) * degrees_capacity);
-			memset(degrees_in, 0, sizeof(*degrees_in) * degrees_capacity);
-		}
 
 
 		/*
@@ -451,13 +447,6 @@ public:
 						sizeof(*x)*(d-degrees_capacity));
 				degrees_out = x;
 
-				if (reverse) {
-					x = (degree_t*) realloc(degrees_in, sizeof(*degrees_in)*d);
-					memset(&x[degrees_capacity], 0,
-							sizeof(*x)*(d-degrees_capacity));
-					degrees_in = x;
-				}
-
 				degrees_capacity = d;
 			}
 
@@ -487,7 +476,6 @@ public:
 					last_tail = buffer->tail;
 
 					degrees_out[buffer->tail]++;
-					if (reverse) degrees_in[buffer->head]++;
 					buffer++;
 
 					index++;
@@ -528,10 +516,6 @@ public:
 						max_edges = 0;
 						memset(degrees_out, 0, sizeof(*degrees_out)
 								* degrees_capacity);
-						if (reverse) {
-							memset(degrees_in, 0, sizeof(*degrees_in)
-									* degrees_capacity);
-						}
 
 						out_sort = new ll_external_sort<xs_w_edge,
 								 xs_w_edge_comparator>(config);
@@ -555,19 +539,10 @@ public:
 							sizeof(*x)*(d-degrees_capacity));
 					degrees_out = x;
 
-					if (reverse) {
-						x = (degree_t*) realloc(degrees_in,
-								sizeof(*degrees_in)*d);
-						memset(&x[degrees_capacity], 0,
-								sizeof(*x)*(d-degrees_capacity));
-						degrees_in = x;
-					}
-
 					degrees_capacity = d;
 				}
 
 				degrees_out[e.tail]++;
-				if (reverse) degrees_in[e.head]++;
 
 				if (!already_sorted) {
 					*out_sort << e;
@@ -579,7 +554,6 @@ public:
 						max_edges++;
 
 						degrees_out[e.tail]++;
-						if (reverse) degrees_in[e.head]++;
 
 						if (!already_sorted) {
 							*out_sort << e;
@@ -604,7 +578,6 @@ public:
 		 * PASS 2
 		 *   - Write out the level, either by re-reading the input file if it
 		 *     is sorted or by pulling them out of external sort
-		 *   - Feed the edges into the in-edges external sort
 		 */
 
 		// Create the out-edges level
@@ -631,15 +604,6 @@ public:
 		if (load_weight) prop_weight = init_prop_weight(graph);
 
 
-		// Initialize the external sort for the in-edges
-
-		ll_external_sort<xs_in_edge, xs_in_edge_comparator>* in_sort = NULL;
-		if (reverse) {
-			in_sort = new ll_external_sort<xs_in_edge,
-					xs_in_edge_comparator>(config);
-		}
-
-
 		// Write the out-edges
 
 		if (print_progress) {
@@ -686,16 +650,6 @@ public:
 					prop_weight->cow_write(edge, e.weight);
 				}
 
-				if (reverse) {
-					xs_in_edge x;
-					x.head = e.head;
-					x.tail = e.tail;
-#ifdef LL_LOAD_CREATE_REV_EDGE_MAP
-					x.out_edge = edge;
-#endif
-					*in_sort << x;
-				}
-
 				index++;
 
 				if (print_progress) {
@@ -754,16 +708,6 @@ public:
 						prop_weight->cow_write(edge, e.weight);
 					}
 
-					if (reverse) {
-						xs_in_edge x;
-						x.head = buffer->head;
-						x.tail = buffer->tail;
-#ifdef LL_LOAD_CREATE_REV_EDGE_MAP
-						x.out_edge = edge;
-#endif
-						*in_sort << x;
-					}
-
 					index++;
 					buffer++;
 
@@ -793,89 +737,28 @@ public:
 
 		/*
 		 * PASS 3
-		 *   - Compute the in-edges, if applicable
+		 *   - Compute the in-edges from the new level, if applicable
 		 */
 
-		// Do the in-edges
-
 		if (reverse) {
 
 			if (print_progress) {
 				fprintf(stderr, "[I]");
 			}
 
-			graph->in().init_level_from_degrees(max_nodes, degrees_in, NULL); 
-			et = graph->in().edge_table(new_level);
-			vt = graph->in().vertex_table(new_level); (void) vt;
-
-
-			// If the out-to-in, in-to-out properties are not enabled, disable
-			// that feature in the corresponding ll_csr_base
-
-			if (!config->lc_reverse_edges || !config->lc_reverse_maps) {
-				graph->in().set_edge_translation(false);
-			}
-
-
-			// Sort the in edges and load them
-
-			in_sort->sort();
-
-			xs_in_edge* buffer;
-			size_t length;
-			size_t index = 0;
-
-			last_head = LL_NIL_NODE;
-			last_tail = LL_NIL_NODE;
-
-			while (in_sort->next_block(&buffer, &length)) {
-				while (length --> 0) {
-
-#ifdef LL_MLCSR_CONTINUATIONS
-					if (last_head != buffer->head) {
-						auto& vt_value = (*vt)[buffer->head];
-						assert(LL_EDGE_LEVEL(vt_value.adj_list_start)
-								== new_level);
-						index = LL_EDGE_INDEX(vt_value.adj_list_start);
-					}
-#endif
-
-					last_head = buffer->head;
-					last_tail = buffer->tail;
-
-					(*et)[index] = LL_VALUE_CREATE((node_t) buffer->tail);
-
-					// TODO Do the out-to-in, in-to-out properties if desired
-
-					index++;
-					buffer++;
-
-					if (print_progress) {
-						if (index % step == 0) {
-							fprintf(stderr, ".");
-							if (index % (step * 10) == 0) {
-								fprintf(stderr, "%lu", index / 1000000ul);
-							}
-						}
-					}
-				}
-			}
-
-			delete in_sort;
-			in_sort = NULL;
-
-			graph->in().finish_level_edges();
+			graph->make_reverse_edges(NULL, config->lc_xs_buffer_size);
 		}
 
 
 		// Finish
 
-		if (reverse) free(degrees_in);
 		free(degrees_out);
 
 		_last_has_more = _has_more;
 		_has_more = false;
 
+		IF_LL_PERSISTENCE(graph->storage()->end_deferred_sync());
+
 		return true;
 	}
 
@@ -916,20 +799,7 @@ public:
 			LL_D_NODE2_PRINT(e.tail, e.head, "%u --> %u\n", (unsigned) e.tail,
 					(unsigned) e.head);
 
-			ll_la_request_with_edge_properties* request;
-
-			if (HasWeight && load_weight) {
-				// XXX
-				//LL_NOT_IMPLEMENTED;
-			}
-
-#ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
-			request = new ll_la_add_edge_for_streaming_with_weights
-				<node_t>((node_t) e.tail, (node_t) e.head);
-#else
-			request = new ll_la_add_edge
-				<node_t>((node_t) e.tail, (node_t) e.head);
-#endif
+			ll_la_request* request = new_edge_request(e, load_weight);
 
 			size_t stripe = (e.tail >> (LL_ENTRIES_PER_PAGE_BITS+3))
 				% num_stripes;
@@ -943,6 +813,47 @@ public:
 	}
 
 
+	/**
+	 * Load the data into the ingest service
+	 *
+	 * @param ingest the ingest service
+	 * @param config the loader configuration
+	 * @return true if there are more edges to load
+	 */
+	bool load_to_ingest(ll_la_ingest* ingest, const ll_loader_config* config) {
+
+
+		// Check features
+
+		feature_vector_t features;
+		features << LL_L_FEATURE(lc_max_edges);
+		features << LL_L_FEATURE(lc_no_properties);
+
+		config->assert_features(false /*direct*/, true /*error*/, features);
+
+
+		// Initializie
+
+		size_t max_edges = 0;
+		size_t chunk_size = config->lc_max_edges;
+		bool load_weight = !config->lc_no_properties;
+
+		xs_w_edge e;
+		bool has_more;
+
+		while ((has_more = next_edge(&e.tail, &e.head, &e.weight))) {
+			max_edges++;
+
+			ingest->submit(new_edge_request(e, load_weight), (node_t) e.tail);
+
+			if (chunk_size > 0)
+				if (max_edges % chunk_size == 0) break;
+		}
+
+		return has_more;
+	}
+
+
 	/**
 	 * Load the graph into the writable representation
 	 *
@@ -1064,8 +975,53 @@ public:
 	}
 
 
+	/**
+	 * Load the next batch of data to the ingest service
+	 *
+	 * @param ingest the ingest service
+	 * @param max_edges the maximum number of edges
+	 * @return true if data was loaded, false if there are no more data
+	 */
+	virtual bool pull(ll_la_ingest* ingest, size_t max_edges) {
+
+		ll_loader_config config;
+		config.lc_max_edges = max_edges;
+
+		bool has_more = load_to_ingest(ingest, &config);
+
+		_last_has_more = _has_more;
+		_has_more = has_more;
+
+		return _last_has_more;
+	}
+
+
 private:
 
+	/**
+	 * Create a request to add an edge
+	 *
+	 * @param e the edge
+	 * @param load_weight whether to load the weight
+	 * @return the new request
+	 */
+	ll_la_request_with_edge_properties* new_edge_request(const xs_w_edge& e,
+			bool load_weight) {
+
+		if (HasWeight && load_weight) {
+			// XXX
+			//LL_NOT_IMPLEMENTED;
+		}
+
+#ifdef LL_S_WEIGHTS_INSTEAD_OF_DUPLICATE_EDGES
+		return new ll_la_add_edge_for_streaming_with_weights
+			<node_t>((node_t) e.tail, (node_t) e.head);
+#else
+		return new ll_la_add_edge<node_t>((node_t) e.tail, (node_t) e.head);
+#endif
+	}
+
+
 	/**
 	 * Initialize the weights property (if applicable)
 	 *
@@ -1217,6 +1173,8 @@ private:
 		size_t max_edges = 0;
 
 		xs_w_edge e;
+
+		IF_LL_PERSISTENCE(graph->storage()->begin_deferred_sync());
 		
 		if (!stat(&max_nodes, &max_edges)) {
 			LL_E_PRINT("The graph stat call failed\n");
@@ -1609,6 +1567,8 @@ private:
 		_last_has_more = _has_more;
 		_has_more = false;
 
+		IF_LL_PERSISTENCE(graph->storage()->end_deferred_sync());
+
 		return true;
 	}
 };
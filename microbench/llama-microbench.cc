@@ -0,0 +1,1157 @@
+/*
+ * llama-microbench.cc
+ * LLAMA Graph Analytics
+ *
+ * Copyright 2014
+ *      The President and Fellows of Harvard College.
+ *
+ * Copyright 2014
+ *      Oracle Labs.
+ *
+ * Redistribution and use in source and binary forms, with or without
+ * modification, are permitted provided that the following conditions
+ * are met:
+ * 1. Redistributions of source code must retain the above copyright
+ *    notice, this list of conditions and the following disclaimer.
+ * 2. Redistributions in binary form must reproduce the above copyright
+ *    notice, this list of conditions and the following disclaimer in the
+ *    documentation and/or other materials provided with the distribution.
+ * 3. Neither the name of the University nor the names of its contributors
+ *    may be used to endorse or promote products derived from this software
+ *    without specific prior written permission.
+ *
+ * THIS SOFTWARE IS PROVIDED BY THE UNIVERSITY AND CONTRIBUTORS ``AS IS'' AND
+ * ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO, THE
+ * IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+ * ARE DISCLAIMED.  IN NO EVENT SHALL THE UNIVERSITY OR CONTRIBUTORS BE LIABLE
+ * FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR CONSEQUENTIAL
+ * DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF SUBSTITUTE GOODS
+ * OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS INTERRUPTION)
+ * HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN CONTRACT, STRICT
+ * LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE) ARISING IN ANY WAY
+ * OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF THE POSSIBILITY OF
+ * SUCH DAMAGE.
+ */
+
+
+/**
+ * LLAMA Micro-Benchmarks: the core primitives in isolation (LL_MEMORY_ONLY)
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <getopt.h>
+#include <libgen.h>
+#include <string>
+#include <vector>
+
+#include <llama.h>
+
+#include "benchmarks/benchmark_results.h"
+
+
+//==========================================================================//
+// The Configuration                                                        //
+//==========================================================================//
+
+/// The number of nodes of the synthetic graphs
+static size_t g_nodes = 1ul << 18;
+
+/// The out-degree of each node of the synthetic graphs
+static size_t g_degree = 16;
+
+/// The maximum number of levels for the level sweeps
+static int g_max_levels = 8;
+
+/// The number of measured repetitions
+static int g_repeat = 7;
+
+/// The number of warm-up repetitions
+static int g_warmup = 1;
+
+/// The minimum duration of a repetition of a repeatable benchmark (ms)
+static double g_min_time_ms = 100;
+
+/// The maximum number of threads for the thread sweeps
+static int g_max_threads = 1;
+
+/// The random seed
+static unsigned g_seed = 42;
+
+/// Verbose output
+static bool g_verbose = false;
+
+/// The machine-readable results
+static ll_benchmark_results g_results;
+
+/// The sink for the computed values, so that they are not optimized out
+static volatile size_t g_sink;
+
+
+
+//==========================================================================//
+// The Measurement Harness                                                  //
+//==========================================================================//
+
+/**
+ * A micro-benchmark at one point of a parameter sweep
+ */
+class ll_microbenchmark {
+
+public:
+
+	/**
+	 * Destroy the benchmark
+	 */
+	virtual ~ll_microbenchmark() {}
+
+
+	/**
+	 * Prepare for a repetition (not timed)
+	 */
+	virtual void setup() {}
+
+
+	/**
+	 * Run the timed body
+	 *
+	 * @return the number of operations
+	 */
+	virtual size_t run() = 0;
+
+
+	/**
+	 * Clean up after a repetition (not timed)
+	 */
+	virtual void teardown() {}
+
+
+	/**
+	 * Determine whether run() can be called several times after a single
+	 * setup(), in which case it is repeated until each repetition takes at
+	 * least g_min_time_ms
+	 *
+	 * @return true if the body is repeatable
+	 */
+	virtual bool repeatable() { return false; }
+};
+
+
+/**
+ * Get the median
+ *
+ * @param v the vector
+ * @return the median
+ */
+static double median(std::vector<double> v) {
+
+	if (v.empty()) return 0;
+	std::sort(v.begin(), v.end());
+	size_t n = v.size();
+	return n % 2 == 1 ? v[n / 2] : 0.5 * (v[n / 2 - 1] + v[n / 2]);
+}
+
+
+/**
+ * Print the header of the results table
+ */
+static void print_header(void) {
+
+	printf("%-32s %10s %10s %20s %10s %10s\n", "Benchmark", "Ops/rep",
+			"Median ns", "Mean ns +- c95", "Min ns", "ms/rep");
+}
+
+
+/**
+ * Measure a benchmark: run the warm-up repetitions, then the measured ones,
+ * and report the time per operation
+ *
+ * @param name the series name
+ * @param b the benchmark
+ */
+static void measure(const std::string& name, ll_microbenchmark& b) {
+
+	std::vector<double> ns_per_op;
+	std::vector<double> ms_per_rep;
+	size_t ops = 0;
+
+	for (int r = -g_warmup; r < g_repeat; r++) {
+
+		b.setup();
+
+		size_t n = 0;
+		double t = 0;
+		do {
+			double ts = ll_get_time_ms();
+			n += b.run();
+			t += ll_get_time_ms() - ts;
+		}
+		while (b.repeatable() && t < g_min_time_ms);
+
+		b.teardown();
+
+		if (g_verbose) {
+			fprintf(stderr, "%s%s %d: %lu ops in %0.3lf ms\n", name.c_str(),
+					r < 0 ? " warm-up" : "", r < 0 ? r + g_warmup + 1 : r + 1,
+					n, t);
+		}
+
+		if (r < 0) continue;
+
+		ops = n;
+		ns_per_op.push_back(n == 0 ? 0 : t * 1e6 / n);
+		ms_per_rep.push_back(t);
+	}
+
+	char s[64];
+	snprintf(s, sizeof(s), "%0.2lf +- %0.2lf", ll_mean(ns_per_op),
+			ll_c95(ns_per_op));
+	printf("%-32s %10lu %10.2lf %20s %10.2lf %10.2lf\n", name.c_str(), ops,
+			median(ns_per_op), s, ll_min(ns_per_op), median(ms_per_rep));
+	fflush(stdout);
+
+	g_results.add_runs(name.c_str(), ns_per_op);
+}
+
+
+/**
+ * Format a series name
+ *
+ * @param benchmark the benchmark name
+ * @param param the parameter name
+ * @param value the parameter value
+ * @return the series name
+ */
+static std::string series_name(const char* benchmark, const char* param,
+		size_t value) {
+
+	char s[128];
+	snprintf(s, sizeof(s), "%s/%s=%lu", benchmark, param, value);
+	return s;
+}
+
+
+
+//==========================================================================//
+// Synthetic Graphs                                                         //
+//==========================================================================//
+
+/**
+ * A loader of a synthetic level, in which every node has the given number of
+ * out-edges to uniformly random nodes
+ */
+class ll_synthetic_loader : public ll_edge_list_loader<unsigned, false> {
+
+	size_t _nodes;
+	size_t _degree;
+	unsigned _seed;
+
+	unsigned _state;
+	size_t _node;
+	size_t _edge;
+
+
+public:
+
+	/**
+	 * Create an instance of ll_synthetic_loader
+	 *
+	 * @param nodes the number of nodes
+	 * @param degree the out-degree of each node
+	 * @param seed the random seed
+	 */
+	ll_synthetic_loader(size_t nodes, size_t degree, unsigned seed)
+		: ll_edge_list_loader<unsigned, false>() {
+
+		_nodes = nodes;
+		_degree = degree;
+		_seed = seed;
+
+		rewind();
+	}
+
+
+protected:
+
+	/**
+	 * Read the next edge
+	 *
+	 * @param o_tail the output for tail
+	 * @param o_head the output for head
+	 * @param o_weight the output for weight (ignored)
+	 * @return true if the edge was loaded, false if EOF
+	 */
+	virtual bool next_edge(unsigned* o_tail, unsigned* o_head,
+			float* o_weight) {
+
+		if (_node >= _nodes || _degree == 0) return false;
+
+		*o_tail = _node;
+		*o_head = ll_rand64_positive_r(&_state) % _nodes;
+
+		if (++_edge >= _degree) {
+			_edge = 0;
+			_node++;
+		}
+
+		return true;
+	}
+
+
+	/**
+	 * Rewind the input
+	 */
+	virtual void rewind() {
+		_state = _seed;
+		_node = 0;
+		_edge = 0;
+	}
+
+
+	/**
+	 * Get graph stats
+	 *
+	 * @param o_nodes the output for the number of nodes
+	 * @param o_edges the output for the number of edges
+	 * @return true
+	 */
+	virtual bool stat(size_t* o_nodes, size_t* o_edges) {
+		*o_nodes = _nodes;
+		*o_edges = _nodes * _degree;
+		return true;
+	}
+};
+
+
+/**
+ * Create a database with a synthetic graph of g_nodes nodes that spreads the
+ * g_degree out-edges of each node evenly across the given number of levels
+ *
+ * @param levels the number of levels
+ * @return the database
+ */
+static ll_database* create_synthetic_database(int levels) {
+
+	ll_database* database = new ll_database();
+	ll_writable_graph& G = *database->graph();
+
+	ll_loader_config config;
+	config.lc_reverse_edges = false;
+
+	for (int l = 0; l < levels; l++) {
+		size_t d = g_degree / levels + (l < (int) (g_degree % levels) ? 1 : 0);
+		ll_synthetic_loader loader(g_nodes, d, g_seed + 7919 * l);
+		if (!loader.load_direct(&G.ro_graph(), &config)) abort();
+		G.callback_ro_changed();
+	}
+
+	return database;
+}
+
+
+/**
+ * Generate random node pairs
+ *
+ * @param count the number of pairs
+ * @param seed the random seed
+ * @return the pairs
+ */
+static std::vector<std::pair<node_t, node_t> > random_pairs(size_t count,
+		unsigned seed) {
+
+	std::vector<std::pair<node_t, node_t> > v(count);
+	for (size_t i = 0; i < count; i++) {
+		v[i].first = ll_rand64_positive_r(&seed) % g_nodes;
+		v[i].second = ll_rand64_positive_r(&seed) % g_nodes;
+	}
+
+	return v;
+}
+
+
+
+//==========================================================================//
+// Benchmark: iter_begin/iter_next                                          //
+//==========================================================================//
+
+/**
+ * Scan the out-edges of all nodes using ll_mlcsr_core::iter_begin and
+ * iter_next
+ */
+class ll_mb_iter : public ll_microbenchmark {
+
+	ll_mlcsr_core& _out;
+
+public:
+
+	ll_mb_iter(ll_writable_graph& G) : _out(G.ro_graph().out()) {}
+
+	virtual bool repeatable() { return true; }
+
+	virtual size_t run() {
+
+		size_t edges = 0;
+		node_t sum = 0;
+		ll_edge_iterator iter;
+
+		for (node_t n = 0; n < (node_t) g_nodes; n++) {
+			_out.iter_begin(iter, n);
+			FOREACH_ITER(e, _out, iter) {
+				sum += iter.last_node;
+				edges++;
+			}
+		}
+
+		g_sink = sum;
+		return edges;
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: ll_mlcsr_core::find                                           //
+//==========================================================================//
+
+/**
+ * Look up edges using ll_mlcsr_core::find, half of which exist
+ */
+class ll_mb_find : public ll_microbenchmark {
+
+	ll_mlcsr_core& _out;
+	std::vector<std::pair<node_t, node_t> > _queries;
+
+public:
+
+	ll_mb_find(ll_writable_graph& G) : _out(G.ro_graph().out()) {
+
+		_queries = random_pairs(g_nodes, g_seed + 1);
+
+		ll_edge_iterator iter;
+		for (size_t i = 0; i < _queries.size(); i += 2) {
+			node_t n = _queries[i].first;
+			size_t k = _queries[i].second % g_degree;
+			_out.iter_begin(iter, n);
+			FOREACH_ITER(e, _out, iter) {
+				_queries[i].second = iter.last_node;
+				if (k-- == 0) break;
+			}
+		}
+	}
+
+	virtual bool repeatable() { return true; }
+
+	virtual size_t run() {
+
+		size_t found = 0;
+		for (size_t i = 0; i < _queries.size(); i++) {
+			if (_out.find(_queries[i].first, _queries[i].second)
+					!= LL_NIL_EDGE) found++;
+		}
+
+		g_sink = found;
+		return _queries.size();
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: ll_writable_graph::add_edge                                   //
+//==========================================================================//
+
+/**
+ * Add edges to the writable representation on top of a single read-only
+ * level, using the given number of threads
+ */
+class ll_mb_add_edge : public ll_microbenchmark {
+
+	int _threads;
+	std::vector<std::pair<node_t, node_t> > _edges;
+	ll_database* _database;
+
+public:
+
+	ll_mb_add_edge(int threads) {
+		_threads = threads;
+		_edges = random_pairs(g_nodes, g_seed + 2);
+		_database = NULL;
+	}
+
+	virtual void setup() {
+		_database = create_synthetic_database(1);
+	}
+
+	virtual size_t run() {
+
+		ll_writable_graph& G = *_database->graph();
+		size_t n = _edges.size();
+
+		#pragma omp parallel num_threads(_threads)
+		{
+			G.tx_begin();
+
+			#pragma omp for schedule(static)
+			for (size_t i = 0; i < n; i++) {
+				G.add_edge(_edges[i].first, _edges[i].second);
+			}
+
+			G.tx_commit();
+		}
+
+		return n;
+	}
+
+	virtual void teardown() {
+		delete _database;
+		_database = NULL;
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: ll_page_manager::allocate/cow                                 //
+//==========================================================================//
+
+/**
+ * Allocate pages, or copy-on-write them, using ll_page_manager
+ */
+class ll_mb_page_manager : public ll_microbenchmark {
+
+	ll_page_manager<uint64_t> _pm;
+	bool _cow;
+
+	std::vector<size_t> _ids;
+	std::vector<uint64_t*> _ptrs;
+
+public:
+
+	ll_mb_page_manager(size_t page_length, bool cow)
+		: _pm(page_length, false /* zero pages */) {
+
+		_cow = cow;
+
+		size_t pages = (64 * 1048576ul) / _pm.page_bytes();
+		if (pages > 65536) pages = 65536;
+		_ids.resize(pages);
+		_ptrs.resize(pages);
+	}
+
+	virtual void setup() {
+
+		if (!_cow) return;
+		for (size_t i = 0; i < _ids.size(); i++) {
+			_ids[i] = _pm.allocate(&_ptrs[i]);
+			memset(_ptrs[i], 0, _pm.page_bytes());
+		}
+	}
+
+	virtual size_t run() {
+
+		if (_cow) {
+			for (size_t i = 0; i < _ids.size(); i++) {
+				_ids[i] = _pm.cow(&_ptrs[i], _ids[i], _ptrs[i]);
+			}
+		}
+		else {
+			for (size_t i = 0; i < _ids.size(); i++) {
+				_ids[i] = _pm.allocate(&_ptrs[i]);
+			}
+		}
+
+		return _ids.size();
+	}
+
+	virtual void teardown() {
+		for (size_t i = 0; i < _ids.size(); i++) _pm.release_page(_ids[i]);
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: ll_external_sort                                              //
+//==========================================================================//
+
+/**
+ * An edge for the external sort
+ */
+struct ll_mb_xs_edge {
+	unsigned tail;
+	unsigned head;
+};
+
+
+/**
+ * Comparator for ll_mb_xs_edge
+ */
+struct ll_mb_xs_edge_comparator {
+	bool operator() (const ll_mb_xs_edge& a, const ll_mb_xs_edge& b) {
+		if (a.tail != b.tail)
+			return a.tail < b.tail;
+		else
+			return a.head < b.head;
+	}
+};
+
+
+/**
+ * Feed random edges to ll_external_sort, sort them, and read them back
+ */
+class ll_mb_external_sort : public ll_microbenchmark {
+
+	std::vector<ll_mb_xs_edge> _edges;
+	ll_external_sort<ll_mb_xs_edge, ll_mb_xs_edge_comparator>* _sort;
+
+public:
+
+	ll_mb_external_sort(size_t count) {
+
+		_edges.resize(count);
+		unsigned seed = g_seed + 3;
+		for (size_t i = 0; i < count; i++) {
+			_edges[i].tail = ll_rand64_positive_r(&seed) % g_nodes;
+			_edges[i].head = ll_rand64_positive_r(&seed) % g_nodes;
+		}
+
+		_sort = NULL;
+	}
+
+	virtual void setup() {
+		_sort = new ll_external_sort<ll_mb_xs_edge,
+			  ll_mb_xs_edge_comparator>();
+	}
+
+	virtual size_t run() {
+
+		for (size_t i = 0; i < _edges.size(); i++) *_sort << _edges[i];
+		_sort->sort();
+
+		ll_mb_xs_edge* buffer;
+		size_t length;
+		size_t n = 0;
+		unsigned sum = 0;
+
+		while (_sort->next_block(&buffer, &length)) {
+			n += length;
+			while (length --> 0) sum += (buffer++)->head;
+		}
+
+		g_sink = sum;
+
+		if (n != _edges.size()) {
+			LL_E_PRINT("The external sort returned %lu out of %lu elements\n",
+					n, _edges.size());
+			abort();
+		}
+
+		return n;
+	}
+
+	virtual void teardown() {
+		delete _sort;
+		_sort = NULL;
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: Node Properties                                               //
+//==========================================================================//
+
+/**
+ * Create a node property with the given number of levels, the first of which
+ * is dense and the others copy-on-write a random 1/16 of the nodes
+ *
+ * @param levels the number of levels
+ * @return the property
+ */
+static ll_mlcsr_node_property<uint64_t>* create_synthetic_property(
+		int levels) {
+
+	ll_mlcsr_node_property<uint64_t>* p
+		= new ll_mlcsr_node_property<uint64_t>(0, "microbench", LL_T_INT64);
+
+	p->dense_init_level(g_nodes);
+	for (node_t n = 0; n < (node_t) g_nodes; n++) p->dense_direct_write(n, n);
+	p->dense_finish_level();
+
+	unsigned seed = g_seed + 4;
+	for (int l = 1; l < levels; l++) {
+		p->cow_init_level(g_nodes);
+		for (size_t i = 0; i < g_nodes / 16; i++) {
+			node_t n = ll_rand64_positive_r(&seed) % g_nodes;
+			p->cow_write(n, n + l);
+		}
+		p->cow_finish_level();
+	}
+
+	return p;
+}
+
+
+/**
+ * Read random values of a node property with the given number of levels
+ */
+class ll_mb_property_get : public ll_microbenchmark {
+
+	ll_mlcsr_node_property<uint64_t>* _property;
+	std::vector<std::pair<node_t, node_t> > _queries;
+
+public:
+
+	ll_mb_property_get(int levels) {
+		_property = create_synthetic_property(levels);
+		_queries = random_pairs(g_nodes, g_seed + 5);
+	}
+
+	virtual ~ll_mb_property_get() {
+		delete _property;
+	}
+
+	virtual bool repeatable() { return true; }
+
+	virtual size_t run() {
+
+		uint64_t sum = 0;
+		for (size_t i = 0; i < _queries.size(); i++) {
+			sum += _property->get(_queries[i].first);
+		}
+
+		g_sink = sum;
+		return _queries.size();
+	}
+};
+
+
+/**
+ * Write the given number of random values to a new copy-on-write level of a
+ * node property
+ */
+class ll_mb_property_cow_write : public ll_microbenchmark {
+
+	ll_mlcsr_node_property<uint64_t>* _property;
+	std::vector<std::pair<node_t, node_t> > _writes;
+
+public:
+
+	ll_mb_property_cow_write(size_t writes) {
+		_property = NULL;
+		_writes = random_pairs(writes, g_seed + 6);
+	}
+
+	virtual void setup() {
+		_property = create_synthetic_property(1);
+		_property->cow_init_level(g_nodes);
+	}
+
+	virtual size_t run() {
+
+		for (size_t i = 0; i < _writes.size(); i++) {
+			_property->cow_write(_writes[i].first, _writes[i].second);
+		}
+
+		return _writes.size();
+	}
+
+	virtual void teardown() {
+		_property->cow_finish_level();
+		delete _property;
+		_property = NULL;
+	}
+};
+
+
+
+//==========================================================================//
+// Benchmark: ll_writable_graph::checkpoint                                 //
+//==========================================================================//
+
+/**
+ * Checkpoint a writable representation with the given number of edges on top
+ * of a single read-only level
+ */
+class ll_mb_checkpoint : public ll_microbenchmark {
+
+	std::vector<std::pair<node_t, node_t> > _edges;
+	ll_database* _database;
+
+public:
+
+	ll_mb_checkpoint(size_t edges) {
+		_edges = random_pairs(edges, g_seed + 7);
+		_database = NULL;
+	}
+
+	virtual void setup() {
+
+		_database = create_synthetic_database(1);
+		ll_writable_graph& G = *_database->graph();
+
+		G.tx_begin();
+		for (size_t i = 0; i < _edges.size(); i++) {
+			G.add_edge(_edges[i].first, _edges[i].second);
+		}
+		G.tx_commit();
+	}
+
+	virtual size_t run() {
+		_database->graph()->checkpoint();
+		return _edges.size();
+	}
+
+	virtual void teardown() {
+		delete _database;
+		_database = NULL;
+	}
+};
+
+
+
+//==========================================================================//
+// The Benchmark Suite                                                      //
+//==========================================================================//
+
+/**
+ * The available benchmarks
+ */
+static const char* g_benchmarks[][2] = {
+	{ "iter"      , "Scan all out-edges using iter_begin/iter_next vs. levels" },
+	{ "find"      , "Look up edges using ll_mlcsr_core::find vs. levels" },
+	{ "add_edge"  , "Add edges to the writable representation vs. threads" },
+	{ "page"      , "Allocate and COW pages using ll_page_manager vs. page size" },
+	{ "xs"        , "Sort edges using ll_external_sort vs. the number of edges" },
+	{ "property"  , "Node property get vs. levels and cow_write vs. writes" },
+	{ "checkpoint", "Checkpoint vs. the size of the writable representation" },
+	{ NULL, NULL }
+};
+
+
+/**
+ * Run the level sweep of the iterator and find benchmarks
+ *
+ * @param iter true to run the iterator benchmark
+ * @param find true to run the find benchmark
+ */
+static void run_level_sweep(bool iter, bool find) {
+
+	for (int levels = 1; levels <= g_max_levels; levels *= 2) {
+
+		ll_database* database = create_synthetic_database(levels);
+		ll_writable_graph& G = *database->graph();
+
+		if (iter) {
+			ll_mb_iter b(G);
+			measure(series_name("iter", "levels", levels), b);
+		}
+
+		if (find) {
+			ll_mb_find b(G);
+			measure(series_name("find", "levels", levels), b);
+		}
+
+		delete database;
+	}
+}
+
+
+/**
+ * Run a benchmark
+ *
+ * @param name the benchmark name
+ */
+static void run_benchmark(const std::string& name) {
+
+	size_t edges = g_nodes * g_degree;
+
+	if (name == "iter" || name == "find") {
+		run_level_sweep(name == "iter", name == "find");
+	}
+
+	else if (name == "add_edge") {
+		for (int t = 1; t <= g_max_threads; t *= 2) {
+			ll_mb_add_edge b(t);
+			measure(series_name("add_edge", "threads", t), b);
+		}
+	}
+
+	else if (name == "page") {
+		for (int k = -2; k <= 2; k += 2) {
+			size_t length = 1ul << (LL_ENTRIES_PER_PAGE_BITS + k);
+			ll_mb_page_manager a(length, false);
+			measure(series_name("page_allocate", "length", length), a);
+			ll_mb_page_manager c(length, true);
+			measure(series_name("page_cow", "length", length), c);
+		}
+	}
+
+	else if (name == "xs") {
+		for (size_t n = edges / 16; n <= edges; n *= 4) {
+			ll_mb_external_sort b(n);
+			measure(series_name("xs", "edges", n), b);
+		}
+	}
+
+	else if (name == "property") {
+		for (int levels = 1; levels <= g_max_levels; levels *= 2) {
+			ll_mb_property_get b(levels);
+			measure(series_name("property_get", "levels", levels), b);
+		}
+		for (size_t n = g_nodes / 64; n <= g_nodes; n *= 8) {
+			ll_mb_property_cow_write b(n);
+			measure(series_name("property_cow_write", "writes", n), b);
+		}
+	}
+
+	else if (name == "checkpoint") {
+		for (size_t n = edges / 64; n <= edges / 4; n *= 4) {
+			ll_mb_checkpoint b(n);
+			measure(series_name("checkpoint", "edges", n), b);
+		}
+	}
+
+	else {
+		abort();
+	}
+}
+
+
+
+//==========================================================================//
+// The Command-Line Arguments                                               //
+//==========================================================================//
+
+static const char* SHORT_OPTIONS = "d:hJ:j:l:Ln:r:s:T:t:vw:";
+
+static struct option LONG_OPTIONS[] =
+{
+	{"degree"         , required_argument, 0, 'd'},
+	{"help"           , no_argument,       0, 'h'},
+	{"compare-results", required_argument, 0, 'J'},
+	{"results"        , required_argument, 0, 'j'},
+	{"levels"         , required_argument, 0, 'l'},
+	{"list"           , no_argument,       0, 'L'},
+	{"nodes"          , required_argument, 0, 'n'},
+	{"repeat"         , required_argument, 0, 'r'},
+	{"seed"           , required_argument, 0, 's'},
+	{"min-time"       , required_argument, 0, 'T'},
+	{"threads"        , required_argument, 0, 't'},
+	{"verbose"        , no_argument,       0, 'v'},
+	{"warmup"         , required_argument, 0, 'w'},
+	{0, 0, 0, 0}
+};
+
+
+/**
+ * Print the usage information
+ *
+ * @param arg0 the first element in the argv array
+ */
+static void usage(const char* arg0) {
+
+	char* s = strdup(arg0);
+	char* p = basename(s);
+	fprintf(stderr, "Usage: %s [OPTIONS] [BENCHMARK...]\n\n", p);
+	free(s);
+	
+	fprintf(stderr, "Options:\n");
+	fprintf(stderr, "  -d, --degree N        Set the out-degree of the synthetic graphs\n");
+	fprintf(stderr, "  -h, --help            Show this usage information and exit\n");
+	fprintf(stderr, "  -J, --compare-results FILE  Compare the results to a baseline\n");
+	fprintf(stderr, "  -j, --results FILE    Save the results as JSON or CSV (by extension)\n");
+	fprintf(stderr, "  -l, --levels N        Set the maximum number of levels to sweep\n");
+	fprintf(stderr, "  -L, --list            List the benchmarks and exit\n");
+	fprintf(stderr, "  -n, --nodes N         Set the number of nodes of the synthetic graphs\n");
+	fprintf(stderr, "  -r, --repeat N        Set the number of measured repetitions\n");
+	fprintf(stderr, "  -s, --seed N          Set the random seed\n");
+	fprintf(stderr, "  -T, --min-time MS     Set the minimum time of a repeatable repetition\n");
+	fprintf(stderr, "  -t, --threads N       Set the maximum number of threads to sweep\n");
+	fprintf(stderr, "  -v, --verbose         Enable verbose output\n");
+	fprintf(stderr, "  -w, --warmup N        Set the number of warm-up repetitions\n");
+	fprintf(stderr, "\nThe results are in ns per operation; run all benchmarks by default.\n");
+}
+
+
+/**
+ * List the benchmarks
+ */
+static void list_benchmarks(void) {
+
+	for (int i = 0; g_benchmarks[i][0] != NULL; i++) {
+		printf("%-12s %s\n", g_benchmarks[i][0], g_benchmarks[i][1]);
+	}
+}
+
+
+
+//==========================================================================//
+// The Main Function                                                        //
+//==========================================================================//
+
+/**
+ * The main function
+ */
+int main(int argc, char** argv)
+{
+	const char* results_file = NULL;
+	const char* compare_file = NULL;
+
+	g_max_threads = omp_get_max_threads();
+
+
+	// Parse the command-line arguments
+
+	int option_index = 0;
+	while (true) {
+		int c = getopt_long(argc, argv, SHORT_OPTIONS, LONG_OPTIONS, &option_index);
+
+		if (c == -1) break;
+
+		switch (c) {
+
+			case 'd':
+				g_degree = atol(optarg);
+				if (g_degree <= 0) {
+					fprintf(stderr, "Error: Invalid out-degree\n");
+					return 1;
+				}
+				break;
+
+			case 'h':
+				usage(argv[0]);
+				return 0;
+
+			case 'J':
+				compare_file = optarg;
+				break;
+
+			case 'j':
+				results_file = optarg;
+				break;
+
+			case 'l':
+				g_max_levels = atoi(optarg);
+				if (g_max_levels <= 0) {
+					fprintf(stderr, "Error: Invalid number of levels\n");
+					return 1;
+				}
+				break;
+
+			case 'L':
+				list_benchmarks();
+				return 0;
+
+			case 'n':
+				g_nodes = atol(optarg);
+				if (g_nodes < 64) {
+					fprintf(stderr, "Error: Need at least 64 nodes\n");
+					return 1;
+				}
+				break;
+
+			case 'r':
+				g_repeat = atoi(optarg);
+				if (g_repeat <= 0) {
+					fprintf(stderr, "Error: Invalid number of repetitions\n");
+					return 1;
+				}
+				break;
+
+			case 's':
+				g_seed = atoi(optarg);
+				break;
+
+			case 'T':
+				g_min_time_ms = atof(optarg);
+				break;
+
+			case 't':
+				g_max_threads = atoi(optarg);
+				if (g_max_threads <= 0) {
+					fprintf(stderr, "Error: Invalid number of threads\n");
+					return 1;
+				}
+				break;
+
+			case 'v':
+				g_verbose = true;
+				break;
+
+			case 'w':
+				g_warmup = atoi(optarg);
+				if (g_warmup < 0) {
+					fprintf(stderr, "Error: Invalid number of warm-up repetitions\n");
+					return 1;
+				}
+				break;
+
+			case '?':
+			case ':':
+				return 1;
+
+			default:
+				abort();
+		}
+	}
+
+	if (g_max_levels > (int) g_degree) {
+		fprintf(stderr, "Warning: Limiting the number of levels to the degree\n");
+		g_max_levels = g_degree;
+	}
+
+
+	// Get the benchmarks to run
+
+	std::vector<std::string> benchmarks;
+	for (int i = optind; i < argc; i++) {
+		bool found = false;
+		for (int j = 0; g_benchmarks[j][0] != NULL; j++) {
+			if (strcmp(argv[i], g_benchmarks[j][0]) == 0) found = true;
+		}
+		if (!found) {
+			fprintf(stderr, "Error: Unknown benchmark \"%s\"\n", argv[i]);
+			return 1;
+		}
+		benchmarks.push_back(argv[i]);
+	}
+
+	if (benchmarks.empty()) {
+		for (int j = 0; g_benchmarks[j][0] != NULL; j++) {
+			benchmarks.push_back(g_benchmarks[j][0]);
+		}
+	}
+
+
+	// Run
+
+	g_results.set_config("nodes", g_nodes);
+	g_results.set_config("degree", g_degree);
+	g_results.set_config("levels", g_max_levels);
+	g_results.set_config("threads", g_max_threads);
+	g_results.set_config("seed", g_seed);
+
+	print_header();
+	for (size_t i = 0; i < benchmarks.size(); i++) {
+		run_benchmark(benchmarks[i]);
+	}
+
+
+	// Save and compare the results
+
+	if (results_file != NULL) {
+		if (!g_results.save(results_file)) return 1;
+	}
+
+	if (compare_file != NULL) {
+		ll_benchmark_results baseline;
+		if (!baseline.load_file(compare_file)) return 1;
+		printf("\n");
+		if (ll_compare_results(baseline, g_results) > 0) return 2;
+	}
+
+	return 0;
+}
@@ -212,6 +212,7 @@ int main(int argc, char** argv)
 	ll_database database(database_directory);
 	if (num_threads > 0) database.set_num_threads(num_threads);
 	ll_writable_graph& graph = *database.graph();
+	database.recover();
 
 
 	// Load the graph